@@ -39,30 +39,38 @@
    in = in > ((1<<bits)-1) ? ((1<<bits)-1) : in;\
    out=in;
 
+/*
+ * borders are cleared within the rows [first, first+count) of the tile
+ * only, rgb pointing at row first, pixels of ps samples
+ */
 static void
-ClearBorders_uint16(uint16_t * rgb, int sx, int sy, int w)
+ClearBorders_uint16(uint16_t * rgb, int sx, int sy, int w, int ps, int first, int count)
 {
-    int i, j;
-
-    // black edges:
-    i = 3 * sx * w - 1;
-    j = 3 * sx * sy - 1;
-    while (i >= 0) {
-        rgb[i--] = 0;
-        rgb[j--] = 0;
-    }
-
-    int low = sx * (w - 1) * 3 - 1 + w * 3;
-    i = low + sx * (sy - w * 2 + 1) * 3;
-    while (i > low) {
-        j = 6 * w;
-        while (j > 0) {
-            rgb[i--] = 0;
-            j--;
+    int row, col, c;
+
+    for (row = first; row < first + count; row++) {
+        uint16_t *line = rgb + (row - first) * sx * ps;
+        for (col = 0; col < sx; col++) {
+            if (row >= w && row < sy - w && col == w)
+                col = sx - w;
+            for (c = 0; c < 3; c++)
+                line[col * ps + c] = 0;
         }
-        i -= (sx - 2 * w) * 3;
     }
+}
+
+/* black last row and last column, for the methods not reaching them */
+static void
+BlackBorders_uint16(uint16_t * rgb, int sx, int sy, int ps, int first, int count)
+{
+    int row, col, c;
 
+    for (row = first; row < first + count; row++) {
+        uint16_t *line = rgb + (row - first) * sx * ps;
+        for (col = row == sy - 1 ? 0 : sx - 1; col < sx; col++)
+            for (c = 0; c < 3; c++)
+                line[col * ps + c] = 0;
+    }
 }
 
 /**************************************************************
@@ -78,34 +86,27 @@ ClearBorders_uint16(uint16_t * rgb, int sx, int sy, int w)
 
 /* insprired by OpenCV's Bayer decoding */
 static dc1394error_t
-dc1394_bayer_NearestNeighbor_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits)
+dc1394_bayer_NearestNeighbor_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits,
+        int ps, int bgr, int first, int count)
 {
     const int bayerStep = sx;
-    const int rgbStep = 3 * sx;
+    const int rgbStep = ps * sx;
     int width = sx;
     int height = sy;
     int blue = tile == DC1394_COLOR_FILTER_BGGR
         || tile == DC1394_COLOR_FILTER_GBRG ? -1 : 1;
     int start_with_green = tile == DC1394_COLOR_FILTER_GBRG
         || tile == DC1394_COLOR_FILTER_GRBG;
-    int i, iinc, imax;
 
     if ((tile>DC1394_COLOR_FILTER_MAX)||(tile<DC1394_COLOR_FILTER_MIN))
       return DC1394_INVALID_COLOR_FILTER;
+    if (bgr)
+        blue = -blue;
 
     /* add black border */
-    imax = sx * sy * 3;
-    for (i = sx * (sy - 1) * 3; i < imax; i++) {
-        rgb[i] = 0;
-    }
-    iinc = (sx - 1) * 3;
-    for (i = (sx - 1) * 3; i < imax; i += iinc) {
-        rgb[i++] = 0;
-        rgb[i++] = 0;
-        rgb[i++] = 0;
-    }
+    BlackBorders_uint16(rgb, sx, sy, ps, first, count);
 
-    rgb += 1;
+    rgb += -first * rgbStep + 1;
     height -= 1;
     width -= 1;
 
@@ -118,28 +119,28 @@ dc1394_bayer_NearestNeighbor_uint16(const uint16_t *restrict bayer, uint16_t *re
             rgb[0] = bayer[bayerStep + 1];
             rgb[blue] = bayer[bayerStep];
             bayer++;
-            rgb += 3;
+            rgb += ps;
         }
 
         if (blue > 0) {
-            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 6) {
+            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 2 * ps) {
                 rgb[-1] = bayer[0];
                 rgb[0] = bayer[1];
                 rgb[1] = bayer[bayerStep + 1];
 
-                rgb[2] = bayer[2];
-                rgb[3] = bayer[bayerStep + 2];
-                rgb[4] = bayer[bayerStep + 1];
+                rgb[ps - 1] = bayer[2];
+                rgb[ps] = bayer[bayerStep + 2];
+                rgb[ps + 1] = bayer[bayerStep + 1];
             }
         } else {
-            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 6) {
+            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 2 * ps) {
                 rgb[1] = bayer[0];
                 rgb[0] = bayer[1];
                 rgb[-1] = bayer[bayerStep + 1];
 
-                rgb[4] = bayer[2];
-                rgb[3] = bayer[bayerStep + 2];
-                rgb[2] = bayer[bayerStep + 1];
+                rgb[ps + 1] = bayer[2];
+                rgb[ps] = bayer[bayerStep + 2];
+                rgb[ps - 1] = bayer[bayerStep + 1];
             }
         }
 
@@ -148,11 +149,11 @@ dc1394_bayer_NearestNeighbor_uint16(const uint16_t *restrict bayer, uint16_t *re
             rgb[0] = bayer[1];
             rgb[blue] = bayer[bayerStep + 1];
             bayer++;
-            rgb += 3;
+            rgb += ps;
         }
 
         bayer -= width;
-        rgb -= width * 3;
+        rgb -= width * ps;
 
         blue = -blue;
         start_with_green = !start_with_green;
@@ -163,10 +164,11 @@ dc1394_bayer_NearestNeighbor_uint16(const uint16_t *restrict bayer, uint16_t *re
 }
 /* OpenCV's Bayer decoding */
 static dc1394error_t
-dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits)
+dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits,
+        int ps, int bgr, int first, int count)
 {
     const int bayerStep = sx;
-    const int rgbStep = 3 * sx;
+    const int rgbStep = ps * sx;
     int width = sx;
     int height = sy;
     int blue = tile == DC1394_COLOR_FILTER_BGGR
@@ -176,8 +178,10 @@ dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
 
     if ((tile>DC1394_COLOR_FILTER_MAX)||(tile<DC1394_COLOR_FILTER_MIN))
       return DC1394_INVALID_COLOR_FILTER;
+    if (bgr)
+        blue = -blue;
 
-    rgb += rgbStep + 3 + 1;
+    rgb += (1 - first) * rgbStep + ps + 1;
     height -= 2;
     width -= 2;
 
@@ -194,11 +198,11 @@ dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
             rgb[0] = bayer[bayerStep + 1];
             rgb[blue] = (uint16_t) t1;
             bayer++;
-            rgb += 3;
+            rgb += ps;
         }
 
         if (blue > 0) {
-            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 6) {
+            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 2 * ps) {
                 t0 = (bayer[0] + bayer[2] + bayer[bayerStep * 2] +
                       bayer[bayerStep * 2 + 2] + 2) >> 2;
                 t1 = (bayer[1] + bayer[bayerStep] +
@@ -211,12 +215,12 @@ dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                 t0 = (bayer[2] + bayer[bayerStep * 2 + 2] + 1) >> 1;
                 t1 = (bayer[bayerStep + 1] + bayer[bayerStep + 3] +
                       1) >> 1;
-                rgb[2] = (uint16_t) t0;
-                rgb[3] = bayer[bayerStep + 2];
-                rgb[4] = (uint16_t) t1;
+                rgb[ps - 1] = (uint16_t) t0;
+                rgb[ps] = bayer[bayerStep + 2];
+                rgb[ps + 1] = (uint16_t) t1;
             }
         } else {
-            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 6) {
+            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 2 * ps) {
                 t0 = (bayer[0] + bayer[2] + bayer[bayerStep * 2] +
                       bayer[bayerStep * 2 + 2] + 2) >> 2;
                 t1 = (bayer[1] + bayer[bayerStep] +
@@ -229,9 +233,9 @@ dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                 t0 = (bayer[2] + bayer[bayerStep * 2 + 2] + 1) >> 1;
                 t1 = (bayer[bayerStep + 1] + bayer[bayerStep + 3] +
                       1) >> 1;
-                rgb[4] = (uint16_t) t0;
-                rgb[3] = bayer[bayerStep + 2];
-                rgb[2] = (uint16_t) t1;
+                rgb[ps + 1] = (uint16_t) t0;
+                rgb[ps] = bayer[bayerStep + 2];
+                rgb[ps - 1] = (uint16_t) t1;
             }
         }
 
@@ -245,11 +249,11 @@ dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
             rgb[0] = (uint16_t) t1;
             rgb[blue] = bayer[bayerStep + 1];
             bayer++;
-            rgb += 3;
+            rgb += ps;
         }
 
         bayer -= width;
-        rgb -= width * 3;
+        rgb -= width * ps;
 
         blue = -blue;
         start_with_green = !start_with_green;
@@ -263,10 +267,11 @@ dc1394_bayer_Bilinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
    Bayer-Patterned Color Images, by Henrique S. Malvar, Li-wei He, and
    Ross Cutler, in ICASSP'04 */
 static dc1394error_t
-dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits)
+dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits,
+        int ps, int bgr, int first, int count)
 {
     const int bayerStep = sx;
-    const int rgbStep = 3 * sx;
+    const int rgbStep = ps * sx;
     int width = sx;
     int height = sy;
     /*
@@ -288,9 +293,11 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
 
     if ((tile>DC1394_COLOR_FILTER_MAX)||(tile<DC1394_COLOR_FILTER_MIN))
       return DC1394_INVALID_COLOR_FILTER;
+    if (bgr)
+        blue = -blue;
 
-    ClearBorders_uint16(rgb, sx, sy, 2);
-    rgb += 2 * rgbStep + 6 + 1;
+    ClearBorders_uint16(rgb, sx, sy, 2, ps, first, count);
+    rgb += (2 - first) * rgbStep + 2 * ps + 1;
     height -= 4;
     width -= 4;
 
@@ -330,11 +337,11 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
             t1 = (t1 + 4) >> 3;
             CLIP16(t1, rgb[blue], bits);
             bayer++;
-            rgb += 3;
+            rgb += ps;
         }
 
         if (blue > 0) {
-            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 6) {
+            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 2 * ps) {
                 /* B at B */
                 rgb[1] = bayer[bayerStep2 + 2];
                 /* R at B */
@@ -357,8 +364,8 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                 t1 = (t1 + 4) >> 3;
                 CLIP16(t1, rgb[0], bits);
                 /* at green pixel */
-                rgb[3] = bayer[bayerStep2 + 3];
-                t0 = rgb[3] * 5
+                rgb[ps] = bayer[bayerStep2 + 3];
+                t0 = rgb[ps] * 5
                     + ((bayer[bayerStep + 3] + bayer[bayerStep3 + 3]) << 2)
                     - bayer[3]
                     - bayer[bayerStep + 2]
@@ -369,7 +376,7 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                     +
                     ((bayer[bayerStep2 + 1] + bayer[bayerStep2 + 5] +
                       1) >> 1);
-                t1 = rgb[3] * 5 +
+                t1 = rgb[ps] * 5 +
                     ((bayer[bayerStep2 + 2] + bayer[bayerStep2 + 4]) << 2)
                     - bayer[bayerStep2 + 1]
                     - bayer[bayerStep + 2]
@@ -379,12 +386,12 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                     - bayer[bayerStep2 + 5]
                     + ((bayer[3] + bayer[bayerStep4 + 3] + 1) >> 1);
                 t0 = (t0 + 4) >> 3;
-                CLIP16(t0, rgb[2], bits);
+                CLIP16(t0, rgb[ps - 1], bits);
                 t1 = (t1 + 4) >> 3;
-                CLIP16(t1, rgb[4], bits);
+                CLIP16(t1, rgb[ps + 1], bits);
             }
         } else {
-            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 6) {
+            for (; bayer <= bayerEnd - 2; bayer += 2, rgb += 2 * ps) {
                 /* R at R */
                 rgb[-1] = bayer[bayerStep2 + 2];
                 /* B at R */
@@ -408,8 +415,8 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                 CLIP16(t1, rgb[0], bits);
 
                 /* at green pixel */
-                rgb[3] = bayer[bayerStep2 + 3];
-                t0 = rgb[3] * 5
+                rgb[ps] = bayer[bayerStep2 + 3];
+                t0 = rgb[ps] * 5
                     + ((bayer[bayerStep + 3] + bayer[bayerStep3 + 3]) << 2)
                     - bayer[3]
                     - bayer[bayerStep + 2]
@@ -420,7 +427,7 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                     +
                     ((bayer[bayerStep2 + 1] + bayer[bayerStep2 + 5] +
                       1) >> 1);
-                t1 = rgb[3] * 5 +
+                t1 = rgb[ps] * 5 +
                     ((bayer[bayerStep2 + 2] + bayer[bayerStep2 + 4]) << 2)
                     - bayer[bayerStep2 + 1]
                     - bayer[bayerStep + 2]
@@ -430,9 +437,9 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
                     - bayer[bayerStep2 + 5]
                     + ((bayer[3] + bayer[bayerStep4 + 3] + 1) >> 1);
                 t0 = (t0 + 4) >> 3;
-                CLIP16(t0, rgb[4], bits);
+                CLIP16(t0, rgb[ps + 1], bits);
                 t1 = (t1 + 4) >> 3;
-                CLIP16(t1, rgb[2], bits);
+                CLIP16(t1, rgb[ps - 1], bits);
             }
         }
 
@@ -458,11 +465,11 @@ dc1394_bayer_HQLinear_uint16(const uint16_t *restrict bayer, uint16_t *restrict
             t1 = (t1 + 4) >> 3;
             CLIP16(t1, rgb[0], bits);
             bayer++;
-            rgb += 3;
+            rgb += ps;
         }
 
         bayer -= width;
-        rgb -= width * 3;
+        rgb -= width * ps;
 
         blue = -blue;
         start_with_green = !start_with_green;
@@ -541,7 +548,8 @@ dc1394_bayer_Downsample_uint16(const uint16_t *restrict bayer, uint16_t *restric
 
 /* coriander's Bayer decoding */
 static dc1394error_t
-dc1394_bayer_Simple_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits)
+dc1394_bayer_Simple_uint16(const uint16_t *restrict bayer, uint16_t *restrict rgb, int sx, int sy, int tile, int bits,
+        int ps, int bgr, int first, int count)
 {
     uint16_t *outR, *outG, *outB;
     int i, j;
@@ -585,6 +593,12 @@ dc1394_bayer_Simple_uint16(const uint16_t *restrict bayer, uint16_t *restrict rg
         break;
     }
 
+    if (bgr) {
+        uint16_t *swap = outR;
+        outR = outB;
+        outB = swap;
+    }
+
     switch (tile) {
     case DC1394_COLOR_FILTER_GRBG:        //---------------------------------------------------------
     case DC1394_COLOR_FILTER_GBRG:
@@ -592,44 +606,44 @@ dc1394_bayer_Simple_uint16(const uint16_t *restrict bayer, uint16_t *restrict rg
             for (j = 0; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base] + bayer[base + sx + 1]) >> 1);
-                CLIP16(tmp, outG[base * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base + 1];
-                CLIP16(tmp, outR[base * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base + sx];
-                CLIP16(tmp, outB[base * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         for (i = 0; i < sy - 1; i += 2) {
             for (j = 1; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base + 1] + bayer[base + sx]) >> 1);
-                CLIP16(tmp, outG[(base) * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base];
-                CLIP16(tmp, outR[(base) * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base + 1 + sx];
-                CLIP16(tmp, outB[(base) * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         for (i = 1; i < sy - 1; i += 2) {
             for (j = 0; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base + sx] + bayer[base + 1]) >> 1);
-                CLIP16(tmp, outG[base * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base + sx + 1];
-                CLIP16(tmp, outR[base * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base];
-                CLIP16(tmp, outB[base * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         for (i = 1; i < sy - 1; i += 2) {
             for (j = 1; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base] + bayer[base + 1 + sx]) >> 1);
-                CLIP16(tmp, outG[(base) * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base + sx];
-                CLIP16(tmp, outR[(base) * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base + 1];
-                CLIP16(tmp, outB[(base) * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         break;
@@ -639,58 +653,51 @@ dc1394_bayer_Simple_uint16(const uint16_t *restrict bayer, uint16_t *restrict rg
             for (j = 0; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base + sx] + bayer[base + 1]) >> 1);
-                CLIP16(tmp, outG[base * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base + sx + 1];
-                CLIP16(tmp, outR[base * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base];
-                CLIP16(tmp, outB[base * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         for (i = 1; i < sy - 1; i += 2) {
             for (j = 0; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base] + bayer[base + 1 + sx]) >> 1);
-                CLIP16(tmp, outG[(base) * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base + 1];
-                CLIP16(tmp, outR[(base) * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base + sx];
-                CLIP16(tmp, outB[(base) * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         for (i = 0; i < sy - 1; i += 2) {
             for (j = 1; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base] + bayer[base + sx + 1]) >> 1);
-                CLIP16(tmp, outG[base * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base + sx];
-                CLIP16(tmp, outR[base * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base + 1];
-                CLIP16(tmp, outB[base * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         for (i = 1; i < sy - 1; i += 2) {
             for (j = 1; j < sx - 1; j += 2) {
                 base = i * sx + j;
                 tmp = ((bayer[base + 1] + bayer[base + sx]) >> 1);
-                CLIP16(tmp, outG[(base) * 3], bits);
+                CLIP16(tmp, outG[(base - first * sx) * ps], bits);
                 tmp = bayer[base];
-                CLIP16(tmp, outR[(base) * 3], bits);
+                CLIP16(tmp, outR[(base - first * sx) * ps], bits);
                 tmp = bayer[base + 1 + sx];
-                CLIP16(tmp, outB[(base) * 3], bits);
+                CLIP16(tmp, outB[(base - first * sx) * ps], bits);
             }
         }
         break;
     }
 
     /* add black border */
-    for (i = sx * (sy - 1) * 3; i < sx * sy * 3; i++) {
-        rgb[i] = 0;
-    }
-    for (i = (sx - 1) * 3; i < sx * sy * 3; i += (sx - 1) * 3) {
-        rgb[i++] = 0;
-        rgb[i++] = 0;
-        rgb[i++] = 0;
-    }
+    BlackBorders_uint16(rgb, sx, sy, ps, first, count);
 
     return DC1394_SUCCESS;
 
@@ -762,7 +769,7 @@ dc1394_bayer_VNG_uint16(const uint16_t *restrict bayer,
                         dc1394color_filter_t pattern, int bits)
 {
     const int height = sy, width = sx;
-    static const signed char *cp;
+    const signed char *cp;
     /* the following has the same type as the image */
     uint16_t (*brow[5])[3], *pix;          /* [FD] */
     int code[8][2][320], *ip, gval[8], gmin, gmax, sum[4];
@@ -772,7 +779,7 @@ dc1394_bayer_VNG_uint16(const uint16_t *restrict bayer,
 
     /* first, use bilinear bayer decoding */
 
-    dc1394_bayer_Bilinear_uint16(bayer, dst, sx, sy, pattern, bits);
+    dc1394_bayer_Bilinear_uint16(bayer, dst, sx, sy, pattern, bits, 3, 0, 0, sy);
 
     switch(pattern) {
     case DC1394_COLOR_FILTER_BGGR:
@@ -1103,18 +1110,28 @@ dc1394_bayer_AHD_uint16(const uint16_t *restrict bayer,
     return DC1394_SUCCESS;
 }
 
+/* builds the AHD tables, to be called before decoding from several threads */
+void
+dc1394_bayer_init(void)
+{
+    if (ahd_inited==DC1394_FALSE) {
+        cam_to_cielab (NULL,NULL);
+        ahd_inited = DC1394_TRUE;
+    }
+}
+
 dc1394error_t
 dc1394_bayer_decoding_16bit(const uint16_t *restrict bayer, uint16_t *restrict rgb, uint32_t sx, uint32_t sy, dc1394color_filter_t tile, dc1394bayer_method_t method, uint32_t bits)
 {
     switch (method) {
     case DC1394_BAYER_METHOD_NEAREST:
-        return dc1394_bayer_NearestNeighbor_uint16(bayer, rgb, sx, sy, tile, bits);
+        return dc1394_bayer_NearestNeighbor_uint16(bayer, rgb, sx, sy, tile, bits, 3, 0, 0, sy);
     case DC1394_BAYER_METHOD_SIMPLE:
-        return dc1394_bayer_Simple_uint16(bayer, rgb, sx, sy, tile, bits);
+        return dc1394_bayer_Simple_uint16(bayer, rgb, sx, sy, tile, bits, 3, 0, 0, sy);
     case DC1394_BAYER_METHOD_BILINEAR:
-        return dc1394_bayer_Bilinear_uint16(bayer, rgb, sx, sy, tile, bits);
+        return dc1394_bayer_Bilinear_uint16(bayer, rgb, sx, sy, tile, bits, 3, 0, 0, sy);
     case DC1394_BAYER_METHOD_HQLINEAR:
-        return dc1394_bayer_HQLinear_uint16(bayer, rgb, sx, sy, tile, bits);
+        return dc1394_bayer_HQLinear_uint16(bayer, rgb, sx, sy, tile, bits, 3, 0, 0, sy);
     case DC1394_BAYER_METHOD_DOWNSAMPLE:
         return dc1394_bayer_Downsample_uint16(bayer, rgb, sx, sy, tile, bits);
     case DC1394_BAYER_METHOD_EDGESENSE:
@@ -1129,3 +1146,53 @@ dc1394_bayer_decoding_16bit(const uint16_t *restrict bayer, uint16_t *restrict r
 
 }
 
+int
+dc1394_bayer_reach(dc1394bayer_method_t method, int *above, int *below)
+{
+    switch (method) {
+    case DC1394_BAYER_METHOD_NEAREST:
+    case DC1394_BAYER_METHOD_SIMPLE:
+        *above = 0;
+        *below = 1;
+        return 1;
+    case DC1394_BAYER_METHOD_BILINEAR:
+        *above = 1;
+        *below = 1;
+        return 1;
+    case DC1394_BAYER_METHOD_HQLINEAR:
+        *above = 2;
+        *below = 2;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+dc1394error_t
+dc1394_bayer_decoding_16bit_rows(const uint16_t *restrict bayer, uint16_t *restrict rgb,
+                                 uint32_t sx, uint32_t sy, uint32_t ps, int bgr,
+                                 uint32_t first, uint32_t count,
+                                 dc1394color_filter_t tile, dc1394bayer_method_t method,
+                                 uint32_t bits)
+{
+    int above, below;
+
+    if (!dc1394_bayer_reach(method, &above, &below))
+        return DC1394_FUNCTION_NOT_SUPPORTED;
+    /* the rows computed by the method must all be in the window */
+    if (ps < 3 || first + count > sy ||
+        (int)first > above || (int)(first + count) < (int)sy - below)
+        return DC1394_INVALID_ARGUMENT_VALUE;
+    switch (method) {
+    case DC1394_BAYER_METHOD_NEAREST:
+        return dc1394_bayer_NearestNeighbor_uint16(bayer, rgb, sx, sy, tile, bits, ps, bgr, first, count);
+    case DC1394_BAYER_METHOD_SIMPLE:
+        return dc1394_bayer_Simple_uint16(bayer, rgb, sx, sy, tile, bits, ps, bgr, first, count);
+    case DC1394_BAYER_METHOD_BILINEAR:
+        return dc1394_bayer_Bilinear_uint16(bayer, rgb, sx, sy, tile, bits, ps, bgr, first, count);
+    case DC1394_BAYER_METHOD_HQLINEAR:
+        return dc1394_bayer_HQLinear_uint16(bayer, rgb, sx, sy, tile, bits, ps, bgr, first, count);
+    default:
+        return DC1394_INVALID_BAYER_METHOD;
+    }
+}
@@ -182,11 +182,34 @@ dc1394_deinterlace_stereo(uint8_t *src, uint8_t *dest, uint32_t width, uint32_t
 /**
  * Perform de-mosaicing on an 16-bit image buffer
  */
+void
+dc1394_bayer_init(void);
+
 dc1394error_t
 dc1394_bayer_decoding_16bit(const uint16_t *bayer, uint16_t *rgb,
                             uint32_t width, uint32_t height, dc1394color_filter_t tile,
                             dc1394bayer_method_t method, uint32_t bits);
 
+/**
+ * Rows of the tile read by a method above and below the rows it writes,
+ * returns 0 for the methods using the whole tile as working memory
+ */
+int
+dc1394_bayer_reach(dc1394bayer_method_t method, int *above, int *below);
+
+/**
+ * Perform de-mosaicing of the rows [first, first+count) of a tile straight
+ * into pixels of ps samples, green being the second one, blue the first
+ * one if bgr is set. rgb points at row first, the other rows are never
+ * written and the window must hold all the rows the method computes
+ */
+dc1394error_t
+dc1394_bayer_decoding_16bit_rows(const uint16_t *bayer, uint16_t *rgb,
+                                 uint32_t width, uint32_t height,
+                                 uint32_t ps, int bgr, uint32_t first, uint32_t count,
+                                 dc1394color_filter_t tile,
+                                 dc1394bayer_method_t method, uint32_t bits);
+
 
 #ifdef __cplusplus
 }
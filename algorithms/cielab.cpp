@@ -31,6 +31,7 @@
 #include <Magick++.h>
 #include "cielab.h"
 #include "photo.h"
+#include "hdr.h"
 
 /*
 //convertion rgv <-> lch depuis ufraw et dcraw
@@ -72,3 +73,100 @@ const double rgb_xyz[3][3] = {
 
 // Illuminent D65
 const double illuminant[3] = { 0.95047, 1.00000, 1.08883 };
+
+/* covers the XYZ of the whole RGB cube, with some headroom */
+#define LAB_LUT_MAX 2.f
+#define LAB_LUT_SIZE 8192
+
+static float labLut[LAB_LUT_SIZE+2];
+
+static class LabLutInit {
+public:
+    LabLutInit() {
+        for ( int i = 0 ; i < LAB_LUT_SIZE+2 ; ++i ) {
+            double t = double(i) * LAB_LUT_MAX / LAB_LUT_SIZE;
+            labLut[i] = t > __lab_epsilon ? cbrt(t) : ( __lab_kappa * t + 16. ) / 116.;
+        }
+    }
+} labLutInit;
+
+float lab_f(float t)
+{
+    if ( t >= LAB_LUT_MAX )
+        return cbrtf(t);
+    float idx = ( t > 0 ? t : 0 ) * ( LAB_LUT_SIZE / LAB_LUT_MAX );
+    int i = int(idx);
+    float frac = idx - i;
+    return labLut[i] + frac * ( labLut[i+1] - labLut[i] );
+}
+
+void RGB_to_LinearLab_row(const Magick::PixelPacket *src, int w, bool hdr,
+                          float *L, float *a, float *b)
+{
+    /* planar rgb, in the output buffers */
+    if ( hdr ) {
+        for ( int x = 0 ; x < w ; ++x ) {
+            L[x] = fromHDR(src[x].red);
+            a[x] = fromHDR(src[x].green);
+            b[x] = fromHDR(src[x].blue);
+        }
+    }
+    else {
+        for ( int x = 0 ; x < w ; ++x ) {
+            L[x] = src[x].red;
+            a[x] = src[x].green;
+            b[x] = src[x].blue;
+        }
+    }
+    float m[3][3];
+    for ( int i = 0 ; i < 3 ; ++i )
+        for ( int j = 0 ; j < 3 ; ++j )
+            m[i][j] = xyz_rgb[i][j] / ( 65535. * illuminant[i] );
+    for ( int x = 0 ; x < w ; ++x ) {
+        float r = L[x], g = a[x], bl = b[x];
+        float xr = m[0][0]*r + m[0][1]*g + m[0][2]*bl;
+        float yr = m[1][0]*r + m[1][1]*g + m[1][2]*bl;
+        float zr = m[2][0]*r + m[2][1]*g + m[2][2]*bl;
+        float fx = lab_f(xr);
+        float fy = lab_f(yr);
+        float fz = lab_f(zr);
+        L[x] = yr;
+        a[x] = 500.f * (fx - fy);
+        b[x] = 200.f * (fy - fz);
+    }
+}
+
+void LinearLab_to_RGB_row(float *L, float *a, float *b, int w, bool hdr,
+                          Magick::PixelPacket *dst)
+{
+    float m[3][3];
+    for ( int i = 0 ; i < 3 ; ++i )
+        for ( int j = 0 ; j < 3 ; ++j )
+            m[i][j] = rgb_xyz[i][j] * illuminant[j] * 65535.;
+    for ( int x = 0 ; x < w ; ++x ) {
+        float yr = L[x];
+        float fy = lab_f(yr);
+        float xr = lab_f_inverse(a[x]/500.f + fy);
+        float zr = lab_f_inverse(fy - b[x]/200.f);
+        float r = m[0][0]*xr + m[0][1]*yr + m[0][2]*zr;
+        float g = m[1][0]*xr + m[1][1]*yr + m[1][2]*zr;
+        float bl = m[2][0]*xr + m[2][1]*yr + m[2][2]*zr;
+        L[x] = r < 0 ? 0 : r > 65535.f ? 65535.f : r;
+        a[x] = g < 0 ? 0 : g > 65535.f ? 65535.f : g;
+        b[x] = bl < 0 ? 0 : bl > 65535.f ? 65535.f : bl;
+    }
+    if ( hdr ) {
+        for ( int x = 0 ; x < w ; ++x ) {
+            dst[x].red = toHDR(L[x]);
+            dst[x].green = toHDR(a[x]);
+            dst[x].blue = toHDR(b[x]);
+        }
+    }
+    else {
+        for ( int x = 0 ; x < w ; ++x ) {
+            dst[x].red = L[x] + .5f;
+            dst[x].green = a[x] + .5f;
+            dst[x].blue = b[x] + .5f;
+        }
+    }
+}
@@ -217,4 +217,42 @@ do { \
 	if ( rgb[2] > QuantumRange ) rgb[2] = QuantumRange; \
 } while(0)
 
+/*
+ * row kernels of the linear Lab conversions above, in single precision
+ * on planar buffers so that the compiler vectorizes the arithmetic.
+ * the Lab companding reads its cube root from a table with linear
+ * interpolation, the error on L is below 0.0005
+ */
+float lab_f(float t);
+
+static inline float lab_f_inverse(float u) {
+    float u3 = u*u*u;
+    return u3 > float(__lab_epsilon) ? u3 : (116.f*u-16.f)/float(__lab_kappa);
+}
+
+static inline float lab_linearize_f(float l) {
+    return l <= float(__lab_kappa*__lab_epsilon)
+            ? l/float(__lab_kappa)
+            : lab_f_inverse((l+16.f)/116.f);
+}
+
+static inline float lab_gammaize_f(float v) {
+    return 116.f * lab_f(v) - 16.f;
+}
+
+/**
+ * @param src pixels of a row, linear or HDR
+ * @param[out] L a b w floats each, Lab [0..1,-120..120,-120..120]
+ */
+void RGB_to_LinearLab_row(const Magick::PixelPacket *src, int w, bool hdr,
+                          float *L, float *a, float *b);
+
+/**
+ * @param L a b w floats each, Lab [0..1,-120..120,-120..120]
+ * @param[out] dst pixels of a row, linear or HDR
+ * @note L, a and b are clobbered
+ */
+void LinearLab_to_RGB_row(float *L, float *a, float *b, int w, bool hdr,
+                          Magick::PixelPacket *dst);
+
 #endif // CIELAB_H
@@ -29,6 +29,7 @@
  *
  */
 #include <cmath>
+#include <vector>
 #include "desaturateshadows.h"
 #include "photo.h"
 #include <Magick++.h>
@@ -90,44 +91,27 @@ void DesaturateShadows::applyOnImage(Magick::Image& image, bool hdr)
             error=true;
             continue;
         }
+        std::vector<float> buffer(3*w);
+        std::vector<char> changed(w, 0);
+        float *L = &buffer[0];
+        float *a = &buffer[w];
+        float *b = &buffer[2*w];
+        RGB_to_LinearLab_row(src, w, hdr, L, a, b);
         for ( int x = 0 ; x < w ; ++x ) {
-            double rgb[3];
-            if (hdr) {
-                rgb[0]=fromHDR(src[x].red);
-                rgb[1]=fromHDR(src[x].green);
-                rgb[2]=fromHDR(src[x].blue);
-            }
-            else {
-                rgb[0]=src[x].red;
-                rgb[1]=src[x].green;
-                rgb[2]=src[x].blue;
-            }
-            double lab[3];
-            RGB_to_LinearLab(rgb,lab);
-            quantum_t L= DF_ROUND(lab[0]*QuantumRange);
-            if ( L > QuantumRange ) L=QuantumRange;
-            if ( ! DF_EQUALS(m_lut[L],1.,.00001) )
-            {
-                lab[1]*=m_lut[L];
-                lab[2]*=m_lut[L];
-                LinearLab_to_RGB(lab,rgb);
-                if (hdr) {
-                    pixels[x].red = toHDR(rgb[0]);
-                    pixels[x].green = toHDR(rgb[1]);
-                    pixels[x].blue = toHDR(rgb[2]);
-                }
-                else {
-                    pixels[x].red = DF_ROUND(rgb[0]);
-                    pixels[x].green = DF_ROUND(rgb[1]);
-                    pixels[x].blue = DF_ROUND(rgb[2]);
-                }
-            }
-            else {
-                pixels[x].red = src[x].red;
-                pixels[x].green = src[x].green;
-                pixels[x].blue = src[x].blue;
+            quantum_t l = DF_ROUND(L[x]*QuantumRange);
+            if ( l > QuantumRange ) l=QuantumRange;
+            if ( ! DF_EQUALS(m_lut[l],1.,.00001) ) {
+                a[x]*=m_lut[l];
+                b[x]*=m_lut[l];
+                changed[x] = 1;
             }
         }
+        LinearLab_to_RGB_row(L, a, b, w, hdr, pixels);
+        /* pixels out of the shadows are copied verbatim */
+        for ( int x = 0 ; x < w ; ++x ) {
+            if ( !changed[x] )
+                pixels[x] = src[x];
+        }
         pixel_cache->sync();
     });
 }
@@ -60,6 +60,9 @@ DiscreteFourierTransform::DiscreteFourierTransform(Magick::Image &image, Photo::
     Ordinary::Pixels cache(image);
     const Magick::PixelPacket *pixels = cache.getConst(0, 0, m_w, m_h);
     for (int c = 0 ; c < 3 ; ++c ) {
+        /* the worker is stopped, its result will be discarded */
+        if ( DfInterrupted() )
+            break;
         for ( int y = 0 ; y < m_h ; ++y ) {
             for ( int x = 0 ; x < m_w ; ++x ) {
                 quantum_t p = 0;
@@ -148,6 +151,8 @@ Magick::Image DiscreteFourierTransform::reverse(double luminosity, ReverseType t
     std::complex<double> *input = reinterpret_cast<std::complex<double>*>(fftw_alloc_complex(m_h*m_w));
     std::complex<double> *output = reinterpret_cast<std::complex<double>*>(fftw_alloc_complex(m_h*m_w));
     for ( int c = 0 ; c < 3 ; ++c ) {
+        if ( DfInterrupted() )
+            break;
         std::complex<double> *plane = 0;
         switch(c) {
         case 0: plane = red; break;
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QSaveFile>
+#include <QDateTime>
+#include <QLocale>
+#include <QVector>
+
+#include <cstring>
+#include <memory>
+
+#include "fitswriter.h"
+#include "photo.h"
+#include "hdr.h"
+#include "ports.h"
+
+using Magick::Quantum;
+
+#define FITS_BLOCK 2880
+#define FITS_CARD 80
+
+static QByteArray card(const char *key, const QByteArray& value,
+                       const char *comment = NULL)
+{
+    QByteArray c = QByteArray(key).leftJustified(8, ' ', true);
+    if ( !value.isNull() )
+        c += "= " + value;
+    if ( comment )
+        c += " / " + QByteArray(comment);
+    return c.leftJustified(FITS_CARD, ' ', true);
+}
+
+static QByteArray comment(const char *text)
+{
+    return ("COMMENT " + QByteArray(text)).leftJustified(FITS_CARD, ' ', true);
+}
+
+static QByteArray numeric(const QByteArray& value)
+{
+    return value.rightJustified(20);
+}
+
+static QByteArray quoted(const QString& str)
+{
+    QByteArray v = str.toLatin1();
+    v.replace("'", "''");
+    return "'" + v.leftJustified(8).left(68) + "'";
+}
+
+FitsWriter::FitsWriter(Format format, QObject *parent) :
+    QObject(parent),
+    m_format(format),
+    m_errorString()
+{
+}
+
+QString FitsWriter::errorString() const
+{
+    return m_errorString;
+}
+
+bool FitsWriter::write(Photo &photo, const QString &filename)
+{
+    Magick::Image& image = photo.image();
+    int w = image.columns();
+    int h = image.rows();
+    int planes = photo.getTag(TAG_PIXELS) == TAG_PIXELS_CFA ? 1 : 3;
+    QSaveFile file(filename);
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        m_errorString = file.errorString();
+        return false;
+    }
+    QByteArray hdr = header(photo, w, h, planes);
+    if ( file.write(hdr) != hdr.size() ||
+         !writeData(photo, file, w, h, planes) ||
+         !file.commit() ) {
+        if ( m_errorString.isEmpty() )
+            m_errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QByteArray FitsWriter::header(Photo &photo, int w, int h, int planes) const
+{
+    QByteArray hdr;
+    hdr += card("SIMPLE", numeric("T"), "conforms to FITS standard");
+    hdr += card("BITPIX", numeric(m_format == Float32 ? "-32" : "16"));
+    hdr += card("NAXIS", numeric(planes == 1 ? "2" : "3"));
+    hdr += card("NAXIS1", numeric(QByteArray::number(w)));
+    hdr += card("NAXIS2", numeric(QByteArray::number(h)));
+    if ( planes != 1 )
+        hdr += card("NAXIS3", numeric(QByteArray::number(planes)), "red, green, blue");
+    if ( m_format == Integer16 ) {
+        hdr += card("BZERO", numeric("32768"), "unsigned 16-bit data");
+        hdr += card("BSCALE", numeric("1"));
+    }
+    else {
+        hdr += comment(photo.getScale() == Photo::HDR
+                       ? "linear HDR data, 1.0 is the full scale of the source"
+                       : "data normalized to 1.0");
+    }
+    hdr += card("CREATOR", quoted("darkflow"));
+
+    bool ok;
+    double v = photo.getTag(TAG_SHUTTER).toDouble(&ok);
+    if ( ok && v > 0 )
+        hdr += card("EXPTIME", numeric(QByteArray::number(v, 'g', 10)), "[s] exposure time");
+    v = photo.getTag(TAG_ISO_SPEED).toDouble(&ok);
+    if ( ok && v > 0 )
+        hdr += card("ISOSPEED", numeric(QByteArray::number(v, 'g', 10)));
+    v = photo.getTag(TAG_FOCAL_LENGTH).toDouble(&ok);
+    if ( ok && v > 0 )
+        hdr += card("FOCALLEN", numeric(QByteArray::number(v, 'g', 10)), "[mm] focal length");
+    v = photo.getTag(TAG_APERTURE).toDouble(&ok);
+    if ( ok && v > 0 )
+        hdr += card("APERTURE", numeric(QByteArray::number(v, 'g', 10)), "f-number");
+    QString camera = photo.getTag(TAG_CAMERA);
+    if ( !camera.isEmpty() )
+        hdr += card("INSTRUME", quoted(camera));
+    QDateTime date = QLocale::c().toDateTime(photo.getTag(TAG_TIMESTAMP).simplified(),
+                                             TAG_TIMESTAMP_FORMAT);
+    if ( date.isValid() )
+        hdr += card("DATE-OBS", quoted(date.toString("yyyy-MM-dd'T'hh:mm:ss")));
+    QString name = photo.getTag(TAG_NAME);
+    if ( !name.isEmpty() )
+        hdr += card("FILENAME", quoted(name));
+    if ( planes == 1 ) {
+        QString pattern = photo.getTag(TAG_FILTER_PATTERN);
+        pattern.remove('/');
+        if ( pattern.count() >= 4 )
+            hdr += card("BAYERPAT", quoted(pattern.left(4)));
+    }
+    hdr += card("END", QByteArray());
+    int pad = (FITS_BLOCK - hdr.size() % FITS_BLOCK) % FITS_BLOCK;
+    return hdr + QByteArray(pad, ' ');
+}
+
+bool FitsWriter::writeData(Photo &photo, QIODevice &device, int w, int h, int planes)
+{
+    bool hdr = photo.getScale() == Photo::HDR;
+    int sampleSize = m_format == Float32 ? 4 : 2;
+    QVector<char> row(w * sampleSize);
+    qint64 written = 0;
+    std::shared_ptr<Ordinary::Pixels> cache(new Ordinary::Pixels(photo.image()));
+    for ( int c = 0 ; c < planes ; ++c ) {
+        /* FITS images start at the bottom row */
+        for ( int y = h - 1 ; y >= 0 ; --y ) {
+            const Magick::PixelPacket *pixels = cache->getConst(0, y, w, 1);
+            if ( !pixels ) {
+                m_errorString = tr("Unable to read pixels");
+                return false;
+            }
+            unsigned char *dst = reinterpret_cast<unsigned char*>(row.data());
+            for ( int x = 0 ; x < w ; ++x ) {
+                quantum_t q = c == 0 ? pixels[x].red
+                            : c == 1 ? pixels[x].green
+                                     : pixels[x].blue;
+                if ( m_format == Float32 ) {
+                    float f = (hdr ? fromHDR(q) : q) / QuantumRange;
+                    quint32 u;
+                    memcpy(&u, &f, sizeof(u));
+                    dst[0] = u >> 24;
+                    dst[1] = u >> 16;
+                    dst[2] = u >> 8;
+                    dst[3] = u;
+                    dst += 4;
+                }
+                else {
+                    /* BZERO offset: flip the sign bit */
+                    dst[0] = (q >> 8) ^ 0x80;
+                    dst[1] = q;
+                    dst += 2;
+                }
+            }
+            if ( device.write(row.data(), row.size()) != row.size() )
+                return false;
+            written += row.size();
+        }
+    }
+    int pad = (FITS_BLOCK - written % FITS_BLOCK) % FITS_BLOCK;
+    if ( pad )
+        return device.write(QByteArray(pad, '\0')) == pad;
+    return true;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef FITSWRITER_H
+#define FITSWRITER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+
+class Photo;
+class QIODevice;
+
+/*
+ * Native FITS encoder. Rows are converted and written one at a time, so
+ * the encoded file is never held in memory. RGB photos are written as a
+ * 3 planes cube, CFA photos as a single plane with their Bayer pattern.
+ */
+class FitsWriter : public QObject
+{
+    Q_OBJECT
+public:
+    typedef enum {
+        Integer16,
+        Float32
+    } Format;
+
+    explicit FitsWriter(Format format, QObject *parent = 0);
+
+    bool write(Photo& photo, const QString& filename);
+    QString errorString() const;
+
+private:
+    QByteArray header(Photo& photo, int w, int h, int planes) const;
+    bool writeData(Photo& photo, QIODevice& device, int w, int h, int planes);
+
+    Format m_format;
+    QString m_errorString;
+};
+
+#endif // FITSWRITER_H
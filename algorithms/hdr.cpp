@@ -59,7 +59,8 @@ HDR::HDR(bool revert, QObject *parent) :
     LutBased(parent),
     m_revert(revert)
 {
-
+    /* the tables may be kept for the whole session */
+    DfUninterruptible uninterruptible;
     dfl_parallel_for(i, 0, int(QuantumRange+1), 1024, (), {
         m_hdrLut[i] = clamp( revert
                           ? DF_ROUND(fromHDR(i))
@@ -29,6 +29,7 @@
  *
  */
 #include "hotpixels.h"
+#include <algorithm>
 #include <Magick++.h>
 #include "hdr.h"
 #include "console.h"
@@ -70,26 +71,82 @@ HotPixels::HotPixels(double delta, bool aggressive, bool naive, QObject *parent)
     other_channels = (rgb[(q+2)%3]+rgb[(q+1)%3])/2; \
     sum_rgb[q]-=(max_rgb[q]+min_rgb[q]); \
     sum_rgb[q]/=6; \
-    if ( sum_rgb[q]*m_delta < rgb[q] && other_channels*m_delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
-    if ( sum_rgb[q]/m_delta > rgb[q] && other_channels/m_delta > rgb[q] ) rgb[q]=sum_rgb[q];
+    if ( sum_rgb[q]*delta < rgb[q] && other_channels*delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
+    if ( sum_rgb[q]/delta > rgb[q] && other_channels/delta > rgb[q] ) rgb[q]=sum_rgb[q];
 
 #define color_op2_naive(q) \
     other_channels = (rgb[(q+2)%3]+rgb[(q+1)%3])/2; \
     sum_rgb[q]/=8; \
-    if ( sum_rgb[q]*m_delta < rgb[q] && other_channels*m_delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
-    if ( sum_rgb[q]/m_delta > rgb[q] && other_channels/m_delta > rgb[q] ) rgb[q]=sum_rgb[q];
+    if ( sum_rgb[q]*delta < rgb[q] && other_channels*delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
+    if ( sum_rgb[q]/delta > rgb[q] && other_channels/delta > rgb[q] ) rgb[q]=sum_rgb[q];
 
 
 #define color_op2_aggressive(q) \
     sum_rgb[q]-=(max_rgb[q]+min_rgb[q]); \
     sum_rgb[q]/=6; \
-    if ( sum_rgb[q]*m_delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
-    if ( sum_rgb[q]/m_delta > rgb[q] ) rgb[q]=sum_rgb[q];
+    if ( sum_rgb[q]*delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
+    if ( sum_rgb[q]/delta > rgb[q] ) rgb[q]=sum_rgb[q];
 
 #define color_op2_naive_aggressive(q) \
     sum_rgb[q]/=8; \
-    if ( sum_rgb[q]*m_delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
-    if ( sum_rgb[q]/m_delta > rgb[q] ) rgb[q]=sum_rgb[q];
+    if ( sum_rgb[q]*delta < rgb[q] ) rgb[q]=sum_rgb[q]; \
+    if ( sum_rgb[q]/delta > rgb[q] ) rgb[q]=sum_rgb[q];
+
+/*
+ * replaces in rgb the channels of pixel x of the middle row that stand out
+ * of their 3x3 neighbourhood, returns the mask of the replaced channels
+ */
+static unsigned char evaluate(const Magick::PixelPacket *input_pixels[3], int x, bool hdr,
+                              double delta, bool aggressive, bool naive,
+                              extended_quantum_t rgb[3])
+{
+    extended_quantum_t max_rgb[3]={0,0,0};
+    extended_quantum_t min_rgb[3]={QuantumRange,QuantumRange,QuantumRange};
+    extended_quantum_t sum_rgb[3]={0,0,0};
+    extended_quantum_t orig[3];
+    extended_quantum_t nrgb[3];
+    extended_quantum_t other_channels=0;
+
+    if (hdr) {
+        rgb[0]=DF_ROUND(fromHDR(input_pixels[1][x].red));
+        rgb[1]=DF_ROUND(fromHDR(input_pixels[1][x].green));
+        rgb[2]=DF_ROUND(fromHDR(input_pixels[1][x].blue));
+    }
+    else {
+        rgb[0]=input_pixels[1][x].red;
+        rgb[1]=input_pixels[1][x].green;
+        rgb[2]=input_pixels[1][x].blue;
+    }
+    orig[0]=rgb[0]; orig[1]=rgb[1]; orig[2]=rgb[2];
+
+    if ( naive ) {
+        loop_code_naive(-1,-1); loop_code_naive(-1, 0); loop_code_naive(-1, 1);
+        loop_code_naive( 0,-1);                         loop_code_naive( 0, 1);
+        loop_code_naive( 1,-1); loop_code_naive( 1, 0); loop_code_naive( 1, 1);
+
+        if ( aggressive ) {
+            color_op2_naive_aggressive(0); color_op2_naive_aggressive(1); color_op2_naive_aggressive(2);
+        }
+        else {
+            color_op2_naive(0); color_op2_naive(1); color_op2_naive(2);
+        }
+    }
+    else {
+        loop_code(-1,-1); loop_code(-1, 0); loop_code(-1, 1);
+        loop_code( 0,-1);                   loop_code( 0, 1);
+        loop_code( 1,-1); loop_code( 1, 0); loop_code( 1, 1);
+
+        if ( aggressive ) {
+            color_op2_aggressive(0); color_op2_aggressive(1); color_op2_aggressive(2);
+        }
+        else {
+            color_op2(0); color_op2(1); color_op2(2);
+        }
+    }
+    return ( rgb[0] != orig[0] ? 1 : 0 ) |
+           ( rgb[1] != orig[1] ? 2 : 0 ) |
+           ( rgb[2] != orig[2] ? 4 : 0 );
+}
 
 void HotPixels::applyOnImage(Magick::Image &image, bool hdr)
 {
@@ -116,49 +173,8 @@ void HotPixels::applyOnImage(Magick::Image &image, bool hdr)
             continue;
         }
         for ( int x = 1 ; x < w-1 ; ++x ) {
-            extended_quantum_t max_rgb[3]={0,0,0};
-            extended_quantum_t min_rgb[3]={QuantumRange,QuantumRange,QuantumRange};
-            extended_quantum_t sum_rgb[3]={0,0,0};
             extended_quantum_t rgb[3];
-            extended_quantum_t nrgb[3];
-            extended_quantum_t other_channels=0;
-
-            if (hdr) {
-                rgb[0]=DF_ROUND(fromHDR(input_pixels[1][x].red));
-                rgb[1]=DF_ROUND(fromHDR(input_pixels[1][x].green));
-                rgb[2]=DF_ROUND(fromHDR(input_pixels[1][x].blue));
-            }
-            else {
-                rgb[0]=input_pixels[1][x].red;
-                rgb[1]=input_pixels[1][x].green;
-                rgb[2]=input_pixels[1][x].blue;
-            }
-
-
-            if ( m_naive ) {
-                loop_code_naive(-1,-1); loop_code_naive(-1, 0); loop_code_naive(-1, 1);
-                loop_code_naive( 0,-1);                         loop_code_naive( 0, 1);
-                loop_code_naive( 1,-1); loop_code_naive( 1, 0); loop_code_naive( 1, 1);
-
-                if ( m_aggressive ) {
-                    color_op2_naive_aggressive(0); color_op2_naive_aggressive(1); color_op2_naive_aggressive(2);
-                }
-                else {
-                    color_op2_naive(0); color_op2_naive(1); color_op2_naive(2);
-                }
-            }
-            else {
-                loop_code(-1,-1); loop_code(-1, 0); loop_code(-1, 1);
-                loop_code( 0,-1);                   loop_code( 0, 1);
-                loop_code( 1,-1); loop_code( 1, 0); loop_code( 1, 1);
-
-                if ( m_aggressive ) {
-                    color_op2_aggressive(0); color_op2_aggressive(1); color_op2_aggressive(2);
-                }
-                else {
-                    color_op2(0); color_op2(1); color_op2(2);
-                }
-            }
+            evaluate(input_pixels, x, hdr, m_delta, m_aggressive, m_naive, rgb);
 
             if (hdr) {
                 output_pixels[x].red=toHDR(rgb[0]>QuantumRange?QuantumRange:rgb[0]);
@@ -174,3 +190,102 @@ void HotPixels::applyOnImage(Magick::Image &image, bool hdr)
         output_cache->sync();
     });
 }
+
+QVector<HotPixels::Defect> HotPixels::findDefects(Magick::Image &image, bool hdr)
+{
+    std::shared_ptr<Ordinary::Pixels> input_cache(new Ordinary::Pixels(image));
+    int w = image.columns();
+    int h = image.rows();
+    QVector<Defect> defects;
+    QVector<Defect> *defects_p = &defects;
+    dfl_block bool error=false;
+    dfl_parallel_for(y, 1, h-1, 4, (image), {
+        const Magick::PixelPacket *input_pixels[3];
+        input_pixels[0] = input_cache->getConst(0,y-1,w,1);
+        input_pixels[1] = input_cache->getConst(0,y,w,1);
+        input_pixels[2] = input_cache->getConst(0,y+1,w,1);
+        if ( error || !input_pixels[0] || !input_pixels[1] || !input_pixels[2] ) {
+            if (!error)
+                dflError(DF_NULL_PIXELS);
+            error=true;
+            continue;
+        }
+        QVector<Defect> line;
+        for ( int x = 1 ; x < w-1 ; ++x ) {
+            extended_quantum_t rgb[3];
+            unsigned char channels = evaluate(input_pixels, x, hdr, m_delta, m_aggressive, m_naive, rgb);
+            if ( channels )
+                line.push_back(Defect(x, y, channels));
+        }
+        if ( line.count() ) {
+            dfl_critical_section({
+                *defects_p += line;
+            });
+        }
+    });
+    std::sort(defects.begin(), defects.end());
+    return defects;
+}
+
+/*
+ * only the listed pixels are visited, each defective channel is replaced
+ * by the mean of the 3x3 neighbours that are not defects themselves, so
+ * that defects do not depend on each other and can be corrected
+ * concurrently in place. defects must be sorted
+ */
+void HotPixels::applyOnDefects(Magick::Image &image, bool hdr, const QVector<Defect> &defects)
+{
+    std::shared_ptr<Ordinary::Pixels> image_cache(new Ordinary::Pixels(image));
+    int w = image.columns();
+    int h = image.rows();
+    int n = defects.count();
+    const Defect *list = defects.constData();
+    dfl_block bool error=false;
+    dfl_parallel_for(i, 0, n, 256, (image), {
+        const Defect& defect = list[i];
+        if ( error || defect.x < 1 || defect.y < 1 || defect.x >= w-1 || defect.y >= h-1 )
+            continue;
+        const Magick::PixelPacket *area = image_cache->getConst(defect.x-1, defect.y-1, 3, 3);
+        if ( !area ) {
+            dflError(DF_NULL_PIXELS);
+            error=true;
+            continue;
+        }
+        extended_quantum_t sum_rgb[3]={0,0,0};
+        int count=0;
+        for ( int j = 0 ; j < 3 ; ++j ) {
+            for ( int k = 0 ; k < 3 ; ++k ) {
+                Defect neighbour(defect.x+k-1, defect.y+j-1, 0);
+                if ( std::binary_search(list, list+n, neighbour) )
+                    continue;
+                const Magick::PixelPacket& pixel = area[j*3+k];
+                sum_rgb[0] += hdr ? fromHDR(pixel.red) : pixel.red;
+                sum_rgb[1] += hdr ? fromHDR(pixel.green) : pixel.green;
+                sum_rgb[2] += hdr ? fromHDR(pixel.blue) : pixel.blue;
+                ++count;
+            }
+        }
+        if ( count == 0 )
+            continue;
+        Magick::PixelPacket *pixel = image_cache->get(defect.x, defect.y, 1, 1);
+        if ( !pixel ) {
+            dflError(DF_NULL_PIXELS);
+            error=true;
+            continue;
+        }
+        for ( int c = 0 ; c < 3 ; ++c ) {
+            if ( !( defect.channels & (1<<c) ) )
+                continue;
+            extended_quantum_t v = DF_ROUND(sum_rgb[c]/count);
+            if ( v > QuantumRange )
+                v = QuantumRange;
+            Magick::Quantum q = hdr ? toHDR(v) : v;
+            switch(c) {
+            case 0: pixel->red = q; break;
+            case 1: pixel->green = q; break;
+            case 2: pixel->blue = q; break;
+            }
+        }
+        image_cache->sync();
+    });
+}
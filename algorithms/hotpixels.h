@@ -32,14 +32,33 @@
 #define HOTPIXELS_H
 
 #include <QObject>
+#include <QVector>
 #include "algorithm.h"
 
 class HotPixels : public Algorithm
 {
     Q_OBJECT
 public:
+    /**
+     * @brief The Defect class
+     * a pixel of the sensor, channels is the mask of its faulty channels
+     */
+    class Defect {
+    public:
+        Defect(int x_ = 0, int y_ = 0, unsigned char channels_ = 0) :
+            x(x_), y(y_), channels(channels_) {}
+        bool operator<(const Defect& other) const {
+            return y < other.y || ( y == other.y && x < other.x );
+        }
+        int x;
+        int y;
+        unsigned char channels;
+    };
+
     HotPixels(double delta, bool aggressive, bool  naive, QObject *parent = 0);
     void applyOnImage(Magick::Image &image, bool hdr);
+    QVector<Defect> findDefects(Magick::Image &image, bool hdr);
+    void applyOnDefects(Magick::Image &image, bool hdr, const QVector<Defect> &defects);
 private:
     double m_delta;
     bool m_aggressive;
@@ -53,6 +53,8 @@ iGamma::iGamma(qreal gamma, qreal x0, bool invert, QObject *parent) :
     else
         p=(a+1.L)*pow(x0,1.L/gamma)/(gamma*x0);
 
+    /* the standard curves are kept for the whole session */
+    DfUninterruptible uninterruptible;
     dfl_parallel_for(i, 0, int(QuantumRange+1), 1024, (), {
         double xx= double(i)/double(QuantumRange);
         if ( xx > x0 ) {
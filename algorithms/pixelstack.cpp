@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <QtGlobal>
+
+#include "pixelstack.h"
+
+/* iterations of the clipping loops, stacks rarely need more than 3 */
+#define PIXELSTACK_MAX_ITERATIONS 10
+/* consistency of the winsorized deviation with a normal distribution */
+#define PIXELSTACK_WINSOR_CORRECTION 1.134
+#define PIXELSTACK_WINSOR_CLIP 1.5
+
+PixelStack::PixelStack(Estimator estimator, double upper, double lower) :
+    m_estimator(estimator),
+    m_upper(upper),
+    m_lower(lower)
+{
+}
+
+/**
+ * @brief PixelStack::combine
+ * @param values the samples, reordered on return
+ * @param n number of samples, at least 1
+ * @param low receives the lowest kept value
+ * @param high receives the highest kept value
+ * @return the estimate of the pixel
+ */
+double PixelStack::combine(float *values, int n, float *low, float *high) const
+{
+    *low = -FLT_MAX;
+    *high = FLT_MAX;
+    switch (m_estimator) {
+    default:
+    case Median:
+        return median(values, n);
+    case WinsorizedSigma:
+        return winsorizedSigma(values, n, low, high);
+    case LinearFit:
+        return linearFit(values, n, low, high);
+    case Percentile:
+        return percentile(values, n, low, high);
+    }
+}
+
+/**
+ * @brief PixelStack::median
+ * O(n) selection, values are reordered
+ */
+double PixelStack::median(float *values, int n)
+{
+    int half = n / 2;
+    std::nth_element(values, values + half, values + n);
+    double m = values[half];
+    if ( n % 2 == 0 )
+        m = ( m + *std::max_element(values, values + half) ) / 2.;
+    return m;
+}
+
+static double mean(const float *values, int n)
+{
+    double sum = 0;
+    for (int i = 0 ; i < n ; ++i )
+        sum += values[i];
+    return sum / n;
+}
+
+/* moves the values in [low,high] to the front, returns their count */
+static int keep(float *values, int n, float low, float high)
+{
+    int kept = 0;
+    for (int i = 0 ; i < n ; ++i )
+        if ( values[i] >= low && values[i] <= high )
+            values[kept++] = values[i];
+    return kept;
+}
+
+double PixelStack::winsorizedSigma(float *values, int n, float *low, float *high) const
+{
+    for (int iteration = 0 ; iteration < PIXELSTACK_MAX_ITERATIONS && n > 2 ; ++iteration ) {
+        double m = median(values, n);
+        double sigma = 0;
+        for (int i = 0 ; i < n ; ++i )
+            sigma += (values[i] - m) * (values[i] - m);
+        sigma = sqrt(sigma / n);
+        /* the deviation of the stack with its tails pulled in, outliers
+         * don't inflate it the way they do in plain sigma clipping */
+        for (int j = 0 ; j < PIXELSTACK_MAX_ITERATIONS && sigma > 0 ; ++j ) {
+            double c0 = m - PIXELSTACK_WINSOR_CLIP * sigma;
+            double c1 = m + PIXELSTACK_WINSOR_CLIP * sigma;
+            double sum = 0, sum2 = 0;
+            for (int i = 0 ; i < n ; ++i ) {
+                double v = qBound(c0, double(values[i]), c1);
+                sum += v;
+                sum2 += v * v;
+            }
+            double avg = sum / n;
+            double s = PIXELSTACK_WINSOR_CORRECTION * sqrt(qMax(0., sum2 / n - avg * avg));
+            bool converged = fabs(s - sigma) <= sigma * .0005;
+            sigma = s;
+            if ( converged )
+                break;
+        }
+        float lo = m - m_lower * sigma;
+        float hi = m + m_upper * sigma;
+        *low = qMax(*low, lo);
+        *high = qMin(*high, hi);
+        int kept = keep(values, n, *low, *high);
+        if ( kept == n || kept == 0 )
+            break;
+        n = kept;
+    }
+    return mean(values, n);
+}
+
+double PixelStack::linearFit(float *values, int n, float *low, float *high) const
+{
+    std::sort(values, values + n);
+    int first = 0, last = n;
+    for (int iteration = 0 ; iteration < n && last - first > 2 ; ++iteration ) {
+        /* least squares line through the sorted samples, by rank */
+        int count = last - first;
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (int i = first ; i < last ; ++i ) {
+            sx += i;
+            sy += values[i];
+            sxx += double(i) * i;
+            sxy += i * double(values[i]);
+        }
+        double d = count * sxx - sx * sx;
+        double b = d != 0 ? ( count * sxy - sx * sy ) / d : 0;
+        double a = ( sy - b * sx ) / count;
+        double sigma = 0;
+        for (int i = first ; i < last ; ++i )
+            sigma += fabs(values[i] - (a + b * i));
+        sigma /= count;
+        bool clipped = false;
+        if ( values[first] < a + b * first - m_lower * sigma ) {
+            ++first;
+            clipped = true;
+        }
+        if ( values[last-1] > a + b * (last-1) + m_upper * sigma ) {
+            --last;
+            clipped = true;
+        }
+        if ( !clipped )
+            break;
+    }
+    if ( first > 0 )
+        *low = values[first];
+    if ( last < n )
+        *high = values[last-1];
+    /* ties of a clipped sample are kept, as the interval tells */
+    float *begin = std::lower_bound(values, values + n, *low);
+    float *end = std::upper_bound(values, values + n, *high);
+    return mean(begin, end - begin);
+}
+
+double PixelStack::percentile(float *values, int n, float *low, float *high) const
+{
+    if ( n < 3 )
+        return mean(values, n);
+    double m = median(values, n);
+    if ( m <= 0 )
+        return mean(values, n);
+    *low = m / m_lower;
+    *high = m * m_upper;
+    int kept = keep(values, n, *low, *high);
+    if ( kept == 0 )
+        return m;
+    return mean(values, kept);
+}
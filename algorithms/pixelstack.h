@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef PIXELSTACK_H
+#define PIXELSTACK_H
+
+/**
+ * @brief The PixelStack class
+ * robust estimators working on the samples of one channel of one output
+ * pixel, one per frame. The kept samples are always those falling in the
+ * returned interval, so that the caller can tell which frames were
+ * rejected without the estimator keeping track of them
+ */
+class PixelStack
+{
+public:
+    typedef enum {
+        Median,
+        WinsorizedSigma,
+        LinearFit,
+        Percentile
+    } Estimator;
+
+    PixelStack(Estimator estimator, double upper, double lower);
+
+    double combine(float *values, int n, float *low, float *high) const;
+
+    static double median(float *values, int n);
+
+private:
+    Estimator m_estimator;
+    double m_upper;
+    double m_lower;
+
+    double winsorizedSigma(float *values, int n, float *low, float *high) const;
+    double linearFit(float *values, int n, float *low, float *high) const;
+    double percentile(float *values, int n, float *low, float *high) const;
+};
+
+#endif // PIXELSTACK_H
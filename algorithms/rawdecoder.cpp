@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QDateTime>
+#include <QLocale>
+
+#include <memory>
+#include <vector>
+
+#include "rawdecoder.h"
+#include "rawinfo.h"
+#include "photo.h"
+#include "igamma.h"
+#include "algorithm.h"
+#include "console.h"
+
+#ifdef HAVE_LIBRAW
+#include <libraw/libraw.h>
+#endif
+
+using Magick::Quantum;
+
+RawDecoder::Params::Params() :
+    document(false),
+    halfSize(false),
+    quality(3),
+    rawColors(false),
+    cameraWhiteBalance(false),
+    unitMultipliers(false),
+    curve(Linear),
+    saturation(0)
+{
+}
+
+#ifdef HAVE_LIBRAW
+
+RawDecoder::RawDecoder(const Params &params, QObject *parent) :
+    QObject(parent),
+    m_params(params),
+    m_raw(new LibRaw()),
+    m_filename(),
+    m_errorString()
+{
+    libraw_output_params_t& p = m_raw->imgdata.params;
+    p.half_size = m_params.halfSize;
+    p.user_qual = m_params.quality;
+    p.use_camera_wb = m_params.cameraWhiteBalance;
+    if ( m_params.unitMultipliers )
+        p.user_mul[0] = p.user_mul[1] = p.user_mul[2] = p.user_mul[3] = 1;
+    if ( m_params.rawColors )
+        p.output_color = 0;
+    p.output_bps = 16;
+    switch(m_params.curve) {
+    case Linear:
+        p.gamm[0] = p.gamm[1] = 1;
+        p.no_auto_bright = 1;
+        break;
+    case sRGB:
+        p.gamm[0] = 1./2.4;
+        p.gamm[1] = 12.92;
+        break;
+    case IUT_BT_709:
+        /* libraw defaults */
+        break;
+    }
+    if ( m_params.saturation > 0 )
+        p.user_sat = m_params.saturation;
+    /* darkness to 0 */
+    p.user_black = 0;
+    /* orientation */
+    p.user_flip = 0;
+}
+
+RawDecoder::~RawDecoder()
+{
+    delete m_raw;
+}
+
+bool RawDecoder::available()
+{
+    return true;
+}
+
+bool RawDecoder::open(const QString &filename)
+{
+    m_filename = filename;
+    int ret = m_raw->open_file(filename.toLocal8Bit().constData());
+    if ( LIBRAW_SUCCESS != ret ) {
+        m_errorString = tr("libraw could not open %0: %1").arg(filename).arg(libraw_strerror(ret));
+        return false;
+    }
+    return true;
+}
+
+bool RawDecoder::probe(RawInfo &info)
+{
+    const libraw_data_t& d = m_raw->imgdata;
+    info.m_isoSpeed = d.other.iso_speed;
+    info.m_shutterSpeed = d.other.shutter;
+    info.m_aperture = d.other.aperture;
+    info.m_focal = d.other.focal_len;
+    info.m_daylightMultipliers.r = d.color.pre_mul[0];
+    info.m_daylightMultipliers.g = d.color.pre_mul[1];
+    info.m_daylightMultipliers.b = d.color.pre_mul[2];
+    info.m_cameraMultipliers.r = d.color.cam_mul[0];
+    info.m_cameraMultipliers.g = d.color.cam_mul[1];
+    info.m_cameraMultipliers.b = d.color.cam_mul[2];
+    if ( d.color.cam_mul[3] != 0 ) {
+        info.m_cameraMultipliers.r /= d.color.cam_mul[3];
+        info.m_cameraMultipliers.g /= d.color.cam_mul[3];
+        info.m_cameraMultipliers.b /= d.color.cam_mul[3];
+    }
+    info.m_camera = QString("%0 %1").arg(d.idata.make).arg(d.idata.model);
+    info.m_timestamp = QLocale::c().toString(QDateTime::fromTime_t(d.other.timestamp),
+                                             TAG_TIMESTAMP_FORMAT);
+    info.m_filterPattern.clear();
+    if ( d.idata.filters > 999 )
+        for ( int i = 0 ; i < 16 ; ++i )
+            info.m_filterPattern += QLatin1Char(d.idata.cdesc[m_raw->COLOR(i >> 1, i & 1)]);
+    return true;
+}
+
+bool RawDecoder::decode(Photo &photo)
+{
+    int ret = m_raw->unpack();
+    if ( LIBRAW_SUCCESS != ret ) {
+        m_errorString = tr("libraw could not unpack %0: %1").arg(m_filename).arg(libraw_strerror(ret));
+        return false;
+    }
+    if ( m_params.document )
+        return decodeCFA(photo);
+    return decodeRGB(photo);
+}
+
+/*
+ * same scaling as dcraw's scale_colors() in document mode, the CFA
+ * is read straight from the unpacked sensor data. Gamma curves come with
+ * dcraw's auto brightness, like dcraw -d -6 without -W
+ */
+bool RawDecoder::decodeCFA(Photo &photo)
+{
+    const libraw_data_t& d = m_raw->imgdata;
+    if ( !d.rawdata.raw_image || d.idata.filters < 1000 ) {
+        m_errorString = tr("%0 is not a Bayer CFA").arg(m_filename);
+        return false;
+    }
+    int w = d.sizes.width;
+    int h = d.sizes.height;
+    int pitch = d.sizes.raw_pitch / sizeof(*d.rawdata.raw_image);
+    const unsigned short *raw = d.rawdata.raw_image
+            + d.sizes.top_margin * pitch
+            + d.sizes.left_margin;
+
+    double maximum = m_params.saturation > 0 ? m_params.saturation : d.color.maximum;
+    if ( maximum <= 0 ) {
+        m_errorString = tr("Invalid saturation level in %0").arg(m_filename);
+        return false;
+    }
+    double mul[4] = { 1, 1, 1, 1 };
+    if ( !m_params.unitMultipliers ) {
+        const float *src = ( m_params.cameraWhiteBalance && d.color.cam_mul[0] > 0 )
+                ? d.color.cam_mul
+                : d.color.pre_mul;
+        for ( int c = 0 ; c < 4 ; ++c )
+            mul[c] = src[c];
+        if ( mul[3] == 0 )
+            mul[3] = mul[1];
+    }
+    double dmin = mul[0];
+    for ( int c = 1 ; c < 4 ; ++c )
+        if ( mul[c] < dmin ) dmin = mul[c];
+    if ( dmin <= 0 ) {
+        m_errorString = tr("Invalid multipliers in %0").arg(m_filename);
+        return false;
+    }
+    double scale_storage[4];
+    const double *scale = scale_storage;
+    for ( int c = 0 ; c < 4 ; ++c )
+        scale_storage[c] = mul[c] / dmin * double(QuantumRange) / maximum;
+
+    int cfa_storage[16];
+    const int *cfa = cfa_storage;
+    for ( int i = 0 ; i < 16 ; ++i )
+        cfa_storage[i] = m_raw->COLOR(i >> 1, i & 1);
+
+    iGamma *curve = NULL;
+    switch(m_params.curve) {
+    case Linear: break;
+    case sRGB: curve = &iGamma::sRGB(); break;
+    case IUT_BT_709: curve = &iGamma::BT709(); break;
+    }
+
+    /*
+     * dcraw's auto brightness, applied along with the curve: the level
+     * 1% of the pixels exceed becomes white, on a 0x2000 bins histogram
+     */
+    double bright = 1;
+    if ( curve ) {
+        std::vector<long> histogram(0x2000);
+        long *histogramp = &histogram[0];
+        int nBands = (h+63)/64;
+        dfl_parallel_for(band, 0, nBands, 1, (), {
+            std::vector<long> local(0x2000);
+            for ( int y = band*64, y1 = qMin(h, y+64) ; y < y1 ; ++y ) {
+                const unsigned short *src = raw + y * pitch;
+                const int *fc = cfa + ((y & 7) << 1);
+                for ( int x = 0 ; x < w ; ++x ) {
+                    quantum_t v = clamp<quantum_t>(DF_ROUND(src[x] * scale[fc[x & 1]]));
+                    ++local[long(v) * 0x2000 / (long(QuantumRange) + 1)];
+                }
+            }
+            dfl_critical_section({
+                for ( int i = 0 ; i < 0x2000 ; ++i )
+                    histogramp[i] += local[i];
+            });
+        });
+        long perc = long(w) * h * 0.01;
+        long total = 0;
+        int white = 0x2000;
+        while ( --white > 32 )
+            if ( (total += histogram[white]) > perc )
+                break;
+        bright = double(0x2000) / white;
+    }
+
+    photo.createImage(w, h);
+    if ( !photo.isComplete() )
+        return false;
+    Magick::Image& image = photo.image();
+    std::shared_ptr<Ordinary::Pixels> pixel_cache(new Ordinary::Pixels(image));
+    dfl_block bool error = false;
+    dfl_parallel_for(y, 0, h, 4, (image), {
+        Magick::PixelPacket *pixels = pixel_cache->get(0, y, w, 1);
+        if ( error || !pixels ) {
+            if ( !error )
+                dflError(DF_NULL_PIXELS);
+            error = true;
+            continue;
+        }
+        const unsigned short *src = raw + y * pitch;
+        const int *fc = cfa + ((y & 7) << 1);
+        for ( int x = 0 ; x < w ; ++x ) {
+            quantum_t v = clamp<quantum_t>(DF_ROUND(src[x] * scale[fc[x & 1]]));
+            if ( curve )
+                v = curve->applyOnQuantum(clamp<quantum_t>(DF_ROUND(v * bright)), false);
+            pixels[x].red = pixels[x].green = pixels[x].blue = v;
+        }
+        pixel_cache->sync();
+    });
+    if ( error ) {
+        photo.setUndefined();
+        return false;
+    }
+    return true;
+}
+
+bool RawDecoder::decodeRGB(Photo &photo)
+{
+    int ret = m_raw->dcraw_process();
+    if ( LIBRAW_SUCCESS != ret ) {
+        m_errorString = tr("libraw could not process %0: %1").arg(m_filename).arg(libraw_strerror(ret));
+        return false;
+    }
+    libraw_processed_image_t *mem = m_raw->dcraw_make_mem_image(&ret);
+    if ( !mem || LIBRAW_SUCCESS != ret || mem->type != LIBRAW_IMAGE_BITMAP ) {
+        m_errorString = tr("libraw could not render %0: %1").arg(m_filename).arg(libraw_strerror(ret));
+        if ( mem )
+            LibRaw::dcraw_clear_mem(mem);
+        return false;
+    }
+    int w = mem->width;
+    int h = mem->height;
+    int colors = mem->colors;
+    int bits = mem->bits;
+    const unsigned char *data = mem->data;
+    photo.createImage(w, h);
+    if ( !photo.isComplete() ) {
+        LibRaw::dcraw_clear_mem(mem);
+        return false;
+    }
+    Magick::Image& image = photo.image();
+    std::shared_ptr<Ordinary::Pixels> pixel_cache(new Ordinary::Pixels(image));
+    dfl_block bool error = false;
+    dfl_parallel_for(y, 0, h, 4, (image), {
+        Magick::PixelPacket *pixels = pixel_cache->get(0, y, w, 1);
+        if ( error || !pixels ) {
+            if ( !error )
+                dflError(DF_NULL_PIXELS);
+            error = true;
+            continue;
+        }
+        int g = colors > 1 ? 1 : 0;
+        int b = colors > 2 ? 2 : 0;
+        if ( bits == 16 ) {
+            const unsigned short *src = reinterpret_cast<const unsigned short*>(data) + y * w * colors;
+            for ( int x = 0 ; x < w ; ++x ) {
+                pixels[x].red = src[x*colors];
+                pixels[x].green = src[x*colors+g];
+                pixels[x].blue = src[x*colors+b];
+            }
+        }
+        else {
+            const unsigned char *src = data + y * w * colors;
+            for ( int x = 0 ; x < w ; ++x ) {
+                pixels[x].red = src[x*colors]*257;
+                pixels[x].green = src[x*colors+g]*257;
+                pixels[x].blue = src[x*colors+b]*257;
+            }
+        }
+        pixel_cache->sync();
+    });
+    LibRaw::dcraw_clear_mem(mem);
+    if ( error ) {
+        photo.setUndefined();
+        return false;
+    }
+    return true;
+}
+
+#else
+
+RawDecoder::RawDecoder(const Params &params, QObject *parent) :
+    QObject(parent),
+    m_params(params),
+    m_raw(NULL),
+    m_filename(),
+    m_errorString(tr("libraw not compiled in"))
+{
+}
+
+RawDecoder::~RawDecoder()
+{
+}
+
+bool RawDecoder::available()
+{
+    return false;
+}
+
+bool RawDecoder::open(const QString &)
+{
+    return false;
+}
+
+bool RawDecoder::probe(RawInfo &)
+{
+    return false;
+}
+
+bool RawDecoder::decode(Photo &)
+{
+    return false;
+}
+
+bool RawDecoder::decodeCFA(Photo &)
+{
+    return false;
+}
+
+bool RawDecoder::decodeRGB(Photo &)
+{
+    return false;
+}
+
+#endif
+
+QString RawDecoder::errorString() const
+{
+    return m_errorString;
+}
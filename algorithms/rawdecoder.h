@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef RAWDECODER_H
+#define RAWDECODER_H
+
+#include <QObject>
+#include <QString>
+
+class LibRaw;
+class RawInfo;
+class Photo;
+
+/*
+ * In-process raw decoding, reads metadata and sensor data from a single
+ * open of the file. Parameters mirror the dcraw switches used by
+ * WorkerLoadRaw so that both paths produce the same pixels.
+ */
+class RawDecoder : public QObject
+{
+    Q_OBJECT
+public:
+    typedef enum {
+        Linear,
+        sRGB,
+        IUT_BT_709
+    } Curve;
+    struct Params {
+        Params();
+        bool document;          /* -d, undebayered CFA */
+        bool halfSize;          /* -h */
+        int quality;            /* -q */
+        bool rawColors;         /* -o 0 */
+        bool cameraWhiteBalance;/* -w */
+        bool unitMultipliers;   /* -r 1 1 1 1 */
+        Curve curve;            /* -4, -6 and -g */
+        int saturation;         /* -S, 0 for auto */
+    };
+
+    explicit RawDecoder(const Params& params, QObject *parent = 0);
+    ~RawDecoder();
+
+    static bool available();
+
+    bool open(const QString& filename);
+    bool probe(RawInfo& info);
+    bool decode(Photo& photo);
+
+    QString errorString() const;
+
+private:
+    bool decodeCFA(Photo& photo);
+    bool decodeRGB(Photo& photo);
+
+    Params m_params;
+    LibRaw *m_raw;
+    QString m_filename;
+    QString m_errorString;
+    Q_DISABLE_COPY(RawDecoder)
+};
+
+#endif // RAWDECODER_H
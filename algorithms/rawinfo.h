@@ -61,6 +61,7 @@ signals:
 public slots:
 
 private:
+    friend class RawDecoder;
     qreal m_isoSpeed;
     qreal m_shutterSpeed;
     qreal m_aperture;
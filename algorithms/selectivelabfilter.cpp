@@ -33,6 +33,10 @@
 #include "cielab.h"
 #include "ports.h"
 #include "console.h"
+#include <vector>
+
+/* entries of the hue and correction tables */
+#define SELECTIVE_LAB_LUT_SIZE 4096
 
 SelectiveLabFilter::SelectiveLabFilter(int hue,
                                        int coverage,
@@ -102,6 +106,19 @@ void SelectiveLabFilter::applyOnImage(Magick::Image &image, bool hdr)
     //calcul de l'angle d'application
     theta = M_PI * double((360+m_hue)%360)/180.;
 
+    /*
+     * the hue weighting, and the exposure correction indexed by the
+     * square root of the chroma module, are tabulated once per image
+     */
+    std::shared_ptr<std::vector<float> > hueLut(new std::vector<float>(SELECTIVE_LAB_LUT_SIZE+2));
+    std::shared_ptr<std::vector<float> > correctionLut(new std::vector<float>(SELECTIVE_LAB_LUT_SIZE+2));
+    for ( int i = 0 ; i < SELECTIVE_LAB_LUT_SIZE+2 ; ++i ) {
+        double phi = 2 * M_PI * i / SELECTIVE_LAB_LUT_SIZE;
+        (*hueLut)[i] = pow((1.-cos(phi))/2.,puissance);
+        double correction = clamp<double>(pow(double(i) / SELECTIVE_LAB_LUT_SIZE, .3), 0, 1);
+        (*correctionLut)[i] = pow(value, 1-correction);
+    }
+
     dfl_block bool error = false;
     dfl_parallel_for(y, 0, h, 4, (image, srcImage), {
         const Magick::PixelPacket *src = src_cache->getConst(0,y,w,1);
@@ -112,42 +129,25 @@ void SelectiveLabFilter::applyOnImage(Magick::Image &image, bool hdr)
             error = true;
             continue;
         }
+        std::vector<float> buffer(3*w);
+        float *L = &buffer[0];
+        float *a = &buffer[w];
+        float *b = &buffer[2*w];
+        const float *hue = &(*hueLut)[0];
+        const float *corr = &(*correctionLut)[0];
+        RGB_to_LinearLab_row(src, w, hdr, L, a, b);
         for ( int x = 0 ; x < w ; ++x ) {
-
-            double rgb[3];
-            if (hdr) {
-                rgb[0] = fromHDR(src[x].red);
-                rgb[1] = fromHDR(src[x].green);
-                rgb[2] = fromHDR(src[x].blue);
-            }
-            else {
-                rgb[0] = src[x].red;
-                rgb[1] = src[x].green;
-                rgb[2] = src[x].blue;
-            }
-
-            double lab[3];
-
-            RGB_to_LinearLab(rgb,lab);
-
-            double module = sqrt(lab[1]*lab[1]+lab[2]*lab[2]);
-            double arg;
-            if ( lab[2] > 0 )
-                arg = M_PI/2-atan(-lab[1]/lab[2]);
-            else
-                arg = -M_PI/2-atan(-lab[1]/lab[2]);
-
-            double mul= pow((1.-cos(arg+theta))/2.,puissance);
-            double mul_sat = mul;
-            double mul_val = mul;
-            if ( inv_sat ) {
-                mul_sat=1.-mul_sat;
-            }
-            if ( inv_val ) {
-                mul_val=1.-mul_val;
-            }
-
-            double v = lab_linearize(lab[0]);
+            float module = sqrtf(a[x]*a[x]+b[x]*b[x]);
+            float arg = atan2f(b[x], -a[x]) + theta;
+            float idx = (arg < 0 ? arg + 2*M_PI : arg) * float(SELECTIVE_LAB_LUT_SIZE / (2*M_PI));
+            if ( idx >= SELECTIVE_LAB_LUT_SIZE )
+                idx -= SELECTIVE_LAB_LUT_SIZE;
+            int i = int(idx);
+            float mul = hue[i] + (idx - i) * (hue[i+1] - hue[i]);
+            float mul_sat = inv_sat ? 1.f - mul : mul;
+            float mul_val = inv_val ? 1.f - mul : mul;
+
+            float v = lab_linearize_f(L[x]);
             if ( bias_val == 0 )
                 v = v * mul_val * value;
             else {
@@ -155,33 +155,28 @@ void SelectiveLabFilter::applyOnImage(Magick::Image &image, bool hdr)
                  * correction handles low saturation zone by enlarging selection
                  * to prevent discontinuity
                  */
-                double correction = clamp<double>(pow(module/DF_MAX_AB_MODULE,.15), 0, 1);
-                v = v * mul_val * value + v * (1-mul_val) * pow(value,1-correction);
+                float s = sqrtf(module/float(DF_MAX_AB_MODULE)) * SELECTIVE_LAB_LUT_SIZE;
+                float k = 1;
+                if ( s < SELECTIVE_LAB_LUT_SIZE ) {
+                    int j = int(s);
+                    k = corr[j] + (s - j) * (corr[j+1] - corr[j]);
+                }
+                v = v * mul_val * value + v * (1-mul_val) * k;
             }
 
-            lab[0] = lab_gammaize(v);
+            L[x] = lab_gammaize_f(v);
 
+            float newModule;
             if ( bias_sat == 0 )
-                module = module * mul_sat * saturation;
+                newModule = module * mul_sat * saturation;
             else
-                module = module * mul_sat * saturation + module * (1-mul_sat);
+                newModule = module * mul_sat * saturation + module * (1-mul_sat);
 
-            lab[1]= -module * cos(arg);
-            lab[2]=  module * sin(arg);
-
-            LinearLab_to_RGB(lab,rgb);
-
-            if ( hdr) {
-                pixels[x].red=toHDR(rgb[0]);
-                pixels[x].green=toHDR(rgb[1]);
-                pixels[x].blue=toHDR(rgb[2]);
-            }
-            else {
-                pixels[x].red=rgb[0];
-                pixels[x].green=rgb[1];
-                pixels[x].blue=rgb[2];
-            }
+            float ratio = module > 0 ? newModule / module : 0;
+            a[x] *= ratio;
+            b[x] *= ratio;
         }
+        LinearLab_to_RGB_row(L, a, b, w, hdr, pixels);
         pixel_cache->sync();
     });
 }
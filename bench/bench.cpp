@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QThread>
+#include <QJsonArray>
+#include <QTransform>
+#include <cmath>
+#include <algorithm>
+
+#include "bench.h"
+#include "benchsource.h"
+#include "ports.h"
+#include "console.h"
+#include "process.h"
+#include "operator.h"
+#include "profiler.h"
+#include "algorithm.h"
+#include "preferences.h"
+#include "transformview.h"
+#include "discretefouriertransform.h"
+#include "atrouswavelettransform.h"
+
+#include "opexposure.h"
+#include "opgaussianblur.h"
+#include "opunsharpmask.h"
+#include "opchannelmixer.h"
+#include "opblend.h"
+#include "opintegration.h"
+#include "opdebayer.h"
+#include "ophotpixels.h"
+#include "opdftforward.h"
+#include "opdwtforward.h"
+
+#ifdef DF_WINDOWS
+# include <psapi.h>
+#else
+# include <sys/resource.h>
+#endif
+
+using Magick::Quantum;
+
+#define BENCH_SEED 0x44464c42u
+#define BENCH_DWT_PLANES 5
+
+static const char *OperatorCases[] = {
+    "exposure",
+    "gaussianblur",
+    "unsharpmask",
+    "channelmixer",
+    "blend",
+    "integration",
+    "debayer",
+    "hotpixels",
+    "dftforward",
+    "dwtforward",
+};
+
+static const char *KernelCases[] = {
+    "dft",
+    "atrous",
+    "transformview",
+};
+
+/* numerical recipes LCG, the frames must be identical from run to run */
+static inline quint32 lcg(quint32& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+static inline double uniform(quint32& state)
+{
+    return double(lcg(state) >> 8) / double(1 << 24);
+}
+
+static inline double gaussian(quint32& state)
+{
+    /* Irwin-Hall approximation, good enough for sensor noise */
+    double s = 0;
+    for (int i = 0 ; i < 12 ; ++i )
+        s += uniform(state);
+    return s - 6.;
+}
+
+Bench::Bench(Process *process, QObject *parent) :
+    QObject(parent),
+    m_process(process),
+    m_source(new BenchSource(process)),
+    m_sizes(),
+    m_threads(),
+    m_frames(4),
+    m_repeat(3),
+    m_filter()
+{
+    m_sizes.push_back(QSize(512, 512));
+    m_sizes.push_back(QSize(1024, 1024));
+    m_sizes.push_back(QSize(2048, 2048));
+    m_threads.push_back(1);
+    if ( QThread::idealThreadCount() > 1 )
+        m_threads.push_back(QThread::idealThreadCount());
+}
+
+Bench::~Bench()
+{
+    delete m_source;
+}
+
+void Bench::setSizes(const QVector<QSize> &sizes)
+{
+    m_sizes = sizes;
+}
+
+void Bench::setThreads(const QVector<int> &threads)
+{
+    m_threads = threads;
+    std::sort(m_threads.begin(), m_threads.end());
+}
+
+void Bench::setFrames(int frames)
+{
+    m_frames = qMax(1, frames);
+}
+
+void Bench::setRepeat(int repeat)
+{
+    m_repeat = qMax(1, repeat);
+}
+
+void Bench::setFilter(const QStringList &filter)
+{
+    m_filter = filter;
+}
+
+QStringList Bench::cases()
+{
+    QStringList list;
+    for (size_t i = 0 ; i < sizeof(OperatorCases)/sizeof(*OperatorCases) ; ++i )
+        list.push_back(OperatorCases[i]);
+    for (size_t i = 0 ; i < sizeof(KernelCases)/sizeof(*KernelCases) ; ++i )
+        list.push_back(KernelCases[i]);
+    return list;
+}
+
+/**
+ * @brief Bench::run
+ * @return one result per case, size and thread count. efficiency is
+ * relative to the smallest thread count of the same case and size
+ */
+QJsonObject Bench::run()
+{
+    QJsonArray results;
+    int savedThreads = preferences->getNumThreads();
+    QStringList names = cases();
+
+    foreach(const QSize& size, m_sizes) {
+        QVector<Photo> inputs[2];
+        inputs[InputStars] = starField(size, m_frames, InputStars);
+        inputs[InputCFA] = starField(size, m_frames, InputCFA);
+        foreach(const QString& name, names) {
+            if ( !m_filter.isEmpty() && !m_filter.contains(name) )
+                continue;
+            const QVector<Photo>& photos = inputs[inputKind(name)];
+            if ( !isKernel(name) ) {
+                m_source->setPhotos(photos);
+                if ( !playAndWait(m_source) ) {
+                    dflError(tr("Bench: could not prepare the inputs of %0").arg(name));
+                    continue;
+                }
+            }
+            qint64 baseline = 0;
+            int baselineThreads = 0;
+            foreach(int threads, m_threads) {
+                dflInfo(tr("Bench: %0 %1x%2, %3 thread(s)")
+                        .arg(name).arg(size.width()).arg(size.height()).arg(threads));
+                preferences->setNumThreads(threads);
+                qint64 peakBytes = 0;
+                qint64 usecs = isKernel(name)
+                        ? runKernel(name, photos)
+                        : runOperator(name, &peakBytes);
+                QJsonObject result;
+                result["case"] = name;
+                result["kind"] = isKernel(name) ? "kernel" : "operator";
+                result["input"] = inputKind(name) == InputCFA ? "cfa" : "stars";
+                result["width"] = size.width();
+                result["height"] = size.height();
+                result["frames"] = m_frames;
+                result["threads"] = threads;
+                result["success"] = usecs > 0;
+                if ( usecs > 0 ) {
+                    double seconds = usecs / 1e6;
+                    double mpixels = double(m_frames) * size.width() * size.height() / 1e6;
+                    if ( !baseline ) {
+                        baseline = usecs;
+                        baselineThreads = threads;
+                    }
+                    result["seconds"] = seconds;
+                    result["megapixelsPerSecond"] = mpixels / seconds;
+                    result["efficiency"] = double(baseline) * baselineThreads
+                            / (double(usecs) * threads);
+                }
+                result["peakResultBytes"] = double(peakBytes);
+                result["maxResidentBytes"] = double(maxResidentBytes());
+                results.push_back(result);
+            }
+        }
+        m_source->setPhotos(QVector<Photo>());
+    }
+    preferences->setNumThreads(savedThreads);
+
+    QJsonObject obj;
+    obj["arch"] = DF_ARCH;
+    obj["idealThreadCount"] = QThread::idealThreadCount();
+    obj["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    obj["frames"] = m_frames;
+    obj["repeat"] = m_repeat;
+    obj["results"] = results;
+    return obj;
+}
+
+/**
+ * @brief Bench::starField
+ * draws frames of gaussian stars over a noisy background, each frame is
+ * shifted by a few pixels and carries three registration points. CFA
+ * frames are RG/GB mosaics of the same field with a fixed set of hot
+ * pixels
+ */
+QVector<Photo> Bench::starField(const QSize &size, int frames, InputKind kind)
+{
+    static const double cfaResponse[3] = { .6, 1., .8 };
+    int w = size.width();
+    int h = size.height();
+    quint32 state = BENCH_SEED;
+
+    int nStars = qMax(3, w * h / 2000);
+    QVector<QPointF> stars(nStars);
+    QVector<double> amplitude(nStars);
+    QVector<double> sigma(nStars);
+    for (int i = 0 ; i < nStars ; ++i ) {
+        stars[i] = QPointF(8 + uniform(state) * (w - 16),
+                           8 + uniform(state) * (h - 16));
+        amplitude[i] = .05 + uniform(state) * .85;
+        sigma[i] = 1.2 + uniform(state) * 1.3;
+    }
+    int nHot = w * h / 10000;
+    QVector<int> hot(nHot);
+    for (int i = 0 ; i < nHot ; ++i )
+        hot[i] = lcg(state) % (w * h);
+
+    QVector<Photo> photos;
+    std::vector<float> field(size_t(w) * h);
+    for (int f = 0 ; f < frames ; ++f ) {
+        QPointF shift(f % 3, (f / 3) % 3);
+        for (size_t i = 0 ; i < field.size() ; ++i )
+            field[i] = .05 + .01 * gaussian(state);
+        for (int i = 0 ; i < nStars ; ++i ) {
+            QPointF c = stars[i] + shift;
+            int r = ceil(4 * sigma[i]);
+            double k = -1. / (2 * sigma[i] * sigma[i]);
+            for (int y = qMax(0, int(c.y()) - r) ; y <= qMin(h - 1, int(c.y()) + r) ; ++y )
+                for (int x = qMax(0, int(c.x()) - r) ; x <= qMin(w - 1, int(c.x()) + r) ; ++x ) {
+                    double dx = x - c.x(), dy = y - c.y();
+                    field[size_t(y) * w + x] += amplitude[i] * exp(k * (dx*dx + dy*dy));
+                }
+        }
+        if ( kind == InputCFA ) {
+            for (int y = 0 ; y < h ; ++y )
+                for (int x = 0 ; x < w ; ++x )
+                    field[size_t(y) * w + x] *= cfaResponse[(y & 1) + (x & 1)];
+            for (int i = 0 ; i < nHot ; ++i )
+                field[hot[i]] = 1;
+        }
+
+        Photo photo(Photo::Linear);
+        photo.createImage(w, h);
+        Magick::Image& image = photo.image();
+        Ordinary::Pixels cache(image);
+        for (int y = 0 ; y < h ; ++y ) {
+            Magick::PixelPacket *pixels = cache.get(0, y, w, 1);
+            if ( !pixels ) {
+                dflError(DF_NULL_PIXELS);
+                return QVector<Photo>();
+            }
+            for (int x = 0 ; x < w ; ++x ) {
+                Quantum v = DF_ROUND(clamp<double>(field[size_t(y) * w + x] * QuantumRange,
+                                                   0, QuantumRange));
+                pixels[x].red = pixels[x].green = pixels[x].blue = v;
+            }
+            cache.sync();
+        }
+        QString name = QString("%0-%1x%2-%3")
+                .arg(kind == InputCFA ? "cfa" : "stars").arg(w).arg(h).arg(f);
+        photo.setIdentity("bench/" + name);
+        photo.setTag(TAG_NAME, name);
+        QVector<QPointF> points;
+        for (int i = 0 ; i < 3 ; ++i )
+            points.push_back(stars[i] + shift);
+        photo.setPoints(points);
+        if ( kind == InputCFA ) {
+            photo.setTag(TAG_PIXELS, TAG_PIXELS_CFA);
+            photo.setTag(TAG_FILTER_PATTERN, "RG/GB");
+        }
+        photos.push_back(photo);
+    }
+    return photos;
+}
+
+qint64 Bench::maxResidentBytes()
+{
+#ifdef DF_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( !GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) )
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if ( getrusage(RUSAGE_SELF, &usage) )
+        return 0;
+# if defined(Q_OS_OSX)
+    return usage.ru_maxrss;
+# else
+    return qint64(usage.ru_maxrss) * 1024;
+# endif
+#endif
+}
+
+Operator *Bench::newOperator(const QString &name)
+{
+    if ( name == "exposure" )
+        return new OpExposure(m_process);
+    if ( name == "gaussianblur" )
+        return new OpGaussianBlur(m_process);
+    if ( name == "unsharpmask" )
+        return new OpUnsharpMask(m_process);
+    if ( name == "channelmixer" )
+        return new OpChannelMixer(m_process);
+    if ( name == "blend" )
+        return new OpBlend(m_process);
+    if ( name == "integration" )
+        return new OpIntegration(m_process);
+    if ( name == "debayer" )
+        return new OpDebayer(m_process);
+    if ( name == "hotpixels" )
+        return new OpHotPixels(m_process);
+    if ( name == "dftforward" )
+        return new OpDFTForward(m_process);
+    if ( name == "dwtforward" )
+        return new OpDWTForward(BENCH_DWT_PLANES, m_process);
+    return NULL;
+}
+
+Bench::InputKind Bench::inputKind(const QString &name) const
+{
+    if ( name == "debayer" || name == "hotpixels" )
+        return InputCFA;
+    return InputStars;
+}
+
+bool Bench::isKernel(const QString &name) const
+{
+    for (size_t i = 0 ; i < sizeof(KernelCases)/sizeof(*KernelCases) ; ++i )
+        if ( name == KernelCases[i] )
+            return true;
+    return false;
+}
+
+bool Bench::playAndWait(Operator *op)
+{
+    op->play();
+    while ( op->isPlaying() )
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    return op->isUpToDate();
+}
+
+/**
+ * @brief Bench::runOperator
+ * @return the best wall time of the runs in microseconds, 0 on failure
+ */
+qint64 Bench::runOperator(const QString &name, qint64 *peakBytes)
+{
+    Operator *op = newOperator(name);
+    if ( !op )
+        return 0;
+    int ways = ( name == "blend" ) ? 2 : 1;
+    for (int i = 0 ; i < ways ; ++i )
+        Operator::operator_connect(m_source, 0, op, i);
+
+    qint64 best = 0;
+    for (int r = 0 ; r < m_repeat ; ++r ) {
+        op->setOutOfDate();
+        profiler->clear();
+        QElapsedTimer timer;
+        timer.start();
+        if ( !playAndWait(op) ) {
+            best = 0;
+            break;
+        }
+        qint64 usecs = qMax(Q_INT64_C(1), timer.nsecsElapsed() / 1000);
+        if ( !best || usecs < best )
+            best = usecs;
+        foreach(const Profiler::Summary& summary, profiler->summaries())
+            if ( summary.uuid == op->uuid() )
+                *peakBytes = qMax(*peakBytes, summary.peakBytes);
+    }
+
+    op->setOutOfDate();
+    for (int i = 0 ; i < ways ; ++i )
+        Operator::operator_disconnect(m_source, 0, op, i);
+    delete op;
+    return best;
+}
+
+/**
+ * @brief Bench::runKernel
+ * calls the algorithms directly on the calling thread, without the
+ * operator and worker overhead
+ * @return the best wall time of the runs in microseconds, 0 on failure
+ */
+qint64 Bench::runKernel(const QString &name, const QVector<Photo> &photos)
+{
+    qint64 best = 0;
+    for (int r = 0 ; r < m_repeat ; ++r ) {
+        QElapsedTimer timer;
+        timer.start();
+        try {
+            foreach(Photo photo, photos) {
+                if ( name == "dft" ) {
+                    Magick::Image source(photo.image());
+                    int m = qMax(source.columns(), source.rows());
+                    source = DiscreteFourierTransform::normalize(source, m, true);
+                    DiscreteFourierTransform dft(source, photo.getScale());
+                    dft.reverse(1);
+                }
+                else if ( name == "atrous" ) {
+                    Photo sign(photo);
+                    ATrousWaveletTransform dwt(photo, b3SplineWavelet,
+                                               sizeof(b3SplineWavelet)/sizeof(*b3SplineWavelet));
+                    for (int n = 0 ; n < BENCH_DWT_PLANES ; ++n )
+                        dwt.transform(n, BENCH_DWT_PLANES, Photo::Linear, sign);
+                }
+                else if ( name == "transformview" ) {
+                    /* a slight rotation, so that every tap is interpolated */
+                    QVector<QPointF> points = photo.getPoints();
+                    QTransform rotation;
+                    rotation.rotate(.5);
+                    QVector<QPointF> reference;
+                    foreach(const QPointF& point, points)
+                        reference.push_back(rotation.map(point));
+                    TransformView view(photo, 1, reference);
+                    view.setInterpolation(TransformView::Bilinear);
+                    if ( view.inError() || !view.loadPixels() )
+                        return 0;
+                    view.resample(photo.image().columns(), photo.image().rows());
+                }
+            }
+        }
+        catch (std::exception &e) {
+            dflError("Bench: %s", e.what());
+            return 0;
+        }
+        qint64 usecs = qMax(Q_INT64_C(1), timer.nsecsElapsed() / 1000);
+        if ( !best || usecs < best )
+            best = usecs;
+    }
+    return best;
+}
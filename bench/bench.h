@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QObject>
+#include <QVector>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include "photo.h"
+
+class Process;
+class Operator;
+class BenchSource;
+
+/**
+ * @brief The Bench class
+ * runs operators and algorithms on deterministic synthetic frames at
+ * several sizes and thread counts, and reports their throughput as JSON
+ */
+class Bench : public QObject
+{
+    Q_OBJECT
+public:
+    typedef enum {
+        InputStars,     /* linear RGB star fields */
+        InputCFA        /* RG/GB mosaics of the same star fields */
+    } InputKind;
+
+    explicit Bench(Process *process, QObject *parent = 0);
+    ~Bench();
+
+    void setSizes(const QVector<QSize>& sizes);
+    void setThreads(const QVector<int>& threads);
+    void setFrames(int frames);
+    void setRepeat(int repeat);
+    void setFilter(const QStringList& filter);
+
+    static QStringList cases();
+
+    QJsonObject run();
+
+    static QVector<Photo> starField(const QSize& size, int frames, InputKind kind);
+    static qint64 maxResidentBytes();
+
+private:
+    Operator *newOperator(const QString& name);
+    InputKind inputKind(const QString& name) const;
+    bool isKernel(const QString& name) const;
+    bool playAndWait(Operator *op);
+    qint64 runOperator(const QString& name, qint64 *peakBytes);
+    qint64 runKernel(const QString& name, const QVector<Photo>& photos);
+
+    Process *m_process;
+    BenchSource *m_source;
+    QVector<QSize> m_sizes;
+    QVector<int> m_threads;
+    int m_frames;
+    int m_repeat;
+    QStringList m_filter;
+};
+
+#endif // BENCH_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include "benchsource.h"
+#include "operatoroutput.h"
+#include "operatorworker.h"
+#include "process.h"
+
+class WorkerBenchSource : public OperatorWorker
+{
+public:
+    WorkerBenchSource(QThread *thread, BenchSource *op) :
+        OperatorWorker(thread, op),
+        m_photos(op->photos())
+    {}
+private slots:
+    Photo process(const Photo &, int, int) { throw 0; }
+    void play() {
+        for (int i = 0, s = m_photos.count() ; i < s ; ++i ) {
+            if ( aborted() )
+                break;
+            outputPush(0, m_photos[i]);
+            emitProgress(i, s, 0, 1);
+        }
+        emitSuccess();
+    }
+private:
+    QVector<Photo> m_photos;
+};
+
+BenchSource::BenchSource(Process *parent) :
+    Operator(OP_SECTION_ASSETS, QT_TRANSLATE_NOOP("Operator", "Bench Source"), Operator::NA, parent),
+    m_photos()
+{
+    addOutput(new OperatorOutput(tr("Images"), this));
+}
+
+BenchSource *BenchSource::newInstance()
+{
+    return new BenchSource(m_process);
+}
+
+OperatorWorker *BenchSource::newWorker()
+{
+    return new WorkerBenchSource(m_thread, this);
+}
+
+void BenchSource::setPhotos(const QVector<Photo> &photos)
+{
+    m_photos = photos;
+    setOutOfDate();
+}
+
+QVector<Photo> BenchSource::photos() const
+{
+    return m_photos;
+}
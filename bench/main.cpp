@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <cstdio>
+
+#include "ports.h"
+#include "console.h"
+#include "memorymanager.h"
+#include "profiler.h"
+#include "proxycache.h"
+#include "preferences.h"
+#include "processscene.h"
+#include "process.h"
+#include "bench.h"
+
+int main(int argc, char *argv[])
+{
+    /* no window is ever shown, don't require a display on the nodes */
+    if ( qgetenv("QT_QPA_PLATFORM").isEmpty() )
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+    QApplication::setApplicationName("darkflow-bench");
+    init_platform();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the throughput of the darkflow operators "
+                                     "on synthetic frames and prints it as JSON");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Frame sizes, e.g. 512x512,2048x1536", "sizes");
+    QCommandLineOption threadsOption("threads", "Thread counts, e.g. 1,2,4,8", "threads");
+    QCommandLineOption framesOption("frames", "Frames per input set", "count");
+    QCommandLineOption repeatOption("repeat", "Runs per measure, the best is kept", "count");
+    QCommandLineOption casesOption("cases", "Cases to run, all by default: "
+                                   + Bench::cases().join(","), "cases");
+    QCommandLineOption outputOption("output", "JSON report file, stdout by default", "file");
+    parser.addOption(sizesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(framesOption);
+    parser.addOption(repeatOption);
+    parser.addOption(casesOption);
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    Console::init();
+    memoryManager = new MemoryManager(QApplication::instance());
+    /* outlives the process below */
+    Profiler runs;
+    profiler = &runs;
+    proxyCache = new ProxyCache(0);
+    preferences = new Preferences;
+    /* results must stay resident, evictions would be measured too */
+    memoryManager->setBudget(0);
+    ProcessScene scene;
+    Process process(&scene);
+
+    Bench bench(&process);
+    if ( parser.isSet(sizesOption) ) {
+        QVector<QSize> sizes;
+        foreach(const QString& str, parser.value(sizesOption).split(',')) {
+            QStringList wh = str.split('x');
+            int w = wh.count() == 2 ? wh[0].toInt() : 0;
+            int h = wh.count() == 2 ? wh[1].toInt() : 0;
+            if ( w < 16 || h < 16 ) {
+                fprintf(stderr, "invalid size: %s\n", str.toLocal8Bit().data());
+                return 1;
+            }
+            sizes.push_back(QSize(w, h));
+        }
+        bench.setSizes(sizes);
+    }
+    if ( parser.isSet(threadsOption) ) {
+        QVector<int> threads;
+        foreach(const QString& str, parser.value(threadsOption).split(',')) {
+            int n = str.toInt();
+            if ( n < 1 ) {
+                fprintf(stderr, "invalid thread count: %s\n", str.toLocal8Bit().data());
+                return 1;
+            }
+            threads.push_back(n);
+        }
+        bench.setThreads(threads);
+    }
+    if ( parser.isSet(framesOption) )
+        bench.setFrames(parser.value(framesOption).toInt());
+    if ( parser.isSet(repeatOption) )
+        bench.setRepeat(parser.value(repeatOption).toInt());
+    if ( parser.isSet(casesOption) ) {
+        QStringList cases = parser.value(casesOption).split(',');
+        foreach(const QString& name, cases) {
+            if ( !Bench::cases().contains(name) ) {
+                fprintf(stderr, "unknown case: %s\n", name.toLocal8Bit().data());
+                return 1;
+            }
+        }
+        bench.setFilter(cases);
+    }
+
+    QByteArray report = QJsonDocument(bench.run()).toJson();
+    if ( parser.isSet(outputOption) ) {
+        QFile file(parser.value(outputOption));
+        if ( !file.open(QIODevice::WriteOnly|QIODevice::Truncate) ||
+             file.write(report) != report.size() ) {
+            fprintf(stderr, "could not write %s\n", file.fileName().toLocal8Bit().data());
+            return 1;
+        }
+    }
+    else {
+        fwrite(report.data(), 1, report.size(), stdout);
+    }
+    return 0;
+}
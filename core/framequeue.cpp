@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QMutexLocker>
+
+#include "framequeue.h"
+
+FrameQueue::FrameQueue(int capacity) :
+    m_mutex(),
+    m_notEmpty(),
+    m_notFull(),
+    m_queue(),
+    m_capacity(capacity > 0 ? capacity : 1),
+    m_attached(false),
+    m_closed(false),
+    m_aborted(false)
+{
+}
+
+FrameQueue::~FrameQueue()
+{
+}
+
+int FrameQueue::capacity() const
+{
+    return m_capacity;
+}
+
+/**
+ * @brief FrameQueue::prefill
+ * enqueue without blocking, used to replay frames produced before
+ * the stream was opened
+ */
+void FrameQueue::prefill(const Photo &photo)
+{
+    QMutexLocker lock(&m_mutex);
+    if ( m_aborted )
+        return;
+    m_queue.enqueue(photo);
+    m_notEmpty.wakeOne();
+}
+
+FrameQueue::Status FrameQueue::push(const Photo &photo, unsigned long timeout)
+{
+    QMutexLocker lock(&m_mutex);
+    if ( m_attached && !m_aborted && m_queue.count() >= m_capacity )
+        m_notFull.wait(&m_mutex, timeout);
+    if ( m_aborted || m_closed )
+        return Closed;
+    if ( m_attached && m_queue.count() >= m_capacity )
+        return Timeout;
+    m_queue.enqueue(photo);
+    m_notEmpty.wakeOne();
+    return Ok;
+}
+
+FrameQueue::Status FrameQueue::pop(Photo &photo, unsigned long timeout)
+{
+    QMutexLocker lock(&m_mutex);
+    if ( !m_aborted && !m_closed && m_queue.isEmpty() && timeout )
+        m_notEmpty.wait(&m_mutex, timeout);
+    if ( m_aborted )
+        return Closed;
+    if ( m_queue.isEmpty() )
+        return m_closed ? Closed : Timeout;
+    photo = m_queue.dequeue();
+    m_notFull.wakeOne();
+    return Ok;
+}
+
+void FrameQueue::attach()
+{
+    QMutexLocker lock(&m_mutex);
+    m_attached = true;
+}
+
+void FrameQueue::close()
+{
+    QMutexLocker lock(&m_mutex);
+    m_closed = true;
+    m_notEmpty.wakeAll();
+    m_notFull.wakeAll();
+}
+
+void FrameQueue::abort()
+{
+    QMutexLocker lock(&m_mutex);
+    m_aborted = true;
+    m_queue.clear();
+    m_notEmpty.wakeAll();
+    m_notFull.wakeAll();
+}
+
+bool FrameQueue::isAborted() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_aborted;
+}
+
+int FrameQueue::pending() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_queue.count();
+}
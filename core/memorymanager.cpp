@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QTemporaryDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QMetaObject>
+#include <QRunnable>
+
+#include "memorymanager.h"
+#include "operator.h"
+#include "operatorinput.h"
+#include "operatoroutput.h"
+#include "console.h"
+
+MemoryManager *memoryManager = NULL;
+
+/*
+ * writes or reads the images of a job in the store thread, the result
+ * is collected in the GUI thread
+ */
+class MemoryStoreJob : public QRunnable
+{
+public:
+    MemoryStoreJob(MemoryManager *manager, std::shared_ptr<MemoryManager::Job> job) :
+        QRunnable(),
+        m_manager(manager),
+        m_job(job)
+    {}
+
+    void run() {
+        MemoryManager::Job& job = *m_job;
+        try {
+            for (int i = 0, s = job.files.count() ; i < s ; ++i) {
+                if ( job.files[i].isEmpty() )
+                    continue;
+                if ( job.kind == MemoryManager::Job::Spill ) {
+                    Magick::Image& image = job.images[i];
+                    image.compressType(Magick::ZipCompression);
+                    image.write(job.files[i].toLocal8Bit().constData());
+                    image = Magick::Image();
+                }
+                else {
+                    job.images[i].read(job.files[i].toLocal8Bit().constData());
+                }
+            }
+            job.success = true;
+        }
+        catch (std::exception &e) {
+            job.error = e.what();
+            job.images.clear();
+        }
+        m_manager->finished(m_job);
+    }
+
+private:
+    MemoryManager *m_manager;
+    std::shared_ptr<MemoryManager::Job> m_job;
+};
+
+MemoryManager::MemoryManager(QObject *parent) :
+    QObject(parent),
+    m_mutex(),
+    m_outputs(),
+    m_workers(),
+    m_budget(-1),
+    m_outputBytes(0),
+    m_workerBytes(0),
+    m_releasingBytes(0),
+    m_clock(0),
+    m_generation(0),
+    m_spillCount(0),
+    m_store(NULL),
+    m_enforcePending(false),
+    m_pool(),
+    m_done()
+{
+    /* one job at a time, the store is a single disk */
+    m_pool.setMaxThreadCount(1);
+}
+
+MemoryManager::~MemoryManager()
+{
+    m_pool.waitForDone();
+    foreach(const std::shared_ptr<Job>& job, m_done)
+        if ( job->kind == Job::Spill )
+            foreach(const QString& filename, job->files)
+                if ( !filename.isEmpty() )
+                    QFile::remove(filename);
+    for (QMap<OperatorOutput*, Entry>::iterator it = m_outputs.begin() ;
+         it != m_outputs.end() ; ++it )
+        removeFiles(*it);
+    delete m_store;
+}
+
+qint64 MemoryManager::photoBytes(const Photo &photo)
+{
+    const Magick::Image& image = photo.image();
+    return qint64(image.columns()) * image.rows() * sizeof(Magick::PixelPacket);
+}
+
+/**
+ * @brief MemoryManager::setBudget
+ * @param bytes the budget, unlimited if not positive
+ */
+void MemoryManager::setBudget(qint64 bytes)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_budget = bytes;
+    }
+    schedule();
+}
+
+qint64 MemoryManager::budget() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_budget;
+}
+
+qint64 MemoryManager::used() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_outputBytes + m_workerBytes;
+}
+
+/**
+ * @brief MemoryManager::track
+ * accounts the new result of output, replacing any previous one
+ */
+void MemoryManager::track(OperatorOutput *output)
+{
+    if ( output->m_result.isEmpty() ) {
+        forget(output);
+        return;
+    }
+    qint64 bytes = 0;
+    foreach(const Photo& photo, output->m_result)
+        bytes += photoBytes(photo);
+    {
+        QMutexLocker lock(&m_mutex);
+        QMap<OperatorOutput*, Entry>::iterator it = m_outputs.find(output);
+        if ( it == m_outputs.end() ) {
+            Entry entry;
+            entry.bytes = 0;
+            entry.busy = false;
+            it = m_outputs.insert(output, entry);
+        }
+        else if ( it->files.isEmpty() ) {
+            m_outputBytes -= it->bytes;
+        }
+        removeFiles(*it);
+        it->bytes = bytes;
+        it->lastUse = ++m_clock;
+        /* a job still running on the previous result is ignored */
+        it->generation = ++m_generation;
+        it->busy = false;
+        m_outputBytes += bytes;
+    }
+    schedule();
+}
+
+void MemoryManager::forget(OperatorOutput *output)
+{
+    QMutexLocker lock(&m_mutex);
+    QMap<OperatorOutput*, Entry>::iterator it = m_outputs.find(output);
+    if ( it == m_outputs.end() )
+        return;
+    if ( it->files.isEmpty() )
+        m_outputBytes -= it->bytes;
+    removeFiles(*it);
+    m_outputs.erase(it);
+}
+
+/**
+ * @brief MemoryManager::touch
+ * marks the result of output as used, reloading it if it was spilled.
+ * The reload is synchronous, operators prefetch their sources first
+ */
+void MemoryManager::touch(OperatorOutput *output)
+{
+    bool spilled;
+    {
+        QMutexLocker lock(&m_mutex);
+        QMap<OperatorOutput*, Entry>::iterator it = m_outputs.find(output);
+        if ( it == m_outputs.end() )
+            return;
+        it->lastUse = ++m_clock;
+        spilled = !it->files.isEmpty();
+    }
+    if ( spilled && reload(output) )
+        schedule();
+}
+
+/**
+ * @brief MemoryManager::prefetch
+ * starts reloading the spilled result of output in the store thread,
+ * waiter is played again once it is back
+ * @return true if waiter has to wait for the result
+ */
+bool MemoryManager::prefetch(OperatorOutput *output, Operator *waiter)
+{
+    std::shared_ptr<Job> job;
+    {
+        QMutexLocker lock(&m_mutex);
+        QMap<OperatorOutput*, Entry>::iterator it = m_outputs.find(output);
+        if ( it == m_outputs.end() || it->files.isEmpty() )
+            return false;
+        if ( !it->waiters.contains(waiter) )
+            it->waiters.push_back(waiter);
+        if ( it->busy )
+            return true;
+        it->busy = true;
+        job.reset(new Job);
+        job->kind = Job::Reload;
+        job->output = output;
+        job->generation = it->generation;
+        job->lastUse = it->lastUse;
+        job->bytes = it->bytes;
+        job->files = it->files;
+        job->images.resize(job->files.count());
+        job->success = false;
+    }
+    start(job);
+    return true;
+}
+
+void MemoryManager::workerAcquire(OperatorWorker *worker, qint64 bytes)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_workers[worker] += bytes;
+        m_workerBytes += bytes;
+    }
+    schedule();
+}
+
+void MemoryManager::workerRelease(OperatorWorker *worker)
+{
+    QMutexLocker lock(&m_mutex);
+    m_workerBytes -= m_workers.take(worker);
+}
+
+void MemoryManager::schedule()
+{
+    QMutexLocker lock(&m_mutex);
+    if ( m_budget <= 0 ||
+         m_outputBytes - m_releasingBytes + m_workerBytes <= m_budget ||
+         m_enforcePending )
+        return;
+    m_enforcePending = true;
+    QMetaObject::invokeMethod(this, "enforce", Qt::QueuedConnection);
+}
+
+/**
+ * @brief MemoryManager::isEligible
+ * a result may only be released once the operator and all its
+ * consumers are up to date
+ */
+bool MemoryManager::isEligible(OperatorOutput *output) const
+{
+    if ( !output->m_operator->isUpToDate() )
+        return false;
+    foreach(OperatorInput *sink, output->sinks())
+        if ( !sink->m_operator->isUpToDate() )
+            return false;
+    return true;
+}
+
+void MemoryManager::enforce()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_enforcePending = false;
+    }
+    for (;;) {
+        OperatorOutput *victim = NULL;
+        {
+            QMutexLocker lock(&m_mutex);
+            if ( m_budget <= 0 ||
+                 m_outputBytes - m_releasingBytes + m_workerBytes <= m_budget )
+                return;
+            qint64 oldest = 0;
+            for (QMap<OperatorOutput*, Entry>::iterator it = m_outputs.begin() ;
+                 it != m_outputs.end() ; ++it ) {
+                if ( !it->files.isEmpty() || it->busy || 0 == it->bytes )
+                    continue;
+                if ( victim && it->lastUse >= oldest )
+                    continue;
+                if ( !isEligible(it.key()) )
+                    continue;
+                victim = it.key();
+                oldest = it->lastUse;
+            }
+        }
+        if ( !victim ) {
+            dflDebug(tr("Memory budget exceeded, nothing left to release"));
+            return;
+        }
+        Operator *op = victim->m_operator;
+        if ( op->getInputs().isEmpty() ) {
+            dflDebug(tr("Memory budget: dropping results of %0").arg(op->getName()));
+            op->dropResults();
+        }
+        else {
+            dflDebug(tr("Memory budget: spilling %0 of %1").arg(victim->name()).arg(op->getName()));
+            if ( !spill(victim) )
+                return;
+        }
+    }
+}
+
+/**
+ * @brief MemoryManager::spill
+ * hands the images of output to the store thread, they are released
+ * when the job is collected, unless output was used or replaced meanwhile
+ */
+bool MemoryManager::spill(OperatorOutput *output)
+{
+    if ( !m_store ) {
+        m_store = new QTemporaryDir(preferences->getTmpDir() + "/darkflow-XXXXXX");
+        if ( !m_store->isValid() ) {
+            dflError(tr("Unable to create the spill store in %0").arg(preferences->getTmpDir()));
+            delete m_store;
+            m_store = NULL;
+            return false;
+        }
+    }
+    std::shared_ptr<Job> job(new Job);
+    job->kind = Job::Spill;
+    job->output = output;
+    job->success = false;
+    for (int i = 0, s = output->m_result.count() ; i < s ; ++i) {
+        const Magick::Image& source = output->m_result[i].image();
+        job->images.push_back(source);
+        if ( 0 == source.columns() )
+            job->files.push_back(QString());
+        else
+            job->files.push_back(QString("%0/%1.miff").arg(m_store->path()).arg(++m_spillCount));
+    }
+    {
+        QMutexLocker lock(&m_mutex);
+        Entry& entry = m_outputs[output];
+        entry.busy = true;
+        job->generation = entry.generation;
+        job->lastUse = entry.lastUse;
+        job->bytes = entry.bytes;
+        m_releasingBytes += entry.bytes;
+    }
+    start(job);
+    return true;
+}
+
+/**
+ * @brief MemoryManager::reload
+ * reads the spilled result of output back in the calling thread
+ */
+bool MemoryManager::reload(OperatorOutput *output)
+{
+    QStringList files;
+    {
+        QMutexLocker lock(&m_mutex);
+        files = m_outputs.value(output).files;
+    }
+    try {
+        for (int i = 0, s = qMin(files.count(), output->m_result.count()) ; i < s ; ++i) {
+            if ( files[i].isEmpty() )
+                continue;
+            Magick::Image image;
+            image.read(files[i].toLocal8Bit().constData());
+            output->m_result[i].image() = image;
+        }
+    }
+    catch (std::exception &e) {
+        dflError(tr("Reload of spilled results failed: %0").arg(e.what()));
+        return false;
+    }
+    QMutexLocker lock(&m_mutex);
+    Entry& entry = m_outputs[output];
+    removeFiles(entry);
+    m_outputBytes += entry.bytes;
+    return true;
+}
+
+void MemoryManager::start(std::shared_ptr<Job> job)
+{
+    m_pool.start(new MemoryStoreJob(this, job));
+}
+
+/* called from the store thread */
+void MemoryManager::finished(std::shared_ptr<Job> job)
+{
+    QMutexLocker lock(&m_mutex);
+    m_done.push_back(job);
+    QMetaObject::invokeMethod(this, "collect", Qt::QueuedConnection);
+}
+
+/**
+ * @brief MemoryManager::collect
+ * applies the finished jobs to the results, in the GUI thread
+ */
+void MemoryManager::collect()
+{
+    QList<std::shared_ptr<Job> > done;
+    {
+        QMutexLocker lock(&m_mutex);
+        done.swap(m_done);
+    }
+    foreach(const std::shared_ptr<Job>& job, done) {
+        QList<QPointer<Operator> > waiters;
+        bool applied = false;
+        {
+            QMutexLocker lock(&m_mutex);
+            if ( job->kind == Job::Spill )
+                m_releasingBytes -= job->bytes;
+            QMap<OperatorOutput*, Entry>::iterator it = m_outputs.find(job->output);
+            if ( it != m_outputs.end() && job->kind == Job::Reload )
+                waiters.swap(it->waiters);
+            if ( it != m_outputs.end() && it->generation == job->generation ) {
+                it->busy = false;
+                if ( job->kind == Job::Reload ) {
+                    /* still spilled, not reloaded by a touch meanwhile */
+                    applied = job->success && it->files == job->files &&
+                            job->images.count() == job->output->m_result.count();
+                    if ( applied ) {
+                        for (int i = 0, s = job->images.count() ; i < s ; ++i)
+                            if ( !job->files[i].isEmpty() )
+                                job->output->m_result[i].image() = job->images[i];
+                        removeFiles(*it);
+                        m_outputBytes += it->bytes;
+                    }
+                }
+                else {
+                    /* left alone if it was used or became needed meanwhile */
+                    applied = job->success && it->files.isEmpty() &&
+                            it->lastUse == job->lastUse &&
+                            job->images.count() == job->output->m_result.count() &&
+                            isEligible(job->output);
+                    if ( applied ) {
+                        for (int i = 0, s = job->files.count() ; i < s ; ++i)
+                            if ( !job->files[i].isEmpty() )
+                                job->output->m_result[i].image() = Magick::Image();
+                        it->files = job->files;
+                        m_outputBytes -= it->bytes;
+                    }
+                }
+            }
+        }
+        if ( !job->success )
+            dflError(job->kind == Job::Spill
+                     ? tr("Spill failed: %0").arg(job->error)
+                     : tr("Reload of spilled results failed: %0").arg(job->error));
+        if ( job->kind == Job::Spill && !applied )
+            foreach(const QString& filename, job->files)
+                if ( !filename.isEmpty() )
+                    QFile::remove(filename);
+        foreach(const QPointer<Operator>& waiter, waiters)
+            if ( waiter )
+                QMetaObject::invokeMethod(waiter, "play", Qt::QueuedConnection);
+    }
+    schedule();
+}
+
+void MemoryManager::removeFiles(Entry &entry)
+{
+    foreach(const QString& filename, entry.files)
+        if ( !filename.isEmpty() )
+            QFile::remove(filename);
+    entry.files.clear();
+}
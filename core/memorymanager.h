@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef MEMORYMANAGER_H
+#define MEMORYMANAGER_H
+
+#include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+#include <QPointer>
+#include <QVector>
+#include <memory>
+
+#include "photo.h"
+
+class QTemporaryDir;
+class OperatorOutput;
+class OperatorWorker;
+class Operator;
+
+/*
+ * Accounts the pixels held by the results of the operators and by the
+ * running workers against a global budget. Under pressure, the least
+ * recently used results are spilled to a compressed store on disk and
+ * reloaded on access, or dropped when they come from a loader and
+ * can be read again.
+ * Results are handled in the GUI thread only, workers may report
+ * from any thread. The disk store is written and read by a background
+ * thread, operators wait for their spilled sources to be prefetched
+ * before playing.
+ */
+class MemoryManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MemoryManager(QObject *parent = 0);
+    ~MemoryManager();
+
+    static qint64 photoBytes(const Photo& photo);
+
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+    qint64 used() const;
+
+    void track(OperatorOutput *output);
+    void forget(OperatorOutput *output);
+    void touch(OperatorOutput *output);
+    bool prefetch(OperatorOutput *output, Operator *waiter);
+
+    void workerAcquire(OperatorWorker *worker, qint64 bytes);
+    void workerRelease(OperatorWorker *worker);
+
+    typedef struct {
+        enum { Spill, Reload } kind;
+        OperatorOutput *output;
+        qint64 generation;
+        qint64 lastUse;
+        qint64 bytes;
+        QVector<Magick::Image> images;
+        QStringList files;
+        bool success;
+        QString error;
+    } Job;
+
+private slots:
+    void enforce();
+    void collect();
+
+private:
+    friend class MemoryStoreJob;
+    typedef struct {
+        qint64 bytes;
+        qint64 lastUse;
+        qint64 generation;
+        bool busy;
+        QStringList files;
+        QList<QPointer<Operator> > waiters;
+    } Entry;
+
+    bool isEligible(OperatorOutput *output) const;
+    bool spill(OperatorOutput *output);
+    bool reload(OperatorOutput *output);
+    void start(std::shared_ptr<Job> job);
+    void finished(std::shared_ptr<Job> job);
+    void removeFiles(Entry& entry);
+    void schedule();
+
+    mutable QMutex m_mutex;
+    QMap<OperatorOutput*, Entry> m_outputs;
+    QMap<OperatorWorker*, qint64> m_workers;
+    qint64 m_budget;
+    qint64 m_outputBytes;
+    qint64 m_workerBytes;
+    qint64 m_releasingBytes;
+    qint64 m_clock;
+    qint64 m_generation;
+    qint64 m_spillCount;
+    QTemporaryDir *m_store;
+    bool m_enforcePending;
+    QThreadPool m_pool;
+    QList<std::shared_ptr<Job> > m_done;
+};
+
+extern MemoryManager *memoryManager;
+
+#endif // MEMORYMANAGER_H
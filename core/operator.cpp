@@ -33,6 +33,10 @@
 #include <QStringList>
 #include <QApplication>
 #include <QInputDialog>
+#include <QTimer>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QSet>
 
 #include <cstdio>
 
@@ -44,6 +48,10 @@
 #include "operatorinput.h"
 #include "operatoroutput.h"
 #include "operatorworker.h"
+#include "framequeue.h"
+#include "preferences.h"
+#include "shard.h"
+#include "memorymanager.h"
 
 Operator::Operator(const QString& classSection,
                    const char* docLink,
@@ -59,7 +67,19 @@ Operator::Operator(const QString& classSection,
     m_inputs(),
     m_outputs(),
     m_outputStatus(),
+    m_inputStreams(),
     m_scaleCompatibility(ScaleCompatibility(scaleCompatibility)),
+    m_executionModel(WholeSet),
+    m_resultDropped(false),
+    m_playRequested(0),
+    m_proxySource(false),
+    m_footprint(FootprintGlobal),
+    m_region(),
+    m_regionPhoto(),
+    m_appending(false),
+    m_appendReplay(false),
+    m_appendPending(),
+    m_appendReference(),
     m_waitingParentFor(NotWaiting),
     m_uuid(Process::uuid()),
     m_docLink(QString(docLink).arg(tr("en")).arg(classIdentifier)),
@@ -69,9 +89,16 @@ Operator::Operator(const QString& classSection,
     m_name(tr(classIdentifier)),
     m_tagsOverride(),
     m_thread(new QThread(this)),
-    m_worker(NULL)
+    m_worker(NULL),
+    m_replayTimer(new QTimer(this)),
+    m_playDeferred(false),
+    m_appendDeferred(false)
 {
     connect(this, SIGNAL(setError(QString,QString)), this, SLOT(setErrorTag(QString,QString)), Qt::QueuedConnection);
+    m_replayTimer->setSingleShot(true);
+    m_replayTimer->setInterval(DF_REPLAY_DELAY);
+    connect(m_replayTimer, SIGNAL(timeout()), this, SLOT(play()));
+    connect(m_thread, SIGNAL(finished()), this, SLOT(threadFinished()));
 }
 
 Operator::~Operator()
@@ -102,6 +129,16 @@ void Operator::stop()
     m_thread->requestInterruption();
 }
 
+/**
+ * @brief Operator::replay
+ * plays once the changes stopped coming for DF_REPLAY_DELAY ms, a burst
+ * of parameter changes restarts the worker only once
+ */
+void Operator::replay()
+{
+    m_replayTimer->start();
+}
+
 void Operator::clone()
 {
     Operator *op = newInstance();
@@ -131,18 +168,37 @@ void Operator::workerSuccess(QVector<QVector<Photo> > result)
     m_worker=NULL;
     m_waitingParentFor = NotWaiting;
 
+    if ( m_appending ) {
+        m_appending = false;
+        workerAppended(result);
+        return;
+    }
+
+    if ( m_resultDropped ) {
+        /* photos were handed over to a streaming sink, nothing to keep */
+        m_resultDropped = false;
+        m_upToDate = false;
+        foreach(OperatorOutput *output, m_outputs)
+            output->clearResult();
+        emit outOfDate();
+        emit progress(0, 1);
+        return;
+    }
+
     int idx = 0;
     Q_ASSERT(m_outputs.count() == result.count());
     foreach(OperatorOutput *output, m_outputs) {
-        output->m_result.clear();
         if ( m_outputStatus[idx] == OutputEnabled )
-            foreach(Photo photo, result[idx]) {
-                output->m_result.push_back(photo);
-            }
+            output->setResult(result[idx]);
+        else
+            output->clearResult();
         ++idx;
     }
 
     setUpToDate();
+    /* the inputs grew while this run was going on */
+    if ( m_appendReplay || !m_appendPending.isEmpty() )
+        playAppend();
 }
 
 void Operator::workerFailure()
@@ -150,9 +206,32 @@ void Operator::workerFailure()
     m_thread->quit();
     m_worker=NULL;
     m_waitingParentFor = NotWaiting;
+    m_resultDropped = false;
+    m_appending = false;
+    m_appendReplay = false;
+    m_appendPending.clear();
+    m_appendReference.clear();
+    m_appendDeferred = false;
     setOutOfDate();
 }
 
+/**
+ * @brief Operator::threadFinished
+ * runs the play or append requested while the previous worker's thread
+ * was winding down
+ */
+void Operator::threadFinished()
+{
+    if ( m_appendDeferred ) {
+        m_appendDeferred = false;
+        playAppend();
+    }
+    if ( m_playDeferred && !m_worker ) {
+        m_playDeferred = false;
+        play();
+    }
+}
+
 void Operator::parentUpToDate()
 {
     switch (m_waitingParentFor) {
@@ -268,17 +347,55 @@ QString Operator::getLocalizedClassIdentifier() const
 }
 
 
+/**
+ * @brief Operator::play_parentDirty
+ * When about to play, a streamable input fed by a single running parent
+ * is not considered dirty, its photos will be consumed while the parent
+ * produces them.
+ */
 bool Operator::play_parentDirty(WaitForParentReason reason)
 {
     bool dirty = false;
-    foreach(OperatorInput *input, m_inputs)
-        foreach(OperatorOutput *parentOutput, input->sources()) {
+    int idx = 0;
+    /* a source restricted to a region is evaluated whole again for an
+     * operator evaluating whole frames */
+    if ( m_region.isNull() ) {
+        foreach(OperatorInput *input, m_inputs) {
+            foreach(OperatorOutput *parentOutput, input->sources()) {
+                if ( !parentOutput->m_operator->region().isNull() ) {
+                    dflDebug(tr("Region evaluation cancelled by %0").arg(getName()));
+                    m_process->requestRegion(parentOutput->m_operator, QString(), QRect());
+                    break;
+                }
+            }
+        }
+    }
+    m_inputStreams.fill(std::shared_ptr<FrameQueue>(), m_inputs.count());
+    foreach(OperatorInput *input, m_inputs) {
+        QSet<OperatorOutput*> sources = input->sources();
+        foreach(OperatorOutput *parentOutput, sources) {
             if ( !parentOutput->m_operator->isUpToDate() ) {
-                dirty = true;
                 parentOutput->m_operator->play();
+                if ( reason == WaitingForPlay &&
+                     sources.count() == 1 &&
+                     isStreamable(idx) ) {
+                    m_inputStreams[idx] = play_openStream(parentOutput);
+                    if ( m_inputStreams[idx] )
+                        continue;
+                }
+                dirty = true;
                 m_waitingParentFor = reason;
             }
         }
+        ++idx;
+    }
+    if ( dirty ) {
+        /* will be collected when parents are up to date */
+        foreach(std::shared_ptr<FrameQueue> stream, m_inputStreams)
+            if ( stream )
+                stream->abort();
+        m_inputStreams.fill(std::shared_ptr<FrameQueue>());
+    }
     if (dirty && reason == WaitingForPlay ) {
         //will be signaled later
         emit progress(0, 1);
@@ -335,6 +452,53 @@ void Operator::releaseAlgorithm(Algorithm *) const
 {
 }
 
+Operator::ExecutionModel Operator::executionModel() const
+{
+    return m_executionModel;
+}
+
+/**
+ * @brief Operator::setExecutionModel
+ * to be called by the constructor of operators whose worker does not
+ * need the whole input sets at once
+ */
+void Operator::setExecutionModel(Operator::ExecutionModel model)
+{
+    m_executionModel = model;
+}
+
+/**
+ * @brief Operator::isStreamable
+ * @return true if the worker may consume the photos of input inputIdx
+ * while the parent produces them, the other inputs of a per-frame
+ * operator are collected whole
+ */
+bool Operator::isStreamable(int inputIdx) const
+{
+    return m_executionModel == PerFrame && inputIdx == 0 && m_region.isNull();
+}
+
+/**
+ * @brief Operator::filterInput
+ * dedup the identity of an incoming photo and apply the tags override
+ * @return false if the photo must be dropped
+ */
+bool Operator::filterInput(Photo &photo, QMap<QString, int> &seen,
+                           const QMap<QString, QMap<QString, QString> > &tagsOverride)
+{
+    QString identity = photo.getIdentity();
+    identity = identity.split('|').first();
+    int count = ++seen[identity];
+    if ( count > 1 )
+        identity+=QString("|%0").arg(count-1);
+    photo.setIdentity(identity);
+
+    applyTagsOverride(photo, tagsOverride);
+    QString treatTag = photo.getTag(TAG_TREAT);
+    return treatTag != TAG_TREAT_DISCARDED &&
+            treatTag != TAG_TREAT_ERROR;
+}
+
 QVector<QVector<Photo> > Operator::collectInputs()
 {
     QMap<QString, int> seen;
@@ -344,55 +508,318 @@ QVector<QVector<Photo> > Operator::collectInputs()
     foreach(OperatorInput *input, m_inputs) {
         inputs.push_back(QVector<Photo>());
         foreach(OperatorOutput *source, input->sources()) {
-            foreach(Photo photo, source->m_result) {
-                QString identity = photo.getIdentity();
-                identity = identity.split('|').first();
-                int count = ++seen[identity];
-                if ( count > 1 )
-                    identity+=QString("|%0").arg(count-1);
-                photo.setIdentity(identity);
-
-                overrideTags(photo);
-                QString treatTag = photo.getTag(TAG_TREAT);
-                if ( treatTag != TAG_TREAT_DISCARDED &&
-                     treatTag != TAG_TREAT_ERROR) {
+            foreach(Photo photo, source->getResult()) {
+                if ( filterInput(photo, seen, m_tagsOverride) ) {
                     inputs[i].push_back(photo);
                 }
-                else if ( treatTag == TAG_TREAT_ERROR ) {
+                else if ( photo.getTag(TAG_TREAT) == TAG_TREAT_ERROR ) {
                     dflWarning(tr("Photo: %0 discarded because of error").arg(photo.getIdentity()));
                 }
             }
         }
         ++i;
     }
+    /* while tuning on proxies or evaluating a region, only the selected
+     * photo goes through the first input, the other inputs are references
+     * and kept whole */
+    QString focus = m_region.isNull() ? m_process->proxyFocus() : m_regionPhoto;
+    if ( !focus.isEmpty() && inputs.count() ) {
+        QVector<Photo> selected;
+        foreach(const Photo& photo, inputs[0]) {
+            if ( photo.getIdentity().split("|").first() == focus )
+                selected.push_back(photo);
+        }
+        if ( selected.count() )
+            inputs[0] = selected;
+    }
+    if ( !m_region.isNull() ) {
+        QRect needed = inputRegion(m_region);
+        for ( int i = 0 ; i < inputs.count() ; ++i )
+            for ( int j = 0 ; j < inputs[i].count() ; ++j )
+                inputs[i][j].restrictToRegion(needed);
+    }
     return inputs;
 }
 
+std::shared_ptr<FrameQueue> Operator::play_openStream(OperatorOutput *source)
+{
+    Operator *parent = source->m_operator;
+    if ( !parent->m_worker )
+        return std::shared_ptr<FrameQueue>();
+    /* a result consumed by a single streaming sink is not kept when it
+     * comes from a loader, the files are read again if it is needed.
+     * In streaming mode, intermediate results are dropped as well */
+    bool transient = ( parent->m_inputs.isEmpty() ||
+                       preferences->getStreamingMode() ) &&
+            source->sinks().count() == 1;
+    std::shared_ptr<FrameQueue> stream =
+            parent->m_worker->openStream(parent->m_outputs.indexOf(source),
+                                         2 * DfThreadLimit(),
+                                         transient);
+    if ( stream ) {
+        dflDebug(tr("Streaming from %0").arg(parent->getName()));
+        if ( transient )
+            parent->m_resultDropped = true;
+    }
+    return stream;
+}
+
 void Operator::play() {
     Q_ASSERT(QThread::currentThread() == thread());
+    m_replayTimer->stop();
     if (m_worker) {
         dflDebug(tr("Already playing"));
         return;
     }
     if (isUpToDate())
         return;
-    if (play_parentDirty(WaitingForPlay))
+    if ( !m_playRequested )
+        m_playRequested = Profiler::now();
+    /* a sharded segment is evaluated from the loaders by worker
+     * processes, the parents in this process are left alone */
+    bool sharded = m_process->shards() > 1 &&
+            m_region.isNull() &&
+            m_process->proxyFocus().isEmpty() &&
+            Shard::frameSources(this, NULL);
+    if (!sharded && play_parentDirty(WaitingForPlay))
         return;
+    if ( !sharded ) {
+        /* spilled sources are read back in the store thread first */
+        bool prefetching = false;
+        foreach(OperatorInput *input, m_inputs)
+            foreach(OperatorOutput *source, input->sources())
+                if ( memoryManager->prefetch(source, this) )
+                    prefetching = true;
+        if ( prefetching ) {
+            dflDebug(tr("Waiting for spilled sources of %0").arg(getName()));
+            return;
+        }
+    }
     dflDebug("play on "+m_uuid);
+    if ( m_thread->isRunning() ) {
+        /* the previous worker's thread is winding down, starting it again
+         * now would be a no-op and keep its interruption request */
+        m_playDeferred = true;
+        return;
+    }
     m_workerAboutToStart = true;
-    m_worker = newWorker();
+    if ( sharded )
+        m_worker = new ShardWorker(m_process, m_thread, this);
+    else
+        m_worker = newWorker();
+    m_worker->setPlayRequested(m_playRequested);
+    m_playRequested = 0;
     setOutOfDate();
-    m_worker->start(collectInputs(), m_outputStatus);
+    if ( sharded ) {
+        m_inputStreams.fill(std::shared_ptr<FrameQueue>());
+        m_worker->start(QVector<QVector<Photo> >(m_inputs.count()), m_outputStatus);
+    }
+    else {
+        for (int idx = 0 ; idx < m_inputStreams.count() ; ++idx )
+            if ( m_inputStreams[idx] )
+                m_worker->setInputStream(idx, m_inputStreams[idx], m_tagsOverride);
+        m_inputStreams.fill(std::shared_ptr<FrameQueue>());
+        m_worker->start(collectInputs(), m_outputStatus);
+    }
     m_workerAboutToStart = false;
     dflDebug(tr("Worker started for %0").arg(m_uuid));
 }
 
+Operator::AppendModel Operator::appendModel() const
+{
+    if ( m_executionModel == PerFrame || m_inputs.isEmpty() )
+        return AppendFrames;
+    return AppendReplay;
+}
+
+/**
+ * @brief Operator::isFoldedOutput
+ * @return true for the outputs an AppendFolded run replaces, the others
+ * only get the photos of the appended frames
+ */
+bool Operator::isFoldedOutput(int idx) const
+{
+    Q_UNUSED(idx);
+    return true;
+}
+
+/**
+ * @brief Operator::isLive
+ * @return true for the loaders watching a directory for new files
+ */
+bool Operator::isLive() const
+{
+    return false;
+}
+
+/**
+ * @brief Operator::stopLive
+ * stops watching for new files, the loader keeps its current collection
+ */
+void Operator::stopLive()
+{
+}
+
+bool Operator::liveUpstream() const
+{
+    if ( isLive() )
+        return true;
+    foreach(OperatorInput *input, m_inputs)
+        foreach(OperatorOutput *source, input->sources())
+            if ( source->m_operator->liveUpstream() )
+                return true;
+    return false;
+}
+
+bool Operator::isAppending() const
+{
+    return m_appending;
+}
+
+/**
+ * @brief Operator::parentAppended
+ * photos were appended to the result of a parent while this operator was
+ * up to date, or computing with the previous result. Depending on the
+ * append model, only the new photos are played, or everything is.
+ */
+void Operator::parentAppended(int idx, const QVector<Photo> &photos)
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+    if ( !m_worker && !m_upToDate )
+        return; /* they will be collected with the others */
+    if ( idx != 0 || appendModel() == AppendReplay ) {
+        parentReplaced();
+        return;
+    }
+    m_appendPending += photos;
+    if ( !m_worker )
+        playAppend();
+}
+
+/**
+ * @brief Operator::parentReplaced
+ * the whole sets have to be computed again, once the current run is over
+ */
+void Operator::parentReplaced()
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+    if ( m_worker ) {
+        m_appendReplay = true;
+        return;
+    }
+    bool upToDate = m_upToDate;
+    setOutOfDate();
+    if ( upToDate )
+        replay();
+}
+
+/**
+ * @brief Operator::playAppend
+ * starts a worker on the pending photos of the first input alone, the
+ * operator stays up to date with its previous results meanwhile
+ */
+void Operator::playAppend()
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+    if ( m_worker )
+        return;
+    if ( m_thread->isRunning() ) {
+        /* see play() */
+        m_appendDeferred = true;
+        return;
+    }
+    if ( m_appendReplay || ( m_inputs.count() && appendModel() == AppendReplay ) ) {
+        m_appendReplay = false;
+        m_appendPending.clear();
+        parentReplaced();
+        return;
+    }
+    foreach(OperatorInput *input, m_inputs) {
+        foreach(OperatorOutput *source, input->sources()) {
+            if ( !source->m_operator->isUpToDate() ) {
+                /* a parent released its result meanwhile */
+                m_appendPending.clear();
+                setOutOfDate();
+                return;
+            }
+        }
+    }
+    QVector<QVector<Photo> > inputs = collectInputs();
+    if ( inputs.count() ) {
+        QSet<QString> added;
+        foreach(const Photo& photo, m_appendPending)
+            added.insert(photo.getIdentity());
+        QVector<Photo> selected;
+        if ( appendModel() == AppendFramesWithReference ) {
+            Photo *reference = Photo::findReference(inputs[0]);
+            if ( reference && !added.contains(reference->getIdentity()) ) {
+                m_appendReference = reference->getIdentity();
+                reference->setTag(TAG_TREAT, TAG_TREAT_REFERENCE);
+                selected.push_back(*reference);
+            }
+        }
+        foreach(const Photo& photo, inputs[0])
+            if ( added.contains(photo.getIdentity().split("|").first()) )
+                selected.push_back(photo);
+        inputs[0] = selected;
+    }
+    m_appendPending.clear();
+    dflDebug(tr("Appending on %0").arg(m_uuid));
+    m_appending = true;
+    m_worker = newWorker();
+    m_worker->start(inputs, m_outputStatus);
+}
+
+/**
+ * @brief Operator::workerAppended
+ * folded operators replace their results and their consumers play
+ * again, the others append theirs and pass the new photos down
+ */
+void Operator::workerAppended(const QVector<QVector<Photo> > &result)
+{
+    bool folded = appendModel() == AppendFolded;
+    Q_ASSERT(m_outputs.count() == result.count());
+    for (int idx = 0 ; idx < m_outputs.count() ; ++idx ) {
+        if ( m_outputStatus[idx] != OutputEnabled )
+            continue;
+        OperatorOutput *output = m_outputs[idx];
+        QVector<Photo> photos;
+        foreach(const Photo& photo, result[idx])
+            if ( m_appendReference.isEmpty() ||
+                 photo.getIdentity() != m_appendReference )
+                photos.push_back(photo);
+        bool replaced = folded && isFoldedOutput(idx);
+        if ( replaced )
+            output->setResult(photos);
+        else
+            output->setResult(output->getResult() + photos);
+        foreach(OperatorInput *remoteInput, output->sinks()) {
+            Operator *sink = remoteInput->m_operator;
+            if ( replaced ) {
+                sink->parentReplaced();
+            }
+            else if ( photos.count() ) {
+                sink->parentAppended(sink->m_inputs.indexOf(remoteInput), photos);
+            }
+        }
+    }
+    m_appendReference.clear();
+    setUpToDate();
+    if ( m_appendReplay || !m_appendPending.isEmpty() )
+        playAppend();
+}
+
 bool Operator::isUpToDate() const
 {
     dflDebug(tr("%0 is up to date: %1").arg(m_uuid).arg(m_upToDate && !m_worker));
     return m_upToDate;
 }
 
+bool Operator::isPlaying() const
+{
+    return m_worker != NULL;
+}
+
 void Operator::setUpToDate()
 {
     Q_ASSERT(QThread::currentThread() == thread());
@@ -411,7 +838,7 @@ void Operator::setOutOfDate()
     }
     m_upToDate = false;
     foreach(OperatorOutput *output, m_outputs) {
-        output->m_result.clear();
+        output->clearResult();
         foreach(OperatorInput *remoteInput, output->sinks())
             remoteInput->m_operator->setOutOfDate();
     }
@@ -420,6 +847,23 @@ void Operator::setOutOfDate()
     emit progress(0, 1);
 }
 
+/**
+ * @brief Operator::dropResults
+ * releases the results without invalidating the consumers, they will
+ * be computed again when needed
+ */
+void Operator::dropResults()
+{
+    Q_ASSERT(QThread::currentThread() == thread());
+    if ( m_worker )
+        return;
+    m_upToDate = false;
+    foreach(OperatorOutput *output, m_outputs)
+        output->clearResult();
+    emit outOfDate();
+    emit progress(0, 1);
+}
+
 void Operator::setErrorTag(const QString &photoIdentity, const QString &msg)
 {
     setTagOverride(photoIdentity, TAG_TREAT, TAG_TREAT_ERROR);
@@ -470,10 +914,17 @@ QMap<QString, QString> Operator::photoTags(const QString &photoIdentity)
  */
 void Operator::overrideTags(Photo &photo)
 {
-    QString identity = photo.getIdentity();
-    if (!photoTagsExists(identity))
+    applyTagsOverride(photo, m_tagsOverride);
+}
+
+void Operator::applyTagsOverride(Photo &photo,
+                                 const QMap<QString, QMap<QString, QString> > &tagsOverride)
+{
+    QMap<QString, QMap<QString, QString> >::const_iterator photoTags =
+            tagsOverride.find(photo.getIdentity());
+    if ( photoTags == tagsOverride.end() )
         return;
-    QMap<QString, QString> tags = photoTags(identity);
+    QMap<QString, QString> tags = photoTags.value();
     for(QMap<QString, QString>::iterator it = tags.begin() ;
         it != tags.end() ;
         ++it ) {
@@ -528,6 +979,114 @@ void Operator::operator_disconnect(Operator *outputOperator, int outputIdx,
     emit inputOperator->stateChanged();
 }
 
+Operator::Footprint Operator::footprint() const
+{
+    return m_footprint;
+}
+
+/**
+ * @brief Operator::footprintRadius
+ * @return the reach in pixels of a local operator, overridden by the
+ * operators whose neighbourhood depends on their parameters
+ */
+int Operator::footprintRadius() const
+{
+    return 0;
+}
+
+/**
+ * @brief Operator::inputRegion
+ * @return the area of the inputs needed to compute the given area of the
+ * outputs, a null rect stands for the whole frame
+ */
+QRect Operator::inputRegion(const QRect &region) const
+{
+    if ( region.isNull() )
+        return QRect();
+    switch(m_footprint) {
+    case FootprintPointwise:
+        return region;
+    case FootprintLocal: {
+        int r = footprintRadius();
+        return region.adjusted(-r, -r, r, r);
+    }
+    default:
+    case FootprintGlobal:
+        return QRect();
+    }
+}
+
+QRect Operator::region() const
+{
+    return m_region;
+}
+
+QString Operator::regionPhoto() const
+{
+    return m_regionPhoto;
+}
+
+/**
+ * @brief Operator::setRegion
+ * restricts the evaluation to an area of one photo, a null region
+ * restores the evaluation of whole sets of frames
+ */
+void Operator::setRegion(const QString &photoIdentity, const QRect &region)
+{
+    QString identity = region.isNull() ? QString() : photoIdentity;
+    if ( m_region == region && m_regionPhoto == identity )
+        return;
+    m_region = region;
+    m_regionPhoto = identity;
+    setOutOfDate();
+}
+
+void Operator::setFootprint(Footprint footprint)
+{
+    m_footprint = footprint;
+}
+
+bool Operator::isProxySource() const
+{
+    return m_proxySource;
+}
+
+/**
+ * @brief Operator::proxyScale
+ * @return the downsampling factor of the photos this operator loads,
+ * 1 for full resolution
+ */
+int Operator::proxyScale() const
+{
+    if ( !m_proxySource )
+        return 1;
+    return m_process->proxyScale();
+}
+
+/**
+ * @brief Operator::proxySignature
+ * @return identifies the decoding settings of a proxy source, the files
+ * collections are left out since the cached proxies are per file
+ */
+QString Operator::proxySignature() const
+{
+    QJsonArray parameters;
+    foreach(OperatorParameter *parameter, m_parameters) {
+        QJsonObject obj = parameter->save(QString());
+        if ( obj["type"].toString() == "filesCollection" )
+            continue;
+        parameters.push_back(obj);
+    }
+    QByteArray hash = QCryptographicHash::hash(QJsonDocument(parameters).toJson(QJsonDocument::Compact),
+                                               QCryptographicHash::Sha1);
+    return m_uuid + "/" + QString(hash.toHex()) + "/" + QString::number(proxyScale());
+}
+
+void Operator::setProxySource(bool proxySource)
+{
+    m_proxySource = proxySource;
+}
+
 void Operator::save(QJsonObject &obj, const QString& baseDirStr)
 {
     QJsonArray parameters;
@@ -595,11 +1154,15 @@ void Operator::load(QJsonObject &obj)
 
 static void logMessage(Console::Level level, const QString& who, const QString& msg)
 {
+    if ( !Console::isEnabled(level) )
+        return;
     dflMessage(level, who+": "+msg);
 }
 
-void Operator::dflDebug(const char *fmt, ...) const
+void (Operator::dflDebug)(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Debug) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -611,8 +1174,10 @@ void Operator::dflDebug(const char *fmt, ...) const
     free(msg);
 }
 
-void Operator::dflInfo(const char *fmt, ...) const
+void (Operator::dflInfo)(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Info) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -626,6 +1191,8 @@ void Operator::dflInfo(const char *fmt, ...) const
 
 void Operator::dflWarning(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Warning) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -639,6 +1206,8 @@ void Operator::dflWarning(const char *fmt, ...) const
 
 void Operator::dflError(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Error) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -652,6 +1221,8 @@ void Operator::dflError(const char *fmt, ...) const
 
 void Operator::dflCritical(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Critical) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -663,12 +1234,12 @@ void Operator::dflCritical(const char *fmt, ...) const
     free(msg);
 }
 
-void Operator::dflDebug(const QString &msg) const
+void (Operator::dflDebug)(const QString &msg) const
 {
     logMessage(Console::Debug, getName(), msg);
 }
 
-void Operator::dflInfo(const QString &msg) const
+void (Operator::dflInfo)(const QString &msg) const
 {
     logMessage(Console::Info, getName(), msg);
 }
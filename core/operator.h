@@ -37,6 +37,8 @@
 #include <QSet>
 #include <QString>
 #include <QJsonObject>
+#include <QRect>
+#include <memory>
 
 #include "ports.h"
 #include "photo.h"
@@ -46,7 +48,12 @@ class OperatorInput;
 class OperatorOutput;
 class Process;
 class QThread;
+class QTimer;
 class OperatorWorker;
+class FrameQueue;
+
+/* delay in ms during which bursts of changes are coalesced into one replay */
+#define DF_REPLAY_DELAY 250
 
 #define OP_SECTION_ASSETS           Operator::tr("Assets"), "/docs/assets.%0/#%1"
 #define OP_SECTION_WORKFLOW         Operator::tr("Workflow"), "/docs/workflow.%0/#%1"
@@ -85,6 +92,21 @@ public:
         NonHDR    = (Linear|NonLinear),
         All       = (NonHDR|HDR),
     } ScaleCompatibility;
+    typedef enum {
+        WholeSet,   /* needs the complete input sets at once */
+        PerFrame    /* maps each photo of its first input independently */
+    } ExecutionModel;
+    typedef enum {
+        AppendReplay,               /* computed again from the whole sets */
+        AppendFrames,               /* the new photos go through alone, results are appended */
+        AppendFramesWithReference,  /* ... along with the reference photo of the set */
+        AppendFolded                /* folded in state kept from the previous run, folded outputs are replaced */
+    } AppendModel;
+    typedef enum {
+        FootprintGlobal,    /* an output pixel may depend on the whole frame */
+        FootprintPointwise, /* an output pixel depends on the same input pixel */
+        FootprintLocal      /* ... and on its neighbours within footprintRadius() */
+    } Footprint;
     explicit Operator(const QString& classSection,
                       const char *docLink,
                       const char* classIdentifier,
@@ -110,6 +132,7 @@ public:
     void setEnabled(bool enabled);
 
     bool isUpToDate() const;
+    bool isPlaying() const;
 
     QString uuid() const;
     void setUuid(const QString &uuid);
@@ -153,8 +176,38 @@ public:
     virtual Algorithm *getAlgorithm() const;
     virtual void releaseAlgorithm(Algorithm *) const;
 
+    ExecutionModel executionModel() const;
+    virtual AppendModel appendModel() const;
+    virtual bool isFoldedOutput(int idx) const;
+    virtual bool isLive() const;
+    virtual void stopLive();
+    bool liveUpstream() const;
+    bool isAppending() const;
+    bool isStreamable(int inputIdx) const;
+    void dropResults();
+
+    Footprint footprint() const;
+    virtual int footprintRadius() const;
+    QRect inputRegion(const QRect& region) const;
+    QRect region() const;
+    QString regionPhoto() const;
+    void setRegion(const QString& photoIdentity, const QRect& region);
+
+    bool isProxySource() const;
+    int proxyScale() const;
+    QString proxySignature() const;
+
+    static bool filterInput(Photo& photo, QMap<QString, int>& seen,
+                            const QMap<QString, QMap<QString, QString> >& tagsOverride);
+    static void applyTagsOverride(Photo& photo,
+                                  const QMap<QString, QMap<QString, QString> >& tagsOverride);
+
 private:
     QVector<QVector<Photo> > collectInputs();
+    std::shared_ptr<FrameQueue> play_openStream(OperatorOutput *source);
+    void parentAppended(int idx, const QVector<Photo>& photos);
+    void parentReplaced();
+    void workerAppended(const QVector<QVector<Photo> >& result);
 
 signals:
     void progress(int ,int );
@@ -168,6 +221,7 @@ public:
 
 public slots:
     void play();
+    void replay();
     void stop();
     void clone();
     void refreshInputs();
@@ -193,17 +247,21 @@ public slots:
     void overrideTags(Photo& photo);
 
 protected:
-    void dflDebug(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
-    void dflInfo(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
+    void (dflDebug)(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
+    void (dflInfo)(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
     void dflWarning(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
     void dflError(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
     void dflCritical(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
-    void dflDebug(const QString& msg) const;
-    void dflInfo(const QString& msg) const;
+    void (dflDebug)(const QString& msg) const;
+    void (dflInfo)(const QString& msg) const;
     void dflWarning(const QString& msg) const;
     void dflError(const QString& msg) const;
     void dflCritical(const QString& msg) const;
 
+    void setExecutionModel(ExecutionModel model);
+    void playAppend();
+    void setProxySource(bool proxySource);
+    void setFootprint(Footprint footprint);
 
 protected:
     friend class Visualization;
@@ -216,7 +274,20 @@ private:
     QVector<OperatorInput*> m_inputs;
     QVector<OperatorOutput*> m_outputs;
     QVector<OperatorOutputStatus> m_outputStatus;
+    QVector<std::shared_ptr<FrameQueue> > m_inputStreams;
     ScaleCompatibility m_scaleCompatibility;
+    ExecutionModel m_executionModel;
+    bool m_resultDropped;
+    qint64 m_playRequested;
+    bool m_proxySource;
+    Footprint m_footprint;
+    QRect m_region;
+    QString m_regionPhoto;
+    /* live mode: photos appended to the first input while up to date */
+    bool m_appending;
+    bool m_appendReplay;
+    QVector<Photo> m_appendPending;
+    QString m_appendReference;
 protected:
     WaitForParentReason m_waitingParentFor;
     QString m_uuid;
@@ -229,6 +300,12 @@ protected:
 
     QThread *m_thread;
     OperatorWorker *m_worker;
+    QTimer *m_replayTimer;
+    bool m_playDeferred;
+    bool m_appendDeferred;
+
+private slots:
+    void threadFinished();
 
 };
 
@@ -32,6 +32,7 @@
 #include "operatorinput.h"
 #include "operatoroutput.h"
 #include "photo.h"
+#include "memorymanager.h"
 
 OperatorOutput::OperatorOutput(const QString &name,
                                Operator *parent) :
@@ -45,6 +46,7 @@ OperatorOutput::OperatorOutput(const QString &name,
 
 OperatorOutput::~OperatorOutput()
 {
+    memoryManager->forget(this);
 }
 
 QString OperatorOutput::name() const
@@ -67,9 +69,26 @@ void OperatorOutput::removeSink(OperatorInput *input)
     m_sinks.remove(input);
 }
 
-QVector<Photo> OperatorOutput::getResult() const
+/**
+ * @brief OperatorOutput::getResult
+ * @return the result, reloaded first if it was spilled to disk
+ */
+QVector<Photo> OperatorOutput::getResult()
 {
+    memoryManager->touch(this);
     return m_result;
 }
 
+void OperatorOutput::setResult(const QVector<Photo> &result)
+{
+    m_result = result;
+    memoryManager->track(this);
+}
+
+void OperatorOutput::clearResult()
+{
+    m_result.clear();
+    memoryManager->forget(this);
+}
+
 
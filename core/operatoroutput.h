@@ -54,7 +54,9 @@ public:
     QSet<OperatorInput *> sinks() const;
     void addSink(OperatorInput *input);
     void removeSink(OperatorInput *input);
-    QVector<Photo> getResult() const;
+    QVector<Photo> getResult();
+    void setResult(const QVector<Photo>& result);
+    void clearResult();
 
 public:
     Operator *m_operator;
@@ -77,6 +77,17 @@ void OperatorParameterFilesCollection::setCollection(const QStringList &collecti
     emit setOutOfDate();
 }
 
+/**
+ * @brief OperatorParameterFilesCollection::appendCollection
+ * adds files without invalidating the operator, for a loader taking them
+ * in as appended photos
+ */
+void OperatorParameterFilesCollection::appendCollection(const QStringList &files)
+{
+    m_collection += files;
+    emit parameterChanged();
+}
+
 QString OperatorParameterFilesCollection::currentValue() const
 {
     int count = m_collection.count();
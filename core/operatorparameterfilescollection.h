@@ -54,6 +54,7 @@ public:
 
     QStringList collection() const;
     void setCollection(const QStringList &collection);
+    void appendCollection(const QStringList &files);
     QString currentValue() const;
 
     QJsonObject save(const QString& baseDirStr);
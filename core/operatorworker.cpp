@@ -40,6 +40,9 @@
 #include "photo.h"
 #include "preferences.h"
 #include "hdr.h"
+#include "framequeue.h"
+#include "memorymanager.h"
+#include "proxycache.h"
 
 static struct AtStart {
     AtStart() {
@@ -55,10 +58,25 @@ OperatorWorker::OperatorWorker(QThread *thread, Operator *op) :
     m_outputs(),
     m_outputStatus(),
     m_elapsed(),
+    m_outputsMutex(),
+    m_outputStreams(),
+    m_outputTransient(),
+    m_streamsState(StreamsOpen),
+    m_inputStreams(),
+    m_tagsOverride(),
+    m_streaming(false),
+    m_profile(),
+    m_cpuStart(0),
+    m_proxyScale(op->proxyScale()),
+    m_proxySignature(m_proxyScale > 1 ? op->proxySignature() : QString()),
     m_signalEmited(false),
     m_error(false),
     m_earlyAbort(false)
 {
+    m_profile.uuid = op->uuid();
+    m_profile.name = op->getName();
+    m_profile.thread = quintptr(thread);
+    m_profile.threads = DfThreadLimit();
     moveToThread(thread);
     connect(m_thread, SIGNAL(finished()), this, SLOT(finished()));
     connect(this, SIGNAL(doStart()), this, SLOT(started()));
@@ -72,16 +90,29 @@ void OperatorWorker::start(QVector<QVector<Photo> > inputs, QVector<Operator::Op
 {
     m_inputs = inputs;
     prepareOutputs(outputStatus);
+    m_profile.queued = Profiler::now();
     emit doStart();
 }
 void OperatorWorker::started()
 {
-    bool ret = preferences->acquireWorker(this);
-    if ( !ret ) {
-        emitFailure();
-        return;
+    /* streaming consumers are throttled by their producer and must not
+     * wait for a worker slot the producer may need */
+    foreach(std::shared_ptr<FrameQueue> stream, m_inputStreams) {
+        if ( stream ) {
+            stream->attach();
+            m_streaming = true;
+        }
+    }
+    if ( !m_streaming ) {
+        bool ret = preferences->acquireWorker(this);
+        if ( !ret ) {
+            emitFailure();
+            return;
+        }
     }
     m_elapsed.start();
+    m_profile.started = Profiler::now();
+    m_cpuStart = Profiler::cpuTime();
     play();
 }
 
@@ -90,19 +121,57 @@ int OperatorWorker::outputsCount()
     return m_outputs.count();
 }
 
+/**
+ * @brief OperatorWorker::outputEnabled
+ * @return false when the photos pushed on output idx would be dropped,
+ * workers may then skip building them
+ */
+bool OperatorWorker::outputEnabled(int idx)
+{
+    QMutexLocker lock(&m_outputsMutex);
+    return idx < m_outputStatus.count() &&
+            m_outputStatus[idx] == Operator::OutputEnabled;
+}
+
 void OperatorWorker::outputPush(int idx, const Photo &photo)
 {
-    if ( idx < m_outputs.count() ) {
-        if ( m_outputStatus[idx] == Operator::OutputEnabled )
-            m_outputs[idx].push_back(photo);
+    /* a photo finished after a stop request may be incomplete */
+    if ( aborted() )
+        return;
+    QVector<std::shared_ptr<FrameQueue> > streams;
+    {
+        QMutexLocker lock(&m_outputsMutex);
+        if ( idx < m_outputs.count() ) {
+            if ( m_outputStatus[idx] == Operator::OutputEnabled &&
+                 !m_outputTransient[idx] ) {
+                qint64 bytes = MemoryManager::photoBytes(photo);
+                m_outputs[idx].push_back(photo);
+                memoryManager->workerAcquire(this, bytes);
+                /* held until the run ends, the peak is the running total */
+                m_profile.peakBytes += bytes;
+            }
+            if ( 0 == idx ) {
+                const Magick::Image& image = photo.image();
+                ++m_profile.frames;
+                m_profile.pixels += qint64(image.columns()) * image.rows();
+            }
+            profileSample();
+            streams = m_outputStreams[idx];
+        }
+        else {
+            dflCritical(tr("OutputPush idx out of range"));
+        }
     }
-    else {
-        dflCritical(tr("OutputPush idx out of range"));
+    /* blocks while a streaming consumer is behind */
+    foreach(std::shared_ptr<FrameQueue> stream, streams) {
+        while ( stream->push(photo, 100) == FrameQueue::Timeout && !aborted() )
+            continue;
     }
 }
 
 void OperatorWorker::outputSort(int idx)
 {
+    QMutexLocker lock(&m_outputsMutex);
     if ( idx < m_outputs.count() ) {
         if ( m_outputStatus[idx] == Operator::OutputEnabled )
             qSort(m_outputs[idx]);
@@ -112,6 +181,71 @@ void OperatorWorker::outputSort(int idx)
     }
 }
 
+/**
+ * @brief OperatorWorker::openStream
+ * called from the operator's thread to let a consumer start on the
+ * photos of output idx while this worker is still producing them.
+ * Photos already produced are replayed first. A transient output is
+ * no longer retained once handed over to the stream.
+ * @return NULL if the output is not available for streaming
+ */
+std::shared_ptr<FrameQueue> OperatorWorker::openStream(int idx, int capacity, bool transient)
+{
+    QMutexLocker lock(&m_outputsMutex);
+    if ( idx >= m_outputs.count() ||
+         m_outputStatus[idx] != Operator::OutputEnabled )
+        return std::shared_ptr<FrameQueue>();
+    std::shared_ptr<FrameQueue> stream(new FrameQueue(capacity));
+    foreach(const Photo& photo, m_outputs[idx])
+        stream->prefill(photo);
+    if ( transient ) {
+        m_outputTransient[idx] = true;
+        m_outputs[idx].clear();
+    }
+    switch(m_streamsState) {
+    case StreamsOpen:
+        m_outputStreams[idx].push_back(stream);
+        break;
+    case StreamsClosed:
+        stream->close();
+        break;
+    case StreamsAborted:
+        stream->abort();
+        break;
+    }
+    return stream;
+}
+
+void OperatorWorker::setInputStream(int idx, const std::shared_ptr<FrameQueue> &stream,
+                                    const QMap<QString, QMap<QString, QString> > &tagsOverride)
+{
+    if ( m_inputStreams.count() <= idx )
+        m_inputStreams.resize(idx+1);
+    m_inputStreams[idx] = stream;
+    m_tagsOverride = tagsOverride;
+}
+
+void OperatorWorker::closeStreams(StreamsState state)
+{
+    QVector<QVector<std::shared_ptr<FrameQueue> > > streams;
+    {
+        QMutexLocker lock(&m_outputsMutex);
+        m_streamsState = state;
+        streams = m_outputStreams;
+    }
+    foreach(QVector<std::shared_ptr<FrameQueue> > output, streams)
+        foreach(std::shared_ptr<FrameQueue> stream, output) {
+            if ( state == StreamsClosed )
+                stream->close();
+            else
+                stream->abort();
+        }
+    /* release the producers */
+    foreach(std::shared_ptr<FrameQueue> stream, m_inputStreams)
+        if ( stream )
+            stream->abort();
+}
+
 void OperatorWorker::play()
 {
     dflDebug("OperatorWorker::play()");
@@ -121,8 +255,10 @@ void OperatorWorker::play()
     if (!play_outputsAvailable())
         return;
 
+    profileBegin("analyse");
     play_analyseSources();
 
+    profileBegin("process");
     play_onInput(0);
     if (!m_signalEmited) {
         dflCritical("BUG: No signal sent!!!");
@@ -140,7 +276,8 @@ void OperatorWorker::finished()
     else { //signal emited, safe to delete
         deleteLater();
     }
-    preferences->releaseWorker();
+    if ( !m_streaming )
+        preferences->releaseWorker();
 }
 
 bool OperatorWorker::aborted() {
@@ -148,6 +285,9 @@ bool OperatorWorker::aborted() {
 }
 
 void OperatorWorker::emitFailure() {
+    closeStreams(StreamsAborted);
+    memoryManager->workerRelease(this);
+    profileEnd(false);
     m_signalEmited = true;
     emit progress(0, 1);
     emit failure();
@@ -159,17 +299,188 @@ void OperatorWorker::emitFailure() {
 
 void OperatorWorker::emitSuccess()
 {
+    /* loops skip their remaining rows once stopped, don't let the
+     * partial results through */
+    if ( aborted() ) {
+        emitFailure();
+        return;
+    }
+    closeStreams(StreamsClosed);
+    memoryManager->workerRelease(this);
+    profileEnd(true);
+    QVector<QVector<Photo> > outputs;
+    {
+        QMutexLocker lock(&m_outputsMutex);
+        outputs = m_outputs;
+    }
     m_signalEmited = true;
     emit progress(1, 1);
-    emit success(m_outputs);
+    emit success(outputs);
     dflInfo(tr("Success (after %0ms)").arg(m_elapsed.elapsed()));
 }
 
 void OperatorWorker::emitProgress(int p, int c, int sub_p, int sub_c)
 {
+    {
+        QMutexLocker lock(&m_outputsMutex);
+        profileSample();
+    }
     emit progress( p * sub_c + sub_p , c * sub_c);
 }
 
+void OperatorWorker::setPlayRequested(qint64 time)
+{
+    m_profile.requested = time;
+}
+
+int OperatorWorker::proxyScale() const
+{
+    return m_proxyScale;
+}
+
+/**
+ * @brief OperatorWorker::proxy
+ * @return the photo box-averaged down to the proxy scale, CFA photos are
+ * averaged per photosite color to keep their filter pattern
+ */
+Photo OperatorWorker::proxy(const Photo &photo) const
+{
+    int s = m_proxyScale;
+    if ( s <= 1 || photo.isUndefined() )
+        return photo;
+    bool cfa = photo.getTag(TAG_PIXELS) == TAG_PIXELS_CFA;
+    bool hdr = photo.getScale() == Photo::HDR;
+    Magick::Image srcImage(photo.image());
+    int w = srcImage.columns();
+    int h = srcImage.rows();
+    /* a CFA proxy pixel of a given parity averages the photosites of the
+     * same parity in a 2s x 2s block */
+    int step = cfa ? 2 : 1;
+    int pw = w / (s * step) * step;
+    int ph = h / (s * step) * step;
+    if ( pw < step || ph < step )
+        return photo;
+    Photo out(photo);
+    try {
+        out.createImage(pw, ph);
+        Ordinary::Pixels src_cache(srcImage);
+        Ordinary::Pixels dst_cache(out.image());
+        const Magick::PixelPacket *src = src_cache.getConst(0, 0, w, h);
+        Magick::PixelPacket *dst = dst_cache.get(0, 0, pw, ph);
+        if ( !src || !dst ) {
+            dflError(tr("Proxy: unable to access pixels"));
+            return photo;
+        }
+        int n = s * s;
+        dfl_parallel_for(y, 0, ph, 4, (srcImage, out.image()), {
+            int by = (y / step) * step * s + y % step;
+            for ( int x = 0 ; x < pw ; ++x ) {
+                int bx = (x / step) * step * s + x % step;
+                double r = 0, g = 0, b = 0;
+                for ( int j = 0 ; j < s ; ++j ) {
+                    const Magick::PixelPacket *line = src + (by + j * step) * w;
+                    for ( int i = 0 ; i < s ; ++i ) {
+                        const Magick::PixelPacket& p = line[bx + i * step];
+                        if ( hdr ) {
+                            r += fromHDR(p.red);
+                            g += fromHDR(p.green);
+                            b += fromHDR(p.blue);
+                        }
+                        else {
+                            r += p.red;
+                            g += p.green;
+                            b += p.blue;
+                        }
+                    }
+                }
+                Magick::PixelPacket& q = dst[y * pw + x];
+                if ( hdr ) {
+                    q.red = toHDR(r / n);
+                    q.green = toHDR(g / n);
+                    q.blue = toHDR(b / n);
+                }
+                else {
+                    q.red = DF_ROUND(r / n);
+                    q.green = DF_ROUND(g / n);
+                    q.blue = DF_ROUND(b / n);
+                }
+            }
+        });
+        dst_cache.sync();
+    }
+    catch (std::exception &e) {
+        dflError(tr("Proxy: %0").arg(e.what()));
+        return photo;
+    }
+    out.setTag(TAG_PROXY, QString("1/%0").arg(s));
+    return out;
+}
+
+/**
+ * @brief OperatorWorker::proxyFetch
+ * @return true if the proxies of the file are cached, always false at
+ * full resolution
+ */
+bool OperatorWorker::proxyFetch(const QString &filename, QVector<Photo> &photos) const
+{
+    if ( m_proxyScale <= 1 )
+        return false;
+    return proxyCache->fetch(ProxyCache::key(m_proxySignature, filename), photos);
+}
+
+/**
+ * @brief OperatorWorker::proxyStore
+ * the cache outlives the run, photos of an interrupted run may be
+ * incomplete and are not stored
+ */
+void OperatorWorker::proxyStore(const QString &filename, const QVector<Photo> &photos) const
+{
+    if ( m_proxyScale <= 1 || m_error ||
+         m_thread->isInterruptionRequested() || DfInterrupted() )
+        return;
+    proxyCache->store(ProxyCache::key(m_proxySignature, filename), photos);
+}
+
+/**
+ * @brief OperatorWorker::profileBegin
+ * closes the current phase of the run, if any, and opens a new one
+ */
+void OperatorWorker::profileBegin(const QString &phase)
+{
+    qint64 now = Profiler::now();
+    QMutexLocker lock(&m_outputsMutex);
+    if ( !m_profile.phases.isEmpty() && 0 == m_profile.phases.last().end )
+        m_profile.phases.last().end = now;
+    Profiler::Phase p = { phase, now, 0 };
+    m_profile.phases.push_back(p);
+}
+
+/* called with m_outputsMutex held */
+void OperatorWorker::profileSample()
+{
+    m_profile.busySum += preferences->getAtWork();
+    ++m_profile.busySamples;
+}
+
+void OperatorWorker::profileEnd(bool success)
+{
+    qint64 now = Profiler::now();
+    Profiler::Run run;
+    {
+        QMutexLocker lock(&m_outputsMutex);
+        if ( !m_profile.phases.isEmpty() && 0 == m_profile.phases.last().end )
+            m_profile.phases.last().end = now;
+        m_profile.finished = now;
+        if ( 0 == m_profile.started )
+            m_profile.started = now;
+        else
+            m_profile.cpu = Profiler::cpuTime() - m_cpuStart;
+        m_profile.success = success;
+        run = m_profile;
+    }
+    profiler->record(run);
+}
+
 bool OperatorWorker::play_inputsAvailable()
 {
     if ( 0 == m_inputs.size() ) {
@@ -184,8 +495,11 @@ void OperatorWorker::prepareOutputs(QVector<Operator::OperatorOutputStatus> outp
 {
     m_outputStatus = outputStatus;
     int n_outputs = outputStatus.count();
-    for (int i = 0 ; i < n_outputs ; ++i )
+    for (int i = 0 ; i < n_outputs ; ++i ) {
         m_outputs.push_back(QVector<Photo>());
+        m_outputStreams.push_back(QVector<std::shared_ptr<FrameQueue> >());
+        m_outputTransient.push_back(false);
+    }
 }
 
 bool OperatorWorker::play_outputsAvailable()
@@ -205,6 +519,8 @@ void OperatorWorker::play_analyseSources()
 
 bool OperatorWorker::play_onInput(int idx)
 {
+    if ( m_inputStreams.value(idx) )
+        return play_onInputStream(idx, false);
     int c = 0;
     int p = 0;
     c = m_inputs[idx].count();
@@ -247,7 +563,7 @@ bool OperatorWorker::play_onInput(int idx)
                 }
             }
             if ( !m_error )
-                m_outputs[0].push_back(newPhoto);
+                outputPush(0, newPhoto);
         }
         catch(std::exception &e) {
             setError(photo, e.what());
@@ -266,6 +582,8 @@ bool OperatorWorker::play_onInput(int idx)
 
 bool OperatorWorker::play_onInputParallel(int idx)
 {
+    if ( m_inputStreams.value(idx) )
+        return play_onInputStream(idx, true);
     int c = 0;
     dfl_block int p = 0;
     c = m_inputs[idx].count();
@@ -310,7 +628,7 @@ bool OperatorWorker::play_onInputParallel(int idx)
         dfl_critical_section({
             if ( !m_error ) {
                 emit progress(++p, c);
-                m_outputs[0].push_back(newPhoto);
+                outputPush(0, newPhoto);
             }
         });
     });
@@ -323,19 +641,109 @@ bool OperatorWorker::play_onInputParallel(int idx)
         emitFailure();
     }
     else {
-        qSort(m_outputs[idx]);
+        outputSort(0);
         emitSuccess();
     }
     return true;
 }
 
+/**
+ * @brief OperatorWorker::play_onInputStream
+ * consume photos as the parent produces them, in batches of at most
+ * one photo per thread when parallel
+ */
+bool OperatorWorker::play_onInputStream(int idx, bool parallel)
+{
+    std::shared_ptr<FrameQueue> stream = m_inputStreams[idx];
+    int batchSize = parallel ? DfThreadLimit() : 1;
+    QVector<Photo> batch;
+    QMap<QString, int> seen;
+    dfl_block int p = 0;
+    bool endOfStream = false;
+    while ( !endOfStream && !m_error && !aborted() ) {
+        batch.clear();
+        while ( batch.count() < batchSize ) {
+            Photo photo;
+            FrameQueue::Status status = stream->pop(photo, batch.isEmpty() ? 100 : 0);
+            if ( status == FrameQueue::Closed ) {
+                endOfStream = true;
+                break;
+            }
+            if ( status == FrameQueue::Timeout )
+                break;
+            if ( !Operator::filterInput(photo, seen, m_tagsOverride) ) {
+                if ( photo.getTag(TAG_TREAT) == TAG_TREAT_ERROR )
+                    dflWarning(tr("Photo: %0 discarded because of error").arg(photo.getIdentity()));
+                continue;
+            }
+            batch.push_back(photo);
+        }
+        int n = batch.count();
+        int c = p + n + stream->pending();
+        /* read only from the tasks, without detaching */
+        const QVector<Photo>& frames = batch;
+        dfl_parallel_for(i, 0, n, 1, (), {
+            if ( m_error || aborted() )
+                continue;
+            Photo photo = frames[i];
+            if ( !m_operator->isCompatible(photo) ) {
+                switch ( preferences->getIncompatibleAction()) {
+                case Preferences::Warning:
+                    dflWarning(tr("Incompatible pixel scale: %0").arg(photo.getIdentity()));
+                case Preferences::Ignore:
+                    if ( photo.getScale() == Photo::HDR )
+                        HDR(true).applyOn(photo);
+                    break;
+                default:
+                case Preferences::Error:
+                    setError(photo, tr("Incompatible pixel scale"));
+                    break;
+                }
+            }
+            if ( m_error )
+                continue;
+            Photo newPhoto;
+            try {
+                newPhoto = this->process(photo, p, c);
+            }
+            catch (std::exception &e) {
+                setError(photo, e.what());
+                continue;
+            }
+            if ( !newPhoto.isComplete() ) {
+                dflDebug(tr("Photo is not complete, sending failure"));
+                m_error = true;
+                continue;
+            }
+            dfl_critical_section({
+                if ( !m_error ) {
+                    emit progress(++p, c);
+                    outputPush(0, newPhoto);
+                }
+            });
+        });
+    }
+    if ( m_error || aborted() || stream->isAborted() ) {
+        dflDebug(tr("Stream interrupted, sending failure"));
+        emitFailure();
+        return false;
+    }
+    outputSort(0);
+    emitSuccess();
+    return true;
+}
+
 static void logMessage(Console::Level level, const QString& who, const QString& msg)
 {
+    if ( !Console::isEnabled(level) )
+        return;
     dflMessage(level, who+"(Worker): "+msg);
 }
 
-void OperatorWorker::dflDebug(const char *fmt, ...) const
+void (OperatorWorker::dflDebug)(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Debug) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -347,8 +755,10 @@ void OperatorWorker::dflDebug(const char *fmt, ...) const
     free(msg);
 }
 
-void OperatorWorker::dflInfo(const char *fmt, ...) const
+void (OperatorWorker::dflInfo)(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Info) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -362,6 +772,8 @@ void OperatorWorker::dflInfo(const char *fmt, ...) const
 
 void OperatorWorker::dflWarning(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Warning) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -375,6 +787,8 @@ void OperatorWorker::dflWarning(const char *fmt, ...) const
 
 void OperatorWorker::dflError(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Error) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -388,6 +802,8 @@ void OperatorWorker::dflError(const char *fmt, ...) const
 
 void OperatorWorker::dflCritical(const char *fmt, ...) const
 {
+    if ( !Console::isEnabled(Console::Critical) )
+        return;
     va_list ap;
     char *msg;
     int ret;
@@ -399,12 +815,12 @@ void OperatorWorker::dflCritical(const char *fmt, ...) const
     free(msg);
 }
 
-void OperatorWorker::dflDebug(const QString &msg) const
+void (OperatorWorker::dflDebug)(const QString &msg) const
 {
     logMessage(Console::Debug, m_operator->getName(), msg);
 }
 
-void OperatorWorker::dflInfo(const QString &msg) const
+void (OperatorWorker::dflInfo)(const QString &msg) const
 {
     logMessage(Console::Info, m_operator->getName(), msg);
 }
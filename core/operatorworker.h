@@ -33,13 +33,18 @@
 
 #include <QObject>
 #include <QVector>
+#include <QMap>
+#include <QMutex>
 #include <QElapsedTimer>
+#include <memory>
 
 #include "ports.h"
 #include "photo.h"
 #include "operator.h"
+#include "profiler.h"
 
 class QThread;
+class FrameQueue;
 
 
 class OperatorWorker : public QObject
@@ -51,10 +56,16 @@ public:
     void start(QVector<QVector<Photo> > inputs, QVector<Operator::OperatorOutputStatus> outputStatus);
 
     int outputsCount();
+    bool outputEnabled(int idx);
     void outputPush(int idx, const Photo& photo);
     void outputSort(int idx);
 
+    std::shared_ptr<FrameQueue> openStream(int idx, int capacity, bool transient);
+    void setInputStream(int idx, const std::shared_ptr<FrameQueue>& stream,
+                        const QMap<QString, QMap<QString, QString> >& tagsOverride);
+
     bool aborted();
+    void setPlayRequested(qint64 time);
 
     virtual void play();
 protected slots:
@@ -73,9 +84,27 @@ protected:
     Operator *m_operator;
     QVector<QVector<Photo> > m_inputs;
 private:
+    typedef enum {
+        StreamsOpen,
+        StreamsClosed,
+        StreamsAborted
+    } StreamsState;
     QVector<QVector<Photo> > m_outputs;
     QVector<Operator::OperatorOutputStatus> m_outputStatus;
     QElapsedTimer m_elapsed;
+    QMutex m_outputsMutex;
+    QVector<QVector<std::shared_ptr<FrameQueue> > > m_outputStreams;
+    QVector<bool> m_outputTransient;
+    StreamsState m_streamsState;
+    QVector<std::shared_ptr<FrameQueue> > m_inputStreams;
+    QMap<QString, QMap<QString, QString> > m_tagsOverride;
+    bool m_streaming;
+    Profiler::Run m_profile;
+    qint64 m_cpuStart;
+    int m_proxyScale;
+    QString m_proxySignature;
+    void profileSample();
+    void profileEnd(bool success);
 protected:
     bool m_signalEmited;
     mutable bool m_error;
@@ -84,20 +113,26 @@ protected:
     void emitFailure();
     void emitSuccess();
     void emitProgress(int p, int c, int sub_p, int sub_c);
+    void profileBegin(const QString& phase);
+    int proxyScale() const;
+    Photo proxy(const Photo& photo) const;
+    bool proxyFetch(const QString& filename, QVector<Photo>& photos) const;
+    void proxyStore(const QString& filename, const QVector<Photo>& photos) const;
     bool play_inputsAvailable();
     bool play_outputsAvailable();
     virtual void play_analyseSources();
     virtual bool play_onInput(int idx);
     virtual bool play_onInputParallel(int idx);
+    bool play_onInputStream(int idx, bool parallel);
 
 public:
-    void dflDebug(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
-    void dflInfo(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
+    void (dflDebug)(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
+    void (dflInfo)(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
     void dflWarning(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
     void dflError(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
     void dflCritical(const char* fmt, ...) const DF_PRINTF_FORMAT(2,3);
-    void dflDebug(const QString& msg) const;
-    void dflInfo(const QString& msg) const;
+    void (dflDebug)(const QString& msg) const;
+    void (dflInfo)(const QString& msg) const;
     void dflWarning(const QString& msg) const;
     void dflError(const QString& msg) const;
     void dflCritical(const QString& msg) const;
@@ -106,6 +141,7 @@ public:
 
 private:
     void prepareOutputs(QVector<Operator::OperatorOutputStatus> outputStatus);
+    void closeStreams(StreamsState state);
 };
 
 #endif // OPERATORWORKER_H
@@ -30,10 +30,13 @@
  */
 #include "photo.h"
 #include <QFile>
+#include <QSaveFile>
 #include <QString>
 #include <QPixmap>
 #include <QElapsedTimer>
 #include <QRectF>
+#include <QMutex>
+#include <QMutexLocker>
 #include <Magick++.h>
 #include <cmath>
 
@@ -53,11 +56,19 @@ using Magick::Quantum;
 Photo::Photo(Photo::Gamma gamma, QObject *parent) :
     QObject(parent),
     m_image(),
-    m_curve(newCurve(gamma)),
+    m_curve(sharedCurve(gamma)),
     m_status(Photo::Undefined),
     m_tags(),
-    m_identity(Process::uuid()),
-    m_sequenceNumber(0)
+    m_identity(std::make_shared<PhotoIdentity>()),
+    m_sequenceNumber(0),
+    m_scale(0),
+    m_points(),
+    m_roi(),
+    m_hasROI(false),
+    m_shutter(0),
+    m_isoSpeed(0),
+    m_hdrExposure(),
+    m_hdrTags(0)
 {
     setScale(gamma);
 }
@@ -65,11 +76,19 @@ Photo::Photo(Photo::Gamma gamma, QObject *parent) :
 Photo::Photo(const Magick::Blob &blob, Photo::Gamma gamma, QObject *parent) :
     QObject(parent),
     m_image(blob),
-    m_curve(newCurve(gamma)),
+    m_curve(sharedCurve(gamma)),
     m_status(Photo::Complete),
     m_tags(),
-    m_identity(Process::uuid()),
-    m_sequenceNumber(0)
+    m_identity(std::make_shared<PhotoIdentity>()),
+    m_sequenceNumber(0),
+    m_scale(0),
+    m_points(),
+    m_roi(),
+    m_hasROI(false),
+    m_shutter(0),
+    m_isoSpeed(0),
+    m_hdrExposure(),
+    m_hdrTags(0)
 {
     setScale(gamma);
 }
@@ -77,11 +96,19 @@ Photo::Photo(const Magick::Blob &blob, Photo::Gamma gamma, QObject *parent) :
 Photo::Photo(const Magick::Image& image, Photo::Gamma gamma, QObject *parent) :
     QObject(parent),
     m_image(image),
-    m_curve(newCurve(gamma)),
+    m_curve(sharedCurve(gamma)),
     m_status(Photo::Complete),
     m_tags(),
-    m_identity(Process::uuid()),
-    m_sequenceNumber(0)
+    m_identity(std::make_shared<PhotoIdentity>()),
+    m_sequenceNumber(0),
+    m_scale(0),
+    m_points(),
+    m_roi(),
+    m_hasROI(false),
+    m_shutter(0),
+    m_isoSpeed(0),
+    m_hdrExposure(),
+    m_hdrTags(0)
 {
     setScale(gamma);
 }
@@ -93,7 +120,15 @@ Photo::Photo(const Photo &photo) :
     m_status(photo.m_status),
     m_tags(photo.m_tags),
     m_identity(photo.m_identity),
-    m_sequenceNumber(photo.m_sequenceNumber)
+    m_sequenceNumber(photo.m_sequenceNumber),
+    m_scale(photo.m_scale),
+    m_points(photo.m_points),
+    m_roi(photo.m_roi),
+    m_hasROI(photo.m_hasROI),
+    m_shutter(photo.m_shutter),
+    m_isoSpeed(photo.m_isoSpeed),
+    m_hdrExposure(photo.m_hdrExposure),
+    m_hdrTags(photo.m_hdrTags)
 {
 }
 
@@ -109,6 +144,14 @@ Photo &Photo::operator=(const Photo &photo)
     m_identity = photo.m_identity;
     m_sequenceNumber = photo.m_sequenceNumber;
     m_status = photo.m_status;
+    m_scale = photo.m_scale;
+    m_points = photo.m_points;
+    m_roi = photo.m_roi;
+    m_hasROI = photo.m_hasROI;
+    m_shutter = photo.m_shutter;
+    m_isoSpeed = photo.m_isoSpeed;
+    m_hdrExposure = photo.m_hdrExposure;
+    m_hdrTags = photo.m_hdrTags;
     return *this;
 }
 
@@ -130,27 +173,41 @@ bool Photo::load(const QString &filename)
     }
     m_tags.clear();
     m_tags[TAG_NAME] = filename;
+    syncTags();
     setIdentity(filename);
     return true;
 }
 
-bool Photo::save(const QString &filename, const QString &magick)
+/**
+ * @brief Photo::save
+ * the encoded image replaces filename atomically once complete, a failed
+ * write leaves the previous file untouched
+ */
+bool Photo::save(const QString &filename, const QString &magick, bool floatingPoint)
 {
+    Magick::Blob blob;
     try {
-        Magick::Blob blob;
-        m_image.write(&blob, magick.toStdString());
-        QFile file(filename);
-        file.open(QFile::WriteOnly);
-        if ( !file.write(reinterpret_cast<const char*>(blob.data()),blob.length()) ) {
-            setUndefined();
-            return false;
+        Magick::Image image(m_image);
+        if ( floatingPoint ) {
+            if ( getScale() == HDR )
+                HDR(true).applyOnImage(image, true);
+            image.defineValue("quantum", "format", "floating-point");
+            image.depth(32);
         }
+        image.write(&blob, magick.toStdString());
     }
     catch (std::exception& e) {
         dflCritical("%s", e.what());
         setUndefined();
         return false;
     }
+    QSaveFile file(filename);
+    if ( !file.open(QFile::WriteOnly) ||
+         file.write(static_cast<const char*>(blob.data()), blob.length()) != qint64(blob.length()) ||
+         !file.commit() ) {
+        dflError(tr("Could not write %0: %1").arg(filename).arg(file.errorString()));
+        return false;
+    }
     return true;
 }
 
@@ -229,11 +286,13 @@ QMap<QString, QString> Photo::tags() const
 void Photo::setTag(const QString &name, const QString &value)
 {
     m_tags.insert(name, value);
+    syncTag(name);
 }
 
 void Photo::removeTag(const QString &name)
 {
     m_tags.remove(name);
+    syncTag(name);
 }
 
 QString Photo::getTag(const QString &name) const
@@ -244,6 +303,116 @@ QString Photo::getTag(const QString &name) const
     return it.value();
 }
 
+#define HDR_TAG_COMP 1
+#define HDR_TAG_HIGH 2
+#define HDR_TAG_LOW  4
+#define HDR_TAG_AUTO 8
+#define HDR_TAGS_ALL (HDR_TAG_COMP|HDR_TAG_HIGH|HDR_TAG_LOW|HDR_TAG_AUTO)
+
+/**
+ * @brief Photo::syncTag
+ * parses the tag into its typed copy, if it has one. called once when
+ * the tag changes instead of on every read
+ */
+void Photo::syncTag(const QString &name)
+{
+    QString value = getTag(name);
+    if ( name == TAG_SCALE ) {
+        if ( value == TAG_SCALE_LINEAR )
+            m_scale = Linear;
+        else if ( value == TAG_SCALE_NONLINEAR )
+            m_scale = NonLinear;
+        else if ( value == TAG_SCALE_HDR )
+            m_scale = HDR;
+        else
+            m_scale = 0;
+    }
+    else if ( name == TAG_POINTS ) {
+        m_points.clear();
+        foreach(const QString& point, value.split(';', QString::SkipEmptyParts)) {
+            QStringList coords = point.split(',');
+            if ( coords.count() != 2 ) {
+                dflError(tr("Photo: Invalid numbers in %0").arg(TAG_POINTS));
+                continue;
+            }
+            m_points.push_back(QPointF(coords[0].toDouble(), coords[1].toDouble()));
+        }
+    }
+    else if ( name == TAG_ROI ) {
+        QStringList coord = value.split(',');
+        m_hasROI = coord.size() == 4;
+        m_roi = m_hasROI
+                ? QRectF(QPointF(coord[0].toDouble(), coord[1].toDouble()),
+                         QPointF(coord[2].toDouble(), coord[3].toDouble()))
+                : QRectF();
+    }
+    else if ( name == TAG_SHUTTER ) {
+        m_shutter = value.toDouble();
+    }
+    else if ( name == TAG_ISO_SPEED ) {
+        m_isoSpeed = value.toDouble();
+    }
+    else {
+        int bit;
+        if ( name == TAG_HDR_COMP ) {
+            m_hdrExposure.compensation = value.toDouble();
+            bit = HDR_TAG_COMP;
+        }
+        else if ( name == TAG_HDR_HIGH ) {
+            m_hdrExposure.high = value.toDouble();
+            bit = HDR_TAG_HIGH;
+        }
+        else if ( name == TAG_HDR_LOW ) {
+            m_hdrExposure.low = value.toDouble();
+            bit = HDR_TAG_LOW;
+        }
+        else if ( name == TAG_HDR_AUTO ) {
+            m_hdrExposure.automatic = !!value.toInt();
+            bit = HDR_TAG_AUTO;
+        }
+        else {
+            return;
+        }
+        if ( value.isEmpty() )
+            m_hdrTags &= ~bit;
+        else
+            m_hdrTags |= bit;
+    }
+}
+
+void Photo::syncTags()
+{
+    static const char *typed[] = {
+        TAG_SCALE, TAG_POINTS, TAG_ROI, TAG_SHUTTER, TAG_ISO_SPEED,
+        TAG_HDR_COMP, TAG_HDR_HIGH, TAG_HDR_LOW, TAG_HDR_AUTO
+    };
+    for (size_t i = 0 ; i < sizeof(typed)/sizeof(*typed) ; ++i )
+        syncTag(typed[i]);
+}
+
+
+Magick::Image Photo::sharedCurve(Photo::Gamma gamma)
+{
+    /* built once per gamma and shared by every photo: Magick images are
+     * reference counted and the algorithms altering a curve reset it
+     * before writing, which leaves the interned one untouched. never
+     * freed, Magick may be gone when static destructors run */
+    static QMutex mutex;
+    static QMap<int, Magick::Image> *curves = new QMap<int, Magick::Image>;
+    QMutexLocker lock(&mutex);
+    QMap<int, Magick::Image>::iterator it = curves->find(gamma);
+    if ( it == curves->end() ) {
+        /* the worker drawing it first may be stopped meanwhile, the
+         * curve is built whole before it is interned */
+        Magick::Image curve;
+        {
+            DfUninterruptible uninterruptible;
+            curve = newCurve(gamma);
+        }
+        it = curves->insert(gamma, curve);
+    }
+    return *it;
+}
 
 Magick::Image Photo::newCurve(Photo::Gamma gamma)
 {
@@ -715,18 +884,25 @@ void Photo::setSequenceNumber(int sequenceNumber)
 
 bool Photo::operator<(const Photo &other) const {
     if ( m_sequenceNumber == other.m_sequenceNumber )
-        return (m_identity < other.m_identity);
+        return (getIdentity() < other.getIdentity());
     return (m_sequenceNumber < other.m_sequenceNumber);
 }
 
 QString Photo::getIdentity() const
 {
-    return m_identity;
+    /* most photos are temporaries or get their identity from a loader,
+     * the uuid is drawn the first time it is actually needed. copies
+     * share the holder so that they still agree on it */
+    PhotoIdentity *identity = m_identity.get();
+    std::call_once(identity->drawn, [identity]() {
+        identity->value = Process::uuid();
+    });
+    return identity->value;
 }
 
 void Photo::setIdentity(const QString &identity)
 {
-    m_identity = identity;
+    m_identity = std::make_shared<PhotoIdentity>(identity);
     if ( m_status == Undefined )
         m_status = Identified;
 }
@@ -759,21 +935,7 @@ bool Photo::isComplete() const
 
 QVector<QPointF> Photo::getPoints() const
 {
-    QVector<QPointF> vec;
-    QStringList points = getTag(TAG_POINTS).split(';');
-    if ( points.count() == 1 && points[0].count() == 0 )
-        return vec;
-    foreach(QString point, points) {
-        if ( point.count() == 0 )
-            continue;
-        QStringList coords = point.split(',');
-        if ( coords.count() != 2 ) {
-            dflError(tr("Photo: Invalid numbers in %0").arg(TAG_POINTS));
-            continue;
-        }
-        vec.push_back(QPointF(coords[0].toDouble(), coords[1].toDouble()));
-    }
-    return vec;
+    return m_points;
 }
 
 void Photo::setPoints(const QVector<QPointF>& vec)
@@ -789,33 +951,28 @@ void Photo::setPoints(const QVector<QPointF>& vec)
 
 QRectF Photo::getROI() const
 {
-    QString roiTag = getTag(TAG_ROI);
-    if ( !roiTag.isEmpty() ) {
-        QStringList coord = roiTag.split(',');
-        if ( coord.size() == 4 ) {
-            qreal x1 = coord[0].toDouble();
-            qreal y1 = coord[1].toDouble();
-            qreal x2 = coord[2].toDouble();
-            qreal y2 = coord[3].toDouble();
-            if ( x1 < 0 ) x1 = 0;
-            if ( y1 < 0 ) y1 = 0;
-            if ( x2 < 0 ) x2 = 0;
-            if ( y2 < 0 ) y2 = 0;
-            if ( x1 > image().columns() ) x1=image().columns();
-            if ( y1 > image().rows() ) y1=image().rows();
-            if ( x2 > image().columns() ) x2=image().columns();
-            if ( y2 > image().rows() ) y2=image().rows();
-            qreal x=x1,y=y1,w=x2-x1,h=y2-y1;
-            if ( x1 > x2 ) {
-                x=x2; w=-w;
-            }
-            if ( y1 > y2 ) {
-                y=y2; h=-h;
-            }
-            return QRectF(x,y,w,h);
-        }
+    if ( !m_hasROI )
+        return QRectF();
+    qreal x1 = m_roi.left();
+    qreal y1 = m_roi.top();
+    qreal x2 = m_roi.right();
+    qreal y2 = m_roi.bottom();
+    if ( x1 < 0 ) x1 = 0;
+    if ( y1 < 0 ) y1 = 0;
+    if ( x2 < 0 ) x2 = 0;
+    if ( y2 < 0 ) y2 = 0;
+    if ( x1 > image().columns() ) x1=image().columns();
+    if ( y1 > image().rows() ) y1=image().rows();
+    if ( x2 > image().columns() ) x2=image().columns();
+    if ( y2 > image().rows() ) y2=image().rows();
+    qreal x=x1,y=y1,w=x2-x1,h=y2-y1;
+    if ( x1 > x2 ) {
+        x=x2; w=-w;
     }
-    return QRectF();
+    if ( y1 > y2 ) {
+        y=y2; h=-h;
+    }
+    return QRectF(x,y,w,h);
 }
 
 void Photo::setROI(const QRectF &rect)
@@ -827,6 +984,79 @@ void Photo::setROI(const QRectF &rect)
     setTag(TAG_ROI,roi);
 }
 
+/**
+ * @brief Photo::getRegion
+ * @param frame if not null, receives the size of the whole frame
+ * @return the area of the frame covered by the pixels, the whole image
+ * unless the photo was restricted to a region
+ */
+QRect Photo::getRegion(QSize *frame) const
+{
+    QRect region(0, 0, m_image.columns(), m_image.rows());
+    if ( frame )
+        *frame = region.size();
+    QStringList coord = getTag(TAG_REGION).split(',');
+    if ( coord.size() != 6 )
+        return region;
+    int x1 = coord[0].toInt();
+    int y1 = coord[1].toInt();
+    int x2 = coord[2].toInt();
+    int y2 = coord[3].toInt();
+    if ( x2 - x1 != region.width() || y2 - y1 != region.height() ) {
+        dflWarning(tr("Photo: %0 doesn't match the pixels").arg(TAG_REGION));
+        return region;
+    }
+    if ( frame )
+        *frame = QSize(coord[4].toInt(), coord[5].toInt());
+    return QRect(x1, y1, x2 - x1, y2 - y1);
+}
+
+void Photo::setRegion(const QRect &region, const QSize &frame)
+{
+    if ( region == QRect(QPoint(0, 0), frame) ) {
+        removeTag(TAG_REGION);
+        return;
+    }
+    QString tag = QString::number(region.x()) + "," +
+            QString::number(region.y()) + "," +
+            QString::number(region.x() + region.width()) + "," +
+            QString::number(region.y() + region.height()) + "," +
+            QString::number(frame.width()) + "," +
+            QString::number(frame.height());
+    setTag(TAG_REGION, tag);
+}
+
+/**
+ * @brief Photo::restrictToRegion
+ * crops the pixels to the given area of the frame, CFA photos keep
+ * their filter pattern aligned
+ */
+void Photo::restrictToRegion(const QRect &region)
+{
+    QSize frame;
+    QRect current = getRegion(&frame);
+    QRect target = region & current;
+    if ( getTag(TAG_PIXELS) == TAG_PIXELS_CFA ) {
+        target.setLeft(target.left() & ~1);
+        target.setTop(target.top() & ~1);
+        target &= current;
+    }
+    if ( target.isEmpty() || target == current )
+        return;
+    try {
+        Magick::Geometry geo(target.width(), target.height(),
+                             target.x() - current.x(), target.y() - current.y());
+        m_image.page(Magick::Geometry(0,0,0,0));
+        m_image.crop(geo);
+        m_image.page(Magick::Geometry(0,0,0,0));
+        setRegion(target, frame);
+    }
+    catch (std::exception &e) {
+        dflError("%s", e.what());
+        setUndefined();
+    }
+}
+
 void Photo::setScale(Photo::Gamma gamma)
 {
     if ( gamma & Linear ) {
@@ -840,17 +1070,33 @@ void Photo::setScale(Photo::Gamma gamma)
 
 Photo::Gamma Photo::getScale() const
 {
-    QString scale = getTag(TAG_SCALE);
-    if  ( scale == TAG_SCALE_LINEAR )
-        return Linear;
-    else if ( scale == TAG_SCALE_NONLINEAR )
-        return NonLinear;
-    else if ( scale == TAG_SCALE_HDR )
-        return HDR;
-    else {
+    if ( !m_scale ) {
         dflWarning(tr("Unknown photo scale"));
         return Linear;
     }
+    return Gamma(m_scale);
+}
+
+qreal Photo::getShutter() const
+{
+    return m_shutter;
+}
+
+qreal Photo::getISOSpeed() const
+{
+    return m_isoSpeed;
+}
+
+/**
+ * @brief Photo::getHDRExposure
+ * @return false unless the four HDR exposure tags are set
+ */
+bool Photo::getHDRExposure(Photo::HDRExposure *exposure) const
+{
+    if ( m_hdrTags != HDR_TAGS_ALL )
+        return false;
+    *exposure = m_hdrExposure;
+    return true;
 }
 
 Photo *Photo::findReference(QVector<Photo> &photos)
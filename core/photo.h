@@ -34,8 +34,13 @@
 #include <QObject>
 #include <QMap>
 #include <QString>
+#include <QRect>
+#include <QVector>
+#include <QThread>
+#include <QAtomicInt>
 #include <Magick++.h>
 #include <memory>
+#include <mutex>
 
 #include "ports.h"
 #include "preferences.h"
@@ -72,6 +77,80 @@ bool OnDiskCache(const Magick::Image& image1, const Magick::Image& image2, const
 bool OnDiskCache(const Magick::Image& image1, const Magick::Image& image2, const Magick::Image& image3, const Magick::Image& image4, const Magick::Image& image5, const Magick::Image& image6);
 int DfThreadLimit();
 
+/*
+ * the worker thread a parallel loop iteration runs for, set on the pool
+ * threads while they run an iteration so that nested loops and serial
+ * checks poll the worker instead of the pool thread
+ */
+inline QThread *&DfLoopThread()
+{
+    static DF_THREAD_LOCAL QThread *thread = NULL;
+    return thread;
+}
+
+inline int &DfUninterruptibleDepth()
+{
+    static DF_THREAD_LOCAL int depth = 0;
+    return depth;
+}
+
+inline QThread *DfWorkerThread()
+{
+    if ( DfUninterruptibleDepth() )
+        return NULL;
+    QThread *thread = DfLoopThread();
+    return thread ? thread : QThread::currentThread();
+}
+
+/*
+ * the loops run within its scope are never cut short, for the tables
+ * and curves kept beyond the run that builds them
+ */
+class DfUninterruptible {
+public:
+    DfUninterruptible() { ++DfUninterruptibleDepth(); }
+    ~DfUninterruptible() { --DfUninterruptibleDepth(); }
+};
+
+class DfLoopScope {
+    QThread *m_previous;
+public:
+    DfLoopScope(QThread *thread) : m_previous(DfLoopThread()) { DfLoopThread() = thread; }
+    ~DfLoopScope() { DfLoopThread() = m_previous; }
+};
+
+/*
+ * true when the thread running the current worker was asked to stop.
+ * Long loops poll it at row or tile granularity so that a stale run
+ * releases the cores quickly; the worker then reports a failure and
+ * its partial results are discarded.
+ */
+inline bool DfInterrupted(QThread *thread = DfWorkerThread())
+{
+    return thread && thread->isInterruptionRequested();
+}
+
+/*
+ * interruption of a parallel loop: the thread is polled once per chunk
+ * of iterations, isInterruptionRequested() takes a lock, and the answer
+ * is kept for the remaining iterations of every task
+ */
+class DfInterruptPoll {
+    QThread *m_thread;
+    QAtomicInt m_stop;
+public:
+    DfInterruptPoll(QThread *thread) : m_thread(thread), m_stop(0) {}
+    bool interrupted(bool poll) {
+        if ( m_stop.load() )
+            return true;
+        if ( poll && DfInterrupted(m_thread) ) {
+            m_stop.store(1);
+            return true;
+        }
+        return false;
+    }
+};
+
 class AtWork {
 public:
     AtWork() { preferences->incrAtWork(); }
@@ -138,6 +217,10 @@ do \
     size_t _dfl_end = __end__; \
     size_t _dfl_stride = __stride__; \
     size_t _dfl_n_strides = (_dfl_end-_dfl_start)/_dfl_stride; \
+    size_t _dfl_chunk = _dfl_stride; \
+    QThread *_dfl_thread = DfWorkerThread(); \
+    DfInterruptPoll _dfl_poll(_dfl_thread); \
+    DfInterruptPoll *_dfl_pollp = &_dfl_poll; \
     int _dfl_num_threads = (OnDiskCache __image_list__)?1:DfThreadLimit(); \
     std::shared_ptr<DflDispatch> _dfl_dispatch(new DflDispatch(_dfl_num_threads)); \
     if (_dfl_num_threads > 1 ) { \
@@ -146,10 +229,12 @@ do \
                    ^(size_t _dfl_idx) { \
                        AtWork atWork; \
                        Acquire sem(_dfl_dispatch); \
+                       DfLoopScope _dfl_scope(_dfl_thread); \
                        size_t i_start = _dfl_idx * _dfl_stride + _dfl_start; \
                        size_t i_end = i_start + _dfl_stride; \
                        for ( int __var__ = i_start ; __var__ < (int)i_end ; ++__var__) \
                        { \
+                        if ( _dfl_pollp->interrupted(__var__ == (int)i_start) ) break; \
                         __VA_ARGS__ \
                        } \
                    }); \
@@ -157,7 +242,8 @@ do \
         _dfl_n_strides = _dfl_stride = 0; \
     } \
     for ( int __var__ = _dfl_n_strides*_dfl_stride + _dfl_start ; __var__ < (int)_dfl_end ; ++__var__) \
-        { AtWork atWork; \
+        { if ( _dfl_poll.interrupted((__var__ - _dfl_start) % _dfl_chunk == 0) ) break; \
+          AtWork atWork; \
             { __VA_ARGS__ } \
         } \
 } while (0)
@@ -179,9 +265,13 @@ do \
 #endif
 #define dfl_parallel_for(__var__, __start__, __end__, __stride__, __image_list__, ...) \
 do {\
+    QThread *_dfl_thread = DfWorkerThread(); \
+    DfInterruptPoll _dfl_poll(_dfl_thread); \
+    const int _dfl_start = (__start__); \
     DF_PRAGMA(omp parallel for schedule(static, __stride__) num_threads((OnDiskCache __image_list__ )?1:DfThreadLimit())) \
-    for(int __var__ = __start__ ; __var__ < __end__ ; ++__var__ ) \
-        { AtWork atWork; { __VA_ARGS__ } }\
+    for(int __var__ = _dfl_start ; __var__ < __end__ ; ++__var__ ) \
+        { if ( _dfl_poll.interrupted((__var__ - _dfl_start) % (__stride__) == 0) ) continue; \
+          AtWork atWork; DfLoopScope _dfl_scope(_dfl_thread); { __VA_ARGS__ } }\
 } while (0)
 
 #define dfl_critical_section(...) DF_PRAGMA(omp critical) { __VA_ARGS__ }
@@ -231,6 +321,17 @@ public:
 
 class QRectF;
 
+/* identity of a photo and its copies, a uuid is drawn once unless set */
+class PhotoIdentity {
+public:
+    PhotoIdentity() : drawn(), value() {}
+    explicit PhotoIdentity(const QString& identity) : drawn(), value(identity) {
+        std::call_once(drawn, [](){});
+    }
+    std::once_flag drawn;
+    QString value;
+};
+
 class Photo : public QObject
 {
     Q_OBJECT
@@ -261,6 +362,12 @@ public:
         Identified,
         Complete
     } Status;
+    typedef struct {
+        qreal compensation;
+        qreal high;         /* thresholds, fractions of QuantumRange */
+        qreal low;
+        bool automatic;
+    } HDRExposure;
 
     Photo(Gamma gamma = Linear, QObject *parent = 0);
     Photo(const Magick::Image& image, Gamma gamma, QObject *parent = 0);
@@ -272,7 +379,7 @@ public:
     Photo& operator=(const Photo& photo);
 
     bool load(const QString& filename);
-    bool save(const QString& filename, const QString &magick);
+    bool save(const QString& filename, const QString &magick, bool floatingPoint = false);
 
     void createImage(long width, long height);
     void createImageAlike(const Photo& photo);
@@ -310,8 +417,14 @@ public:
     void setPoints(const QVector<QPointF>& vec);
     QRectF getROI() const;
     void setROI(const QRectF& rect);
+    QRect getRegion(QSize *frame = 0) const;
+    void setRegion(const QRect& region, const QSize& frame);
+    void restrictToRegion(const QRect& region);
     void setScale(Gamma gamma);
     Gamma getScale() const;
+    qreal getShutter() const;
+    qreal getISOSpeed() const;
+    bool getHDRExposure(HDRExposure *exposure) const;
 
     static Photo *findReference(QVector<Photo>& photos);
     static Photo *findReference(Photo **photos, int count);
@@ -321,10 +434,26 @@ private:
     Magick::Image m_curve;
     Status m_status;
     QMap<QString, QString> m_tags;
-    QString m_identity;
+    /* drawn on first use, see getIdentity() */
+    std::shared_ptr<PhotoIdentity> m_identity;
     int m_sequenceNumber;
 
-
+    /* typed copies of the tags read on per-photo and per-frame paths,
+     * kept in sync by setTag() and removeTag(). m_tags stays the
+     * reference for serialization and display */
+    int m_scale;
+    QVector<QPointF> m_points;
+    QRectF m_roi;
+    bool m_hasROI;
+    qreal m_shutter;
+    qreal m_isoSpeed;
+    HDRExposure m_hdrExposure;
+    int m_hdrTags;
+
+    void syncTag(const QString& name);
+    void syncTags();
+
+    static Magick::Image sharedCurve(Gamma gamma);
     static Magick::Image newCurve(Gamma gamma);
 };
 
@@ -339,6 +468,8 @@ private:
 #define TAG_D65_B_MULTIPLIER "D65 B multiplier"
 #define TAG_CAMERA "Camera"
 #define TAG_TIMESTAMP "TimeStamp"
+/* dcraw's ctime() layout, always written and parsed with QLocale::c() */
+#define TAG_TIMESTAMP_FORMAT "ddd MMM d hh:mm:ss yyyy"
 #define TAG_FILTER_PATTERN "Filter pattern"
 #define TAG_COLOR_SPACE "Color Space"
 #define TAG_DEBAYER "Debayer"
@@ -353,6 +484,8 @@ private:
 #define TAG_TREAT_ERROR "ERROR"
 #define TAG_POINTS "Points"
 #define TAG_ROI "ROI"
+#define TAG_PROXY "Proxy"
+#define TAG_REGION "Region"
 #define TAG_HDR_COMP "HDR compensation"
 #define TAG_HDR_HIGH "HDR high threshold"
 #define TAG_HDR_LOW "HDR low threshold"
@@ -364,4 +497,10 @@ private:
 #define TAG_DFT_NORMALIZATION "DFT Normalization"
 #define TAG_DFT_WIDTH "DFT Original Width"
 #define TAG_DFT_HEIGHT "DFT Original Height"
+#define TAG_QUALITY_STARS "Quality stars"
+#define TAG_QUALITY_FWHM "Quality FWHM"
+#define TAG_QUALITY_ECCENTRICITY "Quality eccentricity"
+#define TAG_QUALITY_BACKGROUND "Quality background"
+#define TAG_QUALITY_NOISE "Quality noise"
+#define TAG_QUALITY_SNR "Quality SNR"
 #endif // IMAGE_H
@@ -65,6 +65,7 @@ typedef long long int64_t;
 # define DF_TRAP() do { __asm__("int3"); } while(0)
 # define atomic_incr(ptr) do { __sync_fetch_and_add ((ptr), 1); } while(0)
 # define atomic_decr(ptr) do { __sync_fetch_and_add ((ptr), -1); } while(0)
+# define DF_THREAD_LOCAL __thread
 
 #else /* not GCC */
 
@@ -72,6 +73,7 @@ typedef long long int64_t;
 # define DF_TRAP() __debugbreak()
 # define atomic_incr(ptr) do { InterlockedIncrement ((ptr)); } while(0)
 # define atomic_decr(ptr) do { InterlockedDecrement ((ptr)); } while(0)
+# define DF_THREAD_LOCAL __declspec(thread)
 #endif /* __GNUC__ */
 
 # ifndef M_PI
@@ -38,6 +38,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <signal.h>
 #include <errno.h>
 #include <cstring>
 
@@ -54,6 +55,7 @@ class PosixSpawnImpl {
         channels(),
         error(false),
         started(false),
+        finished(false),
         rc(0)
     {
         channels[0] = channels[1] = -1;
@@ -66,6 +68,7 @@ class PosixSpawnImpl {
     int channels[2];
     bool error;
     bool started;
+    bool finished;
     int rc;
 };
 
@@ -105,27 +108,51 @@ QByteArray PosixSpawn::readAllStandardOutput()
     return array;
 }
 
-bool PosixSpawn::waitForFinished(int)
+/**
+ * @brief PosixSpawn::waitForFinished
+ * @param msecs how long to wait, forever if negative
+ * @return true once the child ended, false on timeout. A failed wait
+ * ends the child's tracking with exit code -1
+ */
+bool PosixSpawn::waitForFinished(int msecs)
 {
-    if ( impl->error || !impl->started )
+    if ( impl->error || !impl->started || impl->finished )
         return false;
     pid_t w;
     int status;
-    do {
-        w = waitpid(impl->pid, &status, WUNTRACED | WCONTINUED);
+    int waited = 0;
+    for (;;) {
+        w = waitpid(impl->pid, &status, WUNTRACED | WCONTINUED | ( msecs < 0 ? 0 : WNOHANG ));
         if ( w < 0 ) {
             dflError("waitpid() failed, errno=%s", strerror(errno));
             impl->error = true;
-            return false;
+            impl->rc = -1;
+            return true;
+        }
+        if ( w == 0 ) {
+            if ( waited >= msecs )
+                return false;
+            usleep(1000);
+            ++waited;
+            continue;
         }
-    } while( !WIFEXITED(status) && !WIFSIGNALED(status));
-    impl->rc = WEXITSTATUS(status);
+        if ( WIFEXITED(status) || WIFSIGNALED(status) )
+            break;
+    }
+    impl->finished = true;
+    impl->rc = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
     if ( impl->rc ) {
         dflError(tr("Child process failed with exit code %0").arg(impl->rc));
     }
     return true;
 }
 
+void PosixSpawn::kill()
+{
+    if ( impl->started && !impl->finished )
+        ::kill(impl->pid, SIGKILL);
+}
+
 bool PosixSpawn::waitForStarted(int )
 {
     if (impl->error || !impl->started) {
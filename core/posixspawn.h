@@ -44,9 +44,11 @@ public:
     ~PosixSpawn();
     int exitCode();
     QByteArray readAllStandardOutput();
-    bool	waitForFinished(int msecs = 30000);
+    /* unlike QProcess, waits until the end by default */
+    bool	waitForFinished(int msecs = -1);
     bool	waitForStarted(int msecs = 30000);
     void	start(const QString & program, const QStringList & arguments, OpenMode mode = ReadWrite);
+    void	kill();
 
 protected:
     virtual qint64	readData(char * data, qint64 maxSize);
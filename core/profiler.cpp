@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QFile>
+
+#include "ports.h"
+#include "profiler.h"
+
+#ifndef DF_WINDOWS
+# include <time.h>
+#endif
+
+Profiler *profiler = NULL;
+
+Profiler::Run::Run() :
+    uuid(),
+    name(),
+    thread(0),
+    requested(0),
+    queued(0),
+    started(0),
+    finished(0),
+    cpu(0),
+    frames(0),
+    pixels(0),
+    peakBytes(0),
+    busySum(0),
+    busySamples(0),
+    threads(1),
+    success(false),
+    phases()
+{
+}
+
+Profiler::Profiler() :
+    m_mutex(),
+    m_runs(),
+    m_lanes()
+{
+    now();
+}
+
+qint64 Profiler::now()
+{
+    static struct Epoch {
+        QElapsedTimer timer;
+        Epoch() { timer.start(); }
+    } epoch;
+    return epoch.timer.nsecsElapsed() / 1000;
+}
+
+qint64 Profiler::cpuTime()
+{
+#ifdef DF_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    if ( !GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) )
+        return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    /* 100ns units */
+    return (k.QuadPart + u.QuadPart) / 10;
+#else
+    struct timespec ts;
+    if ( clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) )
+        return 0;
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void Profiler::record(const Profiler::Run &run)
+{
+    QMutexLocker lock(&m_mutex);
+    if ( !m_lanes.contains(run.thread) )
+        m_lanes.insert(run.thread, m_lanes.count() + 1);
+    m_runs.push_back(run);
+}
+
+/**
+ * @brief Profiler::summaries
+ * @return the runs aggregated per operator, in order of first run
+ */
+QVector<Profiler::Summary> Profiler::summaries() const
+{
+    QMutexLocker lock(&m_mutex);
+    QVector<Summary> summaries;
+    QMap<QString, int> index;
+    foreach(const Run& run, m_runs) {
+        if ( !index.contains(run.uuid) ) {
+            index.insert(run.uuid, summaries.count());
+            Summary summary = { run.uuid, run.name, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+            summaries.push_back(summary);
+        }
+        Summary& summary = summaries[index[run.uuid]];
+        summary.name = run.name;
+        summary.runs++;
+        summary.wall += run.finished - run.started;
+        summary.cpu += run.cpu;
+        summary.waitWorker += run.started - run.queued;
+        if ( run.requested )
+            summary.waitParents += run.queued - run.requested;
+        summary.frames += run.frames;
+        summary.pixels += run.pixels;
+        summary.peakBytes = qMax(summary.peakBytes, run.peakBytes);
+        if ( run.busySamples )
+            summary.utilization += qreal(run.busySum) / run.busySamples / run.threads;
+    }
+    for (int i = 0, s = summaries.count() ; i < s ; ++i)
+        summaries[i].utilization /= summaries[i].runs;
+    return summaries;
+}
+
+void Profiler::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_runs.clear();
+    m_lanes.clear();
+}
+
+static QJsonObject traceEvent(const QString& name, const QString& category,
+                              qint64 start, qint64 end, int lane)
+{
+    QJsonObject event;
+    event["name"] = name;
+    event["cat"] = category;
+    event["ph"] = QString("X");
+    event["ts"] = start;
+    event["dur"] = qMax(end - start, qint64(0));
+    event["pid"] = 1;
+    event["tid"] = lane;
+    return event;
+}
+
+/**
+ * @brief Profiler::exportTrace
+ * writes the runs in the Chrome trace event format, one lane per
+ * worker thread
+ */
+bool Profiler::exportTrace(const QString &filename) const
+{
+    QJsonArray events;
+    {
+        QMutexLocker lock(&m_mutex);
+        foreach(const Run& run, m_runs) {
+            int lane = m_lanes.value(run.thread);
+            if ( run.requested && run.queued > run.requested )
+                events.append(traceEvent(run.name, "wait parents", run.requested, run.queued, lane));
+            if ( run.started > run.queued )
+                events.append(traceEvent(run.name, "wait worker", run.queued, run.started, lane));
+            QJsonObject event = traceEvent(run.name, "operator", run.started, run.finished, lane);
+            QJsonObject args;
+            args["uuid"] = run.uuid;
+            args["success"] = run.success;
+            args["cpu_ms"] = run.cpu / 1000.;
+            args["frames"] = run.frames;
+            args["megapixels"] = run.pixels / 1e6;
+            args["peak_memory_mb"] = run.peakBytes / qreal(1<<20);
+            if ( run.busySamples )
+                args["threads_busy"] = qreal(run.busySum) / run.busySamples / run.threads;
+            event["args"] = args;
+            events.append(event);
+            foreach(const Phase& phase, run.phases)
+                events.append(traceEvent(phase.name, "phase", phase.start, phase.end, lane));
+        }
+    }
+    QJsonObject obj;
+    obj["traceEvents"] = events;
+    obj["displayTimeUnit"] = QString("ms");
+    QFile file(filename);
+    if ( !file.open(QIODevice::WriteOnly|QIODevice::Truncate) )
+        return false;
+    return file.write(QJsonDocument(obj).toJson()) >= 0;
+}
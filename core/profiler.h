@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+
+/*
+ * Collects one record per worker run: wall and CPU time, waits on the
+ * parents and on a worker slot, phases, frames and pixels produced.
+ * CPU time is the process time elapsed during the run, concurrent
+ * workers are accounted to each of them.
+ * All times are in microseconds since the start of the application.
+ */
+class Profiler
+{
+public:
+    typedef struct {
+        QString name;
+        qint64 start;
+        qint64 end;
+    } Phase;
+
+    class Run {
+    public:
+        Run();
+        QString uuid;
+        QString name;
+        quintptr thread;
+        qint64 requested;   /* play asked, parents may be dirty */
+        qint64 queued;      /* worker created */
+        qint64 started;     /* worker slot acquired */
+        qint64 finished;
+        qint64 cpu;
+        qint64 frames;
+        qint64 pixels;
+        qint64 peakBytes;
+        qint64 busySum;
+        qint64 busySamples;
+        int threads;
+        bool success;
+        QVector<Phase> phases;
+    };
+
+    typedef struct {
+        QString uuid;
+        QString name;
+        int runs;
+        qint64 wall;
+        qint64 cpu;
+        qint64 waitWorker;
+        qint64 waitParents;
+        qint64 frames;
+        qint64 pixels;
+        qint64 peakBytes;
+        qreal utilization;
+    } Summary;
+
+    Profiler();
+
+    static qint64 now();
+    static qint64 cpuTime();
+
+    void record(const Run& run);
+    QVector<Summary> summaries() const;
+    void clear();
+    bool exportTrace(const QString& filename) const;
+
+private:
+    mutable QMutex m_mutex;
+    QVector<Run> m_runs;
+    QMap<quintptr, int> m_lanes;
+};
+
+extern Profiler *profiler;
+
+#endif // PROFILER_H
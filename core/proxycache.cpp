@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QFileInfo>
+#include <QDateTime>
+
+#include "proxycache.h"
+#include "memorymanager.h"
+
+ProxyCache *proxyCache = NULL;
+
+ProxyCache::ProxyCache(qint64 capacity) :
+    m_mutex(),
+    m_entries(),
+    m_capacity(capacity),
+    m_bytes(0),
+    m_clock(0)
+{
+}
+
+QString ProxyCache::key(const QString &signature, const QString &filename)
+{
+    QFileInfo info(filename);
+    return signature + "|" + info.absoluteFilePath() + "|" +
+            QString::number(info.lastModified().toMSecsSinceEpoch()) + "|" +
+            QString::number(info.size());
+}
+
+bool ProxyCache::fetch(const QString &key, QVector<Photo> &photos)
+{
+    QMutexLocker lock(&m_mutex);
+    QMap<QString, Entry>::iterator it = m_entries.find(key);
+    if ( it == m_entries.end() )
+        return false;
+    it->lastUse = ++m_clock;
+    photos = it->photos;
+    return true;
+}
+
+void ProxyCache::store(const QString &key, const QVector<Photo> &photos)
+{
+    qint64 bytes = 0;
+    foreach(const Photo& photo, photos)
+        bytes += MemoryManager::photoBytes(photo);
+    if ( bytes > m_capacity )
+        return;
+    QMutexLocker lock(&m_mutex);
+    QMap<QString, Entry>::iterator it = m_entries.find(key);
+    if ( it != m_entries.end() ) {
+        m_bytes -= it->bytes;
+        m_entries.erase(it);
+    }
+    while ( m_bytes + bytes > m_capacity && !m_entries.isEmpty() ) {
+        QMap<QString, Entry>::iterator lru = m_entries.begin();
+        for ( it = m_entries.begin() ; it != m_entries.end() ; ++it )
+            if ( it->lastUse < lru->lastUse )
+                lru = it;
+        m_bytes -= lru->bytes;
+        m_entries.erase(lru);
+    }
+    Entry entry;
+    entry.photos = photos;
+    entry.bytes = bytes;
+    entry.lastUse = ++m_clock;
+    m_entries.insert(key, entry);
+    m_bytes += bytes;
+}
+
+void ProxyCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_entries.clear();
+    m_bytes = 0;
+}
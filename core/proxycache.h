@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef PROXYCACHE_H
+#define PROXYCACHE_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+
+#include "photo.h"
+
+/*
+ * Keeps the downsampled photos produced by the loaders in proxy mode,
+ * so that going back and forth between parameters doesn't decode the
+ * sources again. Entries are keyed by the loader signature and the
+ * source file, the least recently used ones are dropped above the
+ * capacity. Thread safe.
+ */
+class ProxyCache
+{
+public:
+    explicit ProxyCache(qint64 capacity);
+
+    static QString key(const QString& signature, const QString& filename);
+
+    bool fetch(const QString& key, QVector<Photo>& photos);
+    void store(const QString& key, const QVector<Photo>& photos);
+    void clear();
+
+private:
+    typedef struct {
+        QVector<Photo> photos;
+        qint64 bytes;
+        qint64 lastUse;
+    } Entry;
+    QMutex m_mutex;
+    QMap<QString, Entry> m_entries;
+    qint64 m_capacity;
+    qint64 m_bytes;
+    qint64 m_clock;
+};
+
+extern ProxyCache *proxyCache;
+
+#endif // PROXYCACHE_H
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QThread>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cstring>
+
+#include "ports.h"
+#ifdef DF_WINDOWS
+# include <QProcess>
+# define PROCESSCLASS QProcess
+#else
+# include "posixspawn.h"
+# define PROCESSCLASS PosixSpawn
+#endif
+
+#include "shard.h"
+#include "console.h"
+#include "process.h"
+#include "preferences.h"
+#include "operator.h"
+#include "operatorinput.h"
+#include "operatoroutput.h"
+#include "operatorparameterfilescollection.h"
+
+/*
+ * file layout: magic, length of the JSON header, JSON header (identity,
+ * sequence, size, quantum size and tags), padding to 16 bytes, the RGB
+ * quanta of the whole image, then the RGB quanta of the tone curve
+ */
+#define SHARD_MAGIC "DFSHARD1"
+#define SHARD_MAGIC_SIZE 8
+#define SHARD_ALIGN 16
+/* ms between two checks of a stop request while the workers run */
+#define SHARD_POLL_INTERVAL 100
+
+using Magick::Quantum;
+
+static void upstream(Operator *op, QSet<Operator*>& ops)
+{
+    if ( ops.contains(op) )
+        return;
+    ops.insert(op);
+    foreach(OperatorInput *input, op->getInputs())
+        foreach(OperatorOutput *source, input->sources())
+            upstream(source->m_operator, ops);
+}
+
+static void playOrder(Operator *op, QVector<Operator*>& order)
+{
+    if ( order.contains(op) )
+        return;
+    foreach(OperatorInput *input, op->getInputs())
+        foreach(OperatorOutput *source, input->sources())
+            playOrder(source->m_operator, order);
+    order.push_back(op);
+}
+
+/**
+ * @brief Shard::frameSources
+ * @param sources if not null, receives the loaders whose files are split
+ * between the workers
+ * @return whether op and everything reached through first inputs are
+ * per-frame operators fed by loaders. other inputs, like a master dark,
+ * are evaluated whole by every worker and must not share a loader with
+ * the frames. a live loader grows its collection as files arrive, it is
+ * never split
+ */
+bool Shard::frameSources(Operator *op, QVector<Operator *> *sources)
+{
+    QVector<Operator*> frames;
+    QSet<Operator*> references;
+    QSet<Operator*> seen;
+    QVector<Operator*> todo(1, op);
+    while ( !todo.isEmpty() ) {
+        Operator *current = todo.last();
+        todo.pop_back();
+        if ( seen.contains(current) )
+            continue;
+        seen.insert(current);
+        QVector<OperatorInput*> inputs = current->getInputs();
+        if ( inputs.isEmpty() ) {
+            if ( !current->isProxySource() || current->isLive() )
+                return false;
+            frames.push_back(current);
+            continue;
+        }
+        if ( current->executionModel() != Operator::PerFrame )
+            return false;
+        for (int i = 0 ; i < inputs.count() ; ++i ) {
+            foreach(OperatorOutput *source, inputs[i]->sources()) {
+                if ( i == 0 )
+                    todo.push_back(source->m_operator);
+                else
+                    upstream(source->m_operator, references);
+            }
+        }
+    }
+    if ( frames.isEmpty() )
+        return false;
+    foreach(Operator *loader, frames)
+        if ( references.contains(loader) )
+            return false;
+    if ( sources )
+        *sources = frames;
+    return true;
+}
+
+bool Shard::write(const Photo &photo, const QString &filename)
+{
+    Magick::Image image(photo.image());
+    Magick::Image curve(photo.curve());
+    qint64 w = image.columns();
+    qint64 h = image.rows();
+    qint64 cw = curve.columns();
+    QJsonObject tags;
+    QMap<QString, QString> photoTags = photo.tags();
+    for (QMap<QString, QString>::const_iterator it = photoTags.begin() ;
+         it != photoTags.end() ; ++it )
+        tags[it.key()] = it.value();
+    QJsonObject header;
+    header["identity"] = photo.getIdentity();
+    header["sequence"] = photo.getSequenceNumber();
+    header["width"] = double(w);
+    header["height"] = double(h);
+    header["curve"] = double(cw);
+    header["quantum"] = int(sizeof(Quantum));
+    header["tags"] = tags;
+    QByteArray json = QJsonDocument(header).toJson(QJsonDocument::Compact);
+    quint32 length = json.size();
+    qint64 offset = SHARD_MAGIC_SIZE + sizeof(length) + length;
+    offset = (offset + SHARD_ALIGN - 1) / SHARD_ALIGN * SHARD_ALIGN;
+    qint64 curveOffset = offset + w * h * 3 * sizeof(Quantum);
+    qint64 size = curveOffset + cw * 3 * sizeof(Quantum);
+
+    QFile file(filename);
+    if ( !file.open(QIODevice::ReadWrite|QIODevice::Truncate) || !file.resize(size) ) {
+        dflError(QObject::tr("Shard: could not create %0").arg(filename));
+        return false;
+    }
+    uchar *data = file.map(0, size);
+    if ( !data ) {
+        dflError(QObject::tr("Shard: could not map %0").arg(filename));
+        return false;
+    }
+    bool success = true;
+    memcpy(data, SHARD_MAGIC, SHARD_MAGIC_SIZE);
+    memcpy(data + SHARD_MAGIC_SIZE, &length, sizeof(length));
+    memcpy(data + SHARD_MAGIC_SIZE + sizeof(length), json.data(), length);
+    try {
+        image.write(0, 0, w, h, "RGB", Magick::QuantumPixel, data + offset);
+        curve.write(0, 0, cw, 1, "RGB", Magick::QuantumPixel, data + curveOffset);
+    }
+    catch (std::exception &e) {
+        dflError("Shard: %s", e.what());
+        success = false;
+    }
+    file.unmap(data);
+    return success;
+}
+
+bool Shard::read(const QString &filename, Photo &photo)
+{
+    QFile file(filename);
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        dflError(QObject::tr("Shard: could not open %0").arg(filename));
+        return false;
+    }
+    qint64 size = file.size();
+    uchar *data = size > SHARD_MAGIC_SIZE + 4 ? file.map(0, size) : NULL;
+    if ( !data || memcmp(data, SHARD_MAGIC, SHARD_MAGIC_SIZE) ) {
+        dflError(QObject::tr("Shard: invalid file %0").arg(filename));
+        return false;
+    }
+    quint32 length;
+    memcpy(&length, data + SHARD_MAGIC_SIZE, sizeof(length));
+    qint64 offset = SHARD_MAGIC_SIZE + sizeof(length) + length;
+    offset = (offset + SHARD_ALIGN - 1) / SHARD_ALIGN * SHARD_ALIGN;
+    QJsonObject header;
+    if ( offset <= size )
+        header = QJsonDocument::fromJson(QByteArray::fromRawData(
+                     reinterpret_cast<const char*>(data) + SHARD_MAGIC_SIZE + sizeof(length),
+                     length)).object();
+    qint64 w = header["width"].toDouble();
+    qint64 h = header["height"].toDouble();
+    qint64 cw = header["curve"].toDouble();
+    qint64 curveOffset = offset + w * h * 3 * qint64(sizeof(Quantum));
+    if ( header["quantum"].toInt() != int(sizeof(Quantum)) || cw <= 0 ||
+         curveOffset + cw * 3 * qint64(sizeof(Quantum)) > size ) {
+        dflError(QObject::tr("Shard: invalid file %0").arg(filename));
+        file.unmap(data);
+        return false;
+    }
+    /* the curve comes with the file, the scale tag is restored below */
+    QJsonObject tags = header["tags"].toObject();
+    bool success = true;
+    try {
+        Magick::Image image(w, h, "RGB", Magick::QuantumPixel, data + offset);
+        photo = Photo(image, Photo::Linear);
+        photo.curve() = Magick::Image(cw, 1, "RGB", Magick::QuantumPixel, data + curveOffset);
+        for (QJsonObject::const_iterator it = tags.begin() ; it != tags.end() ; ++it )
+            photo.setTag(it.key(), it.value().toString());
+        photo.setIdentity(header["identity"].toString());
+        photo.setSequenceNumber(header["sequence"].toInt());
+    }
+    catch (std::exception &e) {
+        dflError("Shard: %s", e.what());
+        success = false;
+    }
+    file.unmap(data);
+    return success;
+}
+
+QString Shard::fileName(const QString &dir, int output, int shard, int n)
+{
+    return QDir(dir).filePath(QString("%0-%1-%2.dfs")
+                              .arg(output)
+                              .arg(shard)
+                              .arg(n, 6, 10, QChar('0')));
+}
+
+/**
+ * @brief Shard::run
+ * the worker process side
+ * @param arguments project file, operator uuid, shard index, shard count
+ * and exchange directory
+ * @return the exit code of the worker
+ */
+int Shard::run(Process *process, const QStringList &arguments)
+{
+    if ( arguments.count() != 5 ) {
+        dflError(QObject::tr("Shard: invalid arguments"));
+        return 2;
+    }
+    process->load(arguments[0]);
+    /* a worker never shards again, and the workers share the cores */
+    process->setShards(1);
+    /* the collection saved in the project is all a worker may process */
+    foreach(Operator *current, process->operators())
+        current->stopLive();
+    preferences->setNumThreads(qMax(1, QThread::idealThreadCount() / qMax(1, arguments[3].toInt())));
+    Operator *op = process->findOperator(arguments[1]);
+    int index = arguments[2].toInt();
+    int count = arguments[3].toInt();
+    QString dir = arguments[4];
+    QVector<Operator*> sources;
+    if ( !op || count < 1 || index < 0 || index >= count ||
+         !frameSources(op, &sources) ) {
+        dflError(QObject::tr("Shard: %0 can't be sharded").arg(arguments[1]));
+        return 2;
+    }
+
+    foreach(Operator *source, sources) {
+        foreach(OperatorParameter *parameter, source->getParameters()) {
+            OperatorParameterFilesCollection *files =
+                    dynamic_cast<OperatorParameterFilesCollection*>(parameter);
+            if ( !files )
+                continue;
+            QStringList all = files->collection();
+            QStringList mine;
+            for (int i = index ; i < all.count() ; i += count )
+                mine.push_back(all[i]);
+            files->setCollection(mine);
+        }
+    }
+
+    QVector<Operator*> order;
+    playOrder(op, order);
+    foreach(Operator *current, order) {
+        current->play();
+        while ( current->isPlaying() )
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        if ( !current->isUpToDate() ) {
+            dflError(QObject::tr("Shard: %0 failed").arg(current->getName()));
+            return 1;
+        }
+    }
+
+    QVector<OperatorOutput*> outputs = op->getOutputs();
+    for (int idx = 0 ; idx < outputs.count() ; ++idx ) {
+        QVector<Photo> result = outputs[idx]->getResult();
+        for (int n = 0 ; n < result.count() ; ++n )
+            if ( !write(result[n], fileName(dir, idx, index, n)) )
+                return 1;
+    }
+    return 0;
+}
+
+ShardWorker::ShardWorker(Process *process, QThread *thread, Operator *op) :
+    OperatorWorker(thread, op),
+    m_shards(process->shards()),
+    m_dir(QDir(preferences->getTmpDir()).filePath("darkflow-shards-" + Process::uuid().mid(1, 36))),
+    m_project()
+{
+    /* the scene is only walked from the main thread */
+    if ( QDir().mkpath(m_dir) ) {
+        m_project = QDir(m_dir).filePath("project.dflow");
+        if ( !process->write(m_project) )
+            m_project.clear();
+    }
+}
+
+ShardWorker::~ShardWorker()
+{
+    QDir(m_dir).removeRecursively();
+}
+
+Photo ShardWorker::process(const Photo &, int, int)
+{
+    throw 0;
+}
+
+void ShardWorker::play()
+{
+    if ( m_project.isEmpty() ) {
+        dflError(tr("Could not write the project for the worker processes"));
+        emitFailure();
+        return;
+    }
+    QString program = QCoreApplication::applicationFilePath();
+    QVector<PROCESSCLASS*> children;
+    for (int i = 0 ; i < m_shards ; ++i ) {
+        QStringList arguments;
+        arguments << "--shard" << m_project << m_operator->uuid()
+                  << QString::number(i) << QString::number(m_shards) << m_dir;
+        PROCESSCLASS *child = new PROCESSCLASS;
+#ifdef DF_WINDOWS
+        child->setStandardOutputFile(QProcess::nullDevice());
+#endif
+        /* the workers log to their own console, their output is not read */
+        child->start(program, arguments, QIODevice::NotOpen);
+        children.push_back(child);
+    }
+    bool success = true;
+    int running = 0;
+    for (int i = 0 ; i < children.count() ; ++i ) {
+        if ( children[i]->waitForStarted() ) {
+            ++running;
+        }
+        else {
+            success = false;
+            delete children[i];
+            children[i] = NULL;
+        }
+    }
+    while ( running && !aborted() ) {
+        int timeout = qMax(1, SHARD_POLL_INTERVAL / running);
+        for (int i = 0 ; i < children.count() ; ++i ) {
+            PROCESSCLASS *child = children[i];
+            if ( !child || !child->waitForFinished(timeout) )
+                continue;
+            if ( child->exitCode() != 0 )
+                success = false;
+            delete child;
+            children[i] = NULL;
+            --running;
+            emitProgress(children.count() - running, children.count(), 0, 1);
+        }
+    }
+    /* stopped, the remaining workers are of no use */
+    foreach(PROCESSCLASS *child, children) {
+        if ( !child )
+            continue;
+        child->kill();
+        child->waitForFinished(-1);
+        delete child;
+    }
+    if ( !success || aborted() ) {
+        if ( !success )
+            dflError(tr("A worker process failed"));
+        emitFailure();
+        return;
+    }
+
+    /* interleaved back, as the files were dealt */
+    for (int idx = 0 ; idx < outputsCount() ; ++idx ) {
+        for (int n = 0, found = 1 ; found ; ++n ) {
+            found = 0;
+            for (int s = 0 ; s < m_shards ; ++s ) {
+                QString filename = Shard::fileName(m_dir, idx, s, n);
+                if ( !QFile::exists(filename) )
+                    continue;
+                Photo photo(Photo::Linear);
+                if ( !Shard::read(filename, photo) ) {
+                    emitFailure();
+                    return;
+                }
+                QFile::remove(filename);
+                outputPush(idx, photo);
+                ++found;
+            }
+        }
+    }
+    emitSuccess();
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include "operatorworker.h"
+#include "photo.h"
+
+class Operator;
+class Process;
+
+/**
+ * @brief The Shard class
+ * runs a per-frame segment of the graph in several worker processes.
+ * each worker loads the project, keeps one file out of n in the loaders
+ * feeding the segment, plays it and writes the results to memory mapped
+ * files the parent maps back
+ */
+class Shard
+{
+public:
+    static bool frameSources(Operator *op, QVector<Operator*> *sources);
+    static bool write(const Photo& photo, const QString& filename);
+    static bool read(const QString& filename, Photo& photo);
+    static QString fileName(const QString& dir, int output, int shard, int n);
+    static int run(Process *process, const QStringList& arguments);
+};
+
+class ShardWorker : public OperatorWorker
+{
+    Q_OBJECT
+public:
+    ShardWorker(Process *process, QThread *thread, Operator *op);
+    ~ShardWorker();
+    Photo process(const Photo& photo, int p, int c);
+
+private slots:
+    void play();
+
+private:
+    int m_shards;
+    QString m_dir;
+    QString m_project;
+};
+
+#endif // SHARD_H
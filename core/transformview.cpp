@@ -5,6 +5,92 @@
 
 #include <QLineF>
 #include <QGenericMatrix>
+#include <cmath>
+
+/* sub-pixel positions of the tabulated kernel weights */
+#define RESAMPLING_PHASES 1024
+
+/*
+ * separable interpolation kernel tabulated for RESAMPLING_PHASES
+ * fractional positions, the weights of a phase are normalized
+ */
+class ResamplingKernel {
+public:
+    ResamplingKernel(int support, double (*f)(double)) :
+        support(support),
+        taps(2*support),
+        weights((RESAMPLING_PHASES+1)*2*support)
+    {
+        for ( int p = 0 ; p <= RESAMPLING_PHASES ; ++p ) {
+            double frac = double(p)/RESAMPLING_PHASES;
+            double sum = 0;
+            for ( int k = 0 ; k < taps ; ++k )
+                sum += f(frac + support - 1 - k);
+            for ( int k = 0 ; k < taps ; ++k )
+                weights[p*taps+k] = f(frac + support - 1 - k)/sum;
+        }
+    }
+    const float *at(float frac) const {
+        return &weights[int(frac*RESAMPLING_PHASES+.5f)*taps];
+    }
+    int support;
+    int taps;
+    std::vector<float> weights;
+};
+
+static double bilinear(double d)
+{
+    d = fabs(d);
+    return d < 1 ? 1 - d : 0;
+}
+
+static double catmullRom(double d)
+{
+    const double a = -.5;
+    d = fabs(d);
+    if ( d < 1 )
+        return ((a+2)*d - (a+3))*d*d + 1;
+    if ( d < 2 )
+        return ((a*d - 5*a)*d + 8*a)*d - 4*a;
+    return 0;
+}
+
+static double lanczos3(double d)
+{
+    if ( d == 0 )
+        return 1;
+    if ( fabs(d) >= 3 )
+        return 0;
+    return 3 * sin(M_PI*d) * sin(M_PI*d/3) / (M_PI*M_PI*d*d);
+}
+
+static const ResamplingKernel bilinearKernel(1, bilinear);
+static const ResamplingKernel bicubicKernel(2, catmullRom);
+static const ResamplingKernel lanczos3Kernel(3, lanczos3);
+
+static inline float decode(bool hdr, quantum_t v)
+{
+    return hdr ? fromHDR(v) : v;
+}
+
+/*
+ * [*a, *b) is the range of x in [0, w) where p0+x*dp lies within
+ * [lo, hi], shrunk by one pixel against rounding
+ */
+static void span(qreal p0, qreal dp, qreal lo, qreal hi, int w, int *a, int *b)
+{
+    if ( dp == 0 ) {
+        *a = 0;
+        *b = ( p0 >= lo && p0 <= hi ) ? w : 0;
+        return;
+    }
+    qreal x0 = (lo-p0)/dp;
+    qreal x1 = (hi-p0)/dp;
+    if ( x0 > x1 )
+        qSwap(x0, x1);
+    *a = qBound(0., ceil(x0)+1, qreal(w));
+    *b = qBound(qreal(*a), floor(x1), qreal(w));
+}
 
 static inline
 QGenericMatrix<3, 3, double>
@@ -41,8 +127,10 @@ TransformView::TransformView(const Photo &photo, qreal scale, QVector<QPointF> r
       m_h(m_photo.image().rows()),
       m_cache(0),
       m_pixels(0),
+      m_top(0),
       m_error(false),
-      m_hdr(photo.getScale() == Photo::HDR)
+      m_hdr(photo.getScale() == Photo::HDR),
+      m_interpolation(Box)
 {
     QVector<QPointF> reference =ref;
     QVector<QPointF> current = m_photo.getPoints();
@@ -147,6 +235,26 @@ TransformView::TransformView(const Photo &photo, qreal scale, QVector<QPointF> r
 
 }
 
+/**
+ * @brief TransformView::TransformView
+ * same photo and transform as view, without its pixels, so that parallel
+ * tasks each load the rows they need
+ */
+TransformView::TransformView(const TransformView &view, QObject *parent)
+    : QObject(parent),
+      m_photo(view.m_photo),
+      m_transform(view.m_transform),
+      m_w(view.m_w),
+      m_h(view.m_h),
+      m_cache(0),
+      m_pixels(0),
+      m_top(0),
+      m_error(view.m_error),
+      m_hdr(view.m_hdr),
+      m_interpolation(view.m_interpolation)
+{
+}
+
 TransformView::~TransformView()
 {
     delete m_cache;
@@ -172,12 +280,38 @@ bool TransformView::inError()
 
 bool TransformView::loadPixels()
 {
+    delete m_cache;
     m_cache = new Ordinary::Pixels(m_photo.image());
+    m_top = 0;
     if (m_cache)
         m_pixels = m_cache->getConst(0, 0, m_w, m_h);
     return m_pixels != 0;
 }
 
+/**
+ * @brief TransformView::loadRows
+ * loads only the source rows needed to resample the rows y0 to y1 (not
+ * included) of a w pixels wide destination
+ */
+bool TransformView::loadRows(int w, int y0, int y1)
+{
+    QRectF reach = m_transform.mapRect(QRectF(0, y0, w+1, y1-y0+1));
+    /* the widest kernel reaches 3 rows away, box sampling one more */
+    const int margin = 4;
+    int top = qBound(0, int(floor(reach.top())) - margin, m_h);
+    int bottom = qBound(top, int(ceil(reach.bottom())) + margin, m_h);
+    delete m_cache;
+    m_cache = new Ordinary::Pixels(m_photo.image());
+    m_top = top;
+    if ( top == bottom ) {
+        /* out of the source, every pixel is undefined */
+        m_pixels = NULL;
+        return true;
+    }
+    m_pixels = m_cache->getConst(0, top, m_w, bottom - top);
+    return m_pixels != 0;
+}
+
 void TransformView::map(qreal x, qreal y, qreal *tx, qreal *ty)
 {
     m_transform.map(x,y,tx,ty);
@@ -195,7 +329,7 @@ Magick::PixelPacket TransformView::getPixel(int px, int py, bool *definedp)
     if ( m_transform.isIdentity() ) {
         if(definedp)
             *definedp=true;
-        return m_pixels[py*m_w+px];
+        return row(py)[px];
     }
     qreal sx, sy;
     qreal ex, ey;
@@ -226,7 +360,7 @@ Magick::PixelPacket TransformView::getPixel(int px, int py, bool *definedp)
                      - (double(x) < sx ? sx : double(x));
             qreal ds = fabs(dx*dy);
             //qDebug("> y: %d, x: %d, dy: %f, dx: %f, ds: %f", y, x, dy, dx, ds);
-            pixel = m_pixels[int(y)*m_w+int(x)];
+            pixel = row(int(y))[int(x)];
             if (m_hdr) {
                 red += ds*fromHDR(pixel.red);
                 green += ds*fromHDR(pixel.green);
@@ -252,3 +386,165 @@ Magick::PixelPacket TransformView::getPixel(int px, int py, bool *definedp)
     }
     return pixel;
 }
+
+/**
+ * @brief TransformView::transform
+ * @return the transformation from the destination to the source
+ */
+QTransform TransformView::transform() const
+{
+    return m_transform;
+}
+
+const Magick::PixelPacket *TransformView::pixels() const
+{
+    return m_pixels;
+}
+
+int TransformView::width() const
+{
+    return m_w;
+}
+
+int TransformView::height() const
+{
+    return m_h;
+}
+
+bool TransformView::isHDR() const
+{
+    return m_hdr;
+}
+
+void TransformView::setInterpolation(TransformView::Interpolation interpolation)
+{
+    m_interpolation = interpolation;
+}
+
+/**
+ * @brief TransformView::sample
+ * interpolates the source at u,v, pixels centers being on integers
+ */
+bool TransformView::sample(float u, float v, bool clampTaps, float *rgb)
+{
+    const ResamplingKernel& kernel =
+            m_interpolation == Bilinear ? bilinearKernel :
+            m_interpolation == Bicubic ? bicubicKernel : lanczos3Kernel;
+    int ix = floorf(u);
+    int iy = floorf(v);
+    const float *wx = kernel.at(u - ix);
+    const float *wy = kernel.at(v - iy);
+    int taps = kernel.taps;
+    ix -= kernel.support - 1;
+    iy -= kernel.support - 1;
+    float red = 0, green = 0, blue = 0;
+    for ( int j = 0 ; j < taps ; ++j ) {
+        int yy = iy + j;
+        if ( clampTaps )
+            yy = qBound(0, yy, m_h-1);
+        const Magick::PixelPacket *line = row(yy);
+        float r = 0, g = 0, b = 0;
+        for ( int k = 0 ; k < taps ; ++k ) {
+            int xx = ix + k;
+            if ( clampTaps )
+                xx = qBound(0, xx, m_w-1);
+            r += wx[k] * decode(m_hdr, line[xx].red);
+            g += wx[k] * decode(m_hdr, line[xx].green);
+            b += wx[k] * decode(m_hdr, line[xx].blue);
+        }
+        red += wy[j] * r;
+        green += wy[j] * g;
+        blue += wy[j] * b;
+    }
+    rgb[0] = red > 0 ? red : 0;
+    rgb[1] = green > 0 ? green : 0;
+    rgb[2] = blue > 0 ? blue : 0;
+    return true;
+}
+
+void TransformView::resampleRowBox(int y, int w, float *rgb)
+{
+    for ( int x = 0 ; x < w ; ++x ) {
+        bool defined;
+        Magick::PixelPacket pixel = getPixel(x, y, &defined);
+        if ( !defined ) {
+            rgb[x*3] = TRANSFORMVIEW_UNDEFINED;
+            continue;
+        }
+        /* getPixel encodes back to HDR */
+        rgb[x*3+0] = decode(m_hdr, pixel.red);
+        rgb[x*3+1] = decode(m_hdr, pixel.green);
+        rgb[x*3+2] = decode(m_hdr, pixel.blue);
+    }
+}
+
+/**
+ * @brief TransformView::resampleRow
+ * writes the linear rgb of the w pixels of row y of the destination.
+ * affine transforms are walked incrementally, the range of x whose
+ * kernel lies within the source is computed once per row, only the
+ * borders of the source need clamped taps
+ */
+void TransformView::resampleRow(int y, int w, float *rgb)
+{
+    if ( m_transform.isIdentity() ) {
+        int n = ( y < m_h ) ? qMin(w, m_w) : 0;
+        const Magick::PixelPacket *line = n ? row(y) : NULL;
+        for ( int x = 0 ; x < n ; ++x ) {
+            rgb[x*3+0] = decode(m_hdr, line[x].red);
+            rgb[x*3+1] = decode(m_hdr, line[x].green);
+            rgb[x*3+2] = decode(m_hdr, line[x].blue);
+        }
+        for ( int x = n ; x < w ; ++x )
+            rgb[x*3] = TRANSFORMVIEW_UNDEFINED;
+        return;
+    }
+    if ( m_interpolation == Box || !m_transform.isAffine() )
+        return resampleRowBox(y, w, rgb);
+
+    int support = m_interpolation == Bilinear ? 1 :
+                  m_interpolation == Bicubic ? 2 : 3;
+    qreal u0, v0;
+    map(.5, y+.5, &u0, &v0);
+    u0 -= .5;
+    v0 -= .5;
+    qreal du = m_transform.m11();
+    qreal dv = m_transform.m12();
+
+    int ua, ub, va, vb;
+    span(u0, du, support-1, m_w-1-support, w, &ua, &ub);
+    span(v0, dv, support-1, m_h-1-support, w, &va, &vb);
+    int a = qMax(ua, va);
+    int b = qMax(a, qMin(ub, vb));
+
+    for ( int x = 0 ; x < w ; ) {
+        if ( x == a && a < b ) {
+            qreal u = u0 + a*du;
+            qreal v = v0 + a*dv;
+            for ( ; x < b ; ++x, u += du, v += dv )
+                sample(u, v, false, &rgb[x*3]);
+            continue;
+        }
+        qreal u = u0 + x*du;
+        qreal v = v0 + x*dv;
+        if ( u < -.5 || u >= m_w-.5 || v < -.5 || v >= m_h-.5 )
+            rgb[x*3] = TRANSFORMVIEW_UNDEFINED;
+        else
+            sample(u, v, true, &rgb[x*3]);
+        ++x;
+    }
+}
+
+/**
+ * @brief TransformView::resample
+ * @return the linear rgb of the whole w x h destination, interleaved
+ */
+std::shared_ptr<std::vector<float> > TransformView::resample(int w, int h)
+{
+    std::shared_ptr<std::vector<float> > buffer(new std::vector<float>(size_t(w)*h*3));
+    float *data = &(*buffer)[0];
+    dfl_parallel_for(y, 0, h, 4, (), {
+        resampleRow(y, w, data + size_t(y)*w*3);
+    });
+    return buffer;
+}
@@ -5,35 +5,66 @@
 #include <QVector>
 #include <QPointF>
 #include <QTransform>
+#include <vector>
+#include <memory>
 
 #include "photo.h"
 #include <Magick++.h>
 
+/* red value of the pixels of a resampled row falling out of the source */
+#define TRANSFORMVIEW_UNDEFINED (-1.f)
+
 class TransformView : public QObject
 {
     Q_OBJECT
+public:
+    typedef enum {
+        Box,
+        Bilinear,
+        Bicubic,
+        Lanczos3
+    } Interpolation;
 
+private:
     Photo m_photo;
     QTransform m_transform;
     int m_w;
     int m_h;
     Ordinary::Pixels *m_cache;
     const Magick::PixelPacket *m_pixels;
+    int m_top;
     bool m_error;
     bool m_hdr;
+    Interpolation m_interpolation;
 
 public:
     TransformView(const Photo& photo, qreal scale, QVector<QPointF> reference, QObject *parent = 0);
+    TransformView(const TransformView& view, QObject *parent = 0);
     ~TransformView();
 
     QRectF boundingBox();
     bool inError();
     bool loadPixels();
+    bool loadRows(int w, int y0, int y1);
 
     void map(qreal x, qreal y, qreal *tx, qreal *ty);
     void invMap(qreal x, qreal y, qreal *tx, qreal *ty);
     Magick::PixelPacket getPixel(int x, int y, bool *definedp);
 
+    QTransform transform() const;
+    const Magick::PixelPacket *pixels() const;
+    int width() const;
+    int height() const;
+    bool isHDR() const;
+
+    void setInterpolation(Interpolation interpolation);
+    void resampleRow(int y, int w, float *rgb);
+    std::shared_ptr<std::vector<float> > resample(int w, int h);
+
+private:
+    const Magick::PixelPacket *row(int y) const { return m_pixels + size_t(y - m_top)*m_w; }
+    void resampleRowBox(int y, int w, float *rgb);
+    bool sample(float u, float v, bool clampTaps, float *rgb);
 };
 
 #endif // TRANSFORMVIEW_H
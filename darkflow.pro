@@ -88,6 +88,11 @@ unix {
     QMAKE_CFLAGS += -DHAVE_FFMPEG
     CONFIG += link_pkgconfig
     PKGCONFIG += Magick++ libavformat libavcodec libavutil fftw3
+    packagesExist(libraw_r) {
+        QMAKE_CXXFLAGS += -DHAVE_LIBRAW
+        QMAKE_CFLAGS += -DHAVE_LIBRAW
+        PKGCONFIG += libraw_r
+    }
     #PKGCONFIG += GraphicsMagick++ libavformat libavcodec libavutil
     LIBS += -lfftw3_threads
 }
@@ -138,6 +143,7 @@ TEMPLATE = app
 
 SOURCES +=\
     ui/aboutdialog.cpp \
+    ui/profiling.cpp \
     ui/filesselection.cpp \
     ui/mainwindow.cpp \
     scene/processbutton.cpp \
@@ -157,6 +163,11 @@ SOURCES +=\
     core/operatorparameterdropdown.cpp \
     core/operatorparameterfilescollection.cpp \
     core/operatorworker.cpp \
+    core/framequeue.cpp \
+    core/memorymanager.cpp \
+    core/profiler.cpp \
+    core/shard.cpp \
+    core/proxycache.cpp \
     core/photo.cpp \
     ui/visualization.cpp \
     scene/process.cpp \
@@ -181,6 +192,7 @@ SOURCES +=\
     operators/opsubtract.cpp \
     operators/opblackbody.cpp \
     operators/opflatfieldcorrection.cpp \
+    operators/opcalibration.cpp \
     operators/opintegration.cpp \
     operators/workerintegration.cpp \
     operators/opexposure.cpp \
@@ -225,6 +237,8 @@ SOURCES +=\
     operators/workerloadraw.cpp \
     algorithms/bayer.c \
     algorithms/rawinfo.cpp \
+    algorithms/rawdecoder.cpp \
+    algorithms/fitswriter.cpp \
     operators/opcmydecompose.cpp \
     operators/opcmycompose.cpp \
     operators/oproll.cpp \
@@ -267,6 +281,7 @@ SOURCES +=\
     operators/opwienerdeconvolution.cpp \
     operators/workerwienerdeconvolution.cpp \
     algorithms/discretefouriertransform.cpp \
+    algorithms/pixelstack.cpp \
     operators/opdftforward.cpp \
     operators/opdftbackward.cpp \
     operators/opdwtforward.cpp \
@@ -278,10 +293,12 @@ SOURCES +=\
     operators/opwindowfunction.cpp \
     operators/opcolormap.cpp \
     operators/opstarfinder.cpp \
+    operators/opframequality.cpp \
     operators/oppixelextrusionmapping.cpp
 
 HEADERS  += \
     ui/aboutdialog.h \
+    ui/profiling.h \
     ui/filesselection.h \
     ui/mainwindow.h \
     scene/processbutton.h \
@@ -300,6 +317,11 @@ HEADERS  += \
     core/operatorparameterdropdown.h \
     core/operatorparameterfilescollection.h \
     core/operatorworker.h \
+    core/framequeue.h \
+    core/memorymanager.h \
+    core/profiler.h \
+    core/shard.h \
+    core/proxycache.h \
     core/photo.h \
     ui/visualization.h \
     scene/process.h \
@@ -324,6 +346,7 @@ HEADERS  += \
     operators/opsubtract.h \
     operators/opblackbody.h \
     operators/opflatfieldcorrection.h \
+    operators/opcalibration.h \
     operators/opintegration.h \
     operators/workerintegration.h \
     operators/opexposure.h \
@@ -367,6 +390,8 @@ HEADERS  += \
     operators/oppassthrough.h \
     operators/workerloadraw.h \
     algorithms/rawinfo.h \
+    algorithms/rawdecoder.h \
+    algorithms/fitswriter.h \
     algorithms/bayer.h \
     operators/opcmydecompose.h \
     operators/opcmycompose.h \
@@ -411,6 +436,7 @@ HEADERS  += \
     operators/opwienerdeconvolution.h \
     operators/workerwienerdeconvolution.h \
     algorithms/discretefouriertransform.h \
+    algorithms/pixelstack.h \
     operators/opdftforward.h \
     operators/opdftbackward.h \
     operators/opdwtforward.h \
@@ -422,11 +448,13 @@ HEADERS  += \
     operators/opwindowfunction.h \
     operators/opcolormap.h \
     operators/opstarfinder.h \
+    operators/opframequality.h \
     operators/oppixelextrusionmapping.h
 
 
 FORMS    += \
     ui/aboutdialog.ui \
+    ui/profiling.ui \
     ui/filesselection.ui \
     ui/mainwindow.ui \
     ui/projectproperties.ui \
@@ -450,6 +478,20 @@ DISTFILES += \
 
 TRANSLATIONS = l10n/darkflow_fr.ts
 
+# qmake CONFIG+=bench builds the command line benchmark instead of the
+# application, it shares every source but the entry point
+bench {
+    TARGET = darkflow-bench
+    SOURCES -= ui/main.cpp
+    SOURCES += bench/main.cpp \
+        bench/bench.cpp \
+        bench/benchsource.cpp
+    HEADERS += bench/bench.h \
+        bench/benchsource.h
+    QMAKE_INCDIR += bench
+    win32: LIBS += -lpsapi
+}
+
 unix:!macx {
     target.path = /usr/bin/
     INSTALLS += target
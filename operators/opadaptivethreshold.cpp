@@ -66,6 +66,7 @@ OpAdaptiveThreshold::OpAdaptiveThreshold(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_width);
     addParameter(m_height);
     addParameter(m_offset);
@@ -34,6 +34,7 @@
 #include "operatoroutput.h"
 #include "operatorparameterslider.h"
 #include <Magick++.h>
+#include <cmath>
 
 using Magick::Quantum;
 
@@ -65,6 +66,8 @@ OpBlur::OpBlur(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintLocal);
     addParameter(m_radius);
     addParameter(m_sigma);
 
@@ -81,3 +84,8 @@ OperatorWorker *OpBlur::newWorker()
                           m_radius->value()*m_sigma->value(),
                           m_thread, this);
 }
+
+int OpBlur::footprintRadius() const
+{
+    return ceil(m_radius->value()) + 1;
+}
@@ -43,6 +43,7 @@ public:
     OpBlur(Process *parent);
     OpBlur *newInstance();
     OperatorWorker *newWorker();
+    int footprintRadius() const;
 private:
     OperatorParameterSlider *m_radius;
     OperatorParameterSlider *m_sigma;
@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QPoint>
+#include <vector>
+
+#include "opcalibration.h"
+#include "operatorworker.h"
+#include "operatorinput.h"
+#include "operatoroutput.h"
+#include "operatorparameterdropdown.h"
+#include "photo.h"
+#include <Magick++.h>
+#include "algorithm.h"
+#include "hdr.h"
+#include "console.h"
+
+using Magick::Quantum;
+
+typedef float real;
+
+/*
+ * Applies (light - dark) / normalized (flat - bias) and replaces the pixels of
+ * the hot pixel map in a single row-parallel pass over each light, the
+ * masters are only read.
+ */
+class WorkerCalibration : public OperatorWorker {
+public:
+    WorkerCalibration(bool scaleDark, QThread *thread, Operator *op) :
+        OperatorWorker(thread, op),
+        m_scaleDark(scaleDark),
+        m_bias(),
+        m_dark(),
+        m_flat(),
+        m_flatMean(),
+        m_darkExposure(0),
+        m_width(0),
+        m_height(0),
+        m_hotPixels(),
+        m_hotMask()
+    {}
+
+    bool master(const QVector<Photo>& input, Photo& photo) {
+        if ( input.count() == 0 )
+            return false;
+        if ( input.count() > 1 )
+            dflWarning(tr("Calibration: more than one master given, using the first one"));
+        photo = input[0];
+        return true;
+    }
+
+    void play_analyseSources() {
+        Q_ASSERT(m_inputs.count() == 5);
+        Photo map;
+        bool hasBias = master(m_inputs[1], m_bias);
+        bool hasDark = master(m_inputs[2], m_dark);
+        bool hasFlat = master(m_inputs[3], m_flat);
+        bool hasMap = master(m_inputs[4], map);
+        try {
+            if ( hasDark ) {
+                m_darkExposure = m_dark.getShutter();
+                if ( m_scaleDark && m_darkExposure <= 0 )
+                    dflWarning(tr("Calibration: master dark has no exposure time, it will not be scaled"));
+            }
+            if ( hasFlat ) {
+                Magick::Image& image = m_flat.image();
+                bool hdr = m_flat.getScale() == Photo::HDR;
+                int w = image.columns();
+                int h = image.rows();
+                if ( !sizeMatches(m_bias, w, h) ) {
+                    dflError(tr("Calibration: master bias and master flat sizes mismatch"));
+                    m_error = true;
+                    return;
+                }
+                /* the flat is normalized once its own bias is removed */
+                bool biasHDR = hasBias && m_bias.getScale() == Photo::HDR;
+                std::shared_ptr<Ordinary::Pixels> flat_cache(new Ordinary::Pixels(image));
+                std::shared_ptr<Ordinary::Pixels> bias_cache;
+                if ( hasBias )
+                    bias_cache.reset(new Ordinary::Pixels(m_bias.image()));
+                dfl_block double sum_r = 0, sum_g = 0, sum_b = 0;
+                dfl_parallel_for(y, 0, h, 4, (image), {
+                    if ( m_error )
+                        continue;
+                    const Magick::PixelPacket *pixels = flat_cache->getConst(0, y, w, 1);
+                    const Magick::PixelPacket *bias = bias_cache ? bias_cache->getConst(0, y, w, 1) : NULL;
+                    if ( !pixels || ( bias_cache && !bias ) ) {
+                        dflError(DF_NULL_PIXELS);
+                        m_error = true;
+                        continue;
+                    }
+                    double r = 0, g = 0, b = 0;
+                    for ( int x = 0 ; x < w ; ++x ) {
+                        if ( hdr ) {
+                            r += fromHDR(pixels[x].red);
+                            g += fromHDR(pixels[x].green);
+                            b += fromHDR(pixels[x].blue);
+                        }
+                        else {
+                            r += pixels[x].red;
+                            g += pixels[x].green;
+                            b += pixels[x].blue;
+                        }
+                        if ( !bias )
+                            continue;
+                        if ( biasHDR ) {
+                            r -= fromHDR(bias[x].red);
+                            g -= fromHDR(bias[x].green);
+                            b -= fromHDR(bias[x].blue);
+                        }
+                        else {
+                            r -= bias[x].red;
+                            g -= bias[x].green;
+                            b -= bias[x].blue;
+                        }
+                    }
+                    dfl_critical_section({
+                        sum_r += r;
+                        sum_g += g;
+                        sum_b += b;
+                    });
+                });
+                if ( m_error )
+                    return;
+                double n = double(w) * h;
+                m_flatMean = Triplet<real>(sum_r/n, sum_g/n, sum_b/n);
+            }
+            if ( hasMap ) {
+                Magick::Image& image = map.image();
+                m_width = image.columns();
+                m_height = image.rows();
+                m_hotMask.assign(size_t(m_width) * m_height, 0);
+                Ordinary::Pixels map_cache(image);
+                for ( int y = 0 ; y < m_height ; ++y ) {
+                    const Magick::PixelPacket *pixels = map_cache.getConst(0, y, m_width, 1);
+                    if ( !pixels ) {
+                        dflError(DF_NULL_PIXELS);
+                        m_error = true;
+                        return;
+                    }
+                    for ( int x = 0 ; x < m_width ; ++x ) {
+                        if ( pixels[x].red || pixels[x].green || pixels[x].blue ) {
+                            m_hotMask[size_t(y) * m_width + x] = 1;
+                            m_hotPixels.push_back(QPoint(x, y));
+                        }
+                    }
+                }
+                dflInfo(tr("Calibration: %0 hot pixels in the map").arg(m_hotPixels.count()));
+            }
+        }
+        catch (std::exception &e) {
+            dflError("%s", e.what());
+            m_error = true;
+        }
+    }
+
+    bool sizeMatches(const Photo& master, int w, int h) {
+        if ( !master.isComplete() )
+            return true;
+        const Magick::Image& image = master.image();
+        return int(image.columns()) == w && int(image.rows()) == h;
+    }
+
+    Photo process(const Photo &photo, int p, int c) {
+        Photo newPhoto(photo);
+        Magick::Image& image = newPhoto.image();
+        int w = image.columns();
+        int h = image.rows();
+        if ( !sizeMatches(m_bias, w, h) ||
+             !sizeMatches(m_dark, w, h) ||
+             !sizeMatches(m_flat, w, h) ||
+             ( m_hotPixels.count() && ( m_width != w || m_height != h ) ) ) {
+            setError(photo, tr("Calibration: masters and light sizes mismatch"));
+            return photo;
+        }
+        bool lightHDR = photo.getScale() == Photo::HDR;
+        bool biasHDR = m_bias.isComplete() && m_bias.getScale() == Photo::HDR;
+        bool darkHDR = m_dark.isComplete() && m_dark.getScale() == Photo::HDR;
+        bool flatHDR = m_flat.isComplete() && m_flat.getScale() == Photo::HDR;
+        real k = 1;
+        if ( m_scaleDark && m_dark.isComplete() && m_darkExposure > 0 ) {
+            real exposure = photo.getShutter();
+            if ( exposure > 0 )
+                k = exposure / m_darkExposure;
+            else
+                dflWarning(tr("Calibration: %0 has no exposure time, dark not scaled").arg(photo.getIdentity()));
+        }
+        Triplet<real> mean = m_flatMean;
+        std::shared_ptr<Ordinary::Pixels> image_cache(new Ordinary::Pixels(image));
+        std::shared_ptr<Ordinary::Pixels> bias_cache;
+        std::shared_ptr<Ordinary::Pixels> dark_cache;
+        std::shared_ptr<Ordinary::Pixels> flat_cache;
+        if ( m_bias.isComplete() )
+            bias_cache.reset(new Ordinary::Pixels(m_bias.image()));
+        if ( m_dark.isComplete() )
+            dark_cache.reset(new Ordinary::Pixels(m_dark.image()));
+        if ( m_flat.isComplete() )
+            flat_cache.reset(new Ordinary::Pixels(m_flat.image()));
+        dfl_block int line = 0;
+        dfl_block bool error = false;
+        dfl_parallel_for(y, 0, h, 4, (image), {
+            if ( error || m_error )
+                continue;
+            Magick::PixelPacket *pixels = image_cache->get(0, y, w, 1);
+            const Magick::PixelPacket *bias = bias_cache ? bias_cache->getConst(0, y, w, 1) : NULL;
+            const Magick::PixelPacket *dark = dark_cache ? dark_cache->getConst(0, y, w, 1) : NULL;
+            const Magick::PixelPacket *flat = flat_cache ? flat_cache->getConst(0, y, w, 1) : NULL;
+            if ( !pixels ||
+                 ( bias_cache && !bias ) ||
+                 ( dark_cache && !dark ) ||
+                 ( flat_cache && !flat ) ) {
+                dflError(DF_NULL_PIXELS);
+                error = true;
+                continue;
+            }
+            for ( int x = 0 ; x < w ; ++x ) {
+                real v[3] = { real(pixels[x].red), real(pixels[x].green), real(pixels[x].blue) };
+                real b[3] = { 0, 0, 0 };
+                if ( lightHDR )
+                    for ( int i = 0 ; i < 3 ; ++i )
+                        v[i] = fromHDR(v[i]);
+                if ( bias ) {
+                    b[0] = bias[x].red; b[1] = bias[x].green; b[2] = bias[x].blue;
+                    if ( biasHDR )
+                        for ( int i = 0 ; i < 3 ; ++i )
+                            b[i] = fromHDR(b[i]);
+                }
+                if ( dark ) {
+                    real d[3] = { real(dark[x].red), real(dark[x].green), real(dark[x].blue) };
+                    if ( darkHDR )
+                        for ( int i = 0 ; i < 3 ; ++i )
+                            d[i] = fromHDR(d[i]);
+                    /* only the thermal part of the dark scales with the exposure */
+                    for ( int i = 0 ; i < 3 ; ++i )
+                        v[i] -= b[i] + k * (d[i] - b[i]);
+                }
+                else {
+                    for ( int i = 0 ; i < 3 ; ++i )
+                        v[i] -= b[i];
+                }
+                if ( flat ) {
+                    real f[3] = { real(flat[x].red), real(flat[x].green), real(flat[x].blue) };
+                    real m[3] = { mean.red, mean.green, mean.blue };
+                    if ( flatHDR )
+                        for ( int i = 0 ; i < 3 ; ++i )
+                            f[i] = fromHDR(f[i]);
+                    for ( int i = 0 ; i < 3 ; ++i )
+                        f[i] -= b[i];
+                    for ( int i = 0 ; i < 3 ; ++i )
+                        if ( f[i] > 0 )
+                            v[i] = v[i] * m[i] / f[i];
+                }
+                /* HDR lights stay HDR, their range is not truncated */
+                if ( lightHDR ) {
+                    pixels[x].red = toHDR(v[0]);
+                    pixels[x].green = toHDR(v[1]);
+                    pixels[x].blue = toHDR(v[2]);
+                }
+                else {
+                    pixels[x].red = clamp<quantum_t>(DF_ROUND(v[0]), 0, QuantumRange);
+                    pixels[x].green = clamp<quantum_t>(DF_ROUND(v[1]), 0, QuantumRange);
+                    pixels[x].blue = clamp<quantum_t>(DF_ROUND(v[2]), 0, QuantumRange);
+                }
+            }
+            image_cache->sync();
+            dfl_critical_section({
+                if ( line % 100 == 0 )
+                    emitProgress(p, c, line, h);
+                ++line;
+            });
+        });
+        if ( error ||
+             ( m_hotPixels.count() &&
+               !replaceHotPixels(image, photo.getTag(TAG_PIXELS) == TAG_PIXELS_CFA, lightHDR) ) ) {
+            setError(photo, tr("Calibration: unable to access pixels"));
+            return photo;
+        }
+        return newPhoto;
+    }
+
+    /*
+     * hot pixels are replaced by the mean of their calibrated neighbours
+     * of the same color, hot neighbours are skipped so that pixels of the
+     * map may be processed concurrently
+     */
+    bool replaceHotPixels(Magick::Image& image, bool cfa, bool hdr) {
+        int w = m_width;
+        int h = m_height;
+        int d = cfa ? 2 : 1;
+        int n = m_hotPixels.count();
+        const QPoint *hot = m_hotPixels.constData();
+        const char *mask = m_hotMask.data();
+        std::shared_ptr<Ordinary::Pixels> image_cache(new Ordinary::Pixels(image));
+        dfl_block bool error = false;
+        dfl_parallel_for(i, 0, n, 256, (image), {
+            if ( error )
+                continue;
+            int x = hot[i].x();
+            int y = hot[i].y();
+            int x0 = qMax(0, x - d), x1 = qMin(w - 1, x + d);
+            int y0 = qMax(0, y - d), y1 = qMin(h - 1, y + d);
+            const Magick::PixelPacket *area = image_cache->getConst(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+            if ( !area ) {
+                dflError(DF_NULL_PIXELS);
+                error = true;
+                continue;
+            }
+            real r = 0, g = 0, b = 0;
+            int count = 0;
+            for ( int yy = y - d ; yy <= y + d ; yy += d ) {
+                for ( int xx = x - d ; xx <= x + d ; xx += d ) {
+                    if ( xx < 0 || xx >= w || yy < 0 || yy >= h ||
+                         mask[size_t(yy) * w + xx] )
+                        continue;
+                    const Magick::PixelPacket &px = area[(yy - y0) * (x1 - x0 + 1) + xx - x0];
+                    if ( hdr ) {
+                        r += fromHDR(px.red);
+                        g += fromHDR(px.green);
+                        b += fromHDR(px.blue);
+                    }
+                    else {
+                        r += px.red;
+                        g += px.green;
+                        b += px.blue;
+                    }
+                    ++count;
+                }
+            }
+            if ( count == 0 )
+                continue;
+            Magick::PixelPacket *pixel = image_cache->get(x, y, 1, 1);
+            if ( !pixel ) {
+                dflError(DF_NULL_PIXELS);
+                error = true;
+                continue;
+            }
+            if ( hdr ) {
+                pixel->red = toHDR(r / count);
+                pixel->green = toHDR(g / count);
+                pixel->blue = toHDR(b / count);
+            }
+            else {
+                pixel->red = clamp<quantum_t>(DF_ROUND(r / count), 0, QuantumRange);
+                pixel->green = clamp<quantum_t>(DF_ROUND(g / count), 0, QuantumRange);
+                pixel->blue = clamp<quantum_t>(DF_ROUND(b / count), 0, QuantumRange);
+            }
+            image_cache->sync();
+        });
+        return !error;
+    }
+
+private:
+    bool m_scaleDark;
+    Photo m_bias;
+    Photo m_dark;
+    Photo m_flat;
+    Triplet<real> m_flatMean;
+    real m_darkExposure;
+    int m_width;
+    int m_height;
+    QVector<QPoint> m_hotPixels;
+    std::vector<char> m_hotMask;
+};
+
+OpCalibration::OpCalibration(Process *parent) :
+    Operator(OP_SECTION_BLEND, QT_TRANSLATE_NOOP("Operator", "Calibration"), Operator::Linear|Operator::HDR, parent),
+    m_scaleDark(new OperatorParameterDropDown("scaleDark", tr("Scale dark"), this, SLOT(setScaleDark(int)))),
+    m_scaleDarkValue(false)
+{
+    m_scaleDark->addOption(DF_TR_AND_C("No"), false, true);
+    m_scaleDark->addOption(DF_TR_AND_C("By exposure time"), true);
+
+    addInput(new OperatorInput(tr("Lights"), OperatorInput::Set, this));
+    addInput(new OperatorInput(tr("Master bias"), OperatorInput::Image, this));
+    addInput(new OperatorInput(tr("Master dark"), OperatorInput::Image, this));
+    addInput(new OperatorInput(tr("Master flat"), OperatorInput::Image, this));
+    addInput(new OperatorInput(tr("Hot pixels map"), OperatorInput::Image, this));
+    addOutput(new OperatorOutput(tr("Calibrated"), this));
+    setExecutionModel(PerFrame);
+    addParameter(m_scaleDark);
+}
+
+OpCalibration *OpCalibration::newInstance()
+{
+    return new OpCalibration(m_process);
+}
+
+OperatorWorker *OpCalibration::newWorker()
+{
+    return new WorkerCalibration(m_scaleDarkValue, m_thread, this);
+}
+
+void OpCalibration::setScaleDark(int type)
+{
+    if ( m_scaleDarkValue != !!type ) {
+        m_scaleDarkValue = !!type;
+        setOutOfDate();
+    }
+}
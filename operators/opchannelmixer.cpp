@@ -63,6 +63,8 @@ OpChannelMixer::OpChannelMixer(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintPointwise);
     addParameter(m_r);
     addParameter(m_g);
     addParameter(m_b);
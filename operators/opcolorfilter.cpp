@@ -62,6 +62,7 @@ OpColorFilter::OpColorFilter(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_r);
     addParameter(m_g);
     addParameter(m_b);
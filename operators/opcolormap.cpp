@@ -78,6 +78,7 @@ OpColorMap::OpColorMap(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Color Map"), this));
+    setExecutionModel(PerFrame);
 }
 
 OpColorMap *OpColorMap::newInstance()
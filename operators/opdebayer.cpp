@@ -64,6 +64,7 @@ OpDebayer::OpDebayer(Process *parent) :
     addParameter(m_debayer);
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
 }
 
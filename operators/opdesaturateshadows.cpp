@@ -65,6 +65,7 @@ OpDesaturateShadows::OpDesaturateShadows(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
     addParameter(m_highlightLimit);
     addParameter(m_range);
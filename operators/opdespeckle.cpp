@@ -51,6 +51,7 @@ OpDespeckle::OpDespeckle(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"),OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
 }
 
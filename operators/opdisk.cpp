@@ -123,6 +123,7 @@ OpDisk::OpDisk(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
     m_color->addOption(DF_TR_AND_C("White"), QuantumRange, true);
     m_color->addOption(DF_TR_AND_C("Black"), 0);
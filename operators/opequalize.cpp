@@ -54,6 +54,7 @@ OpEqualize::OpEqualize(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 }
 
 OpEqualize *OpEqualize::newInstance()
@@ -60,6 +60,8 @@ OpExposure::OpExposure(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintPointwise);
     addParameter(m_value);
 
 }
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "opframequality.h"
+#include "operatorparameterslider.h"
+#include "operatorparameterdropdown.h"
+#include "operatorinput.h"
+#include "operatoroutput.h"
+#include "operatorworker.h"
+#include "photo.h"
+#include "cielab.h"
+#include "hdr.h"
+#include "console.h"
+#include <Magick++.h>
+
+using Magick::Quantum;
+
+/* sigma to FWHM of a gaussian profile */
+#define FWHM_SIGMA 2.3548
+#define STAR_RADIUS 4
+#define MAX_STARS 2000
+
+static inline double
+luminance(bool hdr, const Magick::PixelPacket &pixel)
+{
+    if (hdr)
+        return LUMINANCE(
+                    fromHDR(pixel.red),
+                    fromHDR(pixel.green),
+                    fromHDR(pixel.blue));
+    else
+        return LUMINANCE_PIXEL(pixel);
+}
+
+static double median(std::vector<double>& values)
+{
+    if ( values.size() == 0 )
+        return 0;
+    std::vector<double>::iterator mid = values.begin() + values.size()/2;
+    std::nth_element(values.begin(), mid, values.end());
+    return *mid;
+}
+
+class Quality {
+public:
+    Quality() :
+        stars(0), fwhm(0), eccentricity(0),
+        background(0), noise(0), snr(0), valid(false) {}
+    int stars;
+    double fwhm;
+    double eccentricity;
+    double background;
+    double noise;
+    double snr;
+    bool valid;
+};
+
+class WorkerFrameQuality : public OperatorWorker {
+public:
+    WorkerFrameQuality(double threshold, bool reject, double percentile,
+                       QThread *thread, Operator *op) :
+        OperatorWorker(thread, op),
+        m_threshold(threshold),
+        m_reject(reject),
+        m_percentile(percentile)
+    {}
+
+    /*
+     * background and noise are the median and MAD of the luminance, read
+     * from its histogram. stars are the local maxima standing m_threshold
+     * noise deviations above the background, their FWHM and eccentricity
+     * come from the second order moments of a small window around them
+     */
+    Quality measure(Photo& photo) {
+        Quality q;
+        Magick::Image& image = photo.image();
+        bool hdr = photo.getScale() == Photo::HDR;
+        int w = image.columns();
+        int h = image.rows();
+        if ( w < 2*STAR_RADIUS+1 || h < 2*STAR_RADIUS+1 )
+            return q;
+        Ordinary::Pixels cache(image);
+        std::vector<quint32> histogram(QuantumRange+1, 0);
+        for ( int y = 0 ; y < h ; ++y ) {
+            const Magick::PixelPacket *pixels = cache.getConst(0, y, w, 1);
+            if ( !pixels ) {
+                dflError(DF_NULL_PIXELS);
+                return q;
+            }
+            for ( int x = 0 ; x < w ; ++x )
+                ++histogram[clamp<int>(DF_ROUND(luminance(hdr, pixels[x])), 0, QuantumRange)];
+        }
+        quint64 half = quint64(w)*h/2;
+        quint64 acc = 0;
+        int bg = 0;
+        while ( bg < QuantumRange && (acc += histogram[bg]) <= half )
+            ++bg;
+        std::vector<quint32> deviations(QuantumRange+1, 0);
+        for ( int i = 0 ; i <= QuantumRange ; ++i )
+            deviations[qAbs(i-bg)] += histogram[i];
+        acc = 0;
+        int mad = 0;
+        while ( mad < QuantumRange && (acc += deviations[mad]) <= half )
+            ++mad;
+        q.background = bg;
+        q.noise = qMax(1., 1.4826 * mad);
+
+        /* the star windows get their own view, rows stay valid across them */
+        Ordinary::Pixels window_cache(image);
+        double threshold = q.background + m_threshold * q.noise;
+        std::vector<double> fwhms, eccentricities, snrs;
+        for ( int y = STAR_RADIUS ; y < h - STAR_RADIUS && q.stars < MAX_STARS ; ++y ) {
+            const Magick::PixelPacket *rows = cache.getConst(0, y-1, w, 3);
+            if ( !rows ) {
+                dflError(DF_NULL_PIXELS);
+                return q;
+            }
+            for ( int x = STAR_RADIUS ; x < w - STAR_RADIUS && q.stars < MAX_STARS ; ++x ) {
+                double peak = luminance(hdr, rows[w+x]);
+                if ( peak < threshold )
+                    continue;
+                bool maximum = true;
+                /* on a plateau, only the first pixel in scan order is kept */
+                for ( int j = 0 ; j < 3 && maximum ; ++j )
+                    for ( int i = -1 ; i <= 1 && maximum ; ++i ) {
+                        if ( j == 1 && i == 0 )
+                            continue;
+                        double v = luminance(hdr, rows[j*w+x+i]);
+                        bool before = j == 0 || ( j == 1 && i < 0 );
+                        if ( v > peak || ( before && v >= peak ) )
+                            maximum = false;
+                    }
+                if ( !maximum )
+                    continue;
+                const int size = 2*STAR_RADIUS+1;
+                const Magick::PixelPacket *window =
+                        window_cache.getConst(x-STAR_RADIUS, y-STAR_RADIUS, size, size);
+                if ( !window ) {
+                    dflError(DF_NULL_PIXELS);
+                    return q;
+                }
+                double flux = 0, mx = 0, my = 0;
+                for ( int j = 0 ; j < size ; ++j )
+                    for ( int i = 0 ; i < size ; ++i ) {
+                        double v = luminance(hdr, window[j*size+i]) - q.background;
+                        if ( v <= 0 )
+                            continue;
+                        flux += v;
+                        mx += v * i;
+                        my += v * j;
+                    }
+                if ( flux <= 0 )
+                    continue;
+                mx /= flux;
+                my /= flux;
+                double mxx = 0, myy = 0, mxy = 0;
+                for ( int j = 0 ; j < size ; ++j )
+                    for ( int i = 0 ; i < size ; ++i ) {
+                        double v = luminance(hdr, window[j*size+i]) - q.background;
+                        if ( v <= 0 )
+                            continue;
+                        mxx += v * (i-mx) * (i-mx);
+                        myy += v * (j-my) * (j-my);
+                        mxy += v * (i-mx) * (j-my);
+                    }
+                mxx /= flux;
+                myy /= flux;
+                mxy /= flux;
+                double trace = mxx + myy;
+                double det = sqrt((mxx-myy)*(mxx-myy) + 4*mxy*mxy);
+                double l1 = (trace + det) / 2;
+                double l2 = (trace - det) / 2;
+                if ( l1 <= 0 || l2 <= 0 )
+                    continue;
+                fwhms.push_back(FWHM_SIGMA * sqrt((l1+l2)/2));
+                eccentricities.push_back(sqrt(1 - l2/l1));
+                snrs.push_back((peak - q.background) / q.noise);
+                ++q.stars;
+                x += STAR_RADIUS;
+            }
+        }
+        q.fwhm = median(fwhms);
+        q.eccentricity = median(eccentricities);
+        q.snr = median(snrs);
+        q.valid = true;
+        return q;
+    }
+
+    static double percentile(QVector<double> values, double p) {
+        if ( values.count() == 0 )
+            return 0;
+        std::sort(values.begin(), values.end());
+        return values[qBound(0, int(p * (values.count()-1) + .5), values.count()-1)];
+    }
+
+    void play() {
+        Q_ASSERT( m_inputs.count() == 1 );
+        int n = m_inputs[0].count();
+        std::shared_ptr<QVector<Quality> > qualities(new QVector<Quality>(n));
+        std::shared_ptr<QVector<QString> > errors(new QVector<QString>(n));
+        Photo *photos = m_inputs[0].data();
+        dfl_block int done = 0;
+        dfl_parallel_for(i, 0, n, 1, (), {
+            if ( aborted() )
+                continue;
+            try {
+                (*qualities)[i] = measure(photos[i]);
+            }
+            catch (std::exception &e) {
+                (*errors)[i] = e.what();
+            }
+            dfl_critical_section({
+                emit progress(++done, n);
+            });
+        });
+        if ( aborted() )
+            return emitFailure();
+        for ( int i = 0 ; i < n ; ++i ) {
+            if ( !(*errors)[i].isEmpty() ) {
+                setError(photos[i], (*errors)[i]);
+                return emitFailure();
+            }
+        }
+
+        QVector<double> stars, fwhm, eccentricity, snr;
+        for ( int i = 0 ; i < n ; ++i ) {
+            const Quality& q = (*qualities)[i];
+            if ( !q.valid )
+                continue;
+            stars.push_back(q.stars);
+            snr.push_back(q.snr);
+            if ( q.stars ) {
+                fwhm.push_back(q.fwhm);
+                eccentricity.push_back(q.eccentricity);
+            }
+        }
+        double minStars = percentile(stars, m_percentile);
+        double minSNR = percentile(snr, m_percentile);
+        double maxFWHM = percentile(fwhm, 1 - m_percentile);
+        double maxEccentricity = percentile(eccentricity, 1 - m_percentile);
+
+        int rejected = 0;
+        for ( int i = 0 ; i < n ; ++i ) {
+            Photo photo(photos[i]);
+            const Quality& q = (*qualities)[i];
+            if ( !q.valid ) {
+                outputPush(0, photo);
+                continue;
+            }
+            photo.setTag(TAG_QUALITY_STARS, QString::number(q.stars));
+            photo.setTag(TAG_QUALITY_FWHM, QString::number(q.fwhm));
+            photo.setTag(TAG_QUALITY_ECCENTRICITY, QString::number(q.eccentricity));
+            photo.setTag(TAG_QUALITY_BACKGROUND, QString::number(q.background/QuantumRange));
+            photo.setTag(TAG_QUALITY_NOISE, QString::number(q.noise/QuantumRange));
+            photo.setTag(TAG_QUALITY_SNR, QString::number(q.snr));
+            if ( m_reject && m_percentile > 0 &&
+                 photo.getTag(TAG_TREAT) != TAG_TREAT_REFERENCE &&
+                 ( q.stars < minStars ||
+                   q.snr < minSNR ||
+                   ( q.stars && q.fwhm > maxFWHM ) ||
+                   ( q.stars && q.eccentricity > maxEccentricity ) ) ) {
+                photo.setTag(TAG_TREAT, TAG_TREAT_DISCARDED);
+                ++rejected;
+            }
+            outputPush(0, photo);
+        }
+        if ( m_reject )
+            dflInfo(tr("Frame Quality: %0 frame(s) of %1 discarded").arg(rejected).arg(n));
+        emitSuccess();
+    }
+
+    Photo process(const Photo &photo, int, int) { return Photo(photo); }
+
+private:
+    double m_threshold;
+    bool m_reject;
+    double m_percentile;
+};
+
+OpFrameQuality::OpFrameQuality(Process *parent) :
+    Operator(OP_SECTION_ANALYSIS, QT_TRANSLATE_NOOP("Operator", "Frame Quality"), Operator::All, parent),
+    m_threshold(new OperatorParameterSlider("threshold", tr("Threshold"), tr("Frame Quality - Star Detection Threshold"), Slider::Value, Slider::Logarithmic, Slider::Real, 1, 100, 5, 1, 1000, Slider::FilterNothing, this)),
+    m_reject(new OperatorParameterDropDown("reject", tr("Reject"), this, SLOT(selectReject(int)))),
+    m_percentile(new OperatorParameterSlider("percentile", tr("Percentile"), tr("Frame Quality - Rejection Percentile"), Slider::Percent, Slider::Linear, Slider::Real, 0, .5, .1, 0, .5, Slider::FilterPercent, this)),
+    m_rejectValue(false)
+{
+    m_reject->addOption(DF_TR_AND_C("No"), false, true);
+    m_reject->addOption(DF_TR_AND_C("Yes"), true);
+
+    addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
+    addOutput(new OperatorOutput(tr("Images"), this));
+
+    addParameter(m_threshold);
+    addParameter(m_reject);
+    addParameter(m_percentile);
+}
+
+OpFrameQuality *OpFrameQuality::newInstance()
+{
+    return new OpFrameQuality(m_process);
+}
+
+OperatorWorker *OpFrameQuality::newWorker()
+{
+    return new WorkerFrameQuality(m_threshold->value(),
+                                  m_rejectValue,
+                                  m_percentile->value(),
+                                  m_thread, this);
+}
+
+void OpFrameQuality::selectReject(int v)
+{
+    if ( m_rejectValue != !!v ) {
+        m_rejectValue = !!v;
+        setOutOfDate();
+    }
+}
@@ -43,6 +43,7 @@ public:
     OpGaussianBlur(Process *parent);
     OpGaussianBlur *newInstance();
     OperatorWorker *newWorker();
+    int footprintRadius() const;
 private:
     OperatorParameterSlider *m_radius;
     OperatorParameterSlider *m_sigma;
@@ -33,19 +33,31 @@
 #include "operatorinput.h"
 #include "operatoroutput.h"
 #include "operatorparameterslider.h"
+#include "operatorparameterdropdown.h"
 #include "workergradientevaluation.h"
 
 OpGradientEvaluation::OpGradientEvaluation(Process *parent) :
     Operator(OP_SECTION_COLOR, QT_TRANSLATE_NOOP("Operator", "Gradient Evaluation"), Operator::All, parent),
     m_radius(new OperatorParameterSlider("radius", tr("Points Radius"), tr("Gradient Evaluation Points Radius"), Slider::Value, Slider::Linear, Slider::Real, 0, 20, 3, 0, 100, Slider::FilterPixels, this)),
     m_altitude(new OperatorParameterSlider("altitude", tr("Altitude"), tr("Gradient Evaluation Altitude"), Slider::Value, Slider::Linear, Slider::Real, 0, 100, 0, 0, 10000, Slider::FilterPixels, this)),
-    m_pow(new OperatorParameterSlider("pow", tr("Power"), tr("Gradient Evaluation Power"), Slider::Value, Slider::Logarithmic, Slider::Real, .125, 8, .5, 0.01, 50, Slider::FilterNothing, this))
+    m_pow(new OperatorParameterSlider("pow", tr("Power"), tr("Gradient Evaluation Power"), Slider::Value, Slider::Logarithmic, Slider::Real, .125, 8, .5, 0.01, 50, Slider::FilterNothing, this)),
+    m_method(new OperatorParameterDropDown("method", tr("Method"), this, SLOT(selectMethod(int)))),
+    m_tolerance(new OperatorParameterSlider("tolerance", tr("Tolerance"), tr("Gradient Evaluation Grid Tolerance"), Slider::Percent, Slider::Logarithmic, Slider::Real, 1./(1<<16), 1./(1<<6), 1./(1<<10), 1./(1<<16), 1, Slider::FilterPercent, this)),
+    m_degree(new OperatorParameterSlider("degree", tr("Degree"), tr("Gradient Evaluation Polynomial Degree"), Slider::Value, Slider::Linear, Slider::Integer, 1, 6, 3, 1, 6, Slider::FilterNothing, this)),
+    m_methodValue(Exact)
 {
+    m_method->addOption(DF_TR_AND_C("Exact"), Exact, true);
+    m_method->addOption(DF_TR_AND_C("Grid"), Grid);
+    m_method->addOption(DF_TR_AND_C("Polynomial"), Polynomial);
+
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Gradients"), this));
     addParameter(m_radius);
     addParameter(m_altitude);
     addParameter(m_pow);
+    addParameter(m_method);
+    addParameter(m_tolerance);
+    addParameter(m_degree);
 }
 
 OpGradientEvaluation *OpGradientEvaluation::newInstance()
@@ -58,5 +70,16 @@ OperatorWorker *OpGradientEvaluation::newWorker()
     return new WorkerGradientEvaluation(m_radius->value(),
                                         m_altitude->value(),
                                         m_pow->value(),
+                                        m_methodValue,
+                                        m_tolerance->value(),
+                                        m_degree->value(),
                                         m_thread, this);
 }
+
+void OpGradientEvaluation::selectMethod(int v)
+{
+    if ( m_methodValue != v ) {
+        m_methodValue = Method(v);
+        setOutOfDate();
+    }
+}
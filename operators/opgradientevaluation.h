@@ -35,18 +35,30 @@
 #include <QObject>
 
 class OperatorParameterSlider;
+class OperatorParameterDropDown;
 
 class OpGradientEvaluation : public Operator
 {
     Q_OBJECT
 public:
+    typedef enum {
+        Exact,
+        Grid,
+        Polynomial
+    } Method;
     OpGradientEvaluation(Process *parent);
     OpGradientEvaluation *newInstance();
     OperatorWorker *newWorker();
+private slots:
+    void selectMethod(int v);
 private:
     OperatorParameterSlider *m_radius;
     OperatorParameterSlider *m_altitude;
     OperatorParameterSlider *m_pow;
+    OperatorParameterDropDown *m_method;
+    OperatorParameterSlider *m_tolerance;
+    OperatorParameterSlider *m_degree;
+    Method m_methodValue;
 };
 
 #endif // OPGRADIENTEVALUATION_H
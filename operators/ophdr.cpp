@@ -63,6 +63,7 @@ OpHDR::OpHDR(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
     m_revertDialog->addOption(DF_TR_AND_C("No"), false, true);
     m_revertDialog->addOption(DF_TR_AND_C("Yes"), true);
     addParameter(m_revertDialog);
@@ -36,22 +36,126 @@
 #include "operatorparameterdropdown.h"
 #include "hotpixels.h"
 #include "ports.h"
+#include "photo.h"
+#include "console.h"
+#include <QHash>
+#include <algorithm>
 
 class WorkerHotPixels : public OperatorWorker {
 public:
-    WorkerHotPixels(qreal delta, bool aggressive, bool naive, QThread *thread, Operator *op) :
+    WorkerHotPixels(qreal delta, bool aggressive, bool naive,
+                    OpHotPixels::Detection detection,
+                    QThread *thread, Operator *op) :
         OperatorWorker(thread, op),
-        m_hotPixels(delta,aggressive, naive)
+        m_hotPixels(delta,aggressive, naive),
+        m_detection(detection),
+        m_defects(),
+        m_width(0),
+        m_height(0)
     {
     }
+
+    /*
+     * the defects are found once, from the master dark or from the pixels
+     * found in at least half of the lights, and only them are corrected
+     */
+    void play_analyseSources() {
+        if ( m_detection == OpHotPixels::EveryFrame )
+            return;
+        int w = 0;
+        int h = 0;
+        try {
+            if ( m_detection == OpHotPixels::MasterDark ) {
+                if ( m_inputs[1].count() == 0 ) {
+                    dflError(tr("Hot Pixels: no master dark given"));
+                    m_error = true;
+                    return;
+                }
+                Photo dark(m_inputs[1][0]);
+                Magick::Image& image = dark.image();
+                w = image.columns();
+                h = image.rows();
+                m_defects = m_hotPixels.findDefects(image, dark.getScale() == Photo::HDR);
+            }
+            else {
+                QHash<qint64, HotPixels::Defect> found;
+                QHash<qint64, int> occurrences;
+                int n = 0;
+                foreach(Photo photo, m_inputs[0]) {
+                    if ( aborted() )
+                        return;
+                    Magick::Image& image = photo.image();
+                    if ( n && ( w != int(image.columns()) || h != int(image.rows()) ) ) {
+                        dflError(tr("Hot Pixels: %0 size mismatch").arg(photo.getIdentity()));
+                        m_error = true;
+                        return;
+                    }
+                    w = image.columns();
+                    h = image.rows();
+                    QVector<HotPixels::Defect> defects =
+                            m_hotPixels.findDefects(image, photo.getScale() == Photo::HDR);
+                    foreach(const HotPixels::Defect& defect, defects) {
+                        qint64 key = qint64(defect.y) * w + defect.x;
+                        found[key].x = defect.x;
+                        found[key].y = defect.y;
+                        found[key].channels |= defect.channels;
+                        ++occurrences[key];
+                    }
+                    emit progress(++n, 2*m_inputs[0].count());
+                }
+                foreach(qint64 key, found.keys())
+                    if ( 2*occurrences[key] >= n )
+                        m_defects.push_back(found[key]);
+                std::sort(m_defects.begin(), m_defects.end());
+            }
+            m_width = w;
+            m_height = h;
+            dflInfo(tr("Hot Pixels: %0 defects found").arg(m_defects.count()));
+            Photo map(Photo::Linear);
+            map.setIdentity(m_operator->uuid());
+            map.createImage(w, h);
+            map.setTag(TAG_NAME, tr("Hot pixels map"));
+            Magick::Image& image = map.image();
+            Ordinary::Pixels pixel_cache(image);
+            foreach(const HotPixels::Defect& defect, m_defects) {
+                Magick::PixelPacket *pixel = pixel_cache.get(defect.x, defect.y, 1, 1);
+                if ( !pixel )
+                    continue;
+                pixel->red = pixel->green = pixel->blue = QuantumRange;
+                pixel_cache.sync();
+            }
+            outputPush(1, map);
+        }
+        catch (std::exception &e) {
+            dflError("%s", e.what());
+            m_error = true;
+        }
+    }
+
     Photo process(const Photo &photo, int , int ) {
         Photo newPhoto(photo);
-        m_hotPixels.applyOn(newPhoto);
+        if ( m_detection == OpHotPixels::EveryFrame ) {
+            m_hotPixels.applyOn(newPhoto);
+        }
+        else {
+            Magick::Image& image = newPhoto.image();
+            /* the defects are positions in frames of the detection size */
+            if ( int(image.columns()) != m_width ||
+                 int(image.rows()) != m_height ) {
+                setError(photo, tr("Hot Pixels: size mismatch"));
+                return photo;
+            }
+            m_hotPixels.applyOnDefects(image, photo.getScale() == Photo::HDR, m_defects);
+        }
         return newPhoto;
     }
 
 private:
     HotPixels m_hotPixels;
+    OpHotPixels::Detection m_detection;
+    QVector<HotPixels::Defect> m_defects;
+    int m_width;
+    int m_height;
 };
 
 OpHotPixels::OpHotPixels(Process *parent) :
@@ -59,20 +163,29 @@ OpHotPixels::OpHotPixels(Process *parent) :
     m_delta(new OperatorParameterSlider("delta", tr("Delta"), tr("Hot Pixels Delta"), Slider::ExposureValue, Slider::Logarithmic, Slider::Real, 1, 1<<4, M_SQRT2l, 1, 1<<16, Slider::FilterExposureFromOne, this)),
     m_aggressive(new OperatorParameterDropDown("aggressive", tr("Aggressive"), this, SLOT(selectAggressive(int)))),
     m_naive(new OperatorParameterDropDown("naive", tr("Naive"), this, SLOT(selectNaive(int)))),
+    m_detection(new OperatorParameterDropDown("detection", tr("Detection"), this, SLOT(selectDetection(int)))),
     m_aggressiveValue(true),
-    m_naiveValue(false)
+    m_naiveValue(false),
+    m_detectionValue(EveryFrame)
 {
     m_aggressive->addOption(DF_TR_AND_C("Yes"), true, true);
     m_aggressive->addOption(DF_TR_AND_C("No"), false);
     m_naive->addOption(DF_TR_AND_C("Yes"), true);
     m_naive->addOption(DF_TR_AND_C("No"), false, true);
+    m_detection->addOption(DF_TR_AND_C("Every frame"), EveryFrame, true);
+    m_detection->addOption(DF_TR_AND_C("Master dark"), MasterDark);
+    m_detection->addOption(DF_TR_AND_C("Images statistics"), LightsStatistics);
 
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
+    addInput(new OperatorInput(tr("Master dark"), OperatorInput::Image, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    addOutput(new OperatorOutput(tr("Hot pixels map"), this));
+    setExecutionModel(PerFrame);
 
     addParameter(m_delta);
     addParameter(m_aggressive);
     addParameter(m_naive);
+    addParameter(m_detection);
 }
 
 OpHotPixels *OpHotPixels::newInstance()
@@ -85,6 +198,7 @@ OperatorWorker *OpHotPixels::newWorker()
 return new WorkerHotPixels(m_delta->value(),
                            m_aggressiveValue,
                            m_naiveValue,
+                           m_detectionValue,
                            m_thread, this);
 }
 
@@ -103,3 +217,13 @@ void OpHotPixels::selectNaive(int v)
         setOutOfDate();
     }
 }
+
+void OpHotPixels::selectDetection(int v)
+{
+    if ( m_detectionValue != v ) {
+        m_detectionValue = Detection(v);
+        /* the statistics need all the images before the first correction */
+        setExecutionModel(m_detectionValue == LightsStatistics ? WholeSet : PerFrame);
+        setOutOfDate();
+    }
+}
@@ -41,18 +41,26 @@ class OpHotPixels : public Operator
 {
     Q_OBJECT
 public:
+    typedef enum {
+        EveryFrame,
+        MasterDark,
+        LightsStatistics
+    } Detection;
     OpHotPixels(Process *parent);
     OpHotPixels *newInstance();
     OperatorWorker *newWorker();
 private slots:
     void selectAggressive(int v);
     void selectNaive(int v);
+    void selectDetection(int v);
 private:
     OperatorParameterSlider *m_delta;
     OperatorParameterDropDown *m_aggressive;
     OperatorParameterDropDown *m_naive;
+    OperatorParameterDropDown *m_detection;
     bool m_aggressiveValue;
     bool m_naiveValue;
+    Detection m_detectionValue;
 };
 
 #endif // OPHOTPIXELS_H
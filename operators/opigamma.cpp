@@ -101,6 +101,8 @@ OpIGamma::OpIGamma(Process *parent) :
 
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintPointwise);
 
     m_revertDialog->addOption(DF_TR_AND_C("No"), false, true);
     m_revertDialog->addOption(DF_TR_AND_C("Yes"), true);
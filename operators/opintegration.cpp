@@ -35,13 +35,18 @@
 #include "operatoroutput.h"
 #include "opintegration.h"
 #include "workerintegration.h"
+#include "transformview.h"
 #include "Magick++.h"
 
 static const char *RejectionTypeStr[] = {
     QT_TRANSLATE_NOOP("OpIntegration", "None"),
     QT_TRANSLATE_NOOP("OpIntegration", "Min/Max"),
     QT_TRANSLATE_NOOP("OpIntegration", "Average Deviation"),
-    QT_TRANSLATE_NOOP("OpIntegration", "Sigma clipping")
+    QT_TRANSLATE_NOOP("OpIntegration", "Sigma clipping"),
+    QT_TRANSLATE_NOOP("OpIntegration", "Median"),
+    QT_TRANSLATE_NOOP("OpIntegration", "Winsorized sigma clipping"),
+    QT_TRANSLATE_NOOP("OpIntegration", "Linear fit clipping"),
+    QT_TRANSLATE_NOOP("OpIntegration", "Percentile clipping")
 };
 static const char *NormalizationTypeStr[] = {
     QT_TRANSLATE_NOOP("OpIntegration", "None"),
@@ -62,7 +67,13 @@ OpIntegration::OpIntegration(Process *parent) :
     m_customNormalization(new OperatorParameterSlider("normalizationValue", tr("Custom Norm."), tr("Integration Custom Normalization"), Slider::ExposureValue, Slider::Logarithmic, Slider::Real, 1, 1<<4, 1, 1./QuantumRange, QuantumRange, Slider::FilterExposureFromOne, this)),
     m_outputHDR(new OperatorParameterDropDown("outputHDR", tr("Output HDR"), this, SLOT(setOutputHDR(int)))),
     m_outputHDRValue(false),
-    m_scale(new OperatorParameterSlider("scale", tr("Scale"), tr("Integration scale"), Slider::Value, Slider::Logarithmic, Slider::Real, 1./4., 4, 1, 1./4., 4., Slider::FilterPercent, this))
+    m_scale(new OperatorParameterSlider("scale", tr("Scale"), tr("Integration scale"), Slider::Value, Slider::Logarithmic, Slider::Real, 1./4., 4, 1, 1./4., 4., Slider::FilterPercent, this)),
+    m_interpolation(new OperatorParameterDropDown("interpolation", tr("Interpolation"), this, SLOT(setInterpolation(int)))),
+    m_interpolationValue(TransformView::Box),
+    m_drizzle(new OperatorParameterDropDown("drizzle", tr("Drizzle"), this, SLOT(setDrizzle(int)))),
+    m_drizzleValue(false),
+    m_pixfrac(new OperatorParameterSlider("pixfrac", tr("Pixfrac"), tr("Integration Drizzle Drop Size"), Slider::Percent, Slider::Linear, Slider::Real, .1, 1, .7, .01, 1, Slider::FilterPercent, this)),
+    m_state()
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Integrated Image"), this));
@@ -72,6 +83,10 @@ OpIntegration::OpIntegration(Process *parent) :
     m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[MinMax]), MinMax);
     m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[AverageDeviation]), AverageDeviation);
     m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[SigmaClipping]), SigmaClipping);
+    m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[Median]), Median);
+    m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[WinsorizedSigmaClipping]), WinsorizedSigmaClipping);
+    m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[LinearFitClipping]), LinearFitClipping);
+    m_rejectionTypeDropDown->addOption(DF_TR_AND_C(RejectionTypeStr[PercentileClipping]), PercentileClipping);
 
     m_normalizationTypeDropDown->addOption(DF_TR_AND_C(NormalizationTypeStr[NoNormalization]), NoNormalization, true);
     m_normalizationTypeDropDown->addOption(DF_TR_AND_C(NormalizationTypeStr[HighestValue]), HighestValue);
@@ -80,12 +95,23 @@ OpIntegration::OpIntegration(Process *parent) :
     m_outputHDR->addOption(DF_TR_AND_C("No"), false, true);
     m_outputHDR->addOption(DF_TR_AND_C("Yes"), true);
 
+    m_interpolation->addOption(DF_TR_AND_C("Box"), TransformView::Box, true);
+    m_interpolation->addOption(DF_TR_AND_C("Bilinear"), TransformView::Bilinear);
+    m_interpolation->addOption(DF_TR_AND_C("Bicubic"), TransformView::Bicubic);
+    m_interpolation->addOption(DF_TR_AND_C("Lanczos-3"), TransformView::Lanczos3);
+
+    m_drizzle->addOption(DF_TR_AND_C("No"), false, true);
+    m_drizzle->addOption(DF_TR_AND_C("Yes"), true);
+
     addParameter(m_rejectionTypeDropDown);
     addParameter(m_upper);
     addParameter(m_lower);
     addParameter(m_normalizationTypeDropDown);
     addParameter(m_customNormalization);
     addParameter(m_scale);
+    addParameter(m_interpolation);
+    addParameter(m_drizzle);
+    addParameter(m_pixfrac);
     addParameter(m_outputHDR);
 }
 
@@ -96,6 +122,13 @@ OpIntegration *OpIntegration::newInstance()
 
 OperatorWorker *OpIntegration::newWorker()
 {
+    bool fold = isAppending();
+    if ( !fold ) {
+        if ( foldable() )
+            m_state.reset(new IntegrationState);
+        else
+            m_state.reset();
+    }
     return new WorkerIntegration(m_rejectionType,
                                  m_upper->value(),
                                  m_lower->value(),
@@ -103,9 +136,42 @@ OperatorWorker *OpIntegration::newWorker()
                                  m_customNormalization->value(),
                                  m_outputHDRValue,
                                  m_scale->value(),
+                                 m_interpolationValue,
+                                 m_drizzleValue,
+                                 m_pixfrac->value(),
+                                 m_state, fold,
                                  m_thread, this);
 }
 
+/* live sources are folded in the sums of the previous runs, unless the
+ * last run was interrupted before they were complete */
+Operator::AppendModel OpIntegration::appendModel() const
+{
+    return m_state && m_state->valid ? AppendFolded : AppendReplay;
+}
+
+/* the integrated image is replaced, the rejection maps of the new frames
+ * are appended to those of the previous runs */
+bool OpIntegration::isFoldedOutput(int idx) const
+{
+    return idx == 0;
+}
+
+/* the estimators that can be maintained from running sums */
+bool OpIntegration::foldable() const
+{
+    if ( m_drizzleValue )
+        return false;
+    switch (m_rejectionType) {
+    case NoRejection:
+    case AverageDeviation:
+    case SigmaClipping:
+        return liveUpstream();
+    default:
+        return false;
+    }
+}
+
 void OpIntegration::setRejectionType(int type)
 {
     if ( m_rejectionType != type ) {
@@ -129,3 +195,19 @@ void OpIntegration::setOutputHDR(int type)
         setOutOfDate();
     }
 }
+
+void OpIntegration::setInterpolation(int type)
+{
+    if ( m_interpolationValue != type ) {
+        m_interpolationValue = type;
+        setOutOfDate();
+    }
+}
+
+void OpIntegration::setDrizzle(int type)
+{
+    if ( m_drizzleValue != !!type ) {
+        m_drizzleValue = !!type;
+        setOutOfDate();
+    }
+}
@@ -33,9 +33,11 @@
 
 #include "operator.h"
 #include <QObject>
+#include <memory>
 
 class OperatorParameterSlider;
 class OperatorParameterDropDown;
+class IntegrationState;
 
 class OpIntegration : public Operator
 {
@@ -46,6 +48,10 @@ public:
         MinMax,
         AverageDeviation,
         SigmaClipping,
+        Median,
+        WinsorizedSigmaClipping,
+        LinearFitClipping,
+        PercentileClipping,
     } RejectionType;
 
     typedef enum {
@@ -58,12 +64,16 @@ public:
 
     OpIntegration *newInstance();
     OperatorWorker *newWorker();
+    AppendModel appendModel() const;
+    bool isFoldedOutput(int idx) const;
 
 public slots:
     void setRejectionType(int type);
 
     void setNormalizationType(int type);
     void setOutputHDR(int type);
+    void setInterpolation(int type);
+    void setDrizzle(int type);
 
 private:
     RejectionType m_rejectionType;
@@ -76,7 +86,14 @@ private:
     OperatorParameterDropDown *m_outputHDR;
     bool m_outputHDRValue;
     OperatorParameterSlider *m_scale;
+    OperatorParameterDropDown *m_interpolation;
+    int m_interpolationValue;
+    OperatorParameterDropDown *m_drizzle;
+    bool m_drizzleValue;
+    OperatorParameterSlider *m_pixfrac;
+    std::shared_ptr<IntegrationState> m_state;
 
+    bool foldable() const;
 };
 
 #endif // OPINTEGRATION_H
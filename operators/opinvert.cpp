@@ -54,6 +54,8 @@ OpInvert::OpInvert(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Negative images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintPointwise);
 
 }
 
@@ -70,6 +70,7 @@ OpLevel::OpLevel(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_blackPoint);
     addParameter(m_whitePoint);
     addParameter(m_gamma);
@@ -63,6 +63,7 @@ OpLoadImage::OpLoadImage(Process *parent) :
     addParameter(m_filesCollection);
     addParameter(m_colorSpace);
     addOutput(new OperatorOutput(tr("Images"),this));
+    setProxySource(true);
 }
 
 OpLoadImage *OpLoadImage::newInstance()
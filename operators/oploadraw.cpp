@@ -28,13 +28,24 @@
  *     * Guillaume Gimenez <guillaume@blackmilk.fr>
  *
  */
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QSet>
+
 #include "process.h"
 #include "operatorparameterfilescollection.h"
 #include "operatorparameterdropdown.h"
+#include "operatorparameterdirectory.h"
 #include "oploadraw.h"
 #include "operatoroutput.h"
 #include "workerloadraw.h"
 
+#define RAW_NAME_FILTERS "*.nef *.cr2 *.dng *.mef *.3fr *.raf *.x3f *.pef *.arw *.nrw"
+
+/* quiet period after a directory change before looking at the new files */
+#define DF_LIVE_SCAN_DELAY 2000
+
 static const char *ColorSpaceStr[] = {
     QT_TRANSLATE_NOOP("OpLoadRaw", "Linear"),
     QT_TRANSLATE_NOOP("OpLoadRaw", "sRGB"),
@@ -62,6 +73,10 @@ static const char *ClippingStr[] = {
     QT_TRANSLATE_NOOP("OpLoadRaw", "13-bit"),
     QT_TRANSLATE_NOOP("OpLoadRaw", "12-bit")
 };
+static const char *LiveStr[] = {
+    QT_TRANSLATE_NOOP("OpLoadRaw", "No"),
+    QT_TRANSLATE_NOOP("OpLoadRaw", "Yes")
+};
 
 OpLoadRaw::OpLoadRaw(Process *parent) :
     Operator(OP_SECTION_ASSETS, QT_TRANSLATE_NOOP("Operator", "Raw photos"), Operator::NA, parent),
@@ -70,16 +85,23 @@ OpLoadRaw::OpLoadRaw(Process *parent) :
                           tr("RAW photos"),
                           tr("Select RAW photos to add to the collection"),
                           m_process->baseDirectory(),
-                          tr("RAW photos (*.nef *.cr2 *.dng *.mef *.3fr *.raf *.x3f *.pef *.arw *.nrw);;"
+                          tr("RAW photos (" RAW_NAME_FILTERS ");;"
                              "All Files (*.*)"), this)),
     m_colorSpace(new OperatorParameterDropDown("colorSpace", tr("Color Space"),this, SLOT(setColorSpace(int)))),
     m_debayer(new OperatorParameterDropDown("debayer", tr("Debayer"), this, SLOT(setDebayer(int)))),
     m_whiteBalance(new OperatorParameterDropDown("whiteBalance", tr("White Balance"), this, SLOT(setWhiteBalance(int)))),
     m_clipping(new OperatorParameterDropDown("clip", tr("Clip Highlight"), this, SLOT(setClipping(int)))),
+    m_live(new OperatorParameterDropDown("live", tr("Live"), this, SLOT(setLive(int)))),
+    m_liveDirectory(new OperatorParameterDirectory("liveDirectory", tr("Watched directory"), m_process->baseDirectory(), "", this)),
     m_colorSpaceValue(Linear),
     m_debayerValue(NoDebayer),
     m_whiteBalanceValue(Daylight),
-    m_clippingValue(ClipAuto)
+    m_clippingValue(ClipAuto),
+    m_liveValue(false),
+    m_watcher(new QFileSystemWatcher(this)),
+    m_liveTimer(new QTimer(this)),
+    m_liveSizes(),
+    m_liveFiles()
 {
     m_colorSpace->addOption(DF_TR_AND_C(ColorSpaceStr[Linear]), Linear, true);
     m_colorSpace->addOption(DF_TR_AND_C(ColorSpaceStr[sRGB]), sRGB);
@@ -104,13 +126,25 @@ OpLoadRaw::OpLoadRaw(Process *parent) :
     m_clipping->addOption(DF_TR_AND_C(ClippingStr[Clip13bit]), Clip13bit);
     m_clipping->addOption(DF_TR_AND_C(ClippingStr[Clip12bit]), Clip12bit);
 
+    m_live->addOption(DF_TR_AND_C(LiveStr[0]), false, true);
+    m_live->addOption(DF_TR_AND_C(LiveStr[1]), true);
+
+    m_liveTimer->setSingleShot(true);
+    m_liveTimer->setInterval(DF_LIVE_SCAN_DELAY);
+    connect(m_liveTimer, SIGNAL(timeout()), this, SLOT(liveScan()));
+    connect(m_watcher, SIGNAL(directoryChanged(QString)), m_liveTimer, SLOT(start()));
+    connect(m_liveDirectory, SIGNAL(updated()), this, SLOT(liveDirectoryChanged()));
+
     addParameter(m_filesCollection);
     addParameter(m_colorSpace);
     addParameter(m_debayer);
     addParameter(m_whiteBalance);
     addParameter(m_clipping);
+    addParameter(m_live);
+    addParameter(m_liveDirectory);
 
     addOutput(new OperatorOutput(tr("RAWs"), this));
+    setProxySource(true);
 }
 
 OpLoadRaw::~OpLoadRaw()
@@ -175,11 +209,103 @@ void OpLoadRaw::setClipping(int v)
 }
 
 
+void OpLoadRaw::setLive(int v)
+{
+    if ( m_liveValue != bool(v) ) {
+        m_liveValue = v;
+        liveWatch();
+    }
+}
+
+bool OpLoadRaw::isLive() const
+{
+    return m_liveValue;
+}
+
+void OpLoadRaw::stopLive()
+{
+    setLive(false);
+}
+
 void OpLoadRaw::filesCollectionChanged()
 {
     setOutOfDate();
 }
 
+void OpLoadRaw::liveDirectoryChanged()
+{
+    liveWatch();
+}
+
+void OpLoadRaw::liveWatch()
+{
+    QStringList watched = m_watcher->directories();
+    if ( watched.count() )
+        m_watcher->removePaths(watched);
+    m_liveSizes.clear();
+    QString dir = m_liveDirectory->currentValue();
+    if ( !m_liveValue || dir.isEmpty() )
+        return;
+    if ( !m_watcher->addPath(dir) ) {
+        dflWarning(tr("Live: can't watch directory %0").arg(dir));
+        return;
+    }
+    m_liveTimer->start();
+}
+
+/**
+ * @brief OpLoadRaw::liveScan
+ * takes the raws that appeared in the watched directory. a file is taken
+ * once its size held between two scans, the camera or the copy may still
+ * be writing it. an up to date loader appends the new photos downstream,
+ * otherwise they just join the collection for the next play
+ */
+void OpLoadRaw::liveScan()
+{
+    QString dirName = m_liveDirectory->currentValue();
+    if ( !m_liveValue || dirName.isEmpty() )
+        return;
+    QDir dir(dirName);
+    QStringList collection = getCollection();
+    QSet<QString> known = collection.toSet();
+    QStringList ready;
+    bool waiting = false;
+    foreach(const QFileInfo& info,
+            dir.entryInfoList(QString(RAW_NAME_FILTERS).split(' '),
+                              QDir::Files, QDir::Name)) {
+        QString file = info.absoluteFilePath();
+        if ( known.contains(file) )
+            continue;
+        qint64 size = info.size();
+        if ( 0 == size || m_liveSizes.value(file, -1) != size ) {
+            m_liveSizes[file] = size;
+            waiting = true;
+            continue;
+        }
+        ready.push_back(file);
+    }
+    if ( waiting || ( ready.count() && isPlaying() ) )
+        m_liveTimer->start();
+    if ( ready.isEmpty() || isPlaying() )
+        return;
+    foreach(const QString& file, ready)
+        m_liveSizes.remove(file);
+    dflInfo(tr("Live: %0 new photo(s)").arg(ready.count()));
+    if ( isUpToDate() ) {
+        m_liveFiles = ready;
+        m_filesCollection->appendCollection(ready);
+        playAppend();
+    }
+    else {
+        m_filesCollection->setCollection(collection + ready);
+    }
+}
+
 OperatorWorker *OpLoadRaw::newWorker() {
-    return new WorkerLoadRaw(m_thread, this);
+    if ( isAppending() ) {
+        QStringList collection = getCollection();
+        return new WorkerLoadRaw(m_thread, this, m_liveFiles,
+                                 collection.count() - m_liveFiles.count());
+    }
+    return new WorkerLoadRaw(m_thread, this, getCollection(), 0);
 }
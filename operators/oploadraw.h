@@ -33,10 +33,15 @@
 
 #include "operator.h"
 #include <QObject>
+#include <QMap>
+#include <QStringList>
 
 class Process;
 class OperatorParameterFilesCollection;
 class OperatorParameterDropDown;
+class OperatorParameterDirectory;
+class QFileSystemWatcher;
+class QTimer;
 class OpLoadRaw : public Operator
 {
     Q_OBJECT
@@ -78,13 +83,19 @@ public:
     QString getDebayer() const;
     QString getWhiteBalance() const;
 
+    bool isLive() const;
+    void stopLive();
+
 public slots:
     void setColorSpace(int v);
     void setDebayer(int v);
     void setWhiteBalance(int v);
     void setClipping(int v);
+    void setLive(int v);
 
     void filesCollectionChanged();
+    void liveDirectoryChanged();
+    void liveScan();
 
     OperatorWorker *newWorker();
 
@@ -92,17 +103,29 @@ protected:
 
 
 private:
+    void liveWatch();
+
     friend class WorkerLoadRaw;
     OperatorParameterFilesCollection *m_filesCollection;
     OperatorParameterDropDown *m_colorSpace;
     OperatorParameterDropDown *m_debayer;
     OperatorParameterDropDown *m_whiteBalance;
     OperatorParameterDropDown *m_clipping;
+    OperatorParameterDropDown *m_live;
+    OperatorParameterDirectory *m_liveDirectory;
 
     ColorSpace m_colorSpaceValue;
     Debayer m_debayerValue;
     WhiteBalance m_whiteBalanceValue;
     Clipping m_clippingValue;
+    bool m_liveValue;
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_liveTimer;
+    /* size of the files not taken yet, at the last scan */
+    QMap<QString, qint64> m_liveSizes;
+    /* files loaded by the running append */
+    QStringList m_liveFiles;
 
 };
 
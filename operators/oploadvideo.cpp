@@ -51,6 +51,7 @@ OpLoadVideo::OpLoadVideo(Process *process) :
     addParameter(m_skip);
     addParameter(m_count);
     addOutput(new OperatorOutput(tr("Video frames"), this));
+    setProxySource(true);
 }
 
 OpLoadVideo::~OpLoadVideo()
@@ -68,6 +68,7 @@ OpMicroContrasts::OpMicroContrasts(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"),OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 }
 
 OpMicroContrasts *OpMicroContrasts::newInstance()
@@ -68,6 +68,7 @@ OpModulate::OpModulate(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
     addParameter(m_hue);
     addParameter(m_saturation);
@@ -87,6 +87,7 @@ OpPixelExtrusionMapping::OpPixelExtrusionMapping(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Extrusion"), this));
+    setExecutionModel(PerFrame);
 }
 
 OpPixelExtrusionMapping *OpPixelExtrusionMapping::newInstance()
@@ -58,6 +58,7 @@ OpReduceNoise::OpReduceNoise(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_order);
 }
 
@@ -62,6 +62,7 @@ OpRoll::OpRoll(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Rolled"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_columns);
     addParameter(m_rows);
 }
@@ -89,6 +89,7 @@ OpRotate::OpRotate(Process *parent) :
     addParameter(m_dropdown);
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Rotated"), this));
+    setExecutionModel(PerFrame);
 }
 
 OpRotate::~OpRotate()
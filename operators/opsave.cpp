@@ -35,11 +35,18 @@
 #include "operatorworker.h"
 #include "process.h"
 #include "photo.h"
+#include "fitswriter.h"
 
 #include <QFileInfo>
 #include <QFile>
 #include <QDir>
 #include <QDateTime>
+#include <QSemaphore>
+
+#include <memory>
+
+/* memory the Magick encoders may hold at once */
+#define DF_SAVE_MEMORY_BUDGET (512LL<<20)
 
 class WorkerSave : public OperatorWorker {
     QString m_targetDirectory;
@@ -57,34 +64,93 @@ public:
     {
     }
     Photo process(const Photo&, int, int) { throw 0; }
-    void play() {
-        for (int i = 0, s = m_inputs[0].count() ; i < s ; ++i ) {
-            Photo& photo = m_inputs[0][i];
-            QDir targetDir(m_targetDirectory);
-            QString magick;
-            QString baseFilename = targetDir.filePath(photo.getTag(TAG_NAME));
-            QString ext;
-            switch (m_fileType) {
-            case OpSave::SaveFITS:
-                ext = ".fits"; magick = "FITS"; break;
-            case OpSave::SaveTIFF:
-                ext = ".tif"; magick = "TIFF"; break;
-            case OpSave::SaveJPEG:
-                ext = ".jpg"; magick = "JPG"; break;
-            }
-            QFileInfo finfo(baseFilename + ext);
-            if ( m_backup && finfo.exists() ) {
-                QDateTime lastModified = finfo.lastModified();
-                QString ts = lastModified.toString("yyyy'-'dd'-'MM'T'hh':'mm':'ss'.'zzz'Z'");
-                QFile orig(baseFilename + ext);
-                orig.rename(baseFilename + "-" + ts + ext);
+
+    /**
+     * @brief writers
+     * @return how many photos may be encoded concurrently. The native
+     * FITS writer only holds a row, Magick encoders hold the whole image
+     */
+    int writers() {
+        int threads = DfThreadLimit();
+        if ( m_fileType == OpSave::SaveFITS ||
+             m_fileType == OpSave::SaveFITSFloat )
+            return threads;
+        qint64 frameBytes = 1;
+        foreach(Photo photo, m_inputs[0]) {
+            Magick::Image& image = photo.image();
+            frameBytes = qMax(frameBytes, qint64(image.columns()) * image.rows() *
+                              3 * (m_fileType == OpSave::SaveTIFFFloat ? 8 : 4));
+        }
+        return qBound(qint64(1), DF_SAVE_MEMORY_BUDGET / frameBytes, qint64(threads));
+    }
+
+    bool save(Photo& photo) {
+        QDir targetDir(m_targetDirectory);
+        QString magick;
+        QString baseFilename = targetDir.filePath(photo.getTag(TAG_NAME));
+        QString ext;
+        switch (m_fileType) {
+        case OpSave::SaveFITS:
+        case OpSave::SaveFITSFloat:
+            ext = ".fits"; magick = "FITS"; break;
+        case OpSave::SaveTIFF:
+        case OpSave::SaveTIFFFloat:
+            ext = ".tif"; magick = "TIFF"; break;
+        case OpSave::SaveJPEG:
+            ext = ".jpg"; magick = "JPG"; break;
+        }
+        QFileInfo finfo(baseFilename + ext);
+        if ( m_backup && finfo.exists() ) {
+            QDateTime lastModified = finfo.lastModified();
+            QString ts = lastModified.toString("yyyy'-'dd'-'MM'T'hh':'mm':'ss'.'zzz'Z'");
+            QFile orig(baseFilename + ext);
+            orig.rename(baseFilename + "-" + ts + ext);
+        }
+        QString filename = finfo.filePath();
+        switch (m_fileType) {
+        case OpSave::SaveFITS:
+        case OpSave::SaveFITSFloat: {
+            FitsWriter writer(m_fileType == OpSave::SaveFITS
+                              ? FitsWriter::Integer16
+                              : FitsWriter::Float32);
+            if ( !writer.write(photo, filename) ) {
+                dflError(tr("Could not save %0: %1").arg(filename).arg(writer.errorString()));
+                return false;
             }
-            QString filename = finfo.filePath();
-            photo.save(filename, magick);
-            emitProgress(i, s, 0, 1);
+            return true;
         }
-        emitSuccess();
+        case OpSave::SaveTIFFFloat:
+            return photo.save(filename, magick, true);
+        default:
+            return photo.save(filename, magick);
+        }
+    }
 
+    void play() {
+        int s = m_inputs[0].count();
+        dfl_block int p = 0;
+        dfl_block bool failure = false;
+        std::shared_ptr<QSemaphore> inFlight(new QSemaphore(writers()));
+        dfl_parallel_for(i, 0, s, 1, (), {
+            if ( failure || aborted() )
+                continue;
+            Photo photo;
+            dfl_critical_section({
+                photo = m_inputs[0][i];
+            });
+            inFlight->acquire();
+            bool saved = save(photo);
+            inFlight->release();
+            dfl_critical_section({
+                if ( !saved )
+                    failure = true;
+                emitProgress(++p, s, 0, 1);
+            });
+        });
+        if ( failure || aborted() )
+            emitFailure();
+        else
+            emitSuccess();
     }
 };
 
@@ -92,6 +158,8 @@ static const char *SaveTypeStr[] = {
     QT_TRANSLATE_NOOP("OpSave", "FITS"),
     QT_TRANSLATE_NOOP("OpSave", "TIFF"),
     QT_TRANSLATE_NOOP("OpSave", "JPEG"),
+    QT_TRANSLATE_NOOP("OpSave", "FITS (32-bit float)"),
+    QT_TRANSLATE_NOOP("OpSave", "TIFF (32-bit float)"),
 };
 
 OpSave::OpSave(Process *parent) :
@@ -104,6 +172,8 @@ OpSave::OpSave(Process *parent) :
     m_fileType->addOption(DF_TR_AND_C(SaveTypeStr[SaveFITS]), SaveFITS, true);
     m_fileType->addOption(DF_TR_AND_C(SaveTypeStr[SaveTIFF]), SaveTIFF);
     m_fileType->addOption(DF_TR_AND_C(SaveTypeStr[SaveJPEG]), SaveJPEG);
+    m_fileType->addOption(DF_TR_AND_C(SaveTypeStr[SaveFITSFloat]), SaveFITSFloat);
+    m_fileType->addOption(DF_TR_AND_C(SaveTypeStr[SaveTIFFFloat]), SaveTIFFFloat);
 
     m_backup->addOption(DF_TR_AND_C("No"), false, true);
     m_backup->addOption(DF_TR_AND_C("Yes"), true);
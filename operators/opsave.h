@@ -44,7 +44,9 @@ public:
     typedef enum {
         SaveFITS,
         SaveTIFF,
-        SaveJPEG
+        SaveJPEG,
+        SaveFITSFloat,
+        SaveTIFFFloat
     } SaveType;
     OpSave(Process *parent);
     OpSave *newInstance();
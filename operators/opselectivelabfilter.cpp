@@ -68,6 +68,7 @@ OpSelectiveLabFilter::OpSelectiveLabFilter(Process *parent) :
 
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_selectiveLab);
     addParameter(m_saturation);
     addParameter(m_exposure);
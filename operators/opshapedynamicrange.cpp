@@ -71,6 +71,8 @@ OpShapeDynamicRange::OpShapeDynamicRange(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintPointwise);
 
     m_shapeDialog->addOption(DF_TR_AND_C("TanH"), ShapeDynamicRange::TanH, true);
 
@@ -50,3 +50,9 @@ OperatorWorker *OpSsdReg::newWorker()
 {
     return new WorkerSsdReg(m_thread, this);
 }
+
+/* each photo is registered on its own against the reference */
+Operator::AppendModel OpSsdReg::appendModel() const
+{
+    return AppendFramesWithReference;
+}
@@ -41,6 +41,7 @@ public:
     OpSsdReg(Process *parent);
     OpSsdReg *newInstance();
     OperatorWorker *newWorker();
+    AppendModel appendModel() const;
 };
 
 #endif // OPSSDREG_H
@@ -126,6 +126,7 @@ OpStarFinder::OpStarFinder(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Stars overlay"), this));
+    setExecutionModel(PerFrame);
     addParameter(m_threshold);
 }
 
@@ -116,6 +116,8 @@ OpThreshold::OpThreshold(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintPointwise);
 
     m_component->addOption(DF_TR_AND_C("Luminosity"), ComponentLuminosity, true);
     m_component->addOption(DF_TR_AND_C("RGB"), ComponentRGB);
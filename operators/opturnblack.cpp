@@ -62,6 +62,7 @@ OpTurnBlack::OpTurnBlack(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"),OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Black frame"), this));
+    setExecutionModel(PerFrame);
 }
 
 OpTurnBlack *OpTurnBlack::newInstance()
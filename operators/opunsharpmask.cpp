@@ -34,6 +34,7 @@
 #include "operatoroutput.h"
 #include "operatorparameterslider.h"
 #include <Magick++.h>
+#include <cmath>
 
 using Magick::Quantum;
 
@@ -72,6 +73,8 @@ OpUnsharpMask::OpUnsharpMask(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
+    setFootprint(FootprintLocal);
     addParameter(m_radius);
     addParameter(m_sigma);
     addParameter(m_amount);
@@ -92,3 +95,8 @@ OperatorWorker *OpUnsharpMask::newWorker()
                                  m_threshold->value(),
                                  m_thread, this);
 }
+
+int OpUnsharpMask::footprintRadius() const
+{
+    return ceil(m_radius->value()) + 1;
+}
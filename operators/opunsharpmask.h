@@ -43,6 +43,7 @@ public:
     OpUnsharpMask(Process *parent);
     OpUnsharpMask *newInstance();
     OperatorWorker *newWorker();
+    int footprintRadius() const;
 private:
     OperatorParameterSlider *m_radius;
     OperatorParameterSlider *m_sigma;
@@ -65,6 +65,7 @@ OpWhiteBalance::OpWhiteBalance(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
     m_safeDialog->addOption(DF_TR_AND_C("No"), false, true);
     m_safeDialog->addOption(DF_TR_AND_C("Yes"), true);
@@ -84,6 +84,7 @@ OpWindowFunction::OpWindowFunction(Process *parent) :
 {
     addInput(new OperatorInput(tr("Images"), OperatorInput::Set, this));
     addOutput(new OperatorOutput(tr("Images"), this));
+    setExecutionModel(PerFrame);
 
     m_window->addOption(DF_TR_AND_C("None"), DiscreteFourierTransform::WindowNone, false);
     m_window->addOption(DF_TR_AND_C("Hamming"), DiscreteFourierTransform::WindowHamming, true);
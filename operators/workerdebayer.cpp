@@ -32,10 +32,15 @@
 #include "bayer.h"
 #include "console.h"
 
+#include <vector>
+#include <memory>
+#include <cstddef>
+
 WorkerDebayer::WorkerDebayer(OpDebayer::Debayer quality, QThread *thread, Operator *op) :
     OperatorWorker(thread, op),
     m_quality(quality)
 {
+    dc1394_bayer_init();
 }
 
 /*
@@ -194,64 +199,121 @@ get_color_filter(const Photo& photo)
     }
 }
 
-static uint16_t *
-newBayer(int w, int h)
-{
-    return new uint16_t[w*h];
-}
+/*
+ * rows of context a VNG or AHD strip reads above and below the rows it
+ * writes, even to keep the CFA phase. Enough for the 5x5 neighbourhoods
+ * of VNG and for the 3 pixels tile overlap of AHD
+ */
+#define DEBAYER_HALO 8
+#define DEBAYER_MIN_STRIP 32
 
-static uint16_t *
-newRGB(int w, int h)
-{
-    return new uint16_t[w*h*3];
-}
+Q_STATIC_ASSERT(sizeof(Magick::Quantum) == sizeof(uint16_t));
 
-static void deleteBuffer(uint16_t *buffer)
+/* the pattern seen from the next row */
+static dc1394color_filter_t
+shiftedFilter(dc1394color_filter_t filter)
 {
-    delete[] buffer;
+    switch (filter) {
+    case DC1394_COLOR_FILTER_RGGB: return DC1394_COLOR_FILTER_GBRG;
+    case DC1394_COLOR_FILTER_GBRG: return DC1394_COLOR_FILTER_RGGB;
+    case DC1394_COLOR_FILTER_GRBG: return DC1394_COLOR_FILTER_BGGR;
+    case DC1394_COLOR_FILTER_BGGR: return DC1394_COLOR_FILTER_GRBG;
+    default: return filter;
+    }
 }
 
-static uint16_t *
-imageToBayer(Magick::Image& image, u_int32_t filters)
+/**
+ * @brief demosaic
+ * runs the dc1394 method over horizontal strips in parallel. Each strip
+ * reads its rows plus the rows the method reaches into the source. The
+ * methods computing each pixel from the CFA alone write the strip rows
+ * straight into the destination pixels. VNG and AHD read back their own
+ * output, they decode a strip plus halo rows into a working tile whose
+ * strip rows are then stored
+ */
+static bool demosaic(Magick::Image& src, Magick::Image& dst,
+                     u_int32_t filters, dc1394color_filter_t dc_filters,
+                     dc1394bayer_method_t method)
 {
-    int w = image.columns();
-    int h = image.rows();
-    uint16_t *buffer = newBayer(w, h);
-    Ordinary::Pixels cache(image);
-    const Magick::PixelPacket *pixel = cache.getConst(0, 0, w, h);
-    for ( int y = 0 ; y < h ; ++y ) {
-        for (int x = 0 ; x < w ; ++x ) {
-            switch (FC(filters, y, x)) {
-            case 0:
-                buffer[y*w+x]=pixel[y*w+x].red; break;
-            case 1:
-            case 3:
-                buffer[y*w+x]=pixel[y*w+x].green; break;
-            case 2:
-                buffer[y*w+x]=pixel[y*w+x].blue; break;
+    int w = src.columns();
+    int h = src.rows();
+    int strip = qMax(DEBAYER_MIN_STRIP, h / (DfThreadLimit() * 4));
+    strip += strip & 1;
+    int n_strips = (h + strip - 1) / strip;
+    int above = DEBAYER_HALO, below = DEBAYER_HALO;
+    bool direct = dc1394_bayer_reach(method, &above, &below);
+    /* packed quantum pixels: blue, green, red, opacity on little endian */
+    const int ps = sizeof(Magick::PixelPacket) / sizeof(Magick::Quantum);
+    const int bgr = offsetof(Magick::PixelPacket, blue) == 0;
+    std::shared_ptr<Ordinary::Pixels> src_cache(new Ordinary::Pixels(src));
+    std::shared_ptr<Ordinary::Pixels> dst_cache(new Ordinary::Pixels(dst));
+    dfl_block bool error = false;
+    dfl_parallel_for(i, 0, n_strips, 1, (src, dst), {
+        if ( error )
+            continue;
+        int y0 = i * strip;
+        int y1 = qMin(h, y0 + strip);
+        int top = y0 ? y0 - above : 0;
+        int bottom = y1 < h ? y1 + below : h;
+        int rows = bottom - top;
+        const Magick::PixelPacket *pixels = src_cache->getConst(0, top, w, rows);
+        if ( !pixels ) {
+            dflError(DF_NULL_PIXELS);
+            error = true;
+            continue;
+        }
+        std::vector<uint16_t> bayer(size_t(w) * rows);
+        for ( int y = 0 ; y < rows ; ++y ) {
+            const Magick::PixelPacket *line = pixels + size_t(y) * w;
+            uint16_t *out = &bayer[size_t(y) * w];
+            for ( int x = 0 ; x < w ; ++x ) {
+                switch (FC(filters, top + y, x)) {
+                case 0:
+                    out[x] = line[x].red; break;
+                case 1:
+                case 3:
+                    out[x] = line[x].green; break;
+                case 2:
+                    out[x] = line[x].blue; break;
+                }
             }
         }
-    }
-    return buffer;
-}
-
-static Magick::Image
-bufferToImage(uint16_t *buffer, int w, int h) {
-    Magick::Image image(Magick::Geometry(w,h), Magick::Color(0,0,0));
-    ResetImage(image);
-    int s = w * h;
-    Ordinary::Pixels cache(image);
-    Magick::PixelPacket *pixel = cache.get(0, 0, w, h);
-    for(int i = 0 ; i < s ; ++i) {
-        pixel[i].red = buffer[i*3+0];
-        pixel[i].green = buffer[i*3+1];
-        pixel[i].blue = buffer[i*3+2];
-    }
-    cache.sync();
-    return image;
+        dc1394color_filter_t tile = top & 1 ? shiftedFilter(dc_filters) : dc_filters;
+        Magick::PixelPacket *pixel = dst_cache->get(0, y0, w, y1 - y0);
+        if ( !pixel ) {
+            dflError(DF_NULL_PIXELS);
+            error = true;
+            continue;
+        }
+        bool decoded;
+        if ( direct ) {
+            decoded = DC1394_SUCCESS ==
+                    dc1394_bayer_decoding_16bit_rows(&bayer[0], reinterpret_cast<uint16_t*>(pixel),
+                                                     w, rows, ps, bgr, y0 - top, y1 - y0,
+                                                     tile, method, 16);
+        }
+        else {
+            std::vector<uint16_t> rgb(size_t(w) * rows * 3);
+            decoded = DC1394_SUCCESS ==
+                    dc1394_bayer_decoding_16bit(&bayer[0], &rgb[0], w, rows,
+                                                tile, method, 16);
+            const uint16_t *in = &rgb[size_t(y0 - top) * w * 3];
+            for ( size_t j = 0, s = size_t(y1 - y0) * w ; decoded && j < s ; ++j ) {
+                pixel[j].red = in[j*3+0];
+                pixel[j].green = in[j*3+1];
+                pixel[j].blue = in[j*3+2];
+            }
+        }
+        if ( !decoded ) {
+            dflError(WorkerDebayer::tr("Debayer(Worker): demosaicing failed"));
+            error = true;
+            continue;
+        }
+        dst_cache->sync();
+    });
+    return !error;
 }
 
-
 Photo WorkerDebayer::process(const Photo &photo, int /*p*/, int /*c*/)
 {
     u_int32_t filters = getFilterPattern(photo);
@@ -306,30 +368,16 @@ Photo WorkerDebayer::process(const Photo &photo, int /*p*/, int /*c*/)
     }
     if (use_dc) {
         newPhoto = photo;
+        Magick::Image src(photo.image());
         Magick::Image &image = newPhoto.image();
-        int w = image.columns();
-        int h = image.rows();
-        uint16_t *bayer = imageToBayer(image, filters);
-        uint16_t *rgb = newRGB(w,h);
-        dc1394error_t err;
-        err = dc1394_bayer_decoding_16bit(bayer, rgb, w, h, dc_filters, method, 16);
-        if ( err == DC1394_SUCCESS ) {
-            /*
-            if ( m_quality == OpDebayer::DownSample ) {
-                w/=2;
-                h/=2;
-            }
-            */
-            image = bufferToImage(rgb, w, h);
+        image = Magick::Image(Magick::Geometry(src.columns(), src.rows()), Magick::Color(0,0,0));
+        ResetImage(image);
+        if ( !demosaic(src, image, filters, dc_filters, method) ) {
+            setError(photo, tr("Debayer failed"));
+            return photo;
         }
-        deleteBuffer(rgb);
-        deleteBuffer(bayer);
     }
     newPhoto.removeTag(TAG_FILTER_PATTERN);
     return newPhoto;
 }
 
-bool WorkerDebayer::play_onInput(int idx)
-{
-    return play_onInputParallel(idx);
-}
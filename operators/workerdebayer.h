@@ -40,7 +40,6 @@ class WorkerDebayer : public OperatorWorker
 public:
     WorkerDebayer(OpDebayer::Debayer quality, QThread *thread, Operator *op);
     Photo process(const Photo &photo, int p, int c);
-    bool play_onInput(int idx);
 
 private:
     OpDebayer::Debayer m_quality;
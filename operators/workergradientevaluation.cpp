@@ -28,6 +28,9 @@
  *     * Guillaume Gimenez <guillaume@blackmilk.fr>
  *
  */
+#include <cmath>
+#include <vector>
+#include <algorithm>
 #include <QVector>
 #include <QPointF>
 #include "workergradientevaluation.h"
@@ -37,15 +40,306 @@
 WorkerGradientEvaluation::WorkerGradientEvaluation(qreal radius,
                                                    qreal altitude,
                                                    qreal pow_,
+                                                   OpGradientEvaluation::Method method,
+                                                   qreal tolerance,
+                                                   int degree,
                                                    QThread *thread,
                                                    Operator *op) :
     OperatorWorker(thread, op),
     m_radius(radius),
     m_altitude(altitude),
-    m_pow(pow_)
+    m_pow(pow_),
+    m_method(method),
+    m_tolerance(tolerance),
+    m_degree(degree)
 {
 }
 
+/* the coarsest grid tried, in pixels */
+#define GRADIENT_GRID_STEP 64
+
+static inline void store(Magick::PixelPacket &pixel, const Triplet<qreal>& color, bool hdr)
+{
+    if (hdr) {
+        pixel.red = clamp<quantum_t>(toHDR(color.red));
+        pixel.green = clamp<quantum_t>(toHDR(color.green));
+        pixel.blue = clamp<quantum_t>(toHDR(color.blue));
+    }
+    else {
+        pixel.red = clamp<quantum_t>(color.red);
+        pixel.green = clamp<quantum_t>(color.green);
+        pixel.blue = clamp<quantum_t>(color.blue);
+    }
+}
+
+static inline void catmullRom(qreal t, qreal k[4])
+{
+    qreal t2 = t*t;
+    qreal t3 = t2*t;
+    k[0] = (-t3 + 2*t2 - t)/2;
+    k[1] = (3*t3 - 5*t2 + 2)/2;
+    k[2] = (-3*t3 + 4*t2 + t)/2;
+    k[3] = (t3 - t2)/2;
+}
+
+/*
+ * the background evaluated on the nodes of a regular grid, the nodes
+ * surround the image by one step so that the bicubic interpolation
+ * always finds its 4x4 neighbourhood
+ */
+class GradientGrid {
+public:
+    GradientGrid(int w, int h, int step) :
+        step(step),
+        nx((w-1)/step+4),
+        ny((h-1)/step+4),
+        nodes(nx*ny)
+    {}
+    qreal x(int i) const { return (i-1)*step; }
+    qreal y(int j) const { return (j-1)*step; }
+    /*
+     * interpolation along x of the 4 node rows around y, the last pixel
+     * reads nodes up to (w-1)/step+3, hence the grid size
+     */
+    Triplet<qreal> at(qreal px, qreal py) const {
+        int i = int(px/step);
+        int j = int(py/step);
+        qreal kx[4], ky[4];
+        catmullRom(px/step-i, kx);
+        catmullRom(py/step-j, ky);
+        Triplet<qreal> color;
+        for ( int jj = 0 ; jj < 4 ; ++jj ) {
+            for ( int ii = 0 ; ii < 4 ; ++ii ) {
+                const Triplet<qreal>& node = nodes[(j+jj)*nx+i+ii];
+                qreal k = kx[ii]*ky[jj];
+                color.red += k*node.red;
+                color.green += k*node.green;
+                color.blue += k*node.blue;
+            }
+        }
+        return color;
+    }
+    int step;
+    int nx;
+    int ny;
+    std::vector<Triplet<qreal> > nodes;
+};
+
+Triplet<qreal> WorkerGradientEvaluation::evaluate(qreal x, qreal y,
+                                                  const QVector<QPointF>& points,
+                                                  const QVector<Triplet<qreal> >& colors) const
+{
+    Triplet<qreal> color;
+    qreal coef = 0;
+    qreal altitude = m_altitude*m_altitude;
+    int n_points = points.count();
+    for ( int i = 0 ; i < n_points ; ++i ) {
+        qreal px = points[i].x();
+        qreal py = points[i].y();
+        if ( x == px && y == py )
+            return colors[i];
+        qreal dx = px-x;
+        qreal dy = py-y;
+        qreal dist = pow(dx*dx+dy*dy+altitude, m_pow);
+        color.red +=  colors[i].red/dist;
+        color.green += colors[i].green/dist;
+        color.blue += colors[i].blue/dist;
+        coef+=1./dist;
+    }
+    color.red/=coef;
+    color.green/=coef;
+    color.blue/=coef;
+    return color;
+}
+
+void WorkerGradientEvaluation::evaluateExact(Magick::PixelPacket *pxl, bool hdr, int w, int h,
+                                             const QVector<QPointF>& points,
+                                             const QVector<Triplet<qreal> >& colors,
+                                             int p, int c)
+{
+    dfl_block int line=0;
+    dfl_parallel_for(y, 0, h, 4, (), {
+        for ( int x = 0 ; x < w ; ++x )
+            store(pxl[y*w+x], evaluate(x, y, points, colors), hdr);
+        dfl_critical_section(
+        {
+            emitProgress(p, c, line++, h);
+        });
+    });
+}
+
+/*
+ * the exact background is evaluated on a coarse grid and interpolated
+ * with Catmull-Rom splines. the error is checked at the center of every
+ * cell and at every sample against the exact evaluation, the step is
+ * halved until it falls below the tolerance
+ */
+void WorkerGradientEvaluation::evaluateGrid(Magick::PixelPacket *pxl, bool hdr, int w, int h,
+                                            const QVector<QPointF>& points,
+                                            const QVector<Triplet<qreal> >& colors,
+                                            int p, int c)
+{
+    qreal tolerance = m_tolerance*QuantumRange;
+    std::shared_ptr<GradientGrid> grid;
+    for ( int step = GRADIENT_GRID_STEP ; step > 1 ; step/=2 ) {
+        if ( aborted() )
+            return;
+        grid.reset(new GradientGrid(w, h, step));
+        GradientGrid *g = grid.get();
+        dfl_parallel_for(j, 0, g->ny, 1, (), {
+            for ( int i = 0 ; i < g->nx ; ++i )
+                g->nodes[j*g->nx+i] = evaluate(g->x(i), g->y(j), points, colors);
+        });
+        dfl_block qreal error = 0;
+        int cw = (w-1)/step;
+        int ch = (h-1)/step;
+        dfl_parallel_for(j, 0, ch, 1, (), {
+            qreal rowError = 0;
+            for ( int i = 0 ; i < cw ; ++i ) {
+                qreal x = (i+.5)*step;
+                qreal y = (j+.5)*step;
+                Triplet<qreal> exact = evaluate(x, y, points, colors);
+                Triplet<qreal> approx = g->at(x, y);
+                rowError = qMax(rowError, qAbs(exact.red-approx.red));
+                rowError = qMax(rowError, qAbs(exact.green-approx.green));
+                rowError = qMax(rowError, qAbs(exact.blue-approx.blue));
+            }
+            dfl_critical_section(
+            {
+                if ( rowError > error )
+                    error = rowError;
+            });
+        });
+        /* the cusps of the weighting are on the samples, the grid
+         * misses them the most there */
+        int n_points = points.count();
+        dfl_parallel_for(k, 0, n_points, 16, (), {
+            int x = qBound(0, int(DF_ROUND(points[k].x())), w-1);
+            int y = qBound(0, int(DF_ROUND(points[k].y())), h-1);
+            Triplet<qreal> exact = evaluate(x, y, points, colors);
+            Triplet<qreal> approx = g->at(x, y);
+            qreal pointError = qMax(qAbs(exact.red-approx.red),
+                                    qMax(qAbs(exact.green-approx.green),
+                                         qAbs(exact.blue-approx.blue)));
+            dfl_critical_section(
+            {
+                if ( pointError > error )
+                    error = pointError;
+            });
+        });
+        if ( error <= tolerance ) {
+            dflInfo(tr("Gradient Evaluation: grid step %0, max error %1").arg(step).arg(error/QuantumRange));
+            break;
+        }
+        grid.reset();
+    }
+    if ( !grid ) {
+        dflInfo(tr("Gradient Evaluation: tolerance not reached on a grid, exact evaluation"));
+        return evaluateExact(pxl, hdr, w, h, points, colors, p, c);
+    }
+    GradientGrid *g = grid.get();
+    dfl_block int line=0;
+    dfl_parallel_for(y, 0, h, 4, (), {
+        for ( int x = 0 ; x < w ; ++x )
+            store(pxl[y*w+x], g->at(x, y), hdr);
+        dfl_critical_section(
+        {
+            emitProgress(p, c, line++, h);
+        });
+    });
+}
+
+/*
+ * least squares fit of a polynomial of m_degree in x and y on the
+ * samples, through the normal equations. coordinates are normalized to
+ * [-1,1] to keep them well conditioned
+ */
+bool WorkerGradientEvaluation::fitPolynomial(Magick::PixelPacket *pxl, bool hdr, int w, int h,
+                                             const QVector<QPointF>& points,
+                                             const QVector<Triplet<qreal> >& colors)
+{
+    int degree = m_degree;
+    int n_terms = (degree+1)*(degree+2)/2;
+    int n_points = points.count();
+    if ( n_points < n_terms ) {
+        dflError(tr("Gradient Evaluation: %0 points are needed for a polynomial of degree %1").arg(n_terms).arg(degree));
+        return false;
+    }
+    qreal cx = w/2., cy = h/2.;
+    std::vector<qreal> m(n_terms*(n_terms+3), 0);
+    std::vector<qreal> term(n_terms);
+    for ( int k = 0 ; k < n_points ; ++k ) {
+        qreal u = (points[k].x()-cx)/cx;
+        qreal v = (points[k].y()-cy)/cy;
+        int t = 0;
+        for ( int d = 0 ; d <= degree ; ++d )
+            for ( int j = 0 ; j <= d ; ++j )
+                term[t++] = pow(u, d-j)*pow(v, j);
+        for ( int r = 0 ; r < n_terms ; ++r ) {
+            qreal *row = &m[r*(n_terms+3)];
+            for ( int col = 0 ; col < n_terms ; ++col )
+                row[col] += term[r]*term[col];
+            row[n_terms+0] += term[r]*colors[k].red;
+            row[n_terms+1] += term[r]*colors[k].green;
+            row[n_terms+2] += term[r]*colors[k].blue;
+        }
+    }
+    /* Gauss-Jordan with partial pivoting, the 3 channels at once */
+    int stride = n_terms+3;
+    for ( int col = 0 ; col < n_terms ; ++col ) {
+        int pivot = col;
+        for ( int r = col+1 ; r < n_terms ; ++r )
+            if ( qAbs(m[r*stride+col]) > qAbs(m[pivot*stride+col]) )
+                pivot = r;
+        if ( qAbs(m[pivot*stride+col]) < 1e-12 ) {
+            dflError(tr("Gradient Evaluation: points are degenerated for a polynomial of degree %0").arg(degree));
+            return false;
+        }
+        if ( pivot != col )
+            for ( int k = 0 ; k < stride ; ++k )
+                std::swap(m[pivot*stride+k], m[col*stride+k]);
+        for ( int r = 0 ; r < n_terms ; ++r ) {
+            if ( r == col )
+                continue;
+            qreal f = m[r*stride+col]/m[col*stride+col];
+            for ( int k = col ; k < stride ; ++k )
+                m[r*stride+k] -= f*m[col*stride+k];
+        }
+    }
+    std::shared_ptr<std::vector<Triplet<qreal> > > coefs(new std::vector<Triplet<qreal> >(n_terms));
+    for ( int r = 0 ; r < n_terms ; ++r ) {
+        qreal diag = m[r*stride+r];
+        (*coefs)[r] = Triplet<qreal>(m[r*stride+n_terms]/diag,
+                                     m[r*stride+n_terms+1]/diag,
+                                     m[r*stride+n_terms+2]/diag);
+    }
+    dfl_parallel_for(y, 0, h, 4, (), {
+        std::vector<qreal> pu(degree+1), pv(degree+1);
+        qreal v = (y-cy)/cy;
+        pv[0] = 1;
+        for ( int d = 1 ; d <= degree ; ++d )
+            pv[d] = pv[d-1]*v;
+        for ( int x = 0 ; x < w ; ++x ) {
+            qreal u = (x-cx)/cx;
+            pu[0] = 1;
+            for ( int d = 1 ; d <= degree ; ++d )
+                pu[d] = pu[d-1]*u;
+            Triplet<qreal> color;
+            int t = 0;
+            for ( int d = 0 ; d <= degree ; ++d ) {
+                for ( int j = 0 ; j <= d ; ++j ) {
+                    qreal k = pu[d-j]*pv[j];
+                    const Triplet<qreal>& coef = (*coefs)[t++];
+                    color.red += k*coef.red;
+                    color.green += k*coef.green;
+                    color.blue += k*coef.blue;
+                }
+            }
+            store(pxl[y*w+x], color, hdr);
+        }
+    });
+    return true;
+}
 
 Photo WorkerGradientEvaluation::process(const Photo &srcPhoto, int p, int c)
 {
@@ -107,45 +401,20 @@ Photo WorkerGradientEvaluation::process(const Photo &srcPhoto, int p, int c)
     Ordinary::Pixels out_cache(out);
     Magick::PixelPacket *pxl = out_cache.get(0, 0, w, h);
 
-    dfl_block int line=0;
-    qreal altitude = m_altitude*m_altitude;
-    dfl_parallel_for(y, 0, h, 4, (), {
-        for ( int x = 0 ; x < w ; ++x ) {
-            Triplet<qreal> color;
-            qreal coef = 0;
-            for ( int i = 0 ; i < n_points ; ++i ) {
-                qreal px = points[i].x();
-                qreal py = points[i].y();
-                if ( x == px && y == py ) {
-                    color = (*colors)[i];
-                    coef = 1;
-                    break;
-                }
-                qreal dx = px-x;
-                qreal dy = py-y;
-                qreal dist = pow(dx*dx+dy*dy+altitude, m_pow);
-                color.red +=  double((*colors)[i].red)/dist;
-                color.green += double((*colors)[i].green)/dist;
-                color.blue += double((*colors)[i].blue)/dist;
-                coef+=1./dist;
-            }
-            if (hdr) {
-                pxl[y*w+x].red = clamp<quantum_t>(toHDR(color.red/coef));
-                pxl[y*w+x].green = clamp<quantum_t>(toHDR(color.green/coef));
-                pxl[y*w+x].blue = clamp<quantum_t>(toHDR(color.blue/coef));
-            }
-            else {
-                pxl[y*w+x].red = clamp<quantum_t>(color.red/coef);
-                pxl[y*w+x].green = clamp<quantum_t>(color.green/coef);
-                pxl[y*w+x].blue = clamp<quantum_t>(color.blue/coef);
-            }
-
+    switch(m_method) {
+    case OpGradientEvaluation::Exact:
+        evaluateExact(pxl, hdr, w, h, points, *colors, p, c);
+        break;
+    case OpGradientEvaluation::Grid:
+        evaluateGrid(pxl, hdr, w, h, points, *colors, p, c);
+        break;
+    case OpGradientEvaluation::Polynomial:
+        if ( !fitPolynomial(pxl, hdr, w, h, points, *colors) ) {
+            setError(srcPhoto, tr("Polynomial fit failed"));
+            return srcPhoto;
         }
-        dfl_critical_section(
-        {
-            emitProgress(p, c, line++, h);
-        });
-    });
+        break;
+    }
     out_cache.sync();
 
     outPhoto.setPoints(QVector<QPointF>());
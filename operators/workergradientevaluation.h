@@ -31,19 +31,42 @@
 #ifndef WORKERGRADIENTEVALUATION_H
 #define WORKERGRADIENTEVALUATION_H
 
+#include <QVector>
+#include <QPointF>
 #include "operatorworker.h"
+#include "opgradientevaluation.h"
 
 class WorkerGradientEvaluation : public OperatorWorker
 {
     Q_OBJECT
 public:
-    WorkerGradientEvaluation(qreal radius, qreal altitude, qreal pow_, QThread *thread, Operator *op);
+    WorkerGradientEvaluation(qreal radius, qreal altitude, qreal pow_,
+                             OpGradientEvaluation::Method method,
+                             qreal tolerance, int degree,
+                             QThread *thread, Operator *op);
     Photo process(const Photo &photo, int p, int c);
 
 private:
+    Triplet<qreal> evaluate(qreal x, qreal y,
+                            const QVector<QPointF>& points,
+                            const QVector<Triplet<qreal> >& colors) const;
+    void evaluateExact(Magick::PixelPacket *pixels, bool hdr, int w, int h,
+                       const QVector<QPointF>& points,
+                       const QVector<Triplet<qreal> >& colors,
+                       int p, int c);
+    void evaluateGrid(Magick::PixelPacket *pixels, bool hdr, int w, int h,
+                      const QVector<QPointF>& points,
+                      const QVector<Triplet<qreal> >& colors,
+                      int p, int c);
+    bool fitPolynomial(Magick::PixelPacket *pixels, bool hdr, int w, int h,
+                       const QVector<QPointF>& points,
+                       const QVector<Triplet<qreal> >& colors);
     qreal m_radius;
     qreal m_altitude;
     qreal m_pow;
+    OpGradientEvaluation::Method m_method;
+    qreal m_tolerance;
+    int m_degree;
 };
 
 #endif // WORKERGRADIENTEVALUATION_H
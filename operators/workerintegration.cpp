@@ -36,8 +36,10 @@
 #include "hdr.h"
 #include "transformview.h"
 #include "cielab.h"
+#include "pixelstack.h"
 #include <Magick++.h>
 #include <cmath>
+#include <limits>
 
 #include <QVector>
 #include <QPointF>
@@ -45,6 +47,17 @@
 
 using Magick::Quantum;
 
+/* memory kept for frames resampled once and reused by the next phases */
+#define DF_INTEGRATION_CACHE_BUDGET (qint64(1024)<<20)
+/* output rows owned by a drizzle task */
+#define DF_DRIZZLE_BAND 32
+/* output rows transposed and combined by a stack task */
+#define DF_STACK_BAND 16
+/* frames folded in before the running statistics are trusted to reject */
+#define DF_FOLD_MIN_FRAMES 3
+
+#define SUBPXL(plane, x,y,c) plane[(y)*m_w*3+(x)*3+(c)]
+
 WorkerIntegration::WorkerIntegration(OpIntegration::RejectionType rejectionType,
                                      qreal upper,
                                      qreal lower,
@@ -52,6 +65,11 @@ WorkerIntegration::WorkerIntegration(OpIntegration::RejectionType rejectionType,
                                      qreal customNormalizationValue,
                                      bool outputHDR,
                                      qreal scale,
+                                     int interpolation,
+                                     bool drizzle,
+                                     qreal pixfrac,
+                                     std::shared_ptr<IntegrationState> state,
+                                     bool fold,
                                      QThread *thread,
                                      OpIntegration *op) :
     OperatorWorker(thread, op),
@@ -71,19 +89,34 @@ WorkerIntegration::WorkerIntegration(OpIntegration::RejectionType rejectionType,
     m_h(0),
     m_offX(0),
     m_offY(0),
-    m_scale(scale)
+    m_scale(scale),
+    m_interpolation(interpolation),
+    m_drizzle(drizzle),
+    m_pixfrac(pixfrac),
+    m_weightPlane(0),
+    m_resampled(),
+    m_resampledBytes(0),
+    m_state(state),
+    m_fold(fold),
+    m_runningCount(0),
+    m_runningMean(0),
+    m_runningM2(0)
 {
     dflWarning(tr("H: %0, L: %1").arg(m_upper).arg(m_lower));
 }
 
 WorkerIntegration::~WorkerIntegration()
 {
-    delete[] m_integrationPlane;
-    delete[] m_countPlane;
+    /* the state owns the planes in live mode */
+    if ( !m_state ) {
+        delete[] m_integrationPlane;
+        delete[] m_countPlane;
+    }
     delete[] m_minPlane;
     delete[] m_maxPlane;
     delete[] m_averagePlane;
     delete[] m_stdDevPlane;
+    delete[] m_weightPlane;
 }
 
 QRectF WorkerIntegration::computePlanesDimensions()
@@ -127,6 +160,8 @@ bool WorkerIntegration::play_onInput(int idx)
     int photoCount = 0;
     int photoN;
     Q_ASSERT( m_inputs.count() == 1 );
+    if ( m_fold )
+        return fold();
     photoCount=m_inputs[0].count();
 
     QVector<QPointF> reference;
@@ -159,6 +194,15 @@ bool WorkerIntegration::play_onInput(int idx)
         skip[PhaseMinMax] = true;
         --nPhases;
         break;
+    case OpIntegration::Median:
+    case OpIntegration::WinsorizedSigmaClipping:
+    case OpIntegration::LinearFitClipping:
+    case OpIntegration::PercentileClipping:
+        /* per pixel stacks, see integrateStacks() */
+        for (int phase = PhaseMinMax ; phase < LastPhase ; ++phase)
+            skip[phase] = true;
+        nPhases = 0;
+        break;
     default:
         dflError(tr("Unknown rejection algorithm"));
     case OpIntegration::NoRejection:
@@ -171,14 +215,20 @@ bool WorkerIntegration::play_onInput(int idx)
         --nPhases;
         break;
     }
+    /* phases reading resampled frames, drizzle drops the source pixels */
+    int resamplingPhases = m_drizzle ? nPhases - 1 : nPhases;
     int phaseN=0;
     dfl_block long totalPixels=0;
     dfl_block long rejected=0;
+    static const char *phaseNames[LastPhase] = { "min/max", "mean", "std dev", "integration" };
     for (int phase = PhaseMinMax ; phase < LastPhase ; ++phase) {
         photoN = 0;
         if (skip[phase])
             continue;
+        profileBegin(phaseNames[phase]);
+        int frameIdx = -1;
         foreach(Photo photo, m_inputs[0]) {
+            ++frameIdx;
             if ( aborted() ) {
                 emitFailure();
                 return false;
@@ -197,50 +247,63 @@ bool WorkerIntegration::play_onInput(int idx)
                 bool hdr = photo.getScale() == Photo::HDR;
                 bool hdrExposureAltered = false;
                 bool hdrAutomatic = false;
-                QString hdrCompStr = photo.getTag(TAG_HDR_COMP);
-                QString hdrHighStr = photo.getTag(TAG_HDR_HIGH);
-                QString hdrLowStr = photo.getTag(TAG_HDR_LOW);
-                QString hdrAutomaticStr = photo.getTag(TAG_HDR_AUTO);
+                Photo::HDRExposure hdrExposure;
                 qreal hdrComp = 1,
                         hdrHigh = QuantumRange,
                         hdrLow = 0;
-                if ( !hdrCompStr.isEmpty() &&
-                     !hdrHighStr.isEmpty() &&
-                     !hdrLowStr.isEmpty() &&
-                     !hdrAutomaticStr.isEmpty()) {
+                if ( photo.getHDRExposure(&hdrExposure) ) {
                     hdrExposureAltered = true;
-                    hdrComp = hdrCompStr.toDouble();
-                    hdrHigh = hdrHighStr.toDouble() * QuantumRange;
-                    hdrLow = hdrLowStr.toDouble() * QuantumRange;
-                    hdrAutomatic = !!hdrAutomaticStr.toInt();
-                }
-                std::shared_ptr<TransformView> view(new TransformView(photo, m_scale, reference));
-                if (view->inError()) {
-                    dflError(tr("view in error"));
-                    continue;
-                }
-                if (!view->loadPixels()) {
-                    dflError(tr("unable to load pixels"));
-                    continue;
+                    hdrComp = hdrExposure.compensation;
+                    hdrHigh = hdrExposure.high * QuantumRange;
+                    hdrLow = hdrExposure.low * QuantumRange;
+                    hdrAutomatic = hdrExposure.automatic;
                 }
+                /* the integration phase of drizzle drops the source pixels,
+                 * the statistics phases still work on resampled frames */
+                bool drizzling = m_drizzle && phase == PhaseIntegration;
+                std::shared_ptr<std::vector<float> > frame;
+                if ( !drizzling )
+                    frame = m_resampled.value(frameIdx);
+                std::shared_ptr<TransformView> view;
+                if ( !frame ) {
+                    view.reset(new TransformView(photo, m_scale, reference));
+                    if (view->inError()) {
+                        dflError(tr("view in error"));
+                        continue;
+                    }
+                    if (!view->loadPixels()) {
+                        dflError(tr("unable to load pixels"));
+                        continue;
+                    }
 #ifdef TRANSFORM_POINTS
-                {
-                    qreal x, y;
-                    view->map(0,0, &x, &y);
-                    dflInfo("=> corner 1 in destination: %f, %f",x ,y);
-                    view->map(m_w,0, &x, &y);
-                    dflInfo("=> corner 2 in destination: %f, %f",x ,y);
-                    view->map(m_w,m_h, &x, &y);
-                    dflInfo("=> corner 3 in destination: %f, %f",x ,y);
-                    view->map(0,m_h, &x, &y);
-                    dflInfo("=> corner 4 in destination: %f, %f",x ,y);
-                    for (int i = 0, s = points.count() ; i < s ; ++i) {
+                    {
                         qreal x, y;
-                        view->invMap(points[i].x(), points[i].y(), &x, &y);
-                        transformed.push_back(QPointF(x, y));
+                        view->map(0,0, &x, &y);
+                        dflInfo("=> corner 1 in destination: %f, %f",x ,y);
+                        view->map(m_w,0, &x, &y);
+                        dflInfo("=> corner 2 in destination: %f, %f",x ,y);
+                        view->map(m_w,m_h, &x, &y);
+                        dflInfo("=> corner 3 in destination: %f, %f",x ,y);
+                        view->map(0,m_h, &x, &y);
+                        dflInfo("=> corner 4 in destination: %f, %f",x ,y);
+                        for (int i = 0, s = points.count() ; i < s ; ++i) {
+                            qreal x, y;
+                            view->invMap(points[i].x(), points[i].y(), &x, &y);
+                            transformed.push_back(QPointF(x, y));
+                        }
                     }
-                }
 #endif
+                    if ( !drizzling ) {
+                        view->setInterpolation(TransformView::Interpolation(m_interpolation));
+                        frame = view->resample(m_w, m_h);
+                        qint64 bytes = qint64(frame->size())*sizeof(float);
+                        if ( resamplingPhases > 1 &&
+                             m_resampledBytes + bytes <= DF_INTEGRATION_CACHE_BUDGET ) {
+                            m_resampled[frameIdx] = frame;
+                            m_resampledBytes += bytes;
+                        }
+                    }
+                }
 
                 Photo *rejPhoto = NULL;
                 Ordinary::Pixels *rejCache = NULL;
@@ -250,127 +313,110 @@ bool WorkerIntegration::play_onInput(int idx)
                     rejPhoto = new Photo(photo);
                     ResetImage(rejPhoto->image());
                     rejCache = new Ordinary::Pixels(rejPhoto->image());
-                    rejPixels = rejCache->get(0, 0, m_w, m_h);
+                    /* drizzle reports rejections at source pixels */
+                    if ( drizzling )
+                        rejPixels = rejCache->get(0, 0, view->width(), view->height());
+                    else
+                        rejPixels = rejCache->get(0, 0, m_w, m_h);
                 }
-#define SUBPXL(plane, x,y,c) plane[(y)*m_w*3+(x)*3+(c)]
-                dfl_parallel_for(y, 0, m_h, 4, (), {
-                    for ( int x = 0 ; x < m_w ; ++x ) {
-                        bool defined;
-                        Magick::PixelPacket pixel = view->getPixel(x,y,&defined);
-                        if (!defined)
-                            continue;
-                        integration_plane_t red, green, blue;
-                        if ( hdr ) {
-                            red = fromHDR(pixel.red);
-                            green = fromHDR(pixel.green);
-                            blue = fromHDR(pixel.blue);
-                        }
-                        else {
-                            red = pixel.red;
-                            green = pixel.green;
-                            blue = pixel.blue;
-                        }
-                        if ( hdrExposureAltered ) {
-                            qreal lum = LUMINANCE(red, green, blue);
-                            if ( hdrAutomatic || (lum >= hdrLow && lum <= hdrHigh) ) {
-                                red/=hdrComp;
-                                green/=hdrComp;
-                                blue/=hdrComp;
-                            }
-                            else {
-                                 continue;
-                            }
-                         }
-                         switch (phase) {
-                             case PhaseIntegration: {
-                                 double rgb[3] = { red, green, blue };
-                                 for (int i = 0 ; i < 3 ; ++i) {
-                                     bool reject = true;
-                                     switch(m_rejectionType) {
-                                         default:
-                                         case OpIntegration::NoRejection:
-                                         reject  = false;
-                                         break;
-                                         case OpIntegration::MinMax:
-                                         if ( rgb[i] > SUBPXL(m_minPlane,x,y,i) &&
-                                              rgb[i] < SUBPXL(m_maxPlane,x,y,i) )
-                                             reject = false;
-                                         break;
-                                         case OpIntegration::AverageDeviation:
-                                         if ( rgb[i] >= SUBPXL(m_averagePlane,x,y,i)/m_lower &&
-                                              rgb[i] <= SUBPXL(m_averagePlane,x,y,i)*m_upper)
-                                             reject = false;
-                                         break;
-                                         case OpIntegration::SigmaClipping:
-                                         if ( rgb[i] >= SUBPXL(m_averagePlane,x,y,i)-SUBPXL(m_stdDevPlane,x,y,i)*m_lower &&
-                                              rgb[i] <= SUBPXL(m_averagePlane,x,y,i)+SUBPXL(m_stdDevPlane,x,y,i)*m_upper)
-                                             reject = false;
-                                         break;
-                                     }
-                                     atomic_incr(&totalPixels);
-                                     if (!reject) {
-                                         SUBPXL(m_integrationPlane,x,y,i) += rgb[i];
-                                         ++SUBPXL(m_countPlane,x,y,i);
-                                         if (rejPixels) {
-                                             switch(i) {
-                                                 case 0:
-                                                 rejPixels[y*m_w+x].red = 0; break;
-                                                 case 1:
-                                                 rejPixels[y*m_w+x].green = 0; break;
-                                                 case 2:
-                                                 rejPixels[y*m_w+x].blue = 0; break;
+                if ( drizzling ) {
+                    HDRExposure exposure = { hdrExposureAltered, hdrAutomatic, hdrComp, hdrHigh, hdrLow };
+                    drizzle(*view, exposure, rejPixels, &totalPixels, &rejected);
+                    emitProgress(phaseN*photoCount+photoN, photoCount*nPhases, 1, 1);
+                }
+                else {
+                    const float *resampled = &(*frame)[0];
+                    dfl_parallel_for(y, 0, m_h, 4, (), {
+                        for ( int x = 0 ; x < m_w ; ++x ) {
+                            const float *rgbp = resampled + (size_t(y)*m_w+x)*3;
+                            if ( rgbp[0] == TRANSFORMVIEW_UNDEFINED )
+                                continue;
+                            integration_plane_t red = rgbp[0],
+                                    green = rgbp[1],
+                                    blue = rgbp[2];
+                            if ( hdrExposureAltered ) {
+                                qreal lum = LUMINANCE(red, green, blue);
+                                if ( hdrAutomatic || (lum >= hdrLow && lum <= hdrHigh) ) {
+                                    red/=hdrComp;
+                                    green/=hdrComp;
+                                    blue/=hdrComp;
+                                }
+                                else {
+                                     continue;
+                                }
+                             }
+                             switch (phase) {
+                                 case PhaseIntegration: {
+                                     double rgb[3] = { red, green, blue };
+                                     for (int i = 0 ; i < 3 ; ++i) {
+                                         bool reject = isRejected(rgb[i], x, y, i);
+                                         atomic_incr(&totalPixels);
+                                         if (m_runningCount)
+                                             addRunning(rgb[i], x, y, i);
+                                         if (!reject) {
+                                             SUBPXL(m_integrationPlane,x,y,i) += rgb[i];
+                                             ++SUBPXL(m_countPlane,x,y,i);
+                                             if (rejPixels) {
+                                                 switch(i) {
+                                                     case 0:
+                                                     rejPixels[y*m_w+x].red = 0; break;
+                                                     case 1:
+                                                     rejPixels[y*m_w+x].green = 0; break;
+                                                     case 2:
+                                                     rejPixels[y*m_w+x].blue = 0; break;
+                                                 }
                                              }
                                          }
-                                     }
-                                     else {
-                                        atomic_incr(&rejected);
-                                        if (rejPixels) {
-                                            switch(i) {
-                                                case 0:
-                                                rejPixels[y*m_w+x].red = pixel.red; break;
-                                                case 1:
-                                                rejPixels[y*m_w+x].green = pixel.green; break;
-                                                case 2:
-                                                rejPixels[y*m_w+x].blue = pixel.blue; break;
+                                         else {
+                                            atomic_incr(&rejected);
+                                            if (rejPixels) {
+                                                switch(i) {
+                                                    case 0:
+                                                    rejPixels[y*m_w+x].red = hdr ? toHDR(rgb[0]) : clamp<quantum_t>(DF_ROUND(rgb[0]), 0, QuantumRange); break;
+                                                    case 1:
+                                                    rejPixels[y*m_w+x].green = hdr ? toHDR(rgb[1]) : clamp<quantum_t>(DF_ROUND(rgb[1]), 0, QuantumRange); break;
+                                                    case 2:
+                                                    rejPixels[y*m_w+x].blue = hdr ? toHDR(rgb[2]) : clamp<quantum_t>(DF_ROUND(rgb[2]), 0, QuantumRange); break;
+                                                }
                                             }
-                                        }
+                                         }
                                      }
+                                     break;
                                  }
+                                 case PhaseMinMax:
+                                 SUBPXL(m_minPlane,x,y,0) = qMin(SUBPXL(m_minPlane,x,y,0), red);
+                                 SUBPXL(m_minPlane,x,y,1) = qMin(SUBPXL(m_minPlane,x,y,1), green);
+                                 SUBPXL(m_minPlane,x,y,2) = qMin(SUBPXL(m_minPlane,x,y,2), blue);
+                                 SUBPXL(m_maxPlane,x,y,0) = qMax(SUBPXL(m_maxPlane,x,y,0), red);
+                                 SUBPXL(m_maxPlane,x,y,1) = qMax(SUBPXL(m_maxPlane,x,y,1), green);
+                                 SUBPXL(m_maxPlane,x,y,2) = qMax(SUBPXL(m_maxPlane,x,y,2), blue);
+                                 break;
+                                 case PhaseMean:
+                                 SUBPXL(m_averagePlane,x,y,0) += red;
+                                 SUBPXL(m_averagePlane,x,y,1) += green;
+                                 SUBPXL(m_averagePlane,x,y,2) += blue;
+                                 ++SUBPXL(m_countPlane,x,y,0);
+                                 ++SUBPXL(m_countPlane,x,y,1);
+                                 ++SUBPXL(m_countPlane,x,y,2);
+                                 break;
+                                 case PhaseStdDev:
+                                 SUBPXL(m_stdDevPlane,x,y,0) += pow(red-SUBPXL(m_averagePlane,x,y,0), 2);
+                                 SUBPXL(m_stdDevPlane,x,y,1) += pow(green-SUBPXL(m_averagePlane,x,y,1), 2);
+                                 SUBPXL(m_stdDevPlane,x,y,2) += pow(blue-SUBPXL(m_averagePlane,x,y,2), 2);
+                                 ++SUBPXL(m_countPlane,x,y,0);
+                                 ++SUBPXL(m_countPlane,x,y,1);
+                                 ++SUBPXL(m_countPlane,x,y,2);
                                  break;
                              }
-                             case PhaseMinMax:
-                             SUBPXL(m_minPlane,x,y,0) = qMin(SUBPXL(m_minPlane,x,y,0), red);
-                             SUBPXL(m_minPlane,x,y,1) = qMin(SUBPXL(m_minPlane,x,y,1), green);
-                             SUBPXL(m_minPlane,x,y,2) = qMin(SUBPXL(m_minPlane,x,y,2), blue);
-                             SUBPXL(m_maxPlane,x,y,0) = qMax(SUBPXL(m_maxPlane,x,y,0), red);
-                             SUBPXL(m_maxPlane,x,y,1) = qMax(SUBPXL(m_maxPlane,x,y,1), green);
-                             SUBPXL(m_maxPlane,x,y,2) = qMax(SUBPXL(m_maxPlane,x,y,2), blue);
-                             break;
-                             case PhaseMean:
-                             SUBPXL(m_averagePlane,x,y,0) += red;
-                             SUBPXL(m_averagePlane,x,y,1) += green;
-                             SUBPXL(m_averagePlane,x,y,2) += blue;
-                             ++SUBPXL(m_countPlane,x,y,0);
-                             ++SUBPXL(m_countPlane,x,y,1);
-                             ++SUBPXL(m_countPlane,x,y,2);
-                             break;
-                             case PhaseStdDev:
-                             SUBPXL(m_stdDevPlane,x,y,0) += pow(red-SUBPXL(m_averagePlane,x,y,0), 2);
-                             SUBPXL(m_stdDevPlane,x,y,1) += pow(green-SUBPXL(m_averagePlane,x,y,1), 2);
-                             SUBPXL(m_stdDevPlane,x,y,2) += pow(blue-SUBPXL(m_averagePlane,x,y,2), 2);
-                             ++SUBPXL(m_countPlane,x,y,0);
-                             ++SUBPXL(m_countPlane,x,y,1);
-                             ++SUBPXL(m_countPlane,x,y,2);
-                             break;
                          }
-                     }
-                    dfl_critical_section(
-                    {
-                        ++line;
-                        if ( 0 == line % 100 )
-                            emitProgress(phaseN*photoCount+photoN, photoCount*nPhases, line, m_h);
+                        dfl_critical_section(
+                        {
+                            ++line;
+                            if ( 0 == line % 100 )
+                                emitProgress(phaseN*photoCount+photoN, photoCount*nPhases, line, m_h);
+                        });
                     });
-                });
+                }
                 if (rejPhoto) {
                     rejCache->sync();
                     outputPush(1, *rejPhoto);
@@ -405,6 +451,39 @@ bool WorkerIntegration::play_onInput(int idx)
         }
         ++phaseN;
     }
+    if ( nPhases == 0 ) {
+        long total = 0, rej = 0;
+        if ( !integrateStacks(refPhoto, reference, &total, &rej) )
+            return false;
+        totalPixels = total;
+        rejected = rej;
+    }
+    if ( aborted() ) {
+        emitFailure();
+        return false;
+    }
+#ifdef TRANSFORM_POINTS
+    if ( !pushIntegration(totalPixels, rejected, transformed) )
+#else
+    if ( !pushIntegration(totalPixels, rejected, QVector<QPointF>()) )
+#endif
+        return false;
+    if ( m_state ) {
+        m_state->reference = reference;
+        m_state->valid = true;
+    }
+    emitSuccess();
+    return true;
+}
+
+/**
+ * @brief WorkerIntegration::pushIntegration
+ * normalizes the integration plane into the integrated image, points are
+ * only given to debug the transforms
+ */
+bool WorkerIntegration::pushIntegration(long totalPixels, long rejected,
+                                        const QVector<QPointF>& points)
+{
     try {
         Photo newPhoto(Photo::Linear);
         newPhoto.setIdentity(m_operator->uuid());
@@ -417,36 +496,30 @@ bool WorkerIntegration::play_onInput(int idx)
             Magick::PixelPacket *pixels = pixel_cache->get(0, y, m_w, 1);
             for ( int x = 0 ; x < m_w ; ++x ) {
                 Q_ASSERT( y*m_w*3+x*3+2 < m_w*m_h*3);
+                qreal rgb[3];
+                bool defined[3];
+                for (int c = 0 ; c < 3 ; ++c) {
+                    qreal n = m_weightPlane ? SUBPXL(m_weightPlane,x,y,c) : SUBPXL(m_countPlane,x,y,c);
+                    defined[c] = n > 0;
+                    rgb[c] = defined[c] ? mul*SUBPXL(m_integrationPlane,x,y,c)/n : 0;
+                }
                 if (m_outputHDR) {
-                    pixels[x].red = ( m_countPlane[y*m_w*3+x*3+0] )
-                        ? toHDR(mul*m_integrationPlane[y*m_w*3+x*3+0]/m_countPlane[y*m_w*3+x*3+0])
-                        : 0;
-                    pixels[x].green = ( m_countPlane[y*m_w*3+x*3+1] )
-                        ? toHDR(mul*m_integrationPlane[y*m_w*3+x*3+1]/m_countPlane[y*m_w*3+x*3+1])
-                        : 0;
-                    pixels[x].blue = ( m_countPlane[y*m_w*3+x*3+2] )
-                        ? toHDR(mul*m_integrationPlane[y*m_w*3+x*3+2]/m_countPlane[y*m_w*3+x*3+2])
-                        : 0;
+                    pixels[x].red = defined[0] ? toHDR(rgb[0]) : 0;
+                    pixels[x].green = defined[1] ? toHDR(rgb[1]) : 0;
+                    pixels[x].blue = defined[2] ? toHDR(rgb[2]) : 0;
                 }
                 else {
-                    pixels[x].red = ( m_countPlane[y*m_w*3+x*3+0] )
-                        ? clamp<quantum_t>(mul*m_integrationPlane[y*m_w*3+x*3+0]/m_countPlane[y*m_w*3+x*3+0], 0, QuantumRange)
-                        : 0;
-                    pixels[x].green = ( m_countPlane[y*m_w*3+x*3+1] )
-                        ? clamp<quantum_t>(mul*m_integrationPlane[y*m_w*3+x*3+1]/m_countPlane[y*m_w*3+x*3+1], 0, QuantumRange)
-                        : 0;
-                    pixels[x].blue = ( m_countPlane[y*m_w*3+x*3+2] )
-                        ? clamp<quantum_t>(mul*m_integrationPlane[y*m_w*3+x*3+2]/m_countPlane[y*m_w*3+x*3+2], 0, QuantumRange)
-                        : 0;
+                    pixels[x].red = clamp<quantum_t>(rgb[0], 0, QuantumRange);
+                    pixels[x].green = clamp<quantum_t>(rgb[1], 0, QuantumRange);
+                    pixels[x].blue = clamp<quantum_t>(rgb[2], 0, QuantumRange);
                 }
             }
             pixel_cache->sync();
         });
         if (m_outputHDR)
             newPhoto.setScale(Photo::HDR);
-#ifdef TRANSFORM_POINTS
-    newPhoto.setPoints(transformed);
-#endif
+        if ( points.count() )
+            newPhoto.setPoints(points);
         outputPush(0, newPhoto);
     }
     catch (std::exception &e) {
@@ -458,7 +531,6 @@ bool WorkerIntegration::play_onInput(int idx)
             .arg(totalPixels)
             .arg(rejected)
             .arg(100.*rejected/totalPixels));
-    emitSuccess();
     return true;
 }
 
@@ -466,8 +538,20 @@ void WorkerIntegration::createPlanes(Magick::Image &image)
 {
     m_w = image.columns() * m_scale;
     m_h = image.rows() * m_scale;
-    m_integrationPlane = new integration_plane_t[m_w*m_h*3]();
-    m_countPlane = new int[m_w*m_h*3]();
+    if ( m_state ) {
+        m_state->allocate(m_w, m_h);
+        m_integrationPlane = m_state->sum;
+        m_countPlane = m_state->count;
+        m_runningCount = m_state->runningCount;
+        m_runningMean = m_state->runningMean;
+        m_runningM2 = m_state->runningM2;
+    }
+    else {
+        m_integrationPlane = new integration_plane_t[m_w*m_h*3]();
+        m_countPlane = new int[m_w*m_h*3]();
+    }
+    if ( m_drizzle )
+        m_weightPlane = new integration_plane_t[m_w*m_h*3]();
     switch(m_rejectionType) {
     case OpIntegration::MinMax:
         m_minPlane = new integration_plane_t[m_w*m_h*3]();
@@ -493,3 +577,573 @@ void WorkerIntegration::createPlanes(Magick::Image &image)
     }
     dflDebug(tr("Plane dim: w:%0, h:%1, sz:%2").arg(m_w).arg(m_h).arg(m_w*m_h*3));
 }
+
+static WorkerIntegration::HDRExposure frameExposure(Photo& photo)
+{
+    WorkerIntegration::HDRExposure exposure = { false, false, 1, QuantumRange, 0 };
+    Photo::HDRExposure hdrExposure;
+    if ( photo.getHDRExposure(&hdrExposure) ) {
+        exposure.altered = true;
+        exposure.automatic = hdrExposure.automatic;
+        exposure.comp = hdrExposure.compensation;
+        exposure.high = hdrExposure.high * QuantumRange;
+        exposure.low = hdrExposure.low * QuantumRange;
+    }
+    return exposure;
+}
+
+struct WorkerIntegration::StackFrame {
+    Photo photo;
+    std::shared_ptr<TransformView> view;
+    HDRExposure exposure;
+    bool hdr;
+};
+
+/* the linear rgb of row y of a frame, undefined or out of exposure
+ * samples are NaN */
+static void stackRow(TransformView *view,
+                     const WorkerIntegration::HDRExposure& exposure,
+                     int y, int w, float *rgb)
+{
+    view->resampleRow(y, w, rgb);
+    for ( int x = 0 ; x < w ; ++x, rgb += 3 ) {
+        bool defined = rgb[0] != TRANSFORMVIEW_UNDEFINED;
+        if ( defined && exposure.altered ) {
+            qreal lum = LUMINANCE(rgb[0], rgb[1], rgb[2]);
+            defined = exposure.automatic ||
+                    (lum >= exposure.low && lum <= exposure.high);
+        }
+        for (int c = 0 ; c < 3 ; ++c)
+            rgb[c] = defined
+                    ? rgb[c]/exposure.comp
+                    : std::numeric_limits<float>::quiet_NaN();
+    }
+}
+
+/**
+ * @brief WorkerIntegration::integrateStacks
+ * Estimators needing all the samples of a pixel at once. Bands of output
+ * rows are resampled from every frame and transposed so that the samples
+ * of one channel of one pixel are contiguous, then combined. A band task
+ * maps, through views of its own, only the source rows its band reaches
+ * in each frame and holds one row of stacks, width*3*frames floats.
+ * Fills the integration and count planes like the integration phase
+ * does. The rejection bounds of every pixel are kept, the rejection maps
+ * are then built and pushed one frame at a time.
+ */
+bool WorkerIntegration::integrateStacks(Photo *refPhoto,
+                                        const QVector<QPointF> &reference,
+                                        long *totalPixels,
+                                        long *rejected)
+{
+    PixelStack::Estimator estimator;
+    switch (m_rejectionType) {
+    default:
+    case OpIntegration::Median:
+        estimator = PixelStack::Median; break;
+    case OpIntegration::WinsorizedSigmaClipping:
+        estimator = PixelStack::WinsorizedSigma; break;
+    case OpIntegration::LinearFitClipping:
+        estimator = PixelStack::LinearFit; break;
+    case OpIntegration::PercentileClipping:
+        estimator = PixelStack::Percentile; break;
+    }
+    if ( m_drizzle ) {
+        dflWarning(tr("Drizzle is not available with this rejection, frames are resampled"));
+        m_drizzle = false;
+    }
+    profileBegin("stacks");
+    try {
+        createPlanes(refPhoto->image());
+        bool rejectionMap = estimator != PixelStack::Median && outputEnabled(1);
+        std::vector<StackFrame> frames;
+        foreach(Photo photo, m_inputs[0]) {
+            if ( aborted() ) {
+                emitFailure();
+                return false;
+            }
+            if ( photo.getScale() == Photo::NonLinear ) {
+                dflWarning(tr("%0 is non-linear").arg(photo.getIdentity()));
+            }
+            StackFrame frame;
+            frame.photo = photo;
+            frame.view.reset(new TransformView(photo, m_scale, reference));
+            if ( frame.view->inError() ) {
+                dflError(tr("view in error"));
+                continue;
+            }
+            frame.view->setInterpolation(TransformView::Interpolation(m_interpolation));
+            frame.hdr = photo.getScale() == Photo::HDR;
+            frame.exposure = frameExposure(photo);
+            frames.push_back(frame);
+        }
+
+        int n = frames.size();
+        const StackFrame *framesp = n ? &frames[0] : NULL;
+        /* low and high bounds of each sample, only for the rejection maps */
+        std::vector<float> bounds(rejectionMap ? size_t(m_w)*m_h*3*2 : 0);
+        float *boundsp = rejectionMap ? &bounds[0] : NULL;
+        PixelStack stack(estimator, m_upper, m_lower);
+        int nBands = (m_h+DF_STACK_BAND-1)/DF_STACK_BAND;
+        dfl_block long total = 0;
+        dfl_block long rej = 0;
+        dfl_block int line = 0;
+        dfl_block bool error = false;
+        dfl_parallel_for(band, 0, nBands, 1, (), {
+            int y0 = band*DF_STACK_BAND;
+            int y1 = qMin(m_h, y0+DF_STACK_BAND);
+            std::vector<std::shared_ptr<TransformView> > views(n);
+            bool loaded = true;
+            for ( int k = 0 ; loaded && k < n ; ++k ) {
+                views[k].reset(new TransformView(*framesp[k].view));
+                loaded = views[k]->loadRows(m_w, y0, y1);
+            }
+            if ( !loaded ) {
+                dflError(tr("unable to load pixels"));
+                error = true;
+                continue;
+            }
+            std::vector<float> row(size_t(m_w)*3);
+            std::vector<float> stacks(size_t(m_w)*3*n);
+            std::vector<float> samples(n);
+            long bandTotal = 0, bandRejected = 0;
+            for ( int y = y0 ; y < y1 ; ++y ) {
+                for ( int k = 0 ; k < n ; ++k ) {
+                    stackRow(views[k].get(), framesp[k].exposure, y, m_w, &row[0]);
+                    for ( int x = 0 ; x < m_w ; ++x )
+                        for (int c = 0 ; c < 3 ; ++c)
+                            stacks[(size_t(x)*3+c)*n + k] = row[size_t(x)*3+c];
+                }
+                for ( int x = 0 ; x < m_w ; ++x ) {
+                    for (int c = 0 ; c < 3 ; ++c) {
+                        const float *stackp = &stacks[(size_t(x)*3+c)*n];
+                        float *boundp = boundsp ? &boundsp[((size_t(y)*m_w+x)*3+c)*2] : NULL;
+                        int count = 0;
+                        for ( int k = 0 ; k < n ; ++k )
+                            if ( !std::isnan(stackp[k]) )
+                                samples[count++] = stackp[k];
+                        if ( !count ) {
+                            /* nothing to reject */
+                            if ( boundp ) {
+                                boundp[0] = -std::numeric_limits<float>::infinity();
+                                boundp[1] = std::numeric_limits<float>::infinity();
+                            }
+                            continue;
+                        }
+                        float low, high;
+                        SUBPXL(m_integrationPlane,x,y,c) = stack.combine(&samples[0], count, &low, &high);
+                        SUBPXL(m_countPlane,x,y,c) = 1;
+                        bandTotal += count;
+                        for ( int k = 0 ; k < count ; ++k )
+                            if ( samples[k] < low || samples[k] > high )
+                                ++bandRejected;
+                        if ( boundp ) {
+                            boundp[0] = low;
+                            boundp[1] = high;
+                        }
+                    }
+                }
+            }
+            dfl_critical_section(
+            {
+                total += bandTotal;
+                rej += bandRejected;
+                line += y1-y0;
+                emitProgress(0, 1, line, m_h);
+            });
+        });
+        if ( error || aborted() ) {
+            emitFailure();
+            return false;
+        }
+        for ( int k = 0 ; rejectionMap && k < n ; ++k ) {
+            if ( !pushStackRejection(framesp[k], boundsp) )
+                return false;
+        }
+        *totalPixels = total;
+        *rejected = rej;
+    }
+    catch (std::exception &e) {
+        dflError("%s", e.what());
+        emitFailure();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief WorkerIntegration::pushStackRejection
+ * the rejection map of one frame, its samples resampled again and
+ * compared with the bounds kept by integrateStacks()
+ */
+bool WorkerIntegration::pushStackRejection(const StackFrame& frame, const float *bounds)
+{
+    Photo rejection(frame.photo);
+    rejection.createImage(m_w, m_h);
+    std::shared_ptr<Ordinary::Pixels> rejectionCache(new Ordinary::Pixels(rejection.image()));
+    int nBands = (m_h+DF_STACK_BAND-1)/DF_STACK_BAND;
+    dfl_block bool error = false;
+    dfl_parallel_for(band, 0, nBands, 1, (rejection.image()), {
+        int y0 = band*DF_STACK_BAND;
+        int y1 = qMin(m_h, y0+DF_STACK_BAND);
+        TransformView view(*frame.view);
+        Magick::PixelPacket *rejPixels = rejectionCache->get(0, y0, m_w, y1-y0);
+        if ( !view.loadRows(m_w, y0, y1) || !rejPixels ) {
+            dflError(DF_NULL_PIXELS);
+            error = true;
+            continue;
+        }
+        std::vector<float> row(size_t(m_w)*3);
+        for ( int y = y0 ; y < y1 ; ++y ) {
+            stackRow(&view, frame.exposure, y, m_w, &row[0]);
+            Magick::PixelPacket *pixel = rejPixels + size_t(y-y0)*m_w;
+            for ( int x = 0 ; x < m_w ; ++x ) {
+                quantum_t q[3];
+                for (int c = 0 ; c < 3 ; ++c) {
+                    float v = row[size_t(x)*3+c];
+                    const float *boundp = &bounds[((size_t(y)*m_w+x)*3+c)*2];
+                    bool reject = !std::isnan(v) && ( v < boundp[0] || v > boundp[1] );
+                    q[c] = reject
+                            ? (frame.hdr ? toHDR(v) : clamp<quantum_t>(DF_ROUND(v), 0, QuantumRange))
+                            : 0;
+                }
+                pixel[x].red = q[0];
+                pixel[x].green = q[1];
+                pixel[x].blue = q[2];
+            }
+        }
+        rejectionCache->sync();
+    });
+    if ( error || aborted() ) {
+        emitFailure();
+        return false;
+    }
+    outputPush(1, rejection);
+    return true;
+}
+
+bool WorkerIntegration::isRejected(double v, int x, int y, int c) const
+{
+    switch(m_rejectionType) {
+    default:
+    case OpIntegration::NoRejection:
+        return false;
+    case OpIntegration::MinMax:
+        return !( v > SUBPXL(m_minPlane,x,y,c) &&
+                  v < SUBPXL(m_maxPlane,x,y,c) );
+    case OpIntegration::AverageDeviation:
+        return !( v >= SUBPXL(m_averagePlane,x,y,c)/m_lower &&
+                  v <= SUBPXL(m_averagePlane,x,y,c)*m_upper );
+    case OpIntegration::SigmaClipping:
+        return !( v >= SUBPXL(m_averagePlane,x,y,c)-SUBPXL(m_stdDevPlane,x,y,c)*m_lower &&
+                  v <= SUBPXL(m_averagePlane,x,y,c)+SUBPXL(m_stdDevPlane,x,y,c)*m_upper );
+    }
+}
+
+/**
+ * @brief WorkerIntegration::isRejectedRunning
+ * rejection against the statistics of all the samples seen so far,
+ * rejected ones included, like the full run judges each sample against
+ * the whole set. The first frames are all taken until there are enough
+ * of them to judge
+ */
+bool WorkerIntegration::isRejectedRunning(double v, int x, int y, int c) const
+{
+    int n = SUBPXL(m_runningCount,x,y,c);
+    if ( n < DF_FOLD_MIN_FRAMES )
+        return false;
+    double mean = SUBPXL(m_runningMean,x,y,c);
+    switch(m_rejectionType) {
+    default:
+    case OpIntegration::NoRejection:
+        return false;
+    case OpIntegration::AverageDeviation:
+        return !( v >= mean/m_lower && v <= mean*m_upper );
+    case OpIntegration::SigmaClipping: {
+        double sd = sqrt(qMax(0., SUBPXL(m_runningM2,x,y,c)/n));
+        return !( v >= mean-sd*m_lower && v <= mean+sd*m_upper );
+    }
+    }
+}
+
+/**
+ * @brief WorkerIntegration::addRunning
+ * Welford's update of the unclipped statistics with one more sample
+ */
+void WorkerIntegration::addRunning(double v, int x, int y, int c)
+{
+    int n = ++SUBPXL(m_runningCount,x,y,c);
+    double delta = v - SUBPXL(m_runningMean,x,y,c);
+    SUBPXL(m_runningMean,x,y,c) += delta/n;
+    SUBPXL(m_runningM2,x,y,c) += delta*(v - SUBPXL(m_runningMean,x,y,c));
+}
+
+/**
+ * @brief WorkerIntegration::fold
+ * live mode: the new frames are added to the sums kept from the previous
+ * runs, against the reference points of the first one
+ */
+bool WorkerIntegration::fold()
+{
+    if ( !m_state || !m_state->valid ) {
+        dflError(tr("No integration to fold the new frames in"));
+        emitFailure();
+        return false;
+    }
+    m_w = m_state->w;
+    m_h = m_state->h;
+    m_integrationPlane = m_state->sum;
+    m_countPlane = m_state->count;
+    m_runningCount = m_state->runningCount;
+    m_runningMean = m_state->runningMean;
+    m_runningM2 = m_state->runningM2;
+    /* the sums outlive the run, an interrupted fold leaves them partial
+     * and the next frames go through the whole set again */
+    m_state->valid = false;
+    bool rejectionMap = m_rejectionType != OpIntegration::NoRejection && outputEnabled(1);
+    int photoCount = m_inputs[0].count();
+    int photoN = 0;
+    dfl_block long totalPixels = 0;
+    dfl_block long rejected = 0;
+    profileBegin("fold");
+    foreach(Photo photo, m_inputs[0]) {
+        if ( aborted() ) {
+            emitFailure();
+            return false;
+        }
+        if ( photo.getScale() == Photo::NonLinear ) {
+            dflWarning(tr("%0 is non-linear").arg(photo.getIdentity()));
+        }
+        try {
+            TransformView view(photo, m_scale, m_state->reference);
+            if ( view.inError() ) {
+                dflError(tr("view in error"));
+                continue;
+            }
+            if ( !view.loadPixels() ) {
+                dflError(tr("unable to load pixels"));
+                continue;
+            }
+            view.setInterpolation(TransformView::Interpolation(m_interpolation));
+            std::shared_ptr<std::vector<float> > frame = view.resample(m_w, m_h);
+            const float *resampled = &(*frame)[0];
+            HDRExposure exposure = frameExposure(photo);
+            bool hdr = photo.getScale() == Photo::HDR;
+            std::shared_ptr<Photo> rejPhoto;
+            std::shared_ptr<Ordinary::Pixels> rejCache;
+            Magick::PixelPacket *rejPixels = NULL;
+            if ( rejectionMap ) {
+                rejPhoto.reset(new Photo(photo));
+                rejPhoto->createImage(m_w, m_h);
+                rejCache.reset(new Ordinary::Pixels(rejPhoto->image()));
+                rejPixels = rejCache->get(0, 0, m_w, m_h);
+            }
+            dfl_block int line = 0;
+            dfl_parallel_for(y, 0, m_h, 4, (), {
+                for ( int x = 0 ; x < m_w ; ++x ) {
+                    const float *rgbp = resampled + (size_t(y)*m_w+x)*3;
+                    if ( rgbp[0] == TRANSFORMVIEW_UNDEFINED )
+                        continue;
+                    if ( exposure.altered ) {
+                        qreal lum = LUMINANCE(rgbp[0], rgbp[1], rgbp[2]);
+                        if ( !exposure.automatic && (lum < exposure.low || lum > exposure.high) )
+                            continue;
+                    }
+                    for (int c = 0 ; c < 3 ; ++c) {
+                        double v = rgbp[c]/exposure.comp;
+                        bool reject = isRejectedRunning(v, x, y, c);
+                        atomic_incr(&totalPixels);
+                        addRunning(v, x, y, c);
+                        if ( reject ) {
+                            atomic_incr(&rejected);
+                        }
+                        else {
+                            SUBPXL(m_integrationPlane,x,y,c) += v;
+                            ++SUBPXL(m_countPlane,x,y,c);
+                        }
+                        if ( !rejPixels )
+                            continue;
+                        quantum_t q = reject
+                                ? (hdr ? toHDR(v) : clamp<quantum_t>(DF_ROUND(v), 0, QuantumRange))
+                                : 0;
+                        switch(c) {
+                        case 0: rejPixels[y*m_w+x].red = q; break;
+                        case 1: rejPixels[y*m_w+x].green = q; break;
+                        case 2: rejPixels[y*m_w+x].blue = q; break;
+                        }
+                    }
+                }
+                dfl_critical_section(
+                {
+                    ++line;
+                    if ( 0 == line % 100 )
+                        emitProgress(photoN, photoCount, line, m_h);
+                });
+            });
+            if ( rejPhoto ) {
+                rejCache->sync();
+                outputPush(1, *rejPhoto);
+            }
+            ++photoN;
+        }
+        catch (std::exception &e) {
+            setError(photo, e.what());
+            emitFailure();
+            return false;
+        }
+    }
+    if ( aborted() ) {
+        emitFailure();
+        return false;
+    }
+    if ( !pushIntegration(totalPixels, rejected, QVector<QPointF>()) )
+        return false;
+    m_state->valid = true;
+    emitSuccess();
+    return true;
+}
+
+/**
+ * @brief WorkerIntegration::drizzle
+ * Drops every source pixel, shrunk by pixfrac, on the output grid and
+ * accumulates it weighted by its overlap with each output pixel.
+ * The output is split in bands of rows, each band is owned by a single
+ * task that visits the source pixels able to reach it, so the planes
+ * need no locking.
+ */
+void WorkerIntegration::drizzle(TransformView& view,
+                                const WorkerIntegration::HDRExposure &exposure,
+                                Magick::PixelPacket *rejPixels,
+                                long *totalPixels,
+                                long *rejected)
+{
+    QTransform toSource = view.transform();
+    QTransform toOutput = toSource.inverted();
+    const Magick::PixelPacket *src = view.pixels();
+    int sw = view.width();
+    int sh = view.height();
+    bool hdr = view.isHDR();
+    /* the drop is kept square with the area of the mapped pixel */
+    qreal side = m_pixfrac * sqrt(fabs(toOutput.m11()*toOutput.m22()-toOutput.m12()*toOutput.m21()));
+    qreal half = side/2.;
+    int nBands = (m_h+DF_DRIZZLE_BAND-1)/DF_DRIZZLE_BAND;
+    dfl_parallel_for(band, 0, nBands, 1, (), {
+        int y0 = band*DF_DRIZZLE_BAND;
+        int y1 = qMin(m_h, y0+DF_DRIZZLE_BAND);
+        QRectF reach = toSource.mapRect(QRectF(-side-1, y0-side-1,
+                                               m_w+2*side+2, y1-y0+2*side+2));
+        int sx0 = qMax(0, int(floor(reach.left())));
+        int sx1 = qMin(sw, int(ceil(reach.right()))+1);
+        int sy0 = qMax(0, int(floor(reach.top())));
+        int sy1 = qMin(sh, int(ceil(reach.bottom()))+1);
+        for ( int j = sy0 ; j < sy1 ; ++j ) {
+            for ( int i = sx0 ; i < sx1 ; ++i ) {
+                qreal cx, cy;
+                toOutput.map(i+.5, j+.5, &cx, &cy);
+                qreal top = cy-half, bottom = cy+half;
+                if ( bottom <= y0 || top >= y1 )
+                    continue;
+                qreal left = cx-half, right = cx+half;
+                if ( right <= 0 || left >= m_w )
+                    continue;
+                const Magick::PixelPacket& pixel = src[j*sw+i];
+                double rgb[3] = {
+                    hdr ? fromHDR(pixel.red) : pixel.red,
+                    hdr ? fromHDR(pixel.green) : pixel.green,
+                    hdr ? fromHDR(pixel.blue) : pixel.blue
+                };
+                if ( exposure.altered ) {
+                    qreal lum = LUMINANCE(rgb[0], rgb[1], rgb[2]);
+                    if ( !exposure.automatic && (lum < exposure.low || lum > exposure.high) )
+                        continue;
+                    for (int c = 0 ; c < 3 ; ++c)
+                        rgb[c] /= exposure.comp;
+                }
+                /* rejection is decided once per drop, against the
+                 * statistics of the output pixel under its center */
+                int rx = clamp<int>(cx, 0, m_w-1);
+                int ry = clamp<int>(cy, 0, m_h-1);
+                bool owner = cy >= y0 && cy < y1;
+                bool reject[3];
+                for (int c = 0 ; c < 3 ; ++c) {
+                    reject[c] = isRejected(rgb[c], rx, ry, c);
+                    if ( !owner )
+                        continue;
+                    atomic_incr(totalPixels);
+                    if ( reject[c] )
+                        atomic_incr(rejected);
+                    if ( rejPixels ) {
+                        quantum_t v = reject[c]
+                                ? (hdr ? toHDR(rgb[c]) : clamp<quantum_t>(DF_ROUND(rgb[c]), 0, QuantumRange))
+                                : 0;
+                        switch(c) {
+                        case 0: rejPixels[j*sw+i].red = v; break;
+                        case 1: rejPixels[j*sw+i].green = v; break;
+                        case 2: rejPixels[j*sw+i].blue = v; break;
+                        }
+                    }
+                }
+                int oy0 = qMax(y0, int(floor(top)));
+                int oy1 = qMin(y1, int(ceil(bottom)));
+                int ox0 = qMax(0, int(floor(left)));
+                int ox1 = qMin(m_w, int(ceil(right)));
+                for ( int y = oy0 ; y < oy1 ; ++y ) {
+                    qreal dy = qMin(bottom, qreal(y+1)) - qMax(top, qreal(y));
+                    if ( dy <= 0 )
+                        continue;
+                    for ( int x = ox0 ; x < ox1 ; ++x ) {
+                        qreal dx = qMin(right, qreal(x+1)) - qMax(left, qreal(x));
+                        if ( dx <= 0 )
+                            continue;
+                        qreal a = dx*dy;
+                        for (int c = 0 ; c < 3 ; ++c) {
+                            if ( reject[c] )
+                                continue;
+                            SUBPXL(m_integrationPlane,x,y,c) += a*rgb[c];
+                            SUBPXL(m_weightPlane,x,y,c) += a;
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+IntegrationState::IntegrationState() :
+    valid(false),
+    w(0),
+    h(0),
+    reference(),
+    sum(0),
+    count(0),
+    runningCount(0),
+    runningMean(0),
+    runningM2(0)
+{
+}
+
+IntegrationState::~IntegrationState()
+{
+    delete[] sum;
+    delete[] count;
+    delete[] runningCount;
+    delete[] runningMean;
+    delete[] runningM2;
+}
+
+void IntegrationState::allocate(int w, int h)
+{
+    delete[] sum;
+    delete[] count;
+    delete[] runningCount;
+    delete[] runningMean;
+    delete[] runningM2;
+    this->w = w;
+    this->h = h;
+    valid = false;
+    sum = new WorkerIntegration::integration_plane_t[w*h*3]();
+    count = new int[w*h*3]();
+    runningCount = new int[w*h*3]();
+    runningMean = new WorkerIntegration::integration_plane_t[w*h*3]();
+    runningM2 = new WorkerIntegration::integration_plane_t[w*h*3]();
+}
@@ -31,18 +31,30 @@
 #ifndef WORKERINTEGRATION_H
 #define WORKERINTEGRATION_H
 
+#include <QMap>
+#include <QVector>
+#include <QPointF>
+#include <vector>
+#include <memory>
 #include "operatorworker.h"
 #include "opintegration.h"
+#include <Magick++.h>
 
-namespace Magick {
-class Image;
-}
+class TransformView;
+class IntegrationState;
 
 class WorkerIntegration : public OperatorWorker
 {
     Q_OBJECT
 public:
     typedef double integration_plane_t;
+    typedef struct {
+        bool altered;
+        bool automatic;
+        qreal comp;
+        qreal high;
+        qreal low;
+    } HDRExposure;
     WorkerIntegration(OpIntegration::RejectionType rejectionType,
                       qreal upper,
                       qreal lower,
@@ -50,6 +62,11 @@ public:
                       qreal customNormalizationValue,
                       bool outputHDR,
                       qreal scale,
+                      int interpolation,
+                      bool drizzle,
+                      qreal pixfrac,
+                      std::shared_ptr<IntegrationState> state,
+                      bool fold,
                       QThread *thread, OpIntegration *op);
     ~WorkerIntegration();
     Photo process(const Photo &, int, int) { throw 0; }
@@ -76,9 +93,68 @@ public:
     qreal m_offX;
     qreal m_offY;
     qreal m_scale;
+    int m_interpolation;
+    bool m_drizzle;
+    qreal m_pixfrac;
+    /* drizzle accumulates fractional weights instead of counts */
+    integration_plane_t *m_weightPlane;
+    /* resampled frames kept from one phase to the next */
+    QMap<int, std::shared_ptr<std::vector<float> > > m_resampled;
+    qint64 m_resampledBytes;
+    /* live mode: planes kept by the operator between runs */
+    std::shared_ptr<IntegrationState> m_state;
+    bool m_fold;
+    /* live mode: unclipped statistics of every sample, for the rejection */
+    int *m_runningCount;
+    integration_plane_t *m_runningMean;
+    integration_plane_t *m_runningM2;
 
 private:
+    struct StackFrame;
     void createPlanes(Magick::Image&);
+    bool isRejected(double v, int x, int y, int c) const;
+    bool isRejectedRunning(double v, int x, int y, int c) const;
+    void addRunning(double v, int x, int y, int c);
+    bool fold();
+    bool pushIntegration(long totalPixels, long rejected,
+                         const QVector<QPointF>& points);
+    bool integrateStacks(Photo *refPhoto, const QVector<QPointF>& reference,
+                         long *totalPixels, long *rejected);
+    bool pushStackRejection(const StackFrame& frame, const float *bounds);
+    void drizzle(TransformView& view,
+                 const HDRExposure& exposure,
+                 Magick::PixelPacket *rejPixels,
+                 long *totalPixels,
+                 long *rejected);
+};
+
+/**
+ * @brief The IntegrationState class
+ * sums of an integration kept once it's done, so that the frames appended
+ * in live mode are folded in without going through the set again
+ */
+class IntegrationState
+{
+public:
+    IntegrationState();
+    ~IntegrationState();
+    void allocate(int w, int h);
+
+    bool valid;
+    int w;
+    int h;
+    QVector<QPointF> reference;
+    WorkerIntegration::integration_plane_t *sum;
+    int *count;
+    /* mean and sum of squared deviations of all the samples, rejected
+     * ones included, updated one sample at a time */
+    int *runningCount;
+    WorkerIntegration::integration_plane_t *runningMean;
+    WorkerIntegration::integration_plane_t *runningM2;
+
+private:
+    IntegrationState(const IntegrationState&);
+    IntegrationState& operator=(const IntegrationState&);
 };
 
 #endif // WORKERINTEGRATION_H
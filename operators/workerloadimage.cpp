@@ -63,43 +63,50 @@ void WorkerLoadImage::play()
         }
         try {
             QString filename=collection[i];
-            std::list<Magick::Image> images;
-            Magick::readImages(&images, filename.toStdString());
-            Photo::Gamma gamma;
-            switch(m_colorSpace) {
-            default:
-            case OpLoadImage::Linear: gamma = Photo::Linear; break;
-            case OpLoadImage::IUT_BT_709: gamma = Photo::IUT_BT_709; break;
-            case OpLoadImage::sRGB: gamma = Photo::sRGB; break;
-            case OpLoadImage::HDR: gamma = Photo::HDR; break;
-            }
-            int plane = 0;
-            int count = images.size();
-            for( std::list<Magick::Image>::iterator it = images.begin() ;
-                 it != images.end() ;
-                 ++it ) {
-                Photo photo(*it, gamma);
-                if ( !photo.isComplete() ) {
-                    failure = true;
-                    continue;
+            QVector<Photo> photos;
+            if ( !proxyFetch(filename, photos) ) {
+                std::list<Magick::Image> images;
+                Magick::readImages(&images, filename.toStdString());
+                Photo::Gamma gamma;
+                switch(m_colorSpace) {
+                default:
+                case OpLoadImage::Linear: gamma = Photo::Linear; break;
+                case OpLoadImage::IUT_BT_709: gamma = Photo::IUT_BT_709; break;
+                case OpLoadImage::sRGB: gamma = Photo::sRGB; break;
+                case OpLoadImage::HDR: gamma = Photo::HDR; break;
                 }
-                QFileInfo finfo(collection[i]);
-                QString identity = finfo.fileName();
-                if ( count > 1 )
-                    identity += ":" + QString::number(plane);
-                photo.setIdentity(m_operator->uuid()+"/"+identity);
-                photo.setTag(TAG_NAME, identity);
-                photo.setSequenceNumber(i);
-                photo.setTag(TAG_SCALE, gamma == Photo::Linear
-                             ? TAG_SCALE_LINEAR
-                             : gamma == Photo::HDR
-                                 ? TAG_SCALE_HDR
-                                 : TAG_SCALE_NONLINEAR);
-
+                int plane = 0;
+                int count = images.size();
+                for( std::list<Magick::Image>::iterator it = images.begin() ;
+                     it != images.end() ;
+                     ++it ) {
+                    Photo photo(*it, gamma);
+                    if ( !photo.isComplete() ) {
+                        failure = true;
+                        continue;
+                    }
+                    QFileInfo finfo(collection[i]);
+                    QString identity = finfo.fileName();
+                    if ( count > 1 )
+                        identity += ":" + QString::number(plane);
+                    photo.setIdentity(m_operator->uuid()+"/"+identity);
+                    photo.setTag(TAG_NAME, identity);
+                    photo.setTag(TAG_SCALE, gamma == Photo::Linear
+                                 ? TAG_SCALE_LINEAR
+                                 : gamma == Photo::HDR
+                                     ? TAG_SCALE_HDR
+                                     : TAG_SCALE_NONLINEAR);
+                    photos.push_back(proxy(photo));
+                    ++plane;
+                }
+                if ( !failure )
+                    proxyStore(filename, photos);
+            }
+            for ( int j = 0 ; j < photos.count() ; ++j ) {
+                photos[j].setSequenceNumber(i);
                 dfl_critical_section({
-                    outputPush(0, photo);
+                    outputPush(0, photos[j]);
                 });
-                ++plane;
             }
         }
         catch(std::exception &e) {
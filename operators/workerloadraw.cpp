@@ -47,18 +47,22 @@
 
 #include "workerloadraw.h"
 #include "rawinfo.h"
+#include "rawdecoder.h"
 #include "operatoroutput.h"
 #include "oploadraw.h"
 #include "photo.h"
 
-WorkerLoadRaw::WorkerLoadRaw(QThread *thread, OpLoadRaw *op) :
+WorkerLoadRaw::WorkerLoadRaw(QThread *thread, OpLoadRaw *op,
+                             const QStringList &collection, int firstSequence) :
     OperatorWorker(thread, op),
-    m_loadraw(op)
+    m_loadraw(op),
+    m_collection(collection),
+    m_firstSequence(firstSequence)
 {}
 
 void WorkerLoadRaw::play()
 {
-    QVector<QString> collection = m_loadraw->getCollection().toVector();
+    QVector<QString> collection = m_collection.toVector();
     int s = collection.count();
     dfl_block int p = 0;
     dfl_block bool failure = false;
@@ -68,13 +72,7 @@ void WorkerLoadRaw::play()
             failure = true;
             continue;
         }
-        QByteArray data = convert(collection[i]);
         try {
-            Magick::Blob blob(data.data(),data.length());
-            if ( blob.data() == 0 || data.length() == 0 ) {
-                failure = true;
-                continue;
-            }
             Photo::Gamma gamma;
             switch(m_loadraw->m_colorSpaceValue) {
             default:
@@ -82,13 +80,22 @@ void WorkerLoadRaw::play()
             case OpLoadRaw::IUT_BT_709: gamma = Photo::IUT_BT_709; break;
             case OpLoadRaw::sRGB: gamma = Photo::sRGB; break;
             }
-            Photo photo(blob, gamma);
-            if ( !photo.isComplete() ) {
-                failure = true;
-                continue;
+            QVector<Photo> proxies;
+            Photo photo(gamma);
+            if ( proxyFetch(collection[i], proxies) ) {
+                photo = proxies.first();
+            }
+            else {
+                RawInfo info;
+                if ( !decode(collection[i], info, photo) || !photo.isComplete() ) {
+                    failure = true;
+                    continue;
+                }
+                setTags(collection[i], info, photo);
+                photo = proxy(photo);
+                proxyStore(collection[i], QVector<Photo>() << photo);
             }
-            setTags(collection[i], photo);
-            photo.setSequenceNumber(i);
+            photo.setSequenceNumber(m_firstSequence + i);
             dfl_critical_section({
                 emit progress(++p, s);
                 outputPush(0, photo);
@@ -116,6 +123,103 @@ void WorkerLoadRaw::play()
 
 
 
+/**
+ * @brief WorkerLoadRaw::decode
+ * decode in-process when libraw is available: metadata and pixels are
+ * read from a single open of the file, and written straight into the
+ * photo. Falls back to dcraw for files libraw can't handle.
+ */
+bool WorkerLoadRaw::decode(const QString &filename, RawInfo &info, Photo &photo)
+{
+    if ( RawDecoder::available() ) {
+        RawDecoder decoder(decoderParams());
+        if ( decoder.open(filename) &&
+             decoder.probe(info) &&
+             decoder.decode(photo) )
+            return true;
+        dflWarning(tr("%0, falling back to dcraw").arg(decoder.errorString()));
+    }
+    QByteArray data = convert(filename);
+    if ( data.length() == 0 )
+        return false;
+    Magick::Blob blob(data.data(),data.length());
+    if ( blob.data() == 0 )
+        return false;
+    photo.image() = Magick::Image(blob);
+    photo.setComplete();
+    info.probeFile(filename);
+    return true;
+}
+
+RawDecoder::Params WorkerLoadRaw::decoderParams() const
+{
+    RawDecoder::Params params;
+    switch(m_loadraw->m_whiteBalanceValue ) {
+    case OpLoadRaw::NoWhiteBalance:
+        params.unitMultipliers = true;
+        break;
+    case OpLoadRaw::RawColors:
+        params.rawColors = true;
+        break;
+    case OpLoadRaw::Camera:
+        params.cameraWhiteBalance = true;
+        break;
+    case OpLoadRaw::Daylight:
+        break;
+    }
+    switch(m_loadraw->m_debayerValue) {
+    case OpLoadRaw::NoDebayer:
+        params.document = true;
+        break;
+    case OpLoadRaw::HalfSize:
+        params.halfSize = true;
+        break;
+    case OpLoadRaw::Low:
+        params.quality = 0;
+        break;
+    case OpLoadRaw::VNG:
+        params.quality = 1;
+        break;
+    case OpLoadRaw::PPG:
+        params.quality = 2;
+        break;
+    case OpLoadRaw::AHD:
+        params.quality = 3;
+        break;
+    }
+    switch(m_loadraw->m_colorSpaceValue) {
+    case OpLoadRaw::Linear:
+        params.curve = RawDecoder::Linear;
+        break;
+    case OpLoadRaw::sRGB:
+        params.curve = RawDecoder::sRGB;
+        break;
+    case OpLoadRaw::IUT_BT_709:
+        params.curve = RawDecoder::IUT_BT_709;
+        break;
+    }
+    switch(m_loadraw->m_clippingValue) {
+    case OpLoadRaw::ClipAuto:
+        break;
+    case OpLoadRaw::Clip16bit:
+        params.saturation = 65535;
+        break;
+    case OpLoadRaw::Clip15bit:
+        params.saturation = 32767;
+        break;
+    case OpLoadRaw::Clip14bit:
+        params.saturation = 16383;
+        break;
+    case OpLoadRaw::Clip13bit:
+        params.saturation = 8191;
+        break;
+    case OpLoadRaw::Clip12bit:
+        params.saturation = 4095;
+        break;
+    }
+    return params;
+}
+
 QByteArray WorkerLoadRaw::convert(const QString &filename)
 {
     QString dcraw_executable("dcraw");
@@ -214,11 +318,9 @@ QByteArray WorkerLoadRaw::convert(const QString &filename)
     return data;
 }
 
-void WorkerLoadRaw::setTags(const QString &filename, Photo &photo)
+void WorkerLoadRaw::setTags(const QString &filename, const RawInfo &info, Photo &photo)
 {
-    RawInfo info;
     QFileInfo finfo(filename);
-    info.probeFile(filename);
     //photo.writeJPG("/tmp/"+finfo.fileName()+".jpg");
     photo.setIdentity(m_operator->uuid()+"/"+finfo.fileName());
     photo.setTag(TAG_NAME, finfo.fileName());
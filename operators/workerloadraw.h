@@ -31,16 +31,20 @@
 #ifndef RAWCONVERT_H
 #define RAWCONVERT_H
 #include <QString>
+#include <QStringList>
 #include "operatorworker.h"
+#include "rawdecoder.h"
 
 class OpLoadRaw;
 class Photo;
+class RawInfo;
 
 class WorkerLoadRaw : public OperatorWorker
 {
     Q_OBJECT
 public:
-    WorkerLoadRaw(QThread *thread, OpLoadRaw *op);
+    WorkerLoadRaw(QThread *thread, OpLoadRaw *op,
+                  const QStringList& collection, int firstSequence);
 
     Photo process(const Photo &, int, int) { throw 0; }
 
@@ -48,14 +52,18 @@ private slots:
     void play();
 
 private:
+    bool decode(const QString& filename, RawInfo& info, Photo& photo);
+    RawDecoder::Params decoderParams() const;
     QByteArray convert(const QString& filename);
-    void setTags(const QString& filename, Photo& photo);
+    void setTags(const QString& filename, const RawInfo& info, Photo& photo);
 
 signals:
 
 public slots:
 private:
     OpLoadRaw *m_loadraw;
+    QStringList m_collection;
+    int m_firstSequence;
 };
 
 #endif // RAWCONVERT_H
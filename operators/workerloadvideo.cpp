@@ -32,6 +32,8 @@
 #include <QFileInfo>
 #include <QStringList>
 
+#include <cstring>
+
 #include <Magick++.h>
 
 #include "workerloadvideo.h"
@@ -45,6 +47,7 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/mathematics.h>
+#include <libavutil/pixdesc.h>
 }
 #endif
 
@@ -71,10 +74,8 @@ void WorkerLoadVideo::play()
     for ( int i = 0, s = m_collection.count() ;
           i < s ;
           ++i ) {
-        int skip = m_skip;
         int count = m_count;
         bool res = decodeVideo(m_collection[i], i, s);
-        m_skip = skip;
         m_count = count;
         if ( !res ) {
             emitFailure();
@@ -92,133 +93,371 @@ static bool handle_error(const QString &str) {
     return false;
 }
 
+namespace {
+struct VideoContext {
+    AVFormatContext *format;
+    AVCodecContext *codec;
+    AVFrame *frame;
+    AVPacket *packet;
+    VideoContext() :
+        format(NULL),
+        codec(NULL),
+        frame(NULL),
+        packet(NULL)
+    {}
+    ~VideoContext() {
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&codec);
+        if ( format )
+            avformat_close_input(&format);
+    }
+};
+}
+
 bool WorkerLoadVideo::decodeVideo(const QString &filename, int progress, int complete)
 {
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
     av_register_all();
+#endif
+    VideoContext ctx;
 
-    AVFormatContext *pFormatCtx = avformat_alloc_context();
-
-    if(avformat_open_input(&pFormatCtx, filename.toLocal8Bit(), NULL, NULL)!=0)
+    if(avformat_open_input(&ctx.format, filename.toLocal8Bit(), NULL, NULL)!=0)
             return handle_error(tr("Couldn't open file %0").arg(filename));
 
     // Retrieve stream information
-    if(avformat_find_stream_info(pFormatCtx, NULL)<0)
+    if(avformat_find_stream_info(ctx.format, NULL)<0)
             return handle_error(tr("Couldn't find stream information in file %0").arg(filename));
-    unsigned int            i;
-    int videoStream;
-    AVCodecContext *pCodecCtx;
-    // Find the first video stream
-    videoStream=-1;
-    for(i=0; i<pFormatCtx->nb_streams; i++)
-        if(pFormatCtx->streams[i]->codec->codec_type==AVMEDIA_TYPE_VIDEO)
-        {
-            videoStream=i;
-            break;
-        }
-    if(videoStream==-1)
-        return handle_error(tr("Didn't find a video stream for file %0").arg(filename));
 
-    // Get a pointer to the codec context for the video stream
-    pCodecCtx=pFormatCtx->streams[videoStream]->codec;
-
-
-    AVCodec *pCodec;
+    int videoStream = av_find_best_stream(ctx.format, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if(videoStream < 0)
+        return handle_error(tr("Didn't find a video stream for file %0").arg(filename));
+    AVStream *stream = ctx.format->streams[videoStream];
 
     // Find the decoder for the video stream
-    pCodec=avcodec_find_decoder(pCodecCtx->codec_id);
-    if(pCodec==NULL)
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if(codec==NULL)
         return handle_error(tr("Codec not found for file %0").arg(filename));
 
-    // Inform the codec that we can handle truncated bitstreams -- i.e.,
-    // bitstreams where frame boundaries can fall in the middle of packets
-    if(pCodec->capabilities & CODEC_CAP_TRUNCATED)
-        pCodecCtx->flags|=CODEC_FLAG_TRUNCATED;
+    ctx.codec = avcodec_alloc_context3(codec);
+    if ( !ctx.codec ||
+         avcodec_parameters_to_context(ctx.codec, stream->codecpar) < 0 )
+        return handle_error(tr("Could not open codec for file %0").arg(filename));
+
+    // frame threading where the codec supports it, slices otherwise
+    ctx.codec->thread_count = DfThreadLimit();
+    ctx.codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
-    if ( pCodecCtx->pix_fmt != AV_PIX_FMT_YUV420P &&
-         pCodecCtx->pix_fmt != AV_PIX_FMT_YUV410P &&
-         pCodecCtx->pix_fmt != AV_PIX_FMT_BGR24 )
-            return handle_error(tr("Unsupported pixel format for file %0").arg(filename));
     // Open codec
-    if(avcodec_open2(pCodecCtx, pCodec, NULL)<0)
+    if(avcodec_open2(ctx.codec, codec, NULL)<0)
         return handle_error(tr("Could not open codec for file %0").arg(filename));
 
-    AVFrame *picture;
-    int fps_num = pCodecCtx->framerate.num;
-    int fps_den = pCodecCtx->framerate.den;
-    if ( !fps_num || !fps_den ) {
-        fps_num=1; fps_den=30;
+    AVRational rate = av_guess_frame_rate(ctx.format, stream, NULL);
+    if ( !rate.num || !rate.den )
+        rate = av_make_q(30, 1);
+    AVRational frameDuration = av_inv_q(rate);
+    int64_t start = stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time;
+    int64_t frame_count = stream->nb_frames;
+    if ( frame_count <= 0 && ctx.format->duration != AV_NOPTS_VALUE )
+        frame_count = av_rescale_q(ctx.format->duration, AV_TIME_BASE_Q, frameDuration);
+    if ( frame_count <= 0 )
+        frame_count=30;
+
+    // seek to the keyframe before the first wanted frame instead of
+    // decoding the skipped ones, frames are then numbered by timestamp
+    bool seeked = false;
+    if ( m_skip > 0 ) {
+        int64_t target = start + av_rescale_q(m_skip, frameDuration, stream->time_base);
+        if ( av_seek_frame(ctx.format, videoStream, target, AVSEEK_FLAG_BACKWARD) >= 0 ) {
+            avcodec_flush_buffers(ctx.codec);
+            seeked = true;
+        }
+        else {
+            dflDebug(tr("Seek failed in %0, decoding from start").arg(filename));
+        }
     }
-    if ( fps_num > fps_den ) {
-        int tmp = fps_num;
-        fps_num = fps_den;
-        fps_den = tmp;
+
+    ctx.frame = av_frame_alloc();
+    ctx.packet = av_packet_alloc();
+    if ( !ctx.frame || !ctx.packet )
+        return handle_error(tr("Out of memory decoding %0").arg(filename));
+
+    int64_t frame = 0;
+    bool eof = false;
+    bool pending = false;
+    bool more = true;
+    while ( more ) {
+        if ( aborted() )
+            return false;
+        if ( !eof && !pending ) {
+            if ( av_read_frame(ctx.format, ctx.packet) < 0 ) {
+                eof = true;
+                avcodec_send_packet(ctx.codec, NULL);
+            }
+            else if ( ctx.packet->stream_index != videoStream ) {
+                av_packet_unref(ctx.packet);
+                continue;
+            }
+            else {
+                pending = true;
+            }
+        }
+        if ( pending ) {
+            // a full decoder keeps the packet until frames are received
+            int ret = avcodec_send_packet(ctx.codec, ctx.packet);
+            if ( ret != AVERROR(EAGAIN) ) {
+                pending = false;
+                av_packet_unref(ctx.packet);
+                if ( ret < 0 )
+                    dflDebug(tr("Error while decoding frame in %0").arg(filename));
+            }
+        }
+        for (;;) {
+            int ret = avcodec_receive_frame(ctx.codec, ctx.frame);
+            if ( ret == AVERROR(EAGAIN) )
+                break;
+            if ( ret < 0 ) {
+                if ( ret != AVERROR_EOF )
+                    dflDebug(tr("Error while decoding frame in %0").arg(filename));
+                if ( eof )
+                    more = false;
+                break;
+            }
+            int64_t n = frame;
+            if ( seeked && ctx.frame->best_effort_timestamp != AV_NOPTS_VALUE )
+                n = av_rescale_q(ctx.frame->best_effort_timestamp - start,
+                                 stream->time_base, frameDuration);
+            frame = n + 1;
+            bool cont = true;
+            if ( n < m_skip )
+                emitProgress(progress, complete, n%frame_count, frame_count);
+            else
+                cont = push_frame(ctx.frame, filename, progress, complete, n, frame_count);
+            av_frame_unref(ctx.frame);
+            if ( !cont ) {
+                more = false;
+                break;
+            }
+        }
     }
-    int64_t frame_count = (pFormatCtx->duration==0?AV_TIME_BASE:pFormatCtx->duration/AV_TIME_BASE) *  fps_num / fps_den;
-    if ( !frame_count )
-        frame_count=30;
-    int frame, got_picture, len;
-    picture=av_frame_alloc();
-
-    AVPacket avpkt;
-    //av_init_packet(&avpkt);
-    avpkt.data=NULL;
-    avpkt.size = 0;
-
-    frame = 0;
-     for(;;) {
-         while (avpkt.size > 0) {
-             len = avcodec_decode_video2(pCodecCtx, picture, &got_picture, &avpkt);
-             if (len < 0) {
-                 dflDebug(tr("Error while decoding frame in %0").arg(filename));
-              }
-             avpkt.size-=len;
-             avpkt.data+=len;
-             if (got_picture) {
-                 bool cont = push_frame(picture, filename, progress, complete, frame, frame_count);
-                 frame++;
-                 if ( !cont ) goto loop_exit;
-             }
-         }
-         do {
-             if (avpkt.data) {
-                 av_packet_unref(&avpkt);
-                 avpkt.data = NULL;
-                 avpkt.size = 0;
-             }
-             if (av_read_frame(pFormatCtx, &avpkt))
-                 goto loop_exit;
-         } while(avpkt.stream_index != videoStream );
-     }
-loop_exit:
-     len = avcodec_decode_video2(pCodecCtx, picture, &got_picture, &avpkt);
-     if (got_picture) {
-         fflush(stdout);
-
-         /* the picture is allocated by the decoder. no need to
-            free it */
-         push_frame(picture, filename, progress, complete, frame, frame_count);
-         frame++;
-         if (avpkt.data)
-             av_packet_unref(&avpkt);
-     }
-
-     avcodec_close(pCodecCtx);
-     av_free(pCodecCtx);
-     av_free(picture);
-     return !m_error;
+    return !m_error;
+}
+
+namespace {
+/*
+ * where and how to read one component of a decoded frame, resolved once
+ * per frame from the pixel format descriptor
+ */
+struct FrameComponent {
+    const uint8_t *data;
+    int linesize;
+    int step;
+    int offset;
+    int shift;
+    int mask;
+    int log2w;
+    int log2h;
+    bool wide;
+    bool be;
+};
+
+struct FrameLayout {
+    typedef enum {
+        YUV,
+        RGB,
+        Gray,
+        Bayer
+    } Kind;
+    Kind kind;
+    FrameComponent comp[3];
+    float offset[3];
+    float scale[3];
+    /* YUV to RGB matrix, luma and blue/red differences coefficients */
+    float rv, gu, gv, bu;
+    const char *pattern;
+};
+}
+
+static inline int frame_sample(const FrameComponent& c, int x, int y)
+{
+    const uint8_t *p = c.data + (y >> c.log2h) * c.linesize + (x >> c.log2w) * c.step + c.offset;
+    int v = c.wide ? ( c.be ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0]) ) : p[0];
+    return (v >> c.shift) & c.mask;
 }
 
-static inline void yuv420_to_rgb(unsigned char y, unsigned char u, unsigned char v,
-                          quantum_t& r, quantum_t& g, quantum_t& b) {
-    int c = -16;
-    int d = -128;
-    int e = -128;
-    c+=y;
-    d+=u;
-    e+=v;
-    r = clamp( (298 * c + 409 * e + 128) );
-    g = clamp( (298 * c - 100 * d - 208 * e + 128));
-    b = clamp(298 * c + 516 * d + 128);
+static const char *bayer_pattern(int format)
+{
+    switch(format) {
+    case AV_PIX_FMT_BAYER_BGGR8:
+    case AV_PIX_FMT_BAYER_BGGR16LE:
+    case AV_PIX_FMT_BAYER_BGGR16BE:
+        return "BG/GR";
+    case AV_PIX_FMT_BAYER_RGGB8:
+    case AV_PIX_FMT_BAYER_RGGB16LE:
+    case AV_PIX_FMT_BAYER_RGGB16BE:
+        return "RG/GB";
+    case AV_PIX_FMT_BAYER_GBRG8:
+    case AV_PIX_FMT_BAYER_GBRG16LE:
+    case AV_PIX_FMT_BAYER_GBRG16BE:
+        return "GB/RG";
+    case AV_PIX_FMT_BAYER_GRBG8:
+    case AV_PIX_FMT_BAYER_GRBG16LE:
+    case AV_PIX_FMT_BAYER_GRBG16BE:
+        return "GR/BG";
+    default:
+        return NULL;
+    }
+}
+
+static bool frame_layout(const AVFrame *picture, FrameLayout& layout)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(picture->format));
+    if ( !desc ||
+         desc->flags & (AV_PIX_FMT_FLAG_PAL|AV_PIX_FMT_FLAG_BITSTREAM|AV_PIX_FMT_FLAG_HWACCEL) )
+        return false;
+#ifdef AV_PIX_FMT_FLAG_FLOAT
+    if ( desc->flags & AV_PIX_FMT_FLAG_FLOAT )
+        return false;
+#endif
+    bool be = desc->flags & AV_PIX_FMT_FLAG_BE;
+    layout.pattern = bayer_pattern(picture->format);
+    if ( layout.pattern ) {
+        /* raw CFA, components of the descriptor describe the mosaic */
+        layout.kind = FrameLayout::Bayer;
+        FrameComponent& c = layout.comp[0];
+        int depth = av_get_bits_per_pixel(desc) > 8 ? 16 : 8;
+        c.data = picture->data[0];
+        c.linesize = picture->linesize[0];
+        c.step = depth / 8;
+        c.offset = 0;
+        c.shift = 0;
+        c.mask = (1 << depth) - 1;
+        c.log2w = c.log2h = 0;
+        c.wide = depth > 8;
+        c.be = be;
+        layout.offset[0] = 0;
+        layout.scale[0] = float(QuantumRange) / c.mask;
+        return true;
+    }
+    int n = desc->nb_components < 3 ? 1 : 3;
+    for (int i = 0 ; i < n ; ++i ) {
+        const AVComponentDescriptor& d = desc->comp[i];
+        if ( d.depth > 16 )
+            return false;
+        FrameComponent& c = layout.comp[i];
+        c.data = picture->data[d.plane];
+        c.linesize = picture->linesize[d.plane];
+        c.step = d.step;
+        c.offset = d.offset;
+        c.shift = d.shift;
+        c.mask = (1 << d.depth) - 1;
+        c.log2w = ( i && !(desc->flags & AV_PIX_FMT_FLAG_RGB) ) ? desc->log2_chroma_w : 0;
+        c.log2h = ( i && !(desc->flags & AV_PIX_FMT_FLAG_RGB) ) ? desc->log2_chroma_h : 0;
+        c.wide = d.shift + d.depth > 8;
+        c.be = be;
+    }
+    if ( desc->flags & AV_PIX_FMT_FLAG_RGB ) {
+        layout.kind = FrameLayout::RGB;
+        for (int i = 0 ; i < 3 ; ++i ) {
+            layout.offset[i] = 0;
+            layout.scale[i] = float(QuantumRange) / layout.comp[i].mask;
+        }
+        return true;
+    }
+    layout.kind = n == 1 ? FrameLayout::Gray : FrameLayout::YUV;
+    bool full = picture->color_range == AVCOL_RANGE_JPEG ||
+            0 == strncmp(desc->name, "yuvj", 4) ||
+            ( n == 1 && picture->color_range != AVCOL_RANGE_MPEG );
+    int depth = desc->comp[0].depth;
+    float unit = float(1 << depth) / 256.;
+    if ( full ) {
+        layout.offset[0] = 0;
+        layout.scale[0] = float(QuantumRange) / ((1 << depth) - 1);
+        layout.offset[1] = layout.offset[2] = 128 * unit;
+        layout.scale[1] = layout.scale[2] = float(QuantumRange) / ((1 << depth) - 1);
+    }
+    else {
+        layout.offset[0] = 16 * unit;
+        layout.scale[0] = float(QuantumRange) / (219 * unit);
+        layout.offset[1] = layout.offset[2] = 128 * unit;
+        layout.scale[1] = layout.scale[2] = float(QuantumRange) / (224 * unit);
+    }
+    float kr, kb;
+    switch (picture->colorspace) {
+    case AVCOL_SPC_BT709:
+        kr = .2126; kb = .0722; break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        kr = .2627; kb = .0593; break;
+    case AVCOL_SPC_SMPTE240M:
+        kr = .212; kb = .087; break;
+    default:
+        kr = .299; kb = .114; break;
+    }
+    float kg = 1. - kr - kb;
+    layout.rv = 2. * (1. - kr);
+    layout.gu = 2. * kb * (1. - kb) / kg;
+    layout.gv = 2. * kr * (1. - kr) / kg;
+    layout.bu = 2. * (1. - kb);
+    return true;
+}
+
+#define VIDEO_CHUNK 256
+
+/*
+ * samples are gathered into small float arrays so that the arithmetic
+ * loops below are plain, vectorizable, loops
+ */
+static void convert_row(const FrameLayout& layout, int y, int w,
+                        Magick::PixelPacket *pixels)
+{
+    float c0[VIDEO_CHUNK], c1[VIDEO_CHUNK], c2[VIDEO_CHUNK];
+    for ( int x0 = 0 ; x0 < w ; x0 += VIDEO_CHUNK ) {
+        int n = qMin(VIDEO_CHUNK, w - x0);
+        switch (layout.kind) {
+        case FrameLayout::Bayer:
+        case FrameLayout::Gray:
+            for (int i = 0 ; i < n ; ++i )
+                c0[i] = frame_sample(layout.comp[0], x0+i, y);
+            for (int i = 0 ; i < n ; ++i ) {
+                c0[i] = (c0[i] - layout.offset[0]) * layout.scale[0];
+                c1[i] = c2[i] = c0[i];
+            }
+            break;
+        case FrameLayout::RGB:
+            for (int i = 0 ; i < n ; ++i ) {
+                c0[i] = frame_sample(layout.comp[0], x0+i, y);
+                c1[i] = frame_sample(layout.comp[1], x0+i, y);
+                c2[i] = frame_sample(layout.comp[2], x0+i, y);
+            }
+            for (int i = 0 ; i < n ; ++i ) {
+                c0[i] *= layout.scale[0];
+                c1[i] *= layout.scale[1];
+                c2[i] *= layout.scale[2];
+            }
+            break;
+        case FrameLayout::YUV:
+            for (int i = 0 ; i < n ; ++i ) {
+                c0[i] = frame_sample(layout.comp[0], x0+i, y);
+                c1[i] = frame_sample(layout.comp[1], x0+i, y);
+                c2[i] = frame_sample(layout.comp[2], x0+i, y);
+            }
+            for (int i = 0 ; i < n ; ++i ) {
+                float l = (c0[i] - layout.offset[0]) * layout.scale[0];
+                float u = (c1[i] - layout.offset[1]) * layout.scale[1];
+                float v = (c2[i] - layout.offset[2]) * layout.scale[2];
+                c0[i] = l + layout.rv * v;
+                c1[i] = l - layout.gu * u - layout.gv * v;
+                c2[i] = l + layout.bu * u;
+            }
+            break;
+        }
+        for (int i = 0 ; i < n ; ++i ) {
+            pixels[x0+i].red = clamp<quantum_t>(DF_ROUND(c0[i]), 0, QuantumRange);
+            pixels[x0+i].green = clamp<quantum_t>(DF_ROUND(c1[i]), 0, QuantumRange);
+            pixels[x0+i].blue = clamp<quantum_t>(DF_ROUND(c2[i]), 0, QuantumRange);
+        }
+    }
 }
 
 /**
@@ -237,34 +476,33 @@ bool WorkerLoadVideo::push_frame(AVFrame *picture,
     if ( m_error )
         return false;
 
-    if ( m_skip ) {
-        --m_skip;
-    }
-    else if ( m_count ) {
+    if ( m_count ) {
         int w = picture->width;
         int h = picture->height;
-        int div = 1;
-        switch ( picture->format ) {
-        case AV_PIX_FMT_YUV420P:
-            div = 2; break;
-        case AV_PIX_FMT_YUV410P:
-            div = 4; break;
-        case AV_PIX_FMT_BGR24:
-            break;
-        default:
+        FrameLayout layout;
+        if ( !frame_layout(picture, layout) ) {
             dflWarning(tr("LoadVideo(Worker): Unsupported pixel format in file %0").arg(filename));
+            m_error = true;
             return false;
         }
 
         try {
-            Photo photo(Photo::sRGB);
+            bool cfa = layout.kind == FrameLayout::Bayer;
+            Photo photo(cfa ? Photo::Linear : Photo::sRGB);
             photo.createImage(w, h);
             QFileInfo finfo(filename);
             QString name = QString("%0[%1]").arg(finfo.fileName()).arg(n);
             photo.setIdentity(m_operator->uuid() + "/" + name);
             photo.setTag(TAG_NAME,name);
             photo.setSequenceNumber(n);
-            photo.setTag(TAG_SCALE, TAG_SCALE_NONLINEAR);
+            if ( cfa ) {
+                photo.setTag(TAG_SCALE, TAG_SCALE_LINEAR);
+                photo.setTag(TAG_PIXELS, TAG_PIXELS_CFA);
+                photo.setTag(TAG_FILTER_PATTERN, layout.pattern);
+            }
+            else {
+                photo.setTag(TAG_SCALE, TAG_SCALE_NONLINEAR);
+            }
             Magick::Image& image=photo.image();
             std::shared_ptr<Ordinary::Pixels> pixel_cache(new Ordinary::Pixels(image));
             dfl_block bool error = false;
@@ -276,37 +514,11 @@ bool WorkerLoadVideo::push_frame(AVFrame *picture,
                     error = true;
                     continue;
                 }
-                for ( int x = 0 ; x < w ; ++x ) {
-                    switch ( picture->format ) {
-                    case AV_PIX_FMT_BGR24: {
-                        const unsigned char c_b = picture->data[0][picture->linesize[0]*y + 3*x];
-                        const unsigned char c_g = picture->data[0][picture->linesize[0]*y + 3*x+1];
-                        const unsigned char c_r = picture->data[0][picture->linesize[0]*y + 3*x+2];
-
-                        pixels[x].red = c_r*257;
-                        pixels[x].green = c_g*257;
-                        pixels[x].blue = c_b*257;
-                        break;
-                    }
-                    default: {
-                        Q_ASSERT( x/div < picture->linesize[1] );
-                        Q_ASSERT( x/div < picture->linesize[2] );
-                        const unsigned char c_y = picture->data[0][picture->linesize[0]*y + x];
-                        const unsigned char c_u = picture->data[1][picture->linesize[1]*(y/div) + x/2];
-                        const unsigned char c_v = picture->data[2][picture->linesize[2]*(y/div) + x/div];
-
-                        quantum_t r, g, b;
-                        yuv420_to_rgb(c_y,c_u,c_v,r,g,b);
-                        pixels[x].red = r;
-                        pixels[x].green = g;
-                        pixels[x].blue = b;
-                        break;
-                    }
-                    }
-                }
+                convert_row(layout, y, w, pixels);
                 pixel_cache->sync();
             });
-            outputPush(0, photo);
+            pixel_cache.reset();
+            outputPush(0, proxy(photo));
             --m_count;
         }
         catch (std::exception &e) {
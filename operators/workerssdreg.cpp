@@ -109,7 +109,8 @@ public:
           }
       delete[] ssd;
       QPointF res(min_pos%dw,min_pos/dw);
-      m_worker->dflDebug("x=%f, y=%f",res.x(), res.y());
+      if ( Console::isEnabled(Console::Debug) )
+          (m_worker->dflDebug)("x=%f, y=%f",res.x(), res.y());
       return res;
   }
 
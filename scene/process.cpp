@@ -57,6 +57,8 @@
 #include "processslider.h"
 #include "processselectivelab.h"
 #include "processdirectory.h"
+#include "operatorinput.h"
+#include "operatoroutput.h"
 
 #include "console.h"
 
@@ -73,6 +75,7 @@
 #include "opsubtract.h"
 #include "opblackbody.h"
 #include "opflatfieldcorrection.h"
+#include "opcalibration.h"
 #include "opintegration.h"
 #include "opinvert.h"
 #include "opcrop.h"
@@ -130,6 +133,7 @@
 #include "oppixelextrusionmapping.h"
 #include "opcolormap.h"
 #include "opstarfinder.h"
+#include "opframequality.h"
 #include "preferences.h"
 
 QString Process::uuid()
@@ -144,6 +148,10 @@ Process::Process(ProcessScene *scene, QObject *parent) :
     m_projectName(),
     m_notes(),
     m_baseDirectory(),
+    m_proxyScale(1),
+    m_proxyFocusOnly(false),
+    m_proxyFocus(),
+    m_shards(1),
     m_scene(scene),
     m_dirty(false),
     m_availableOperators(),
@@ -212,6 +220,7 @@ Process::Process(ProcessScene *scene, QObject *parent) :
     m_availableOperators.push_back(new OpBlend(this));
     m_availableOperators.push_back(new OpIntegration(this));
     m_availableOperators.push_back(new OpFlatFieldCorrection(this));
+    m_availableOperators.push_back(new OpCalibration(this));
     m_availableOperators.push_back(new OpBracketing(this));
 
     m_availableOperators.push_back(new OpCrop(this));
@@ -232,6 +241,7 @@ Process::Process(ProcessScene *scene, QObject *parent) :
     m_availableOperators.push_back(new OpMultiplexer(0, this));
 
     m_availableOperators.push_back(new OpStarFinder(this));
+    m_availableOperators.push_back(new OpFrameQuality(this));
     m_availableOperators.push_back(new OpPixelExtrusionMapping(this));
     m_availableOperators.push_back(new OpColorMap(this));
 
@@ -333,6 +343,189 @@ void Process::setBaseDirectory(const QString &baseDirectory)
     }
 }
 
+int Process::proxyScale() const
+{
+    return m_proxyScale;
+}
+
+/**
+ * @brief Process::setProxyScale
+ * @param proxyScale the loaders produce photos downsampled by this factor,
+ * 1 for full resolution
+ */
+void Process::setProxyScale(int proxyScale)
+{
+    proxyScale = qMax(1, proxyScale);
+    if ( m_proxyScale != proxyScale ) {
+        m_proxyScale = proxyScale;
+        setDirty(true);
+        invalidateProxySources();
+    }
+}
+
+bool Process::proxyFocusOnly() const
+{
+    return m_proxyFocusOnly;
+}
+
+void Process::setProxyFocusOnly(bool proxyFocusOnly)
+{
+    if ( m_proxyFocusOnly != proxyFocusOnly ) {
+        m_proxyFocusOnly = proxyFocusOnly;
+        setDirty(true);
+        if ( m_proxyScale > 1 )
+            invalidateProxySources();
+    }
+}
+
+/**
+ * @brief Process::proxyFocus
+ * @return the identity of the only photo processed, empty if the whole
+ * sets are processed
+ */
+QString Process::proxyFocus() const
+{
+    if ( m_proxyScale > 1 && m_proxyFocusOnly )
+        return m_proxyFocus;
+    return QString();
+}
+
+void Process::setProxyFocus(const QString &photoIdentity)
+{
+    if ( m_proxyFocus != photoIdentity ) {
+        m_proxyFocus = photoIdentity;
+        if ( m_proxyScale > 1 && m_proxyFocusOnly )
+            invalidateProxySources();
+    }
+}
+
+int Process::shards() const
+{
+    return m_shards;
+}
+
+/**
+ * @brief Process::setShards
+ * @param shards the number of worker processes sharing the frames of the
+ * per-frame segments of the graph, 1 to process everything in-process
+ */
+void Process::setShards(int shards)
+{
+    shards = qMax(1, shards);
+    if ( m_shards != shards ) {
+        m_shards = shards;
+        setDirty(true);
+    }
+}
+
+void Process::renderFullResolution()
+{
+    setProxyScale(1);
+    foreach(Operator *op, operators()) {
+        bool terminal = true;
+        foreach(OperatorOutput *output, op->getOutputs()) {
+            if ( output->sinks().count() ) {
+                terminal = false;
+                break;
+            }
+        }
+        if ( terminal && !op->isUpToDate() )
+            op->play();
+    }
+}
+
+/**
+ * @brief Process::requestRegion
+ * restricts the evaluation of op to an area of one photo. The area is
+ * expanded upstream by the footprints of the operators up to the first
+ * one that needs whole frames, the other operators get back to whole frames.
+ * An upstream operator is only restricted when all its consumers are, its
+ * result would be read whole otherwise.
+ * A null region cancels the request.
+ */
+void Process::requestRegion(Operator *op, const QString &photoIdentity, const QRect &region)
+{
+    QMap<Operator*, QRect> regions;
+    if ( !region.isNull() && op->footprint() != Operator::FootprintGlobal ) {
+        QList<Operator*> pending;
+        regions[op] = region;
+        pending.push_back(op);
+        while ( !pending.isEmpty() ) {
+            Operator *current = pending.takeFirst();
+            QRect needed = current->inputRegion(regions[current]);
+            foreach(OperatorInput *input, current->getInputs()) {
+                foreach(OperatorOutput *source, input->sources()) {
+                    Operator *parent = source->m_operator;
+                    QRect parentRegion;
+                    if ( parent->footprint() != Operator::FootprintGlobal )
+                        parentRegion = needed;
+                    if ( regions.contains(parent) ) {
+                        QRect previous = regions[parent];
+                        /* a null region stands for the whole frame */
+                        if ( previous.isNull() )
+                            continue;
+                        if ( !parentRegion.isNull() )
+                            parentRegion |= previous;
+                        if ( parentRegion == previous )
+                            continue;
+                    }
+                    regions[parent] = parentRegion;
+                    pending.push_back(parent);
+                }
+            }
+        }
+        /* a result also read by a whole frame consumer is kept whole,
+         * and so are the results it is computed from */
+        bool changed = true;
+        while ( changed ) {
+            changed = false;
+            foreach(Operator *current, regions.keys()) {
+                if ( current == op || regions[current].isNull() )
+                    continue;
+                bool bound = true;
+                foreach(OperatorOutput *output, current->getOutputs())
+                    foreach(OperatorInput *sink, output->sinks())
+                        if ( regions.value(sink->m_operator).isNull() )
+                            bound = false;
+                if ( !bound ) {
+                    regions[current] = QRect();
+                    changed = true;
+                }
+            }
+        }
+    }
+    foreach(Operator *current, operators())
+        current->setRegion(photoIdentity, regions.value(current));
+}
+
+Operator *Process::findOperator(const QString &uuid)
+{
+    foreach(Operator *op, operators())
+        if ( op->uuid() == uuid )
+            return op;
+    return NULL;
+}
+
+QVector<Operator*> Process::operators()
+{
+    QVector<Operator*> ops;
+    foreach (QGraphicsItem *item, m_scene->items()) {
+        if ( item->type() == QGraphicsItem::UserType + ProcessScene::UserTypeNode ) {
+            ProcessNode *node = dynamic_cast<ProcessNode *>(item);
+            ops.push_back(node->m_operator);
+        }
+    }
+    return ops;
+}
+
+void Process::invalidateProxySources()
+{
+    foreach(Operator *op, operators()) {
+        if ( op->isProxySource() )
+            op->setOutOfDate();
+    }
+}
+
 bool Process::dirty() const
 {
     return m_dirty;
@@ -364,7 +557,18 @@ void Process::setProjectFile(const QString &projectFile)
 
 void Process::save()
 {
-    QDir projectFileDir(QFileInfo(projectFile()).absoluteDir());
+    if ( write(projectFile()) )
+        setDirty(false);
+}
+
+/**
+ * @brief Process::write
+ * writes the project to filename, paths are made relative to its
+ * directory. the project file and the dirty state are left untouched
+ */
+bool Process::write(const QString &filename)
+{
+    QDir projectFileDir(QFileInfo(filename).absoluteDir());
     QJsonObject obj;
     QJsonArray nodes;
     QJsonArray connections;
@@ -372,6 +576,9 @@ void Process::save()
     obj["projectName"]=projectName();
     obj["notes"]=notes();
     obj["baseDirectory"]=projectFileDir.relativeFilePath(baseDirectory());
+    obj["proxyScale"]=proxyScale();
+    obj["proxyFocusOnly"]=proxyFocusOnly();
+    obj["shards"]=shards();
     foreach (QGraphicsItem *item, m_scene->items()) {
         if ( item->type() == QGraphicsItem::UserType + ProcessScene::UserTypeNode ) {
             ProcessNode *node = dynamic_cast<ProcessNode *>(item);
@@ -387,15 +594,15 @@ void Process::save()
     obj["connections"] = connections;
 
     doc.setObject(obj);
-    QFile saveFile(projectFile());
+    QFile saveFile(filename);
     if (!saveFile.open(QIODevice::WriteOnly)) {
            dflWarning(tr("Process: Couldn't open save file."));
-       return;
+       return false;
     }
 
     //saveFile.write(doc.toBinaryData());
-    saveFile.write(doc.toJson());
-    setDirty(false);
+    QByteArray data = doc.toJson();
+    return saveFile.write(data) == data.size();
 }
 
 void Process::load(const QString& filename)
@@ -415,6 +622,9 @@ void Process::load(const QString& filename)
     setProjectName(obj["projectName"].toString());
     setNotes(obj["notes"].toString());
     setBaseDirectory(projectFileDir.absoluteFilePath(obj["baseDirectory"].toString()));
+    setProxyScale(obj["proxyScale"].toInt(1));
+    setProxyFocusOnly(obj["proxyFocusOnly"].toBool(false));
+    setShards(obj["shards"].toInt(1));
     foreach(QJsonValue val, obj["nodes"].toArray()) {
         QJsonObject obj = val.toObject();
         bool operatorFound = false;
@@ -631,6 +841,10 @@ void Process::reset()
     setProjectFile("");
     setBaseDirectory(preferences->baseDir());
     m_scene->clear();
+    setProxyScale(1);
+    setProxyFocusOnly(false);
+    setProxyFocus(QString());
+    setShards(1);
     setDirty(true);
 }
 void Process::spawnContextMenu(const QPoint& pos)
@@ -47,6 +47,7 @@ class ProcessNode;
 class ProcessConnection;
 class QGraphicsItem;
 class QMenu;
+class QRect;
 
 #define PEN_WIDTH 0
 #define MARGIN 2
@@ -76,8 +77,23 @@ public:
     QString baseDirectory() const;
     void setBaseDirectory(const QString &outputDirectory);
 
+    int proxyScale() const;
+    void setProxyScale(int proxyScale);
+
+    bool proxyFocusOnly() const;
+    void setProxyFocusOnly(bool proxyFocusOnly);
+
+    QString proxyFocus() const;
+    void setProxyFocus(const QString &photoIdentity);
+
+    int shards() const;
+    void setShards(int shards);
+
+    void requestRegion(Operator *op, const QString& photoIdentity, const QRect& region);
+
     void reset();
     void save();
+    bool write(const QString& filename);
     void load(const QString& filename);
 
 
@@ -88,6 +104,7 @@ public:
     void spawnContextMenu(const QPoint& pos);
 
     ProcessNode *findNode(const QString& uuid);
+    Operator *findOperator(const QString& uuid);
 
     ProcessScene *scene() const;
 
@@ -95,6 +112,7 @@ signals:
     void stateChanged();
 
 public slots:
+    void renderFullResolution();
 
 private slots:
     void contextMenuSignal(QGraphicsSceneContextMenuEvent *);
@@ -105,6 +123,10 @@ private:
     QString m_projectFile;
     QString m_notes;
     QString m_baseDirectory;
+    int m_proxyScale;
+    bool m_proxyFocusOnly;
+    QString m_proxyFocus;
+    int m_shards;
     ProcessScene *m_scene;
     bool m_dirty;
     QVector<Operator*> m_availableOperators;
@@ -119,6 +141,8 @@ private:
     bool eventFilter(QObject *obj, QEvent *event);
     void addParameterizedOperators();
     void addOperatorsToContextMenu();
+    QVector<Operator*> operators();
+    void invalidateProxySources();
 };
 
 #endif // PROCESS_H
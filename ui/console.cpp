@@ -29,25 +29,139 @@
  *
  */
 #include <cstdio>
+#include <atomic>
 #include "console.h"
 #include "ui_console.h"
 #include <QDateTime>
+#include <QTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QQueue>
 #include "darkflow.h"
 
+/* the console appends at most DF_CONSOLE_DRAIN_BATCH messages every
+ * DF_CONSOLE_DRAIN_INTERVAL ms, whatever the rate they are logged at */
+#define DF_CONSOLE_RING_SIZE 4096
+#define DF_CONSOLE_DRAIN_INTERVAL 100
+#define DF_CONSOLE_DRAIN_BATCH 256
+
+/**
+ * @brief The LogRing class
+ * bounded multiple producers, single consumer queue. a slot's sequence
+ * tells whether it is free for the producer of that turn or filled for
+ * the consumer. loggers never wait, when the ring is full the message is
+ * counted as dropped, unless it is a warning or worse: those go to a
+ * locked overflow queue that the consumer empties after the ring
+ */
+class LogRing
+{
+public:
+    LogRing() :
+        m_enqueue(0),
+        m_dequeue(0),
+        m_dropped(0),
+        m_overflowMutex(),
+        m_overflow(),
+        m_overflowCount(0)
+    {
+        for (size_t i = 0 ; i < DF_CONSOLE_RING_SIZE ; ++i )
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    void push(Console::Level level, const QString& message)
+    {
+        Slot *slot;
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        for (;;) {
+            slot = &m_slots[pos % DF_CONSOLE_RING_SIZE];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            qintptr diff = qintptr(seq) - qintptr(pos);
+            if ( diff == 0 ) {
+                if ( m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+                    break;
+            }
+            else if ( diff < 0 ) {
+                if ( level >= Console::Warning ) {
+                    QMutexLocker lock(&m_overflowMutex);
+                    m_overflow.enqueue(qMakePair(level, message));
+                    m_overflowCount.fetch_add(1, std::memory_order_release);
+                }
+                else {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+            else {
+                pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        slot->message = message;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    bool pop(Console::Level *level, QString *message)
+    {
+        Slot *slot = &m_slots[m_dequeue % DF_CONSOLE_RING_SIZE];
+        if ( slot->sequence.load(std::memory_order_acquire) != m_dequeue + 1 ) {
+            if ( 0 == m_overflowCount.load(std::memory_order_acquire) )
+                return false;
+            QMutexLocker lock(&m_overflowMutex);
+            QPair<Console::Level, QString> entry = m_overflow.dequeue();
+            m_overflowCount.fetch_sub(1, std::memory_order_relaxed);
+            *level = entry.first;
+            *message = entry.second;
+            return true;
+        }
+        *level = slot->level;
+        *message = slot->message;
+        slot->message = QString();
+        slot->sequence.store(m_dequeue + DF_CONSOLE_RING_SIZE, std::memory_order_release);
+        ++m_dequeue;
+        return true;
+    }
+
+    size_t takeDropped()
+    {
+        return m_dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Console::Level level;
+        QString message;
+    };
+    Slot m_slots[DF_CONSOLE_RING_SIZE];
+    std::atomic<size_t> m_enqueue;
+    size_t m_dequeue;
+    std::atomic<size_t> m_dropped;
+    QMutex m_overflowMutex;
+    QQueue<QPair<Console::Level, QString> > m_overflow;
+    std::atomic<size_t> m_overflowCount;
+};
+
+static LogRing logRing;
+
 Console *console = NULL;
+QAtomicInt Console::s_threshold(Console::Info);
 
 Console::Console(QWidget *parent) :
     QMainWindow(parent),
     m_level(Info),
     m_raiseLevel(Error),
     m_trapLevel(LastLevel),
+    m_drainTimer(new QTimer(this)),
     ui(new Ui::Console)
 {
     ui->setupUi(this);
     setWindowIcon(QIcon(DF_ICON));
     setWindowFlags(Qt::Tool);
     ui->textEdit->setStyleSheet("QTextEdit { background-color: black }");
-    connect(this, SIGNAL(message(Level, QString)), this, SLOT(recvMessage(Level, QString)), Qt::QueuedConnection);
+    updateThreshold();
+    connect(m_drainTimer, SIGNAL(timeout()), this, SLOT(drain()));
+    m_drainTimer->start(DF_CONSOLE_DRAIN_INTERVAL);
 }
 
 Console::~Console()
@@ -88,11 +202,13 @@ Console::Level Console::getLevel()
 void Console::setLevel(Console::Level level)
 {
     console->m_level = level;
+    console->updateThreshold();
 }
 
 void Console::setTrapLevel(Console::Level level)
 {
     console->m_trapLevel = level;
+    console->updateThreshold();
 }
 
 void Console::setRaiseLevel(Console::Level level)
@@ -106,6 +222,31 @@ void Console::trap(Console::Level level)
         DF_TRAP();
 }
 
+/**
+ * @brief Console::post
+ * queues the message for the console, never blocks the calling thread
+ */
+void Console::post(Console::Level level, const QString &message)
+{
+    logRing.push(level, message);
+}
+
+void Console::updateThreshold()
+{
+    s_threshold.storeRelease(qMin(m_level, m_trapLevel));
+}
+
+void Console::drain()
+{
+    Level level;
+    QString message;
+    for (int i = 0 ; i < DF_CONSOLE_DRAIN_BATCH && logRing.pop(&level, &message) ; ++i )
+        recvMessage(level, message);
+    size_t dropped = logRing.takeDropped();
+    if ( dropped )
+        recvMessage(Warning, tr("Console: %0 message(s) dropped").arg(dropped));
+}
+
 void Console::recvMessage(Console::Level level, QString message)
 {
     if ( level < m_level )
@@ -142,12 +283,14 @@ void Console::recvMessage(Console::Level level, QString message)
 
 static void message(Console::Level level, const char *fmt, va_list ap)
 {
+    if ( !Console::isEnabled(level) )
+        return;
     Console::trap(level);
     char *msg;
     int ret;
     ret = vasprintf(&msg, fmt, ap);
     if ( ret < 0 ) return;
-    emit console->message(level, msg);
+    Console::post(level, msg);
     free(msg);
 }
 
@@ -159,7 +302,7 @@ void dflMessage(Console::Level level, char *fmt, ...)
     va_end(ap);
 }
 
-void dflDebug(const char *fmt, ...)
+void (dflDebug)(const char *fmt, ...)
 {
     va_list ap;
     va_start(ap, fmt);
@@ -167,7 +310,7 @@ void dflDebug(const char *fmt, ...)
     va_end(ap);
 }
 
-void dflInfo(const char* fmt, ...)
+void (dflInfo)(const char* fmt, ...)
 {
     va_list ap;
     va_start(ap, fmt);
@@ -198,16 +341,18 @@ void dflCritical(const char* fmt, ...)
 }
 
 void dflMessage(Console::Level level, const QString& msg) {
+    if ( !Console::isEnabled(level) )
+        return;
     Console::trap(level);
-    emit console->message(level, msg);
+    Console::post(level, msg);
 }
 
-void dflDebug(const QString &msg)
+void (dflDebug)(const QString &msg)
 {
     dflMessage(Console::Debug, msg);
 }
 
-void dflInfo(const QString &msg)
+void (dflInfo)(const QString &msg)
 {
     dflMessage(Console::Info, msg);
 }
@@ -33,6 +33,19 @@
 
 #include "ports.h"
 #include <QMainWindow>
+#include <QAtomicInt>
+
+/* debug messages are compiled out of release builds unless
+ * DF_DEBUG_LOGS=1 is defined */
+#ifndef DF_DEBUG_LOGS
+# ifdef QT_NO_DEBUG
+#  define DF_DEBUG_LOGS 0
+# else
+#  define DF_DEBUG_LOGS 1
+# endif
+#endif
+
+class QTimer;
 
 namespace Ui {
 class Console;
@@ -59,36 +72,60 @@ public:
     static void setTrapLevel(Level level);
     static void setRaiseLevel(Level level);
     static void trap(Level level);
+    static void post(Level level, const QString& message);
+
+    /**
+     * @brief isEnabled
+     * @return whether a message of this level would be displayed or
+     * trapped, safe to call from any thread before formatting anything
+     */
+    static bool isEnabled(Level level) {
+        return ( level != Debug || DF_DEBUG_LOGS ) &&
+                int(level) >= s_threshold.loadAcquire();
+    }
 
 private slots:
     void recvMessage(Level level, QString message);
-
-signals:
-    void message(Level level, QString message);
+    void drain();
 
 private:
     Level m_level;
     Level m_raiseLevel;
     Level m_trapLevel;
+    QTimer *m_drainTimer;
+    static QAtomicInt s_threshold;
     explicit Console(QWidget *parent = 0);
     Ui::Console *ui;
     ~Console();
+    void updateThreshold();
 };
 
 #define DF_NULL_PIXELS Console::tr("Could not get pixels from cache, memory exhausted?")
 
 void dflMessage(Console::Level level, char *fmt, ...) DF_PRINTF_FORMAT(2,3);
-void dflDebug(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
-void dflInfo(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
+void (dflDebug)(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
+void (dflInfo)(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
 void dflWarning(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
 void dflError(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
 void dflCritical(const char* fmt, ...) DF_PRINTF_FORMAT(1,2);
 
 void dflMessage(Console::Level, const QString& msg);
-void dflDebug(const QString& msg);
-void dflInfo(const QString& msg);
+void (dflDebug)(const QString& msg);
+void (dflInfo)(const QString& msg);
 void dflWarning(const QString& msg);
 void dflError(const QString& msg);
 void dflCritical(const QString& msg);
 
+/*
+ * debug and info messages are the chatty ones, their arguments are not
+ * even evaluated when the level is filtered out. the functions and
+ * methods of that name are declared with parentheses to escape these
+ */
+#define dflDebug(...) do { \
+    if ( Console::isEnabled(Console::Debug) ) (dflDebug)(__VA_ARGS__); \
+    } while(0)
+#define dflInfo(...) do { \
+    if ( Console::isEnabled(Console::Info) ) (dflInfo)(__VA_ARGS__); \
+    } while(0)
+
 #endif // CONSOLE_H
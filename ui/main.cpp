@@ -30,13 +30,42 @@
  */
 #include "preferences.h"
 #include "mainwindow.h"
+#include "console.h"
+#include "memorymanager.h"
+#include "profiler.h"
+#include "proxycache.h"
+#include "processscene.h"
+#include "process.h"
+#include "shard.h"
 #include <QApplication>
 #include <QTranslator>
 #include <QPalette>
 #include <QStyleFactory>
 
+/* worker process of a sharded operator, see ShardWorker */
+static int shard(int argc, char *argv[])
+{
+    if ( qgetenv("QT_QPA_PLATFORM").isEmpty() )
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+    init_platform();
+    Console::init();
+    memoryManager = new MemoryManager(QApplication::instance());
+    Profiler runs;
+    profiler = &runs;
+    proxyCache = new ProxyCache(0);
+    preferences = new Preferences;
+    /* upstream results must survive until their consumer has played */
+    memoryManager->setBudget(0);
+    ProcessScene scene;
+    Process process(&scene);
+    return Shard::run(&process, a.arguments().mid(2));
+}
+
 int main(int argc, char *argv[])
 {
+    if ( argc > 1 && QString(argv[1]) == "--shard" )
+        return shard(argc, argv);
     QApplication a(argc, argv);
     init_platform();
 #if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
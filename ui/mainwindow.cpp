@@ -46,6 +46,10 @@
 #include "process.h"
 #include "processscene.h"
 #include "preferences.h"
+#include "memorymanager.h"
+#include "profiler.h"
+#include "proxycache.h"
+#include "profiling.h"
 #include "graphicsviewinteraction.h"
 #include "operator.h"
 
@@ -158,6 +162,16 @@ void MainWindow::actionConsole()
     Console::show();
 }
 
+void MainWindow::actionProfiling()
+{
+    profiling->show();
+}
+
+void MainWindow::actionRenderFullResolution()
+{
+    process->renderFullResolution();
+}
+
 void MainWindow::actionOnlineDocumentation()
 {
     QDesktopServices::openUrl(QUrl(QString("http://www.darkflow.org/docs/home.%0/")
@@ -192,6 +206,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui(new Ui::MainWindow),
     aboutDialog(new AboutDialog(this)),
     projectProperties(new ProjectProperties(this)),
+    profiling(new Profiling(this)),
     scene(new ProcessScene(this)),
     process(0 /* postponed because of preferences */),
     zoomKey(false),
@@ -200,6 +215,10 @@ MainWindow::MainWindow(QWidget *parent) :
     graphicsViewInteraction(0)
 {
     Console::init();
+    /* outlives the operators, which report to it until destroyed */
+    memoryManager = new MemoryManager(QApplication::instance());
+    profiler = new Profiler;
+    proxyCache = new ProxyCache(Q_INT64_C(1) << 30);
     preferences = new Preferences(this);
     process = new Process(scene, this);
     ui->setupUi(this);
@@ -224,7 +243,11 @@ MainWindow::~MainWindow()
 {
     delete process;
     delete scene;
+    /* after the process, its operators record their last runs */
+    delete profiler;
+    profiler = NULL;
     delete projectProperties;
+    delete profiling;
     delete preferences;
     delete aboutDialog;
     delete ui;
@@ -252,6 +275,8 @@ void MainWindow::closeEvent(QCloseEvent *event)
     } else {
         if (aboutDialog->isVisible())
             aboutDialog->close();
+        if (profiling->isVisible())
+            profiling->close();
         Console::close();
         preferences->close();
         event->accept();
@@ -41,6 +41,7 @@ class MainWindow;
 class AboutDialog;
 class Preferences;
 class ProjectProperties;
+class Profiling;
 class Process;
 class ProcessScene;
 class GraphicsViewInteraction;
@@ -67,6 +68,8 @@ public slots:
     void actionLoad();
     void actionSaveAs();
     void actionConsole();
+    void actionProfiling();
+    void actionRenderFullResolution();
     void actionOnlineDocumentation();
     void load(const QString& filename);
 
@@ -77,6 +80,7 @@ private:
     Ui::MainWindow *ui;
     AboutDialog *aboutDialog;
     ProjectProperties *projectProperties;
+    Profiling *profiling;
     ProcessScene *scene;
     Process *process;
     bool zoomKey;
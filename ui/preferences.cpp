@@ -45,6 +45,7 @@
 #include "operatorworker.h"
 #include "darkflow.h"
 #include "mainwindow.h"
+#include "memorymanager.h"
 #include <Magick++.h>
 
 #ifdef DFL_USE_GCD
@@ -102,6 +103,7 @@ Preferences::Preferences(QWidget *parent) :
   m_currentTarget(sRGB),
   m_incompatibleAction(Error),
   m_labSelectionSize(LAB_SEL_SIZE),
+  m_streamingMode(false),
   m_palette(),
   m_atWork(0)
 {
@@ -113,6 +115,7 @@ Preferences::Preferences(QWidget *parent) :
 
     ui->defaultDflThreads->setText(QString::number(m_OpenMPThreads));
     ui->defaultDflWorkers->setText(QString::number(m_scheduledMaxWorkers));
+    ui->defaultDflResults->setText(tr("unlimited"));
 
     bool loaded = load(false);
 
@@ -121,6 +124,7 @@ Preferences::Preferences(QWidget *parent) :
 
         ui->valueDflThreads->setText(QString::number(m_OpenMPThreads));
         ui->valueDflWorkers->setText(QString::number(m_scheduledMaxWorkers));
+        ui->valueDflResults->setText(tr("unlimited"));
 
         ui->valueTmpDir->setText(QStandardPaths::writableLocation(QStandardPaths::TempLocation));
         ui->valueBaseDir->setText(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation));
@@ -136,6 +140,7 @@ Preferences::Preferences(QWidget *parent) :
 
         ui->comboTransformTarget->setCurrentIndex(m_currentTarget);
         ui->spinLabSelectionSize->setValue(m_labSelectionSize);
+        ui->checkBoxStreamingMode->setChecked(m_streamingMode);
     }
     load();
 }
@@ -152,6 +157,11 @@ QString Preferences::baseDir()
     return ui->valueBaseDir->text();
 }
 
+QString Preferences::getTmpDir() const
+{
+    return ui->valueTmpDir->text();
+}
+
 bool Preferences::acquireWorker(OperatorWorker *worker)
 {
     bool success;
@@ -274,6 +284,12 @@ bool Preferences::load(bool create)
     }
     ui->valueDflThreads->setText(QString::number(m_OpenMPThreads));
     ui->valueDflWorkers->setText(QString::number(dflWorkers));
+    int64_t results = resources["results"].toDouble();
+    if ( results <= 0 )
+        ui->valueDflResults->setText(tr("unlimited"));
+    else
+        ui->valueDflResults->setText(QString::number(mul*results));
+    memoryManager->setBudget(results);
 
     int64_t area = resources["area"].toDouble();
     int64_t memory = resources["memory"].toDouble();
@@ -311,6 +327,8 @@ bool Preferences::load(bool create)
     if ( 0 == m_labSelectionSize )
         m_labSelectionSize = LAB_SEL_SIZE;
     ui->spinLabSelectionSize->setValue(m_labSelectionSize);
+    m_streamingMode = pixels["streamingMode"].toBool();
+    ui->checkBoxStreamingMode->setChecked(m_streamingMode);
 
     ui->valueTmpDir->setText(path["tmp"].toString());
     ui->valueBaseDir->setText(path["base"].toString());
@@ -363,6 +381,10 @@ void Preferences::save()
         dflWorkers = 1;
     resources["darkflowWorkers"] = dflWorkers;
     resources["darkflowThreads"] = dflThreads;
+    QString resultsStr = ui->valueDflResults->text();
+    qint64 results = (resultsStr.isEmpty()||resultsStr==tr("unlimited"))?-1:resultsStr.toDouble()*mul;
+    resources["results"] = results;
+    memoryManager->setBudget(results);
 
     m_currentTarget = TransformTarget(ui->comboTransformTarget->currentIndex());
     pixels["transformTarget"] = m_currentTarget;
@@ -370,6 +392,8 @@ void Preferences::save()
     pixels["incompatibleAction"] = m_incompatibleAction;
     m_labSelectionSize = ui->spinLabSelectionSize->value();
     pixels["labSelectionSize"] = m_labSelectionSize;
+    m_streamingMode = ui->checkBoxStreamingMode->isChecked();
+    pixels["streamingMode"] = m_streamingMode;
 
     path["tmp"] = ui->valueTmpDir->text();
     path["base"] = ui->valueBaseDir->text();
@@ -572,6 +596,16 @@ int Preferences::getNumThreads() const
     return m_OpenMPThreads;
 }
 
+void Preferences::setNumThreads(int threads)
+{
+    /* session only, the saved resources are untouched */
+    if ( threads < 1 )
+        threads = 1;
+    if ( threads > 1024 )
+        threads = 1024;
+    m_OpenMPThreads = threads;
+}
+
 int Preferences::getMagickNumThreads() const
 {
     return Magick::ResourceLimits::thread();
@@ -582,6 +616,11 @@ int Preferences::getLabSelectionSize() const
     return m_labSelectionSize;
 }
 
+bool Preferences::getStreamingMode() const
+{
+    return m_streamingMode;
+}
+
 QString Preferences::getAppConfigLocation() const
 {
 #if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
@@ -63,6 +63,7 @@ public:
     ~Preferences();
 
     QString baseDir();
+    QString getTmpDir() const;
 
     bool acquireWorker(OperatorWorker *worker);
     void releaseWorker();
@@ -70,8 +71,10 @@ public:
     TransformTarget getCurrentTarget() const;
     IncompatibleAction getIncompatibleAction() const;
     int getNumThreads() const;
+    void setNumThreads(int threads);
     int getMagickNumThreads() const;
     int getLabSelectionSize() const;
+    bool getStreamingMode() const;
     QString getAppConfigLocation() const;
     QColor color(QPalette::ColorRole role);
     void incrAtWork();
@@ -109,6 +112,7 @@ private:
     TransformTarget m_currentTarget;
     IncompatibleAction m_incompatibleAction;
     int m_labSelectionSize;
+    bool m_streamingMode;
     QPalette m_palette;
     unsigned long m_atWork;
 };
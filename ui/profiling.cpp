@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2006-2016, Guillaume Gimenez <guillaume@blackmilk.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of G.Gimenez nor the names of its contributors may
+ *       be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL G.Gimenez BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors:
+ *     * Guillaume Gimenez <guillaume@blackmilk.fr>
+ *
+ */
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QTableWidgetItem>
+
+#include "profiling.h"
+#include "ui_profiling.h"
+#include "darkflow.h"
+#include "profiler.h"
+#include "preferences.h"
+
+typedef enum {
+    ColOperator,
+    ColRuns,
+    ColWall,
+    ColCpu,
+    ColFrames,
+    ColThroughput,
+    ColMemory,
+    ColWaitWorker,
+    ColWaitParents,
+    ColThreads,
+    ColCount
+} Column;
+
+static const char *ColumnStr[ColCount] = {
+    QT_TRANSLATE_NOOP("Profiling", "Operator"),
+    QT_TRANSLATE_NOOP("Profiling", "Runs"),
+    QT_TRANSLATE_NOOP("Profiling", "Wall (ms)"),
+    QT_TRANSLATE_NOOP("Profiling", "CPU (ms)"),
+    QT_TRANSLATE_NOOP("Profiling", "Frames"),
+    QT_TRANSLATE_NOOP("Profiling", "MP/s"),
+    QT_TRANSLATE_NOOP("Profiling", "Peak memory (MB)"),
+    QT_TRANSLATE_NOOP("Profiling", "Wait worker (ms)"),
+    QT_TRANSLATE_NOOP("Profiling", "Wait parents (ms)"),
+    QT_TRANSLATE_NOOP("Profiling", "Threads busy (%)")
+};
+
+Profiling::Profiling(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::Profiling),
+    m_timer()
+{
+    ui->setupUi(this);
+    setWindowIcon(QIcon(DF_ICON));
+    setWindowFlags(Qt::Tool);
+    QStringList labels;
+    for (int i = 0 ; i < ColCount ; ++i)
+        labels << tr(ColumnStr[i]);
+    ui->table->setColumnCount(ColCount);
+    ui->table->setHorizontalHeaderLabels(labels);
+    m_timer.setInterval(1000);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(updateTable()));
+    m_timer.start();
+}
+
+Profiling::~Profiling()
+{
+    delete ui;
+}
+
+void Profiling::clear()
+{
+    profiler->clear();
+    updateTable();
+}
+
+void Profiling::exportTrace()
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export trace"),
+                                                    preferences->baseDir(),
+                                                    tr("Chrome trace (*.json)"));
+    if ( filename.isEmpty() )
+        return;
+    if ( !filename.endsWith(".json", Qt::CaseInsensitive) )
+        filename += ".json";
+    if ( !profiler->exportTrace(filename) )
+        QMessageBox::warning(this, tr("Export trace"),
+                             tr("Unable to write %0").arg(filename));
+}
+
+static QTableWidgetItem *numberItem(qreal value, int precision)
+{
+    QTableWidgetItem *item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, QString::number(value, 'f', precision).toDouble());
+    item->setTextAlignment(Qt::AlignRight|Qt::AlignVCenter);
+    return item;
+}
+
+void Profiling::updateTable()
+{
+    if ( !isVisible() ) return;
+    QVector<Profiler::Summary> summaries = profiler->summaries();
+    ui->table->setSortingEnabled(false);
+    ui->table->setRowCount(summaries.count());
+    int row = 0;
+    foreach(const Profiler::Summary& s, summaries) {
+        qreal wall = s.wall / 1000.;
+        ui->table->setItem(row, ColOperator, new QTableWidgetItem(s.name));
+        ui->table->setItem(row, ColRuns, numberItem(s.runs, 0));
+        ui->table->setItem(row, ColWall, numberItem(wall, 1));
+        ui->table->setItem(row, ColCpu, numberItem(s.cpu / 1000., 1));
+        ui->table->setItem(row, ColFrames, numberItem(s.frames, 0));
+        ui->table->setItem(row, ColThroughput, numberItem(wall > 0 ? s.pixels / 1000. / wall : 0, 2));
+        ui->table->setItem(row, ColMemory, numberItem(s.peakBytes / qreal(1<<20), 1));
+        ui->table->setItem(row, ColWaitWorker, numberItem(s.waitWorker / 1000., 1));
+        ui->table->setItem(row, ColWaitParents, numberItem(s.waitParents / 1000., 1));
+        ui->table->setItem(row, ColThreads, numberItem(100. * s.utilization, 0));
+        ++row;
+    }
+    ui->table->setSortingEnabled(true);
+}
@@ -66,6 +66,12 @@ void ProjectProperties::modifyInternal(Process *process, bool andSave)
         ui->notes->setPlainText(process->notes());
         ui->project_file->setText(process->projectFile());
         ui->valueBaseDir->setText(process->baseDirectory());
+        int proxyIndex = 0;
+        for ( int scale = process->proxyScale() ; scale > 1 ; scale /= 2 )
+            ++proxyIndex;
+        ui->comboProxy->setCurrentIndex(qMin(proxyIndex, ui->comboProxy->count() - 1));
+        ui->checkProxyFocus->setChecked(process->proxyFocusOnly());
+        ui->spinShards->setValue(process->shards());
     }
     this->show();
 }
@@ -115,6 +121,9 @@ void ProjectProperties::accept()
         m_process->setProjectFile(projectFile);
         m_process->setNotes(ui->notes->toPlainText());
         m_process->setBaseDirectory(baseDir);
+        m_process->setProxyScale(1 << ui->comboProxy->currentIndex());
+        m_process->setProxyFocusOnly(ui->checkProxyFocus->isChecked());
+        m_process->setShards(ui->spinShards->value());
         if (m_andSave) {
             if ( m_process->projectFile().isEmpty())
                 QMessageBox::warning( this, tr("DarkFlow - Warning"),
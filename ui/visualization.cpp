@@ -34,6 +34,8 @@
 #include <QPixmap>
 #include <QEvent>
 #include <QScrollBar>
+#include <QTimer>
+#include <QCloseEvent>
 
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
@@ -86,7 +88,8 @@ Visualization::Visualization(Operator *op, QWidget *parent) :
     m_roi_p2(),
     m_tool(ToolNone),
     m_fullScreenView(new FullScreenView(m_scene, this)),
-    graphicsViewInteraction(0)
+    graphicsViewInteraction(0),
+    m_regionTimer(new QTimer(this))
 {
     ui->setupUi(this);
     setWindowIcon(QIcon(DF_ICON));
@@ -137,6 +140,12 @@ Visualization::Visualization(Operator *op, QWidget *parent) :
     connect(ui->tree_photos, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)),
             this, SLOT(treeWidgetItemDoubleClicked(QTreeWidgetItem*,int)));
     connect(graphicsViewInteraction, SIGNAL(zoomChanged(qreal)), this, SLOT(zoomChanged(qreal)));
+    m_regionTimer->setSingleShot(true);
+    m_regionTimer->setInterval(300);
+    connect(m_regionTimer, SIGNAL(timeout()), this, SLOT(requestViewportRegion()));
+    connect(ui->checkBox_viewport, SIGNAL(toggled(bool)), this, SLOT(viewportOnlyToggled(bool)));
+    connect(ui->graphicsView->horizontalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(viewportChanged()));
+    connect(ui->graphicsView->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(viewportChanged()));
     ui->graphicsView->setMouseTracking(true);
     ui->value_EV_R->setAlignment(Qt::AlignRight);
     ui->value_EV_G->setAlignment(Qt::AlignRight);
@@ -195,6 +204,7 @@ void Visualization::zoomChanged(qreal factor)
         ui->radio_zoom1->click();
     else
         ui->radio_zoomCustom->click();
+    viewportChanged();
 }
 
 void Visualization::getViewGamma(qreal &gamma, qreal &x0) const
@@ -226,8 +236,11 @@ void Visualization::expChanged()
         qreal gamma, x0;
         getViewGamma(gamma, x0);
         ui->value_exp->setText(tr("%0 EV").arg(exposure));
+        QSize frame;
+        QRect region = m_photo->getRegion(&frame);
         m_pixmapItem->setPixmap(m_photo->imageToPixmap(gamma, x0, pow(2.,exposure)));
-        m_scene->setSceneRect(0,0,m_photo->image().columns(),m_photo->image().rows());
+        m_pixmapItem->setOffset(region.topLeft());
+        m_scene->setSceneRect(0,0,frame.width(),frame.height());
     }
 }
 
@@ -250,7 +263,7 @@ void Visualization::outOfDate()
     }
     if ( this->isVisible() && ui->checkBox_autoPlay->isChecked() ) {
         dflDebug(tr("%0 Visualization requests play").arg(m_operator->uuid()));
-        m_operator->play();
+        m_operator->replay();
     }
 }
 
@@ -508,8 +521,10 @@ void Visualization::updateColorLabels(const QPointF& pos)
     bool clearStatus = true;
 
     if ( pos.x() >= 0 && pos.y() >= 0 && m_photo ) {
+        QPoint origin = m_photo->getRegion().topLeft();
         clearStatus = false;
-        rgb = m_photo->pixelColor(pos.x(), pos.y());
+        if ( pos.x() >= origin.x() && pos.y() >= origin.y() )
+            rgb = m_photo->pixelColor(pos.x() - origin.x(), pos.y() - origin.y());
     }
     QString rStr(tr("R: %0"));
     QString gStr(tr("G: %0"));
@@ -636,7 +651,7 @@ void Visualization::updateTreeviewPhotos()
         int idx = 0;
         foreach(OperatorOutput *source, input->sources()) {
             QTreeWidgetItem *tree_source = new TreeOutputItem(source, idx, TreeOutputItem::Source, tree_input);
-            foreach(Photo photo, source->m_result) {
+            foreach(Photo photo, source->getResult()) {
                 if ( !photo.isComplete() )
                     dflCritical(tr("Visualization: source photo is not complete"));
                 QString identity = photo.getIdentity();
@@ -679,7 +694,7 @@ void Visualization::updateTreeviewPhotos()
                                                           : TreeOutputItem::DisabledSink,
                                                           tree_outputs);
         if (m_operator->m_outputStatus[idx] == Operator::OutputEnabled) {
-            foreach(const Photo& photo, output->m_result) {
+            foreach(const Photo& photo, output->getResult()) {
                 if ( !photo.isComplete() )
                     dflCritical(tr("Visualization: output photo is not complete"));
                 TreePhotoItem *item = new TreePhotoItem(photo, TreePhotoItem::Output, tree_output);
@@ -711,6 +726,8 @@ void Visualization::photoSelectionChanged()
             m_photoItem = photoItem;
             m_photo = &photoItem->photo();
             m_photoIsInput = photoItem->isInput();
+            m_operator->m_process->setProxyFocus(m_photo->getIdentity().split('|').first());
+            viewportChanged();
             updateTabs();
             return;
         }
@@ -878,6 +895,53 @@ void Visualization::progress(int p, int c)
     ui->progressBar->setValue(100.*p/c);
 }
 
+void Visualization::viewportOnlyToggled(bool checked)
+{
+    if ( checked )
+        requestViewportRegion();
+    else
+        m_operator->m_process->requestRegion(m_operator, QString(), QRect());
+}
+
+void Visualization::viewportChanged()
+{
+    if ( ui->checkBox_viewport->isChecked() )
+        m_regionTimer->start();
+}
+
+/**
+ * @brief Visualization::requestViewportRegion
+ * asks for the visible area of the selected photo, with a margin to
+ * absorb small pans. Nothing is requested while the current region
+ * still covers the view.
+ */
+void Visualization::requestViewportRegion()
+{
+    if ( !ui->checkBox_viewport->isChecked() || !m_photo )
+        return;
+    QSize frame;
+    m_photo->getRegion(&frame);
+    QRect visible = ui->graphicsView->mapToScene(ui->graphicsView->viewport()->rect())
+            .boundingRect().toAlignedRect() & QRect(QPoint(0, 0), frame);
+    if ( visible.isEmpty() )
+        return;
+    QString identity = m_photo->getIdentity().split('|').first();
+    QRect current = m_operator->region();
+    if ( !current.isNull() && current.contains(visible) &&
+         m_operator->regionPhoto() == identity )
+        return;
+    int mx = visible.width() / 4;
+    int my = visible.height() / 4;
+    visible = visible.adjusted(-mx, -my, mx, my) & QRect(QPoint(0, 0), frame);
+    m_operator->m_process->requestRegion(m_operator, identity, visible);
+}
+
+void Visualization::closeEvent(QCloseEvent *event)
+{
+    ui->checkBox_viewport->setChecked(false);
+    QMainWindow::closeEvent(event);
+}
+
 bool Visualization::eventFilter(QObject *obj, QEvent *event)
 {
     switch(event->type()) {
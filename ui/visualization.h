@@ -50,6 +50,7 @@ class Photo;
 class QTreeWidgetItem;
 class TreePhotoItem;
 class GraphicsViewInteraction;
+class QTimer;
 
 class Visualization : public QMainWindow
 {
@@ -101,6 +102,9 @@ public slots:
 private slots:
     void rubberBandChanged(QRect rubberBandRect, QPointF fromScenePoint, QPointF toScenePoint);
     void progress(int, int);
+    void viewportOnlyToggled(bool checked);
+    void viewportChanged();
+    void requestViewportRegion();
 private:
     Ui::Visualization *ui;
     Operator *m_operator;
@@ -128,6 +132,7 @@ private:
     } m_tool;
     FullScreenView *m_fullScreenView;
     GraphicsViewInteraction *graphicsViewInteraction;
+    QTimer *m_regionTimer;
 
     void clearAllTabs();
     void updateTabs();
@@ -137,6 +142,7 @@ private:
     void updateTagsTable();
     void setInputControlEnabled(bool v);
     bool eventFilter(QObject *obj, QEvent *event);
+    void closeEvent(QCloseEvent *event);
     void drawROI();
     void storeROI();
     void reloadPoints();